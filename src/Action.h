@@ -6,20 +6,23 @@
 *
 * @param action int
 * @param value int
-* @param symbol char *
+* @param symbol const char *
 *
 * @return none
 *
-* @note Case 11 is used for special functions, none bleKeyboard related.
+* @note Case 11 is used for special functions and case 15 opens a menu,
+        none bleKeyboard related.
 */
 
-void bleKeyboardAction(int action, int value, char *symbol) {
+void bleKeyboardAction(int action, int value, const char *symbol) {
 
   Serial.println("[INFO]: BLE Keyboard action received");
-  if (!bleCombo.isConnected() && action != 11) {
+  if (!bleCombo.isConnected() && action != 11 && action != 15) {
     Serial.println("[WARN]: Ble not connected");
     return;
   }
+  latencyMark(inputLatency, LAT_ACTION, micros());
+
   switch (action) {
   case 0:
     // No Action
@@ -47,7 +50,7 @@ void bleKeyboardAction(int action, int value, char *symbol) {
         KEY_END         // 14
       };
       
-      if (value > 0 && value < sizeof(keyMap)/sizeof(keyMap[0])) {
+      if (value > 0 && (size_t)value < sizeof(keyMap)/sizeof(keyMap[0])) {
         bleCombo.write(keyMap[value]);
       }
     }
@@ -68,7 +71,7 @@ void bleKeyboardAction(int action, int value, char *symbol) {
         &KEY_MEDIA_PREVIOUS_TRACK    // 7
       };
       
-      if (value > 0 && value < sizeof(mediaKeyMap)/sizeof(mediaKeyMap[0]) && mediaKeyMap[value] != nullptr) {
+      if (value > 0 && (size_t)value < sizeof(mediaKeyMap)/sizeof(mediaKeyMap[0]) && mediaKeyMap[value] != nullptr) {
         bleCombo.write(*mediaKeyMap[value]);
       }
     }
@@ -93,7 +96,7 @@ void bleKeyboardAction(int action, int value, char *symbol) {
       
       if (value == 9) {
         bleCombo.keyReleaseAll();
-      } else if (value > 0 && value < sizeof(optionKeyMap)/sizeof(optionKeyMap[0])) {
+      } else if (value > 0 && (size_t)value < sizeof(optionKeyMap)/sizeof(optionKeyMap[0])) {
         bleCombo.keyPress(optionKeyMap[value]);
       }
     }
@@ -128,7 +131,7 @@ void bleKeyboardAction(int action, int value, char *symbol) {
         KEY_F24   // 24
       };
       
-      if (value > 0 && value < sizeof(functionKeyMap)/sizeof(functionKeyMap[0])) {
+      if (value > 0 && (size_t)value < sizeof(functionKeyMap)/sizeof(functionKeyMap[0])) {
         bleCombo.keyPress(functionKeyMap[value]);
       }
     }
@@ -159,7 +162,7 @@ void bleKeyboardAction(int action, int value, char *symbol) {
         {KEY_RIGHT_CTRL, KEY_RIGHT_ALT, KEY_RIGHT_GUI}   // 14
       };
       
-      if (value > 0 && value < sizeof(comboMap)/sizeof(comboMap[0])) {
+      if (value > 0 && (size_t)value < sizeof(comboMap)/sizeof(comboMap[0])) {
         for (int i = 0; i < 3; i++) {
           if (comboMap[value][i] != 0) {
             bleCombo.keyPress(comboMap[value][i]);
@@ -185,7 +188,7 @@ void bleKeyboardAction(int action, int value, char *symbol) {
         KEY_F11   // 11
       };
       
-      if (value > 0 && value < sizeof(helperFunctionKeys)/sizeof(helperFunctionKeys[0])) {
+      if (value > 0 && (size_t)value < sizeof(helperFunctionKeys)/sizeof(helperFunctionKeys[0])) {
         // Press configured modifiers
         if (generalconfig.modifier1 != 0) {
           bleCombo.keyPress(generalconfig.modifier1);
@@ -260,7 +263,7 @@ void bleKeyboardAction(int action, int value, char *symbol) {
         KEY_NUM_PERIOD    // 15
       };
       
-      if (value >= 0 && value < sizeof(numpadKeyMap)/sizeof(numpadKeyMap[0])) {
+      if (value >= 0 && (size_t)value < sizeof(numpadKeyMap)/sizeof(numpadKeyMap[0])) {
         bleCombo.write(numpadKeyMap[value]);
       }
     }
@@ -315,8 +318,21 @@ void bleKeyboardAction(int action, int value, char *symbol) {
       break;
     }
     break;
+  case 15: // Open menu, value is the menu number
+    if (isMenuPage(value)) {
+      navigateToPage(value);
+    }
+    break;
   default:
     // If nothing matches do nothing
     break;
   }
+
+  // Everything except no action, delay, special functions and opening a menu
+  // sent at least one report. Counted and marked once per action, not per
+  // report, bleCombo does not tell how many it sent.
+  if (action > 1 && action != 11 && action != 15) {
+    deckMetrics.hidReports++;
+    latencyMark(inputLatency, LAT_HID_REPORT, micros());
+  }
 }
@@ -0,0 +1,302 @@
+#ifndef ACTION_CODE_H
+#define ACTION_CODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DeckArena.h"
+#include "JsonStream.h"
+
+// The actions of a button are compiled to a short bytecode. An action is two
+// bytes, action and value. Actions that send text (4 and 8) are followed by
+// the offset of their text in the pool, two bytes little endian. Every menu
+// has one pool holding the texts of all its buttons, each text once, and the
+// bytecode of all its buttons:
+//
+//   | texts, NUL terminated | bytecode of button 0 | bytecode of button 1 | ...
+//
+// "No action" takes no bytecode and a numeric action takes 2 bytes instead of
+// the 66 of a fixed Action with its symbol.
+
+// Most actions a button can have, a menu file with more is rejected
+#define ACTION_CODE_MAX_OPS MENU_FIELD_ACTIONS
+
+// Longest text of an action, including the NUL
+#define ACTION_TEXT_SIZE 64
+
+// Room for any menu the parser accepts: every button with every action,
+// each with a text of its own and 4 bytes of bytecode. Only the parse pool
+// has this size, a loaded menu gets a copy of the bytes it uses, see
+// actionPoolClone().
+#define ACTION_POOL_SIZE \
+  (DECK_MAX_BUTTONS * ACTION_CODE_MAX_OPS * (ACTION_TEXT_SIZE + 4))
+
+#define ACTION_NO_TEXT 0xFFFF
+
+struct ActionPool {
+  uint16_t used;     // Bytes in use
+  uint16_t texts;    // End of the texts, the bytecode follows
+  uint8_t  overflow; // Set when something did not fit
+  uint8_t  reserved;
+  uint8_t  bytes[ACTION_POOL_SIZE];
+};
+
+// Where the bytecode of a button is in the pool of its menu
+struct ActionCode {
+  uint16_t start;
+  uint8_t  length; // In bytes
+  uint8_t  count;  // Number of actions
+};
+
+// One decoded action
+struct ActionOp {
+  uint8_t     action;
+  uint8_t     value;
+  const char *text; // Only for actions that send text, NULL otherwise
+};
+
+// The actions of one button as read from a menu file, before they are
+// compiled. Values are kept as texts in the pool because whether a value is a
+// number or a text depends on its action, which may come later in the file.
+// Compiling drops the texts that turn out to be numbers.
+struct ActionStage {
+  uint8_t  count;
+  uint8_t  action[ACTION_CODE_MAX_OPS];
+  uint16_t text[ACTION_CODE_MAX_OPS]; // Pool offset of the value, or ACTION_NO_TEXT
+};
+
+bool actionSendsText(uint8_t action) { return action == 4 || action == 8; }
+
+void actionPoolReset(ActionPool &pool) { memset(&pool, 0, offsetof(ActionPool, bytes)); }
+
+/**
+ * @brief Get the bytes at the start of a pool that hold everything in use
+ */
+uint32_t actionPoolStoredSize(const ActionPool &pool) {
+  return offsetof(ActionPool, bytes) + pool.used;
+}
+
+/**
+ * @brief Copy a pool into a heap block of just the bytes it uses
+ *
+ * @return ActionPool* to free() when done, NULL when out of memory
+ *
+ * @note The copy is only read, nothing can be added to it.
+ */
+ActionPool *actionPoolClone(const ActionPool &pool) {
+  uint32_t size = actionPoolStoredSize(pool);
+  ActionPool *clone = (ActionPool *)malloc(size);
+  if (clone) {
+    memcpy(clone, &pool, size);
+  }
+  return clone;
+}
+
+/**
+ * @brief Store a text in the pool, a text that is already there is reused
+ *
+ * @param pool ActionPool without bytecode yet
+ * @param text Text to store
+ *
+ * @return uint16_t offset of the text, ACTION_NO_TEXT when the pool is full
+ */
+uint16_t actionPoolIntern(ActionPool &pool, const char *text) {
+  uint16_t pos = 0;
+  while (pos < pool.texts) {
+    const char *stored = (const char *)pool.bytes + pos;
+    if (strcmp(stored, text) == 0) {
+      return pos;
+    }
+    pos += strlen(stored) + 1;
+  }
+
+  size_t size = strlen(text) + 1;
+  if (pool.used != pool.texts || pool.used + size > ACTION_POOL_SIZE) {
+    pool.overflow = 1;
+    return ACTION_NO_TEXT;
+  }
+  memcpy(pool.bytes + pool.used, text, size);
+  pool.used += size;
+  pool.texts = pool.used;
+  return pos;
+}
+
+void actionPoolEmit(ActionPool &pool, uint8_t byte) {
+  if (pool.used >= ACTION_POOL_SIZE) {
+    pool.overflow = 1;
+    return;
+  }
+  pool.bytes[pool.used++] = byte;
+}
+
+void actionStageReset(ActionStage *stages, uint8_t count) {
+  for (uint8_t b = 0; b < count; b++) {
+    stages[b].count = 0;
+    for (int i = 0; i < ACTION_CODE_MAX_OPS; i++) {
+      stages[b].action[i] = 0;
+      stages[b].text[i] = ACTION_NO_TEXT;
+    }
+  }
+}
+
+/**
+ * @brief Note that a button has an action or value at slot
+ */
+void actionStageUse(ActionStage &stage, int slot) {
+  if (slot + 1 > stage.count) {
+    stage.count = slot + 1;
+  }
+}
+
+/**
+ * @brief Check if any staged action that sends text has its value at offset
+ */
+bool actionStageSendsText(const ActionStage *stages, uint8_t count, uint16_t text) {
+  for (uint8_t b = 0; b < count; b++) {
+    for (uint8_t i = 0; i < stages[b].count; i++) {
+      if (stages[b].text[i] == text && actionSendsText(stages[b].action[i])) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Compile the staged actions of a menu into bytecode, in the pool the
+ *        values were staged in
+ *
+ * @param pool Pool holding the staged values, set to the texts that are used
+ *             and the bytecode
+ * @param stages Staged actions, one per button. The text offsets are moved
+ *               along with the texts.
+ * @param count Number of buttons, at most DECK_MAX_BUTTONS
+ * @param codes Set to the bytecode of every button
+ *
+ * @return false when the pool is full, no button has actions then
+ *
+ * @note Values of numeric actions and "no action" are dropped. With
+ *       ACTION_POOL_SIZE the pool only fills up for more than
+ *       ACTION_CODE_MAX_OPS actions a button or longer texts, which the
+ *       parser does not hand out.
+ */
+bool actionCodeCompile(ActionPool &pool, ActionStage *stages, uint8_t count,
+                       ActionCode *codes) {
+  memset(codes, 0, count * sizeof(ActionCode));
+
+  // Numbers are read before their texts are dropped, a text action without
+  // a value sends ""
+  uint8_t values[DECK_MAX_BUTTONS][ACTION_CODE_MAX_OPS];
+  for (uint8_t b = 0; b < count; b++) {
+    for (uint8_t i = 0; i < stages[b].count; i++) {
+      uint16_t text = stages[b].text[i];
+      values[b][i] = text == ACTION_NO_TEXT ? 0 : atoi((const char *)pool.bytes + text);
+      if (text == ACTION_NO_TEXT && actionSendsText(stages[b].action[i])) {
+        stages[b].text[i] = actionPoolIntern(pool, "");
+      }
+    }
+  }
+  if (pool.overflow) {
+    actionPoolReset(pool);
+    return false;
+  }
+
+  // Only the texts of actions 4 and 8 are kept, moved down over the others
+  uint16_t kept = 0;
+  uint16_t pos = 0;
+  while (pos < pool.texts) {
+    uint16_t size = strlen((const char *)pool.bytes + pos) + 1;
+    if (actionStageSendsText(stages, count, pos)) {
+      memmove(pool.bytes + kept, pool.bytes + pos, size);
+      for (uint8_t b = 0; b < count; b++) {
+        for (uint8_t i = 0; i < stages[b].count; i++) {
+          if (stages[b].text[i] == pos) {
+            stages[b].text[i] = kept;
+          }
+        }
+      }
+      kept += size;
+    }
+    pos += size;
+  }
+  pool.used = kept;
+  pool.texts = kept;
+
+  for (uint8_t b = 0; b < count; b++) {
+    codes[b].start = pool.used;
+    for (uint8_t i = 0; i < stages[b].count; i++) {
+      uint8_t action = stages[b].action[i];
+      if (action == 0) {
+        continue;
+      }
+      actionPoolEmit(pool, action);
+      actionPoolEmit(pool, values[b][i]);
+      if (actionSendsText(action)) {
+        uint16_t text = stages[b].text[i];
+        actionPoolEmit(pool, text & 0xFF);
+        actionPoolEmit(pool, text >> 8);
+      }
+      codes[b].count++;
+    }
+    codes[b].length = pool.used - codes[b].start;
+  }
+
+  if (pool.overflow) {
+    actionPoolReset(pool);
+    memset(codes, 0, count * sizeof(ActionCode));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Decode the next action of a button
+ *
+ * @param pool ActionPool of the menu
+ * @param code ActionCode of the button
+ * @param pos Position in the bytecode, start at 0
+ * @param op Set to the action
+ *
+ * @return false when there are no more actions
+ */
+bool actionCodeNext(const ActionPool &pool, const ActionCode &code,
+                    uint8_t &pos, ActionOp &op) {
+  if (pos + 2 > code.length) {
+    return false;
+  }
+  const uint8_t *p = pool.bytes + code.start + pos;
+  op.action = p[0];
+  op.value = p[1];
+  op.text = NULL;
+  pos += 2;
+  if (actionSendsText(op.action)) {
+    uint16_t text = p[2] | (p[3] << 8);
+    op.text = text < pool.texts ? (const char *)pool.bytes + text : "";
+    pos += 2;
+  }
+  return true;
+}
+
+/**
+ * @brief Check if a button does nothing but press modifier keys
+ *
+ * @return true if every action is a modifier press or a modifier combo
+ */
+bool actionCodeModifiersOnly(const ActionPool &pool, const ActionCode &code) {
+  bool hasModifier = false;
+  uint8_t pos = 0;
+  ActionOp op;
+  while (actionCodeNext(pool, code, pos, op)) {
+    // Action 5 value 9 is "release all", which is not a modifier press
+    if ((op.action == 5 && op.value != 9) || op.action == 9) {
+      hasModifier = true;
+    } else {
+      return false;
+    }
+  }
+  return hasModifier;
+}
+
+#endif // ACTION_CODE_H
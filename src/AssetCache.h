@@ -0,0 +1,182 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// The files of the configurator are served from the asset cache instead of
+// straight from the filesystem. Every asset gets a strong ETag from the CRC32
+// and length of its content, computed once at boot, and a Cache-Control
+// header. A browser that already has the asset sends the ETag back in
+// If-None-Match and gets a 304 without a body. When <file>.gz exists it is
+// sent instead of <file>, with Content-Encoding: gzip. A build with
+// CONFIGURATOR_ASSETS_IN_FLASH serves them from arrays in flash instead.
+#define ASSET_CACHE_SIZE 8
+#define ASSET_PATH_SIZE 32
+#define ASSET_ETAG_SIZE 24 // "crc32-length" in hex, quoted
+
+// A file of the configurator and how long browsers may keep it
+struct AssetSpec {
+  const char *path;
+  uint32_t    maxAge; // Seconds, 0: revalidate on every use
+};
+
+static const AssetSpec configuratorAssets[] = {
+    // Changes with the filesystem image, revalidated with its ETag
+    {"/index.htm", 0},
+    // The version is in the name
+    {"/jquery-3.5.1.slim.min.js", 31536000},
+    {"/favicon.ico", 604800},
+};
+
+// A configurator file built into the firmware, see
+// src/configurator/embed-assets.js, which writes src/WebAssets.h
+struct FlashAsset {
+  const char    *path;
+  const uint8_t *data; // PROGMEM
+  uint32_t       length;
+  uint32_t       crc;
+  bool           gzipped;
+};
+
+struct Asset {
+  char           path[ASSET_PATH_SIZE]; // As requested, e.g. "/index.htm"
+  char           etag[ASSET_ETAG_SIZE];
+  uint32_t       length;  // Bytes sent, of the .gz when gzipped
+  uint32_t       maxAge;  // See AssetSpec
+  uint8_t        gzipped; // <path>.gz is sent
+  const uint8_t *data;    // Content in flash, NULL: on the filesystem
+};
+
+struct AssetCache {
+  uint8_t count;
+  Asset   assets[ASSET_CACHE_SIZE];
+};
+
+void assetCacheReset(AssetCache &cache) { cache.count = 0; }
+
+/**
+ * @brief Add an asset
+ *
+ * @param cache AssetCache
+ * @param spec Path and lifetime of the asset
+ * @param crc CRC32 of the content that is sent
+ * @param length Length of the content that is sent
+ * @param gzipped The content is <path>.gz
+ *
+ * @return Asset* the new asset, NULL when the cache is full or the path is
+ *         too long
+ */
+Asset *assetCacheAdd(AssetCache &cache, const AssetSpec &spec, uint32_t crc,
+                     uint32_t length, bool gzipped) {
+  if (cache.count >= ASSET_CACHE_SIZE ||
+      strlen(spec.path) >= ASSET_PATH_SIZE) {
+    return NULL;
+  }
+  Asset &asset = cache.assets[cache.count++];
+  strcpy(asset.path, spec.path);
+  snprintf(asset.etag, sizeof(asset.etag), "\"%08lx-%lx\"", (unsigned long)crc,
+           (unsigned long)length);
+  asset.length = length;
+  asset.maxAge = spec.maxAge;
+  asset.gzipped = gzipped;
+  asset.data = NULL;
+  return &asset;
+}
+
+/**
+ * @brief Look up the asset of a request
+ *
+ * @param cache AssetCache
+ * @param url Path of the request, "/" is "/index.htm"
+ *
+ * @return const Asset* the asset, NULL when it is not cached
+ */
+const Asset *assetCacheFind(const AssetCache &cache, const char *url) {
+  if (strcmp(url, "/") == 0) {
+    url = "/index.htm";
+  }
+  for (uint8_t i = 0; i < cache.count; i++) {
+    if (strcmp(cache.assets[i].path, url) == 0) {
+      return &cache.assets[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Check an If-None-Match header against the ETag of an asset
+ *
+ * @param header Value of If-None-Match, a list of ETags or "*"
+ * @param etag Quoted ETag of the asset
+ *
+ * @return true if the browser has the asset, answer 304 then
+ *
+ * @note ETags are compared weakly, as If-None-Match asks: W/"x" matches "x".
+ */
+bool assetEtagMatches(const char *header, const char *etag) {
+  size_t etagLen = strlen(etag);
+  const char *p = header;
+  while (*p) {
+    while (*p == ' ' || *p == '\t' || *p == ',') {
+      p++;
+    }
+    if (*p == '*') {
+      return true;
+    }
+    if (p[0] == 'W' && p[1] == '/') {
+      p += 2;
+    }
+    const char *start = p;
+    if (*p == '"') {
+      p = strchr(p + 1, '"');
+      if (!p) {
+        return false;
+      }
+      p++;
+    } else {
+      while (*p && *p != ',' && *p != ' ') {
+        p++;
+      }
+    }
+    if ((size_t)(p - start) == etagLen && strncmp(start, etag, etagLen) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Write the Cache-Control header of an asset
+ */
+void assetCacheControl(const Asset &asset, char *buf, size_t size) {
+  if (asset.maxAge == 0) {
+    snprintf(buf, size, "no-cache");
+  } else {
+    snprintf(buf, size, "public, max-age=%lu", (unsigned long)asset.maxAge);
+  }
+}
+
+/**
+ * @brief Get the Content-Type of a file by its extension
+ */
+const char *assetContentType(const char *path) {
+  static const char *const types[][2] = {
+      {".htm", "text/html"},         {".html", "text/html"},
+      {".js", "application/javascript"}, {".css", "text/css"},
+      {".json", "application/json"}, {".ico", "image/x-icon"},
+      {".bmp", "image/bmp"},
+  };
+  const char *ext = strrchr(path, '.');
+  if (ext) {
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+      if (strcmp(ext, types[i][0]) == 0) {
+        return types[i][1];
+      }
+    }
+  }
+  return "application/octet-stream";
+}
+
+#endif // ASSET_CACHE_H
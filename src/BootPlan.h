@@ -0,0 +1,113 @@
+#ifndef BOOT_PLAN_H
+#define BOOT_PLAN_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// The boot is split into stages. Every stage runs on a fixed core, in the
+// order the stages are listed, once all stages it depends on have finished.
+// Stages on different cores run at the same time.
+#define BOOT_MAX_STAGES 16
+#define BOOT_CORES 2
+
+#define BOOT_AFTER(stage) (1UL << (stage))
+
+struct BootStage {
+  const char *name;
+  uint8_t     core;
+  uint32_t    after; // BOOT_AFTER() of every stage that must finish first
+  void (*run)();
+};
+
+// When every stage ran, in microseconds since the boot started
+struct BootTimeline {
+  uint32_t startUs[BOOT_MAX_STAGES];
+  uint32_t endUs[BOOT_MAX_STAGES];
+  uint32_t done; // BOOT_AFTER() of every finished stage
+};
+
+/**
+ * @brief Check that a plan can run to the end
+ *
+ * @param stages Stages in the order they run on their core
+ * @param count Number of stages, at most BOOT_MAX_STAGES
+ *
+ * @return false if a stage depends on a stage that does not exist or the
+ *         stages would wait on each other forever (e.g. a stage waiting for a
+ *         stage listed after it on the same core)
+ *
+ * @note Runs the plan with every stage taking no time, one step per core at a
+ *       time, the same order the cores can run it in.
+ */
+bool bootPlanValid(const BootStage *stages, uint8_t count) {
+  if (count > BOOT_MAX_STAGES) {
+    return false;
+  }
+  uint32_t all = (1UL << count) - 1;
+  for (uint8_t i = 0; i < count; i++) {
+    if ((stages[i].after & ~all) || stages[i].core >= BOOT_CORES) {
+      return false;
+    }
+  }
+
+  uint32_t done = 0;
+  uint8_t next[BOOT_CORES] = {0};
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (uint8_t core = 0; core < BOOT_CORES; core++) {
+      // Skip to the next stage on this core
+      while (next[core] < count && stages[next[core]].core != core) {
+        next[core]++;
+      }
+      if (next[core] < count &&
+          (stages[next[core]].after & done) == stages[next[core]].after) {
+        done |= BOOT_AFTER(next[core]);
+        next[core]++;
+        progress = true;
+      }
+    }
+  }
+  return done == all;
+}
+
+/**
+ * @brief Format one stage of the timeline, with a bar showing when it ran
+ *
+ * @param buf Buffer for the line
+ * @param size Size of buf
+ * @param stage Stage to format
+ * @param startUs When the stage started
+ * @param endUs When the stage finished
+ * @param totalUs Length of the whole boot, the bar spans this time
+ * @param width Number of characters in the bar
+ *
+ * @return int length of the line, as snprintf
+ *
+ * @note Looks like "display    c1   12.3 -  45.6 ms |  ###        |"
+ */
+int bootTimelineLine(char *buf, size_t size, const BootStage &stage,
+                     uint32_t startUs, uint32_t endUs, uint32_t totalUs,
+                     uint8_t width) {
+  int len = snprintf(buf, size, "%-12s c%u %7.1f - %7.1f ms |", stage.name,
+                     stage.core, startUs / 1000.0, endUs / 1000.0);
+  if (len < 0 || (size_t)len >= size) {
+    return len;
+  }
+  if (totalUs == 0) {
+    totalUs = 1;
+  }
+  uint32_t from = (uint64_t)startUs * width / totalUs;
+  uint32_t to = ((uint64_t)endUs * width + totalUs - 1) / totalUs;
+  if (to == from && to < width) {
+    to++; // Even a short stage gets a mark
+  }
+  for (uint32_t i = 0; i < width && (size_t)len + 2 < size; i++) {
+    buf[len++] = (i >= from && i < to) ? '#' : ' ';
+  }
+  buf[len++] = '|';
+  buf[len] = '\0';
+  return len;
+}
+
+#endif // BOOT_PLAN_H
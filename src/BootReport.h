@@ -0,0 +1,152 @@
+#ifndef BOOT_REPORT_H
+#define BOOT_REPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "BootPlan.h"
+
+// Timings of the last BOOT_REPORT_COUNT boots, kept in NVS as one blob.
+// Times are milliseconds since the boot started, capped at 65535.
+#define BOOT_REPORT_COUNT 4
+
+// Bump when BootReport changes or the boot stages are reordered, stored
+// reports of another version are dropped
+#define BOOT_REPORT_VERSION 1
+
+struct BootReport {
+  uint32_t number;  // Counts up with every boot
+  uint8_t  wake;    // 1 when woken from deep sleep, 0 for a cold boot
+  uint8_t  stageCount;
+  uint16_t keypadMs; // First page drawn
+  uint16_t readyMs;  // setup() done, the keypad reacts from here on
+  uint16_t startMs[BOOT_MAX_STAGES];
+  uint16_t endMs[BOOT_MAX_STAGES];
+};
+
+struct BootReportLog {
+  uint8_t    version;
+  uint8_t    count; // Number of valid reports
+  uint8_t    reserved[2];
+  uint32_t   nextNumber;
+  BootReport reports[BOOT_REPORT_COUNT]; // Newest first
+};
+
+uint16_t bootReportMs(uint32_t us) {
+  uint32_t ms = (us + 500) / 1000;
+  return ms > UINT16_MAX ? UINT16_MAX : ms;
+}
+
+/**
+ * @brief Empty the log
+ */
+void bootReportLogReset(BootReportLog &log) {
+  memset(&log, 0, sizeof(log));
+  log.version = BOOT_REPORT_VERSION;
+}
+
+/**
+ * @brief Check a log read back from NVS
+ *
+ * @param log Log as read
+ * @param len Number of bytes read
+ *
+ * @return false if it was stored by a firmware with another layout
+ */
+bool bootReportLogValid(const BootReportLog &log, size_t len) {
+  return len == sizeof(BootReportLog) && log.version == BOOT_REPORT_VERSION &&
+         log.count <= BOOT_REPORT_COUNT;
+}
+
+/**
+ * @brief Turn a boot timeline into a report and add it to the log. The
+ *        oldest report is dropped when the log is full.
+ *
+ * @param log BootReportLog
+ * @param timeline Timeline of this boot, in microseconds
+ * @param stageCount Number of stages in the timeline
+ * @param keypadStage Stage that draws the first page
+ * @param readyUs When the boot finished
+ * @param wake True when woken from deep sleep
+ *
+ * @return BootReport& the report just added
+ */
+BootReport &bootReportLogAdd(BootReportLog &log, const BootTimeline &timeline,
+                             uint8_t stageCount, uint8_t keypadStage,
+                             uint32_t readyUs, bool wake) {
+  if (stageCount > BOOT_MAX_STAGES) {
+    stageCount = BOOT_MAX_STAGES;
+  }
+  uint8_t keep = log.count < BOOT_REPORT_COUNT ? log.count
+                                               : BOOT_REPORT_COUNT - 1;
+  memmove(&log.reports[1], &log.reports[0], keep * sizeof(BootReport));
+  log.count = keep + 1;
+
+  BootReport &report = log.reports[0];
+  memset(&report, 0, sizeof(report));
+  report.number = log.nextNumber++;
+  report.wake = wake ? 1 : 0;
+  report.stageCount = stageCount;
+  report.keypadMs = bootReportMs(timeline.endUs[keypadStage]);
+  report.readyMs = bootReportMs(readyUs);
+  for (uint8_t i = 0; i < stageCount; i++) {
+    report.startMs[i] = bootReportMs(timeline.startUs[i]);
+    report.endMs[i] = bootReportMs(timeline.endUs[i]);
+  }
+  return report;
+}
+
+/**
+ * @brief Find the newest report of a cold boot or of a wake up
+ *
+ * @return const BootReport* the report, NULL if there is none
+ */
+const BootReport *bootReportLatest(const BootReportLog &log, bool wake) {
+  for (uint8_t i = 0; i < log.count; i++) {
+    if ((log.reports[i].wake != 0) == wake) {
+      return &log.reports[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Get the stage that took longest
+ */
+uint8_t bootReportSlowestStage(const BootReport &report) {
+  uint8_t slowest = 0;
+  for (uint8_t i = 1; i < report.stageCount; i++) {
+    if (report.endMs[i] - report.startMs[i] >
+        report.endMs[slowest] - report.startMs[slowest]) {
+      slowest = i;
+    }
+  }
+  return slowest;
+}
+
+/**
+ * @brief Format a report as a single line
+ *
+ * @param buf Buffer for the line
+ * @param size Size of buf
+ * @param report BootReport
+ * @param stages Stages of this firmware, for the name of the slowest one
+ * @param stageCount Number of stages
+ *
+ * @return int length of the line, as snprintf
+ *
+ * @note Looks like "#12 cold: keypad 812 ready 1234 ms, hid 603", short
+ *       enough for a line on the info page
+ */
+int bootReportSummary(char *buf, size_t size, const BootReport &report,
+                      const BootStage *stages, uint8_t stageCount) {
+  uint8_t slowest = bootReportSlowestStage(report);
+  return snprintf(buf, size, "#%lu %s: keypad %u ready %u ms, %s %u",
+                  (unsigned long)report.number, report.wake ? "wake" : "cold",
+                  report.keypadMs, report.readyMs,
+                  slowest < stageCount ? stages[slowest].name : "?",
+                  report.endMs[slowest] - report.startMs[slowest]);
+}
+
+#endif // BOOT_REPORT_H
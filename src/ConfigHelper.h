@@ -1,3 +1,73 @@
+// Minimum free heap with WiFi up for BLE to keep running next to it. The web
+// server needs it for requests, SPIFFS buffers and WebSocket clients.
+#define COEX_MIN_FREE_HEAP 40000
+
+/**
+* @brief This function makes room for WiFi, which was just started. With
+*        CONFIGURATOR_KEEP_BLE and enough heap left the BLE keyboard keeps
+*        running and both share the radio, otherwise BLE is stopped and its
+*        memory is given to WiFi.
+*
+* @param none
+*
+* @return none
+*
+* @note BLE cannot be started again without a restart once it is stopped.
+*/
+void shareRadioWithWifi() {
+#ifdef CONFIGURATOR_KEEP_BLE
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap >= COEX_MIN_FREE_HEAP) {
+    // WiFi and BLE take turns on the antenna, give the HID reports the first
+    // turn. WiFi must use modem sleep while BLE runs.
+    esp_coex_preference_set(ESP_COEX_PREFER_BT);
+    WiFi.setSleep(true);
+    bleKeptWithWifi = true;
+    Serial.printf("[INFO]: BLE kept running, %u bytes of heap free, largest "
+                  "block %u\n",
+                  freeHeap, ESP.getMaxAllocHeap());
+    return;
+  }
+  Serial.printf("[WARNING]: Only %u bytes of heap free with WiFi, stopping "
+                "BLE\n",
+                freeHeap);
+#endif // defined(CONFIGURATOR_KEEP_BLE)
+
+  // Delete the task bleKeyboard had create to free memory and to not interfere
+  // with AsyncWebServer
+  bleCombo.end();
+
+  // Stop BLE from interfering with our WIFI signal
+  btStop();
+  esp_bt_controller_disable();
+  esp_bt_controller_deinit();
+  esp_bt_controller_mem_release(ESP_BT_MODE_BTDM);
+
+  Serial.println("[INFO]: BLE Stopped");
+}
+
+/**
+* @brief This function starts the webserver and shows the configurator page.
+*
+* @param none
+*
+* @return none
+*
+* @note none
+*/
+void startWebServer() {
+  // Set pageNum to PAGE_CONFIG_MODE so no buttons are displayed. Without BLE
+  // touches are ignored, with BLE a touch goes back to the keys.
+  pageNum = PAGE_CONFIG_MODE;
+
+  // Start the webserver
+  DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
+  webserver.begin();
+  webServerRunning = true;
+  Serial.printf("[INFO]: Webserver started, %u bytes of heap free\n",
+                ESP.getFreeHeap());
+}
+
 // Start as WiFi station
 
 bool startWifiStation() {
@@ -19,31 +89,16 @@ bool startWifiStation() {
     }
   }
 
-  // Delete the task bleKeyboard had create to free memory and to not interfere
-  // with AsyncWebServer
-  bleCombo.end();
-
-  // Stop BLE from interfering with our WIFI signal
-  btStop();
-  esp_bt_controller_disable();
-  esp_bt_controller_deinit();
-  esp_bt_controller_mem_release(ESP_BT_MODE_BTDM);
+  shareRadioWithWifi();
 
   Serial.println("");
-  Serial.println("[INFO]: BLE Stopped");
   Serial.print("[INFO]: Connected! IP address: ");
   Serial.println(WiFi.localIP());
 
   MDNS.begin(wificonfig.hostname);
   MDNS.addService("http", "tcp", 80);
 
-  // Set pageNum to 7 so no buttons are displayed and touches are ignored
-  pageNum = 7;
-
-  // Start the webserver
-  DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
-  webserver.begin();
-  Serial.println("[INFO]: Webserver started");
+  startWebServer();
   return true;
 }
 
@@ -57,29 +112,12 @@ void startWifiAP() {
   Serial.print("[INFO]: Access Point Started! IP address: ");
   Serial.println(WiFi.softAPIP());
 
-  // Delete the task bleKeyboard had create to free memory and to not interfere
-  // with AsyncWebServer
-  bleCombo.end();
-
-  // Stop BLE from interfering with our WIFI signal
-  btStop();
-  esp_bt_controller_disable();
-  esp_bt_controller_deinit();
-  esp_bt_controller_mem_release(ESP_BT_MODE_BTDM);
-
-  Serial.println("");
-  Serial.println("[INFO]: BLE Stopped");
+  shareRadioWithWifi();
 
   MDNS.begin(wificonfig.hostname);
   MDNS.addService("http", "tcp", 80);
 
-  // Set pageNum to 7 so no buttons are displayed and touches are ignored
-  pageNum = 7;
-
-  // Start the webserver
-  DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
-  webserver.begin();
-  Serial.println("[INFO]: Webserver started");
+  startWebServer();
 }
 
 // Start the default AP
@@ -94,28 +132,12 @@ void startDefaultAP() {
   Serial.print("[INFO]: Access Point Started! IP address: ");
   Serial.println(WiFi.softAPIP());
 
-  // Delete the task bleKeyboard had create to free memory and to not interfere
-  // with AsyncWebServer
-  bleCombo.end();
-
-  // Stop BLE from interfering with our WIFI signal
-  btStop();
-  esp_bt_controller_disable();
-  esp_bt_controller_deinit();
-  esp_bt_controller_mem_release(ESP_BT_MODE_BTDM);
-
-  Serial.println("[INFO]: BLE Stopped");
+  shareRadioWithWifi();
 
   MDNS.begin("freetouchdeck");
   MDNS.addService("http", "tcp", 80);
 
-  // Set pageNum to 7 so no buttons are displayed and touches are ignored
-  pageNum = 7;
-
-  // Start the webserver
-  DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
-  webserver.begin();
-  Serial.println("[INFO]: Webserver started");
+  startWebServer();
 }
 
 void configmode();
@@ -126,9 +148,9 @@ void startAPReasonFailed();
 void handleCustomWifiConfig();
 void configureCommonActions();
 /**
-* @brief This function stops Bluetooth and connects to the given
-         WiFi network. It the starts mDNS and starts the Async
-         Webserver.
+* @brief This function connects to the given WiFi network, next to BLE
+         when CONFIGURATOR_KEEP_BLE is set and there is heap enough, see
+         shareRadioWithWifi(). It then starts mDNS and the Async Webserver.
 *
 * @param none
 *
@@ -143,6 +165,13 @@ void configmode() {
   tft.setTextSize(1);
   tft.setTextColor(TFT_WHITE, TFT_BLACK);
 
+  if (webServerRunning) {
+    // Opened again after going back to the keys, WiFi is still up
+    pageNum = PAGE_CONFIG_MODE;
+    configureCommonActions();
+    return;
+  }
+
   Serial.println("[INFO]: Entering Config Mode");
   tft.println("Connecting to Wifi...");
 
@@ -166,7 +195,11 @@ void configureCommonActions() {
   tft.println("To configure:");
   tft.println("http://freetouchdeck.local");
   tft.print("The IP is: ");
-  tft.println(WiFi.softAPIP());
+  tft.println(WiFi.getMode() == WIFI_STA ? WiFi.localIP() : WiFi.softAPIP());
+  if (bleKeptWithWifi) {
+    tft.println("The keyboard keeps working, touch the screen to go back to "
+                "the keys");
+  }
   if (tft.width() > 400) {
     drawSingleButton(140, 180, 200, 80, generalconfig.menuButtonColour,
                      TFT_WHITE, "Restart");
@@ -221,6 +254,26 @@ void handleCustomWifiConfig() {
   }
 }
 
+/**
+* @brief This function saves a config file: it is written next to the current
+*        one, read back and only then swapped in, see ConfigStore.h.
+*
+* @param path Path of the file, e.g. "/config/general.json"
+* @param json New content
+*
+* @return boolean True if succeeded. False otherwise, the current file is
+*         kept then.
+*/
+bool saveConfigFile(const char *path, const String &json) {
+  if (!configStoreSave(configStoreFs, path, (const uint8_t *)json.c_str(),
+                       json.length())) {
+    Serial.printf("[ERROR]: Saving %s failed, keeping the current version\n",
+                  path);
+    return false;
+  }
+  return true;
+}
+
 /**
 * @brief This function allows for saving (updating) the WiFi SSID
 *
@@ -233,9 +286,6 @@ the the configuration using loadMainConfig()
 */
 bool saveWifiSSID(const char* ssid) {
 
-  FILESYSTEM.remove("/config/wificonfig.json");
-  File file = FILESYSTEM.open("/config/wificonfig.json", "w");
-
   JsonDocument doc;
 
   JsonObject wificonfigobject = doc.to<JsonObject>();
@@ -247,13 +297,9 @@ bool saveWifiSSID(const char* ssid) {
   wificonfigobject["attempts"] = wificonfig.attempts;
   wificonfigobject["attemptdelay"] = wificonfig.attemptdelay;
 
-  if (serializeJsonPretty(doc, file) == 0) {
-    Serial.println("[WARNING]: Failed to write to file");
-    return false;
-  }
-
-  file.close();
-  return true;
+  String json;
+  serializeJsonPretty(doc, json);
+  return saveConfigFile("/config/wificonfig.json", json);
 }
 
 /**
@@ -268,9 +314,6 @@ reload the the configuration using loadMainConfig()
 */
 bool saveWifiPW(const char* password) {
 
-  FILESYSTEM.remove("/config/wificonfig.json");
-  File file = FILESYSTEM.open("/config/wificonfig.json", "w");
-
   JsonDocument doc;
 
   JsonObject wificonfigobject = doc.to<JsonObject>();
@@ -282,12 +325,9 @@ bool saveWifiPW(const char* password) {
   wificonfigobject["attempts"] = wificonfig.attempts;
   wificonfigobject["attemptdelay"] = wificonfig.attemptdelay;
 
-  if (serializeJsonPretty(doc, file) == 0) {
-    Serial.println("[WARNING]: Failed to write to file");
-    return false;
-  }
-  file.close();
-  return true;
+  String json;
+  serializeJsonPretty(doc, json);
+  return saveConfigFile("/config/wificonfig.json", json);
 }
 
 /**
@@ -308,9 +348,6 @@ bool saveWifiMode(const char* wifimode) {
     return false;
   }
 
-  FILESYSTEM.remove("/config/wificonfig.json");
-  File file = FILESYSTEM.open("/config/wificonfig.json", "w");
-
   JsonDocument doc;
 
   JsonObject wificonfigobject = doc.to<JsonObject>();
@@ -322,12 +359,9 @@ bool saveWifiMode(const char* wifimode) {
   wificonfigobject["attempts"] = wificonfig.attempts;
   wificonfigobject["attemptdelay"] = wificonfig.attemptdelay;
 
-  if (serializeJsonPretty(doc, file) == 0) {
-    Serial.println("[WARNING]: Failed to write to file");
-    return false;
-  }
-  file.close();
-  return true;
+  String json;
+  serializeJsonPretty(doc, json);
+  return saveConfigFile("/config/wificonfig.json", json);
 }
 
 /**
@@ -360,106 +394,70 @@ bool checkfile(const char *filename) {
 
 bool resetconfig(const char* file) {
 
-  if (strcmp(file, "menu1") != 0 && strcmp(file, "menu2") != 0 && strcmp(file, "menu3") != 0 &&
-      strcmp(file, "menu4") != 0 && strcmp(file, "menu5") != 0 && strcmp(file, "homescreen") != 0 &&
-      strcmp(file, "general") != 0) {
-    Serial.println("[WARNING]: Invalid reset option. Choose: menu1, menu2, "
-                   "menu3, menu4, menu5, homescreen, or general");
+  bool isMenu = deckMenuNumber(file, "") > 0;
+  if (!isMenu && strcmp(file, "homescreen") != 0 && strcmp(file, "general") != 0) {
+    Serial.printf("[WARNING]: Invalid reset option. Choose: menu1 - menu%d, "
+                  "homescreen, or general\n", DECK_MAX_MENUS);
     return false;
   }
 
-  if (strcmp(file, "menu1") == 0 || strcmp(file, "menu2") == 0 || strcmp(file, "menu3") == 0 ||
-      strcmp(file, "menu4") == 0 || strcmp(file, "menu5") == 0) {
-    // Reset a menu config
-
-    // Delete the corrupted json file
-    char filetoremove[64];
-    snprintf(filetoremove, sizeof(filetoremove), "/config/%s.json", file);
-
-    FILESYSTEM.remove(filetoremove);
+  // The corrupted file is kept as the previous version
+  char filetoreset[64];
+  snprintf(filetoreset, sizeof(filetoreset), "/config/%s.json", file);
 
-    // Copy default.json to the new config file
+  String json;
+  if (isMenu) {
+    // Reset a menu config to default.json
     File defaultfile = FILESYSTEM.open("/config/default.json", "r");
-
-    size_t  n;
-    uint8_t buf[64];
-
-    if (defaultfile) {
-      File newfile = FILESYSTEM.open(filetoremove, "w");
-      if (newfile) {
-        while ((n = defaultfile.read(buf, sizeof(buf))) > 0) {
-          newfile.write(buf, n);
-        }
-        // Close the newly created file
-        newfile.close();
-      }
-      Serial.println("[INFO]: Done resetting.");
-      Serial.println("[INFO]: Type \"restart\" to reload configuration.");
-
-      // Close the default.json file
-      defaultfile.close();
-      return true;
+    if (!defaultfile) {
+      Serial.println("[WARNING]: default.json not found");
+      return false;
     }
+    json = defaultfile.readString();
+    defaultfile.close();
 
   } else if (strcmp(file, "homescreen") == 0) {
 
     // Reset the homescreen
     // For this we do not need to open a default file because we can easily
     // write it ourselfs
-    char filetoremove[64];
-    snprintf(filetoremove, sizeof(filetoremove), "/config/%s.json", file);
-
-    FILESYSTEM.remove(filetoremove);
-
-    File newfile = FILESYSTEM.open(filetoremove, "w");
-    newfile.println("{");
-    newfile.println("\"logo0\": \"question.bmp\",");
-    newfile.println("\"logo1\": \"question.bmp\",");
-    newfile.println("\"logo2\": \"question.bmp\",");
-    newfile.println("\"logo3\": \"question.bmp\",");
-    newfile.println("\"logo4\": \"question.bmp\",");
-    newfile.println("\"logo5\": \"settings.bmp\"");
-    newfile.println("}");
-
-    newfile.close();
-    Serial.println("[INFO]: Done resetting homescreen.");
-    Serial.println("[INFO]: Type \"restart\" to reload configuration.");
-    return true;
+    json = "{\n"
+           "\"logo0\": \"question.bmp\",\n"
+           "\"logo1\": \"question.bmp\",\n"
+           "\"logo2\": \"question.bmp\",\n"
+           "\"logo3\": \"question.bmp\",\n"
+           "\"logo4\": \"question.bmp\",\n"
+           "\"logo5\": \"settings.bmp\"\n"
+           "}\n";
 
-  } else if (strcmp(file, "general") == 0) {
+  } else {
 
     // Reset the general config
     // For this we do not need to open a default file because we can easily
     // write it ourselfs
+    json = "{\n"
+           "\"menubuttoncolor\": \"#009bf4\",\n"
+           "\"functionbuttoncolor\": \"#00efcb\",\n"
+           "\"latchcolor\": \"#fe0149\",\n"
+           "\"background\": \"#000000\",\n"
+           "\"sleepenable\": true,\n"
+           "\"sleeptimer\": 10,\n"
+           "\"beep\": true,\n"
+           "\"modifier1\": 130,\n"
+           "\"modifier2\": 129,\n"
+           "\"modifier3\": 0,\n"
+           "\"helperdelay\": 500,\n"
+           "\"touchdeadzone\": 2,\n"
+           "\"touchedgezone\": 4,\n"
+           "\"touchmincontact\": [0, 0, 0, 0, 0, 0],\n"
+           "\"prefetchmenus\": true\n"
+           "}\n";
+  }
 
-    char filetoremove[64];
-    snprintf(filetoremove, sizeof(filetoremove), "/config/%s.json", file);
-
-    FILESYSTEM.remove(filetoremove);
-
-    File newfile = FILESYSTEM.open(filetoremove, "w");
-    newfile.println("{");
-    newfile.println("\"menubuttoncolor\": \"#009bf4\",");
-    newfile.println("\"functionbuttoncolor\": \"#00efcb\",");
-    newfile.println("\"latchcolor\": \"#fe0149\",");
-    newfile.println("\"background\": \"#000000\",");
-    newfile.println("\"sleepenable\": true,");
-    newfile.println("\"sleeptimer\": 10,");
-    newfile.println("\"beep\": true,");
-    newfile.println("\"modifier1\": 130,");
-    newfile.println("\"modifier2\": 129,");
-    newfile.println("\"modifier3\": 0,");
-    newfile.println("\"helperdelay\": 500");
-    newfile.println("}");
-
-    newfile.close();
-    Serial.println("[INFO]: Done resetting general config.");
-    Serial.println("[INFO]: Type \"restart\" to reload configuration.");
-    return true;
-
-  } else {
+  if (!saveConfigFile(filetoreset, json)) {
     return false;
   }
-
-  return false;
+  Serial.printf("[INFO]: Done resetting %s.\n", file);
+  configFileChanged(filetoreset);
+  return true;
 }
@@ -1,3 +1,7 @@
+#include "ConfigSnapshot.h"
+#include "ConfigStore.h"
+#include "JsonStream.h"
+
 /**
 * @brief This function opens wificonfig.json and fills the wificonfig
 *        struct accordingly.
@@ -44,16 +48,286 @@ bool loadMainConfig()
   return true;
 }
 
+/**
+* @brief Feeds the stream parser from a File
+*/
+size_t readConfigFile(void *context, uint8_t *buf, size_t len)
+{
+  return ((File *)context)->read(buf, len);
+}
+
+// ConfigStoreFs on FILESYSTEM, see ConfigStore.h
+bool configStoreExists(void *context, const char *path)
+{
+  return FILESYSTEM.exists(path);
+}
+
+bool configStoreRemove(void *context, const char *path)
+{
+  return FILESYSTEM.remove(path);
+}
+
+bool configStoreRename(void *context, const char *from, const char *to)
+{
+  return FILESYSTEM.rename(from, to);
+}
+
+bool configStoreWrite(void *context, const char *path, const uint8_t *data, size_t len)
+{
+  File file = FILESYSTEM.open(path, "w");
+  bool written = file && file.write(data, len) == len;
+  file.close();
+  return written;
+}
+
+bool configStoreCheck(void *context, const char *path, ConfigStoreSum &sum)
+{
+  File file = FILESYSTEM.open(path, "r");
+  if (!file)
+  {
+    return false;
+  }
+  uint8_t buf[64];
+  size_t  n;
+  while ((n = file.read(buf, sizeof(buf))) > 0)
+  {
+    configStoreSumAdd(sum, buf, n);
+  }
+  file.close();
+  return true;
+}
+
+ConfigStoreFs configStoreFs = {NULL, configStoreExists, configStoreRemove, configStoreRename,
+                               configStoreWrite, configStoreCheck};
+
+/**
+* @brief This function finishes or undoes config saves that a power loss
+*        interrupted, so boot reads the last good generation of every file.
+*
+* @param none
+*
+* @return none
+*
+* @note Only files with a .tmp or .new next to them were interrupted, the
+         config directory is listed once instead of checking every file.
+*/
+void recoverConfigFiles()
+{
+  char pending[8][CONFIG_STORE_PATH_SIZE];
+  int  count = 0;
+
+  File dir = FILESYSTEM.open("/config");
+  File file = dir ? dir.openNextFile() : File();
+  while (file && count < 8)
+  {
+    char path[CONFIG_STORE_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s%s", file.name()[0] == '/' ? "" : "/config/", file.name());
+    file.close();
+    size_t len = strlen(path);
+    if (len > 4 && (strcmp(path + len - 4, CONFIG_STORE_TMP) == 0 ||
+                    strcmp(path + len - 4, CONFIG_STORE_NEW) == 0))
+    {
+      path[len - 4] = '\0';
+      strlcpy(pending[count++], path, CONFIG_STORE_PATH_SIZE);
+    }
+    file = dir.openNextFile();
+  }
+  dir.close();
+
+  for (int i = 0; i < count; i++)
+  {
+    switch (configStoreRecover(configStoreFs, pending[i]))
+    {
+    case CONFIG_STORE_FINISHED:
+      Serial.printf("[WARNING]: Saving %s was interrupted, finished it\n", pending[i]);
+      break;
+    case CONFIG_STORE_ROLLED_BACK:
+      Serial.printf("[WARNING]: %s was missing, went back to the previous version\n",
+                    pending[i]);
+      break;
+    case CONFIG_STORE_FAILED:
+      Serial.printf("[ERROR]: Could not recover %s\n", pending[i]);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/**
+* @brief Gets the id of a logo in iconTable, adding it when it is new.
+*
+* @param prefix Directory of the logo, may be NULL when name is a full path
+* @param name File name of the logo
+*
+* @return IconId of the logo, ICON_NONE when the table is full
+*/
+IconId internIcon(const char *prefix, const char *name)
+{
+  IconId id = iconTableIntern(iconTable, prefix, name);
+  if (id == ICON_NONE)
+  {
+    Serial.printf("[WARNING]: No room for logo %s%s, more than %u logos in use\n",
+                  prefix ? prefix : "", name, iconTable.capacity);
+  }
+  return id;
+}
+
+/**
+* @brief Frees the ids of logos nothing refers to any more, e.g. the old
+*        logos of a menu that was reloaded. Their room is used by the next
+*        logos that are interned.
+*
+* @param none
+*
+* @return none
+*
+* @note Kept are the home screen and system icons, the logos of every menu,
+*       the latch logos of the resident menus and the keys of /screen.
+*/
+void releaseUnusedIcons()
+{
+  uint8_t keep[ICON_NONE] = {};
+  for (int i = 0; i < 6; i++)
+  {
+    iconTableKeep(iconTable, keep, homeIcons[i]);
+  }
+  IconId system[] = {systemIcons.settings, systemIcons.homebutton, systemIcons.configurator,
+                     systemIcons.brightnessDown, systemIcons.brightnessUp, systemIcons.sleep,
+                     systemIcons.info};
+  for (IconId id : system)
+  {
+    iconTableKeep(iconTable, keep, id);
+  }
+  for (int i = 0; i < deck.menuCount; i++)
+  {
+    for (int b = 0; b < menuPages[i].buttonCount; b++)
+    {
+      iconTableKeep(iconTable, keep, menuPages[i].icons[b]);
+    }
+  }
+  for (int slot = 0; slot < MENU_CACHE_SLOTS; slot++)
+  {
+    if (menuCache.menuIndex[slot] == MENU_CACHE_EMPTY)
+    {
+      continue;
+    }
+    for (int b = 0; b < menuPages[menuCache.menuIndex[slot]].buttonCount; b++)
+    {
+      iconTableKeep(iconTable, keep, menuSlots[slot].buttons[b].latchLogo);
+    }
+  }
+  for (int b = 0; b < MIRROR_KEYS; b++)
+  {
+    iconTableKeep(iconTable, keep, screenMirror.keys[b].icon);
+  }
+
+  uint8_t freed = iconTableSweep(iconTable, keep);
+  if (freed > 0)
+  {
+    Serial.printf("[INFO]: %u logos no longer in use, %u ids left\n", freed, iconTable.count);
+  }
+}
+
+// Target of a menu file while it is being parsed
+struct MenuParseTarget {
+  const char  *filename;
+  IconId      *icons;
+  Button      *buttons;
+  uint8_t      buttonCount;
+  ActionPool  *pool;
+  ActionStage *stages; // Actions are compiled once the whole file is read
+  bool         tooManyActions;
+};
+
+/**
+* @brief Stores a single value of a menu file straight into its struct.
+*        Fields that do not fit are truncated and reported.
+*/
+void storeMenuField(void *context, const JsonStreamPath &path,
+                    JsonStreamType type, const char *value, bool truncated)
+{
+  MenuParseTarget *target = (MenuParseTarget *)context;
+  int button, slot;
+  MenuField field = menuFieldAt(path, button, slot);
+  if (field == MENU_FIELD_NONE || button >= target->buttonCount) {
+    return;
+  }
+
+  Button &b = target->buttons[button];
+  bool fits = !truncated;
+  switch (field) {
+  case MENU_FIELD_LOGO:
+  {
+    IconPath logo;
+    fits &= jsonStreamCopy(logo, sizeof(logo), logopath, value);
+    target->icons[button] = internIcon(NULL, logo);
+    break;
+  }
+  case MENU_FIELD_LATCH:
+    b.latch = type == JSON_STREAM_BOOL && strcmp(value, "true") == 0;
+    break;
+  case MENU_FIELD_LATCHLOGO:
+  {
+    // An empty latch logo means the latched key gets a dot
+    IconPath logo;
+    fits &= jsonStreamCopy(logo, sizeof(logo), logopath, value);
+    b.latchLogo = value[0] ? internIcon(NULL, logo) : ICON_NONE;
+    break;
+  }
+  case MENU_FIELD_ACTION:
+    target->stages[button].action[slot] = atoi(value);
+    actionStageUse(target->stages[button], slot);
+    break;
+  case MENU_FIELD_VALUE:
+  {
+    // Number or text depends on the action, that may come later in the file
+    char text[ACTION_TEXT_SIZE];
+    fits &= jsonStreamCopy(text, sizeof(text), NULL, value);
+    target->stages[button].text[slot] = actionPoolIntern(*target->pool, text);
+    actionStageUse(target->stages[button], slot);
+    break;
+  }
+  case MENU_FIELD_TOO_MANY:
+    target->tooManyActions = true;
+    break;
+  default:
+    break;
+  }
+
+  if (!fits) {
+    Serial.printf("[WARNING]: %s: value of %s", target->filename, path.key[0]);
+    if (path.depth > 1) {
+      Serial.printf(".%s", path.key[1]);
+    }
+    if (slot >= 0) {
+      Serial.printf("[%d]", slot);
+    }
+    Serial.println(" is too long and was truncated");
+  }
+}
+
 /**
 * @brief Helper function to load a single menu configuration
 *
-* @param menuIndex The menu index (0-4 for menu1-menu5)
-* @param screenIcons The screen icons array to populate
-* @param menuButtons The menu buttons array to populate
+* @param menuIndex The menu index (0 for menu1)
+* @param icons The logos to populate, one per button
+* @param buttons The buttons to populate
+* @param pool Pool the actions of the buttons are compiled in, usually
+*             menuParsePool
+* @param buttonCount Number of buttons of the menu, the rest of the file is
+*                    ignored
+*
+* @return bool True if successful, false otherwise. A button with more than
+*         ACTION_CODE_MAX_OPS actions is an error.
 *
-* @return bool True if successful, false otherwise
+* @note The file is parsed in small chunks and every value is written straight
+*       into icons and buttons. The values of the actions are staged in pool
+*       and compiled in place, nothing is taken from the heap. See
+*       JsonStream.h.
 */
-bool loadMenuConfig(int menuIndex, Icons& screenIcons, Menu& menuButtons)
+bool loadMenuConfig(int menuIndex, IconId *icons, Button *buttons, ActionPool *pool,
+                    uint8_t buttonCount)
 {
   char filename[32];
   sprintf(filename, "/config/menu%d.json", menuIndex + 1);
@@ -63,81 +337,189 @@ bool loadMenuConfig(int menuIndex, Icons& screenIcons, Menu& menuButtons)
     return false;
   }
 
+  // Defaults for anything the file leaves out
+  IconId question = internIcon(logopath, "question.bmp");
+  for (int i = 0; i < buttonCount; i++) {
+    icons[i] = question;
+    buttons[i].latch = false;
+    buttons[i].latchLogo = question;
+  }
+  ActionStage stages[DECK_MAX_BUTTONS];
+  actionStageReset(stages, buttonCount);
+  actionPoolReset(*pool);
+
+  MenuParseTarget target = {filename, icons, buttons, buttonCount, pool, stages};
+  JsonStream parser;
+  bool parsed = jsonStreamParse(parser, readConfigFile, &configfile, storeMenuField, &target);
+  configfile.close();
+
+  if (!parsed) {
+    Serial.printf("[ERROR]: %s: %s at offset %u\n", filename, parser.error, parser.offset);
+    return false;
+  }
+  if (target.tooManyActions) {
+    Serial.printf("[ERROR]: %s: a button has more than %d actions\n", filename,
+                  ACTION_CODE_MAX_OPS);
+    return false;
+  }
+
+  // Only Send Character (4) and Send Special Character (8) keep their text
+  ActionCode codes[DECK_MAX_BUTTONS];
+  if (!actionCodeCompile(*pool, stages, buttonCount, codes)) {
+    Serial.printf("[ERROR]: %s: the actions do not fit in %d bytes\n", filename,
+                  ACTION_POOL_SIZE);
+    return false;
+  }
+  for (int i = 0; i < buttonCount; i++) {
+    buttons[i].actions = codes[i];
+  }
+
+  return true;
+}
+
+/**
+* @brief This function opens general.json and fills a Config struct with it.
+*
+* @param config Config to fill
+*
+* @return True when succeeded. False otherwise.
+*/
+bool loadGeneralConfig(Config &config)
+{
+  File configfile = FILESYSTEM.open("/config/general.json", "r");
+
   JsonDocument doc;
+
   DeserializationError error = deserializeJson(doc, configfile);
-  
-  if (error) {
+
+  // Parsing colors
+  const char *menubuttoncolor = doc["menubuttoncolor"] | "#009bf4";         // Get the colour for the menu and back home buttons.
+  const char *functionbuttoncolor = doc["functionbuttoncolor"] | "#00efcb"; // Get the colour for the function buttons.
+  const char *latchcolor = doc["latchcolor"] | "#fe0149";                   // Get the colour to use when latching.
+  const char *bgcolor = doc["background"] | "#000000";                      // Get the colour for the background.
+
+  char menubuttoncolorchar[64];
+  strcpy(menubuttoncolorchar, menubuttoncolor);
+  unsigned long rgb888menubuttoncolor = convertHTMLtoRGB888(menubuttoncolorchar);
+  config.menuButtonColour = convertRGB888ToRGB565(rgb888menubuttoncolor);
+
+  char functionbuttoncolorchar[64];
+  strcpy(functionbuttoncolorchar, functionbuttoncolor);
+  unsigned long rgb888functionbuttoncolor = convertHTMLtoRGB888(functionbuttoncolorchar);
+  config.functionButtonColour = convertRGB888ToRGB565(rgb888functionbuttoncolor);
+
+  char latchcolorchar[64];
+  strcpy(latchcolorchar, latchcolor);
+  unsigned long rgb888latchcolor = convertHTMLtoRGB888(latchcolorchar);
+  config.latchedColour = convertRGB888ToRGB565(rgb888latchcolor);
+
+  char backgroundcolorchar[64];
+  strcpy(backgroundcolorchar, bgcolor);
+  unsigned long rgb888backgroundcolor = convertHTMLtoRGB888(backgroundcolorchar);
+  config.backgroundColour = convertRGB888ToRGB565(rgb888backgroundcolor);
+
+  // Loading general settings
+
+  bool sleepenable = doc["sleepenable"] | false;
+  config.sleepenable = sleepenable;
+
+  //uint16_t sleeptimer = doc["sleeptimer"];
+  uint16_t sleeptimer = doc["sleeptimer"] | 60 ;
+  config.sleeptimer = sleeptimer;
+
+  bool beep = doc["beep"] | false;
+  config.beep = beep;
+
+  uint8_t modifier1 = doc["modifier1"] | 0 ;
+  config.modifier1 = modifier1;
+
+  uint8_t modifier2 = doc["modifier2"] | 0 ;
+  config.modifier2 = modifier2;
+
+  uint8_t modifier3 = doc["modifier3"] | 0 ;
+  config.modifier3 = modifier3;
+
+  uint16_t helperdelay = doc["helperdelay"] | 250 ;
+  config.helperdelay = helperdelay;
+
+  // Touch rejection, see TouchRegions.h
+  config.touchDeadZone = doc["touchdeadzone"] | 0;
+  config.touchEdgeZone = doc["touchedgezone"] | 0;
+  for (int i = 0; i < 6; i++)
+  {
+    config.touchMinContact[i] = doc["touchmincontact"][i] | 0;
+  }
+
+  bool prefetchmenus = doc["prefetchmenus"] | false;
+  config.prefetchMenus = prefetchmenus;
+
+  configfile.close();
+
+  if (error)
+  {
     Serial.println("[ERROR]: deserializeJson() error");
     Serial.println(error.c_str());
-    configfile.close();
     return false;
   }
+  return true;
+}
+
+/**
+* @brief This function opens homescreen.json and fills the paths of the
+*        logos of the home screen.
+*
+* @param icons Icons to fill
+*
+* @return True when succeeded. False otherwise.
+*/
+bool loadHomescreenConfig(Icons &icons)
+{
+  File configfile = FILESYSTEM.open("/config/homescreen.json", "r");
+
+  JsonDocument doc;
 
-  // Load logos
-  const char *logos[5] = {
+  DeserializationError error = deserializeJson(doc, configfile);
+
+  const char *logos[6] = {
     doc["logo0"] | "question.bmp",
     doc["logo1"] | "question.bmp", 
     doc["logo2"] | "question.bmp",
     doc["logo3"] | "question.bmp",
-    doc["logo4"] | "question.bmp"
-  };
-
-  // Load latch logos
-  const char *latchlogos[5] = {
-    doc["button0"]["latchlogo"] | "question.bmp",
-    doc["button1"]["latchlogo"] | "question.bmp",
-    doc["button2"]["latchlogo"] | "question.bmp", 
-    doc["button3"]["latchlogo"] | "question.bmp",
-    doc["button4"]["latchlogo"] | "question.bmp"
+    doc["logo4"] | "question.bmp",
+    doc["logo5"] | "question.bmp"  // Only screen 0 has 6 buttons
   };
 
-  // Load screen logos
-  for (int i = 0; i < 5; i++) {
-    strcpy(templogopath, logopath);
-    strcat(templogopath, logos[i]);
-    strcpy(screenIcons.icons[i], templogopath);
-  }
-
-  // Load button configurations
-  for (int buttonIdx = 0; buttonIdx < 5; buttonIdx++) {
-    char buttonKey[20];
-    sprintf(buttonKey, "button%d", buttonIdx);
-    
-    // Load latch setting and latch logo
-    menuButtons.buttons[buttonIdx].latch = doc[buttonKey]["latch"] | false;
-    strcpy(templogopath, logopath);
-    strcat(templogopath, latchlogos[buttonIdx]);
-    strcpy(menuButtons.buttons[buttonIdx].latchlogo, templogopath);
-
-    // Load action arrays
-    JsonArray actionArray = doc[buttonKey]["actionarray"];
-    JsonArray valueArray = doc[buttonKey]["valuearray"];
-
-    int actions[3] = {actionArray[0], actionArray[1], actionArray[2]};
-    
-    // Set actions
-    menuButtons.buttons[buttonIdx].actions.actions[0].action = actions[0];
-    menuButtons.buttons[buttonIdx].actions.actions[1].action = actions[1]; 
-    menuButtons.buttons[buttonIdx].actions.actions[2].action = actions[2];
-
-    // Load values/symbols for each action
-    for (int actionIdx = 0; actionIdx < 3; actionIdx++) {
-      if (actions[actionIdx] == 4 || actions[actionIdx] == 8) {
-        // Symbol/string value
-        const char *symbol = valueArray[actionIdx];
-        strcpy(menuButtons.buttons[buttonIdx].actions.actions[actionIdx].symbol, symbol);
-      } else {
-        // Numeric value
-        int value = valueArray[actionIdx];
-        menuButtons.buttons[buttonIdx].actions.actions[actionIdx].value = value;
-      }
-    }
+  for (int i = 0; i < 6; i++)
+  {
+    snprintf(icons.icons[i], sizeof(icons.icons[i]), "%s%s", logopath, logos[i]);
   }
 
   configfile.close();
+
+  if (error)
+  {
+    Serial.println("[ERROR]: deserializeJson() error");
+    Serial.println(error.c_str());
+    return false;
+  }
   return true;
 }
 
+/**
+* @brief This function makes the logos of the home screen the ones drawn.
+*
+* @param icons Paths of the home screen logos
+*
+* @return none
+*/
+void internHomeIcons(const Icons &icons)
+{
+  for (int i = 0; i < 6; i++)
+  {
+    homeIcons[i] = internIcon(NULL, icons.icons[i]);
+  }
+}
+
 /**
 * @brief This function loads the menu configuration.
 *
@@ -145,146 +527,854 @@ bool loadMenuConfig(int menuIndex, Icons& screenIcons, Menu& menuButtons)
 *
 * @return none
 *
-* @note Options for values are: colors, homescreen, menu1, menu2, menu3
-         menu4, and menu5
+* @note Options for values are: general, homescreen and menu1 up to the
+         number of menus in the deck
 */
 bool loadConfig(String value)
 {
 
   if (value == "general")
   {
-    File configfile = FILESYSTEM.open("/config/general.json", "r");
+    return loadGeneralConfig(generalconfig);
+  }
+  else if (value == "homescreen")
+  {
+    Icons icons;
+    bool loaded = loadHomescreenConfig(icons);
+    internHomeIcons(icons);
+    return loaded;
+  }
 
-    JsonDocument doc;
+  // --------------------- Loading menus ----------------------
+  int menuNumber = deckMenuNumber(value.c_str(), "");
+  if (menuNumber >= 1 && menuNumber <= deck.menuCount)
+  {
+    return loadMenu(menuNumber - 1) != NULL;
+  }
+  return false;
+}
 
-    DeserializationError error = deserializeJson(doc, configfile);
+/**
+* @brief This function reads the deck manifest. Without one the deck has the
+*        classic 5 menus of 5 buttons.
+*
+* @param manifest DeckManifest to fill
+*
+* @return True when succeeded. False when the manifest is invalid, manifest
+*         then holds the default deck.
+*/
+bool loadDeckManifest(DeckManifest &manifest)
+{
+  deckManifestDefault(manifest);
+  if (!FILESYSTEM.exists(DECK_MANIFEST_FILE))
+  {
+    return true;
+  }
 
-    // Parsing colors
-    const char *menubuttoncolor = doc["menubuttoncolor"] | "#009bf4";         // Get the colour for the menu and back home buttons.
-    const char *functionbuttoncolor = doc["functionbuttoncolor"] | "#00efcb"; // Get the colour for the function buttons.
-    const char *latchcolor = doc["latchcolor"] | "#fe0149";                   // Get the colour to use when latching.
-    const char *bgcolor = doc["background"] | "#000000";                      // Get the colour for the background.
+  File file = FILESYSTEM.open(DECK_MANIFEST_FILE, "r");
+  DeckManifest parsed = {};
+  DeckManifestParse parse = {&parsed, true};
+  JsonStream parser;
+  bool ok = file && jsonStreamParse(parser, readConfigFile, &file, deckManifestValue, &parse);
+  file.close();
 
-    char menubuttoncolorchar[64];
-    strcpy(menubuttoncolorchar, menubuttoncolor);
-    unsigned long rgb888menubuttoncolor = convertHTMLtoRGB888(menubuttoncolorchar);
-    generalconfig.menuButtonColour = convertRGB888ToRGB565(rgb888menubuttoncolor);
+  if (!ok || !parse.valid || !deckManifestValid(parsed))
+  {
+    Serial.printf("[WARNING]: %s is invalid, using %d menus of %d buttons\n",
+                  DECK_MANIFEST_FILE, DECK_DEFAULT_MENUS, DECK_MAX_BUTTONS);
+    return false;
+  }
+  manifest = parsed;
+  return true;
+}
 
-    char functionbuttoncolorchar[64];
-    strcpy(functionbuttoncolorchar, functionbuttoncolor);
-    unsigned long rgb888functionbuttoncolor = convertHTMLtoRGB888(functionbuttoncolorchar);
-    generalconfig.functionButtonColour = convertRGB888ToRGB565(rgb888functionbuttoncolor);
+/**
+* @brief This function takes the records of the deck from deckArena: the
+*        menu table, the latch states, the logos of every menu, the buttons
+*        of the menu slots and the icon table. The action pools of the slots
+*        are sized by the menu they hold, see loadMenu().
+*
+* @param none
+*
+* @return none
+*
+* @note While deckArena is only measuring every record is NULL.
+*/
+void layoutDeck()
+{
+  menuPages = (MenuPage *)deckArenaAlloc(deckArena, deck.menuCount * sizeof(MenuPage),
+                                         alignof(MenuPage));
+  latched = (uint8_t *)deckArenaAlloc(deckArena, deckButtonTotal(deck), 1);
+  for (int i = 0; i < deck.menuCount; i++)
+  {
+    IconId *icons = (IconId *)deckArenaAlloc(deckArena, deck.buttonCount[i] * sizeof(IconId), 1);
+    if (menuPages)
+    {
+      menuPages[i].buttonCount = deck.buttonCount[i];
+      menuPages[i].firstButton = deckFirstButton(deck, i);
+      menuPages[i].icons = icons;
+    }
+  }
+  for (int i = 0; i < MENU_CACHE_SLOTS; i++)
+  {
+    menuSlots[i].buttons = (Button *)deckArenaAlloc(
+        deckArena, deckMaxButtons(deck) * sizeof(Button), alignof(Button));
+  }
 
-    char latchcolorchar[64];
-    strcpy(latchcolorchar, latchcolor);
-    unsigned long rgb888latchcolor = convertHTMLtoRGB888(latchcolorchar);
-    generalconfig.latchedColour = convertRGB888ToRGB565(rgb888latchcolor);
+  uint8_t logos = iconTableLogos(deckButtonTotal(deck));
+  IconInfo *icons = (IconInfo *)deckArenaAlloc(deckArena, logos * sizeof(IconInfo),
+                                               alignof(IconInfo));
+  char *paths = (char *)deckArenaAlloc(deckArena, logos * ICON_PATH_SIZE, 1);
+  iconTableBegin(iconTable, icons, paths, icons && paths ? logos : 0);
+}
 
-    char backgroundcolorchar[64];
-    strcpy(backgroundcolorchar, bgcolor);
-    unsigned long rgb888backgroundcolor = convertHTMLtoRGB888(backgroundcolorchar);
-    generalconfig.backgroundColour = convertRGB888ToRGB565(rgb888backgroundcolor);
+/**
+* @brief This function reads the deck manifest and allocates one arena sized
+*        for exactly that deck. The latch states are restored from NVS.
+*
+* @param none
+*
+* @return none
+*
+* @note Stops when there is not enough memory, nothing works without the deck.
+*/
+void buildDeck()
+{
+  loadDeckManifest(deck);
 
-    // Loading general settings
+  // Measure first, then take one block of exactly that size
+  deckArenaBegin(deckArena, NULL, 0);
+  layoutDeck();
+  size_t size = deckArena.used;
+  deckArenaBegin(deckArena, malloc(size), size);
+  layoutDeck();
 
-         bool sleepenable = doc["sleepenable"] | false;
-      if (sleepenable)
-      {
-        generalconfig.sleepenable = true;
-        islatched[28] = 1;
-      }
-      else
-      {
-        generalconfig.sleepenable = false;
-      }
-    
-      //uint16_t sleeptimer = doc["sleeptimer"];
-      uint16_t sleeptimer = doc["sleeptimer"] | 60 ;
-      generalconfig.sleeptimer = sleeptimer;
-    
-      bool beep = doc["beep"] | false;
-      generalconfig.beep = beep;
-    
-      uint8_t modifier1 = doc["modifier1"] | 0 ;
-      generalconfig.modifier1 = modifier1;
-    
-      uint8_t modifier2 = doc["modifier2"] | 0 ;
-      generalconfig.modifier2 = modifier2;
-    
-      uint8_t modifier3 = doc["modifier3"] | 0 ;
-      generalconfig.modifier3 = modifier3;
-    
-      uint16_t helperdelay = doc["helperdelay"] | 250 ;
-      generalconfig.helperdelay = helperdelay;
-
-    configfile.close();
-
-    if (error)
-    {
-      Serial.println("[ERROR]: deserializeJson() error");
-      Serial.println(error.c_str());
-      return false;
-    }
-    return true;
-  }
-  else if (value == "homescreen")
+  if (!deckArenaFits(deckArena))
   {
-    File configfile = FILESYSTEM.open("/config/homescreen.json", "r");
+    Serial.printf("[ERROR]: No memory for a deck arena of %u bytes\n", size);
+    while (1)
+      yield(); // We stop here
+  }
 
-    JsonDocument doc;
+  uint16_t buttons = deckButtonTotal(deck);
+  if (savedStates.getBytesLength("latched") == buttons)
+  {
+    savedStates.getBytes("latched", latched, buttons);
+  }
 
-    DeserializationError error = deserializeJson(doc, configfile);
+  Serial.printf("[INFO]: Deck of %u menus and %u buttons, arena of %u bytes\n",
+                deck.menuCount, buttons, size);
+}
 
-    const char *logos[6] = {
-      doc["logo0"] | "question.bmp",
-      doc["logo1"] | "question.bmp", 
-      doc["logo2"] | "question.bmp",
-      doc["logo3"] | "question.bmp",
-      doc["logo4"] | "question.bmp",
-      doc["logo5"] | "question.bmp"  // Only screen 0 has 6 buttons
-    };
+/**
+* @brief This function describes the sections of the config snapshot: the
+*        general config, the home screen logos and then the logos, buttons
+*        and action pool of every menu of the deck.
+*
+* @param sections Array of CONFIG_SNAPSHOT_SECTIONS to fill
+* @param config Config
+* @param homeIcons Icons of the home screen
+* @param menuIcons Logo paths of every button of the deck, in deck order
+* @param menuButtons Every button of the deck, in deck order
+* @param menuPools The action pool of every menu
+* @param header Snapshot header the sizes of the action pools are taken from
+*               when menuPools is NULL
+*
+* @return none
+*
+* @note Any of the structs may be NULL when only the sizes are needed. Logos
+*       are stored as paths, an IconId is only valid in the running iconTable.
+*       Only the part of an action pool that is in use is stored.
+*/
+void configSnapshotLayout(ConfigSnapshotSection *sections, Config *config,
+                          Icons *homeIcons, ButtonIconNames *menuIcons, Button *menuButtons,
+                          ActionPool **menuPools, const uint8_t *header)
+{
+  sections[0] = {config, sizeof(Config)};
+  sections[1] = {homeIcons, sizeof(Icons)};
+  for (int i = 0; i < deck.menuCount; i++)
+  {
+    uint16_t first = deckFirstButton(deck, i);
+    uint8_t count = deck.buttonCount[i];
+    sections[CONFIG_SNAPSHOT_MENU(i)] = {menuIcons ? &menuIcons[first] : NULL,
+                                         count * (uint32_t)sizeof(ButtonIconNames)};
+    sections[CONFIG_SNAPSHOT_MENU(i) + 1] = {menuButtons ? &menuButtons[first] : NULL,
+                                             count * (uint32_t)sizeof(Button)};
 
-    for (int i = 0; i < 6; i++)
+    // A size no pool can have is left at the full size, the header check fails
+    uint32_t poolSize = sizeof(ActionPool);
+    if (menuPools)
     {
-      strcpy(templogopath, logopath);
-      strcat(templogopath, logos[i]);
-      strcpy(screens[0].icons[i], templogopath);
+      poolSize = actionPoolStoredSize(*menuPools[i]);
     }
-
-    configfile.close();
-
-    if (error)
+    else if (header)
     {
-      Serial.println("[ERROR]: deserializeJson() error");
-      Serial.println(error.c_str());
-      return false;
+      uint32_t stored = configSnapshotStoredSize(header, CONFIG_SNAPSHOT_MENU(i) + 2);
+      if (stored >= offsetof(ActionPool, bytes) && stored < sizeof(ActionPool))
+      {
+        poolSize = stored;
+      }
     }
-    return true;
+    sections[CONFIG_SNAPSHOT_MENU(i) + 2] = {menuPools ? menuPools[i] : NULL, poolSize};
+  }
+}
+
+/**
+* @brief This function writes the config structs to CONFIG_SNAPSHOT_FILE so
+*        they can be loaded without parsing JSON.
+*
+* @param config Config to store
+* @param home Icons of the home screen
+* @param menuIcons Logo paths of every button of the deck
+* @param menuButtons Every button of the deck
+* @param menuPools The action pool of every menu
+*
+* @return True when succeeded. False otherwise.
+*/
+bool writeConfigSnapshot(Config &config, Icons &home, ButtonIconNames *menuIcons,
+                         Button *menuButtons, ActionPool **menuPools)
+{
+  ConfigSnapshotSection sections[CONFIG_SNAPSHOT_MAX_SECTIONS];
+  configSnapshotLayout(sections, &config, &home, menuIcons, menuButtons, menuPools, NULL);
 
-  // --------------------- Loading menus 1-5 ----------------------
+  uint8_t header[CONFIG_SNAPSHOT_HEADER_SIZE];
+  configSnapshotEncodeHeader(sections, CONFIG_SNAPSHOT_SECTIONS, header);
+
+  File file = FILESYSTEM.open(CONFIG_SNAPSHOT_FILE, "w");
+  bool written = file && file.write(header, sizeof(header)) == sizeof(header);
+  for (int i = 0; written && i < CONFIG_SNAPSHOT_SECTIONS; i++)
+  {
+    written = file.write((const uint8_t *)sections[i].data, sections[i].size) ==
+              sections[i].size;
   }
-  else if (value == "menu1")
+  file.close();
+
+  if (!written)
   {
-    return loadMenuConfig(0, screens[1], menus[0]);
+    // A partial snapshot fails its CRC, but there is no need to keep it
+    FILESYSTEM.remove(CONFIG_SNAPSHOT_FILE);
+    Serial.println("[WARNING]: Failed to write config snapshot");
+    return false;
   }
-  else if (value == "menu2")
+
+  Serial.printf("[INFO]: Config snapshot written, %u bytes\n",
+                configSnapshotSize(sections, CONFIG_SNAPSHOT_SECTIONS));
+  return true;
+}
+
+/**
+* @brief This function fills generalconfig and the home screen logos from
+*        CONFIG_SNAPSHOT_FILE with a single read. Menus are loaded when they
+*        are opened, see loadMenu().
+*
+* @param none
+*
+* @return True when succeeded. False when the snapshot is missing, corrupt
+*         or was written by a firmware with different config structs.
+*/
+bool loadConfigSnapshot()
+{
+  if (!FILESYSTEM.exists(CONFIG_SNAPSHOT_FILE))
   {
-    return loadMenuConfig(1, screens[2], menus[1]);
+    Serial.println("[INFO]: No config snapshot, parsing JSON config");
+    return false;
   }
-  else if (value == "menu3")
+
+  Config config;
+  Icons  home;
+  ConfigSnapshotSection sections[CONFIG_SNAPSHOT_MAX_SECTIONS];
+
+  // Header, general config and home screen logos are at the start of the file
+  uint8_t buf[CONFIG_SNAPSHOT_HEADER_SIZE + sizeof(Config) + sizeof(Icons)];
+  const uint32_t prefixSize = sizeof(buf);
+
+  File file = FILESYSTEM.open(CONFIG_SNAPSHOT_FILE, "r");
+  bool loaded = file && file.read(buf, prefixSize) == prefixSize;
+  if (loaded)
   {
-    return loadMenuConfig(2, screens[3], menus[2]);
+    configSnapshotLayout(sections, &config, &home, NULL, NULL, NULL, buf);
+    loaded = file.size() == configSnapshotSize(sections, CONFIG_SNAPSHOT_SECTIONS) &&
+             configSnapshotCheckHeader(buf, sections, CONFIG_SNAPSHOT_SECTIONS);
   }
-  else if (value == "menu4")
+  file.close();
+
+  for (int i = 0; loaded && i < 2; i++)
   {
-    return loadMenuConfig(3, screens[4], menus[3]);
+    const uint8_t *data = buf + configSnapshotSectionOffset(sections, i);
+    loaded = configSnapshotCheckSection(buf, i, data, sections[i].size);
+    if (loaded)
+    {
+      memcpy(sections[i].data, data, sections[i].size);
+    }
   }
-  else if (value == "menu5")
+
+  if (!loaded)
   {
-    return loadMenuConfig(4, screens[5], menus[4]);
+    Serial.println("[WARNING]: Config snapshot is stale, parsing JSON config");
+    return false;
   }
-  else
+
+  generalconfig = config;
+  internHomeIcons(home);
+  return true;
+}
+
+/**
+* @brief This function reads the logos and buttons of a single menu from
+*        CONFIG_SNAPSHOT_FILE.
+*
+* @param menuIndex The menu index (0 for menu1)
+* @param icons The logos to fill, one per button of the menu
+* @param buttons The buttons to fill
+* @param pool The action pool to fill, room for ACTION_POOL_SIZE bytes
+*
+* @return True when succeeded. False when there is no valid snapshot.
+*/
+bool loadMenuFromSnapshot(int menuIndex, IconId *icons, Button *buttons, ActionPool *pool)
+{
+  if (configSnapshotPending || !FILESYSTEM.exists(CONFIG_SNAPSHOT_FILE))
+  {
+    return false;
+  }
+
+  ConfigSnapshotSection sections[CONFIG_SNAPSHOT_MAX_SECTIONS];
+  int iconsSection = CONFIG_SNAPSHOT_MENU(menuIndex);
+  ButtonIconNames names[DECK_MAX_BUTTONS];
+
+  uint8_t header[CONFIG_SNAPSHOT_HEADER_SIZE];
+  File file = FILESYSTEM.open(CONFIG_SNAPSHOT_FILE, "r");
+  bool loaded = file && file.read(header, sizeof(header)) == sizeof(header);
+  uint32_t iconsSize = 0, buttonsSize = 0, poolSize = 0;
+  if (loaded)
+  {
+    configSnapshotLayout(sections, NULL, NULL, NULL, NULL, NULL, header);
+    iconsSize = sections[iconsSection].size;
+    buttonsSize = sections[iconsSection + 1].size;
+    poolSize = sections[iconsSection + 2].size;
+    loaded = configSnapshotCheckHeader(header, sections, CONFIG_SNAPSHOT_SECTIONS) &&
+             file.seek(configSnapshotSectionOffset(sections, iconsSection)) &&
+             file.read((uint8_t *)names, iconsSize) == iconsSize &&
+             file.read((uint8_t *)buttons, buttonsSize) == buttonsSize &&
+             file.read((uint8_t *)pool, poolSize) == poolSize;
+  }
+  file.close();
+
+  loaded = loaded &&
+           configSnapshotCheckSection(header, iconsSection, (const uint8_t *)names, iconsSize) &&
+           configSnapshotCheckSection(header, iconsSection + 1, (const uint8_t *)buttons,
+                                      buttonsSize) &&
+           configSnapshotCheckSection(header, iconsSection + 2, (const uint8_t *)pool, poolSize) &&
+           actionPoolStoredSize(*pool) == poolSize;
+  if (!loaded)
   {
     return false;
   }
+
+  for (int i = 0; i < deck.buttonCount[menuIndex]; i++)
+  {
+    icons[i] = internIcon(NULL, names[i].logo);
+    buttons[i].latchLogo = names[i].latchLogo[0] ? internIcon(NULL, names[i].latchLogo)
+                                                 : ICON_NONE;
+  }
+  return true;
+}
+
+/**
+* @brief This function marks the config snapshot as stale after a JSON
+*        config file changed. loop() rebuilds it with compileConfigSnapshot().
+*
+* @param none
+*
+* @return none
+*/
+void invalidateConfigSnapshot()
+{
+  FILESYSTEM.remove(CONFIG_SNAPSHOT_FILE);
+  configSnapshotPending = true;
+}
+
+/**
+* @brief This function goes back to the previous generation of a config file
+*        that does not load.
+*
+* @param path Path of the file, e.g. "/config/menu3.json"
+*
+* @return True when the previous generation is in place. False when there is
+*         none.
+*/
+bool rollbackConfigFile(const char *path)
+{
+  if (!configStoreRollback(configStoreFs, path))
+  {
+    return false;
+  }
+  Serial.printf("[WARNING]: %s does not load, went back to the previous version\n", path);
+  if (configChangedByFile(path) != 0)
+  {
+    invalidateConfigSnapshot();
+  }
+  return true;
+}
+
+/**
+* @brief This function notes that a JSON config file was written. loop()
+*        reads it again with applyConfigChanges() and rebuilds the snapshot.
+*
+* @param path Path of the file, e.g. "/config/menu3.json"
+*
+* @return none
+*
+* @note Called from the web server task, only sets bits.
+*/
+void configFileChanged(const char *path)
+{
+  uint32_t changed = configChangedByFile(path);
+  if (changed == 0)
+  {
+    return;
+  }
+  __atomic_fetch_or(&configChanged, changed, __ATOMIC_SEQ_CST);
+  invalidateConfigSnapshot();
+}
+
+/**
+* @brief This function notes that a logo file was uploaded or deleted. Only
+*        that logo is read again, loop() redraws the keys showing it.
+*
+* @param path Path of the logo, e.g. "/logos/mute.bmp"
+*
+* @return none
+*/
+void logoFileChanged(const char *path)
+{
+  iconTableInvalidateIcon(iconTable, iconTableFind(iconTable, path));
+  __atomic_fetch_or(&configChanged, (uint32_t)CONFIG_CHANGED_LOGOS, __ATOMIC_SEQ_CST);
+}
+
+/**
+* @brief This function parses all JSON config files into temporary structs
+*        and writes them as the config snapshot.
+*
+* @param none
+*
+* @return True when succeeded. False otherwise.
+*
+* @note The running config is not changed, applyConfigChanges() has already
+         applied the files that changed.
+*/
+bool compileConfigSnapshot()
+{
+  configSnapshotPending = false;
+
+  uint16_t total = deckButtonTotal(deck);
+  Config   *config = new Config();
+  Icons    *home = new Icons();
+  IconId     *menuIcons = new IconId[total]();
+  Button     *menuButtons = new Button[total]();
+
+  // Every menu is compiled in menuParsePool, only what it uses is kept
+  ActionPool *menuPools[DECK_MAX_MENUS] = {};
+
+  bool parsed = loadGeneralConfig(*config) && loadHomescreenConfig(*home);
+  for (int i = 0; parsed && i < deck.menuCount; i++)
+  {
+    uint16_t first = deckFirstButton(deck, i);
+    parsed = loadMenuConfig(i, &menuIcons[first], &menuButtons[first], &menuParsePool,
+                            deck.buttonCount[i]);
+    if (parsed)
+    {
+      menuPools[i] = actionPoolClone(menuParsePool);
+      parsed = menuPools[i] != NULL;
+    }
+  }
+
+  bool written = false;
+  if (parsed)
+  {
+    ButtonIconNames *names = new ButtonIconNames[total]();
+    for (int i = 0; i < total; i++)
+    {
+      strlcpy(names[i].logo, iconTablePath(iconTable, menuIcons[i]), sizeof(IconPath));
+      strlcpy(names[i].latchLogo, iconTablePath(iconTable, menuButtons[i].latchLogo),
+              sizeof(IconPath));
+    }
+    written = writeConfigSnapshot(*config, *home, names, menuButtons, menuPools);
+    delete[] names;
+  }
+  else
+  {
+    Serial.println("[WARNING]: Config has errors, not writing a snapshot");
+  }
+
+  delete config;
+  delete home;
+  delete[] menuIcons;
+  delete[] menuButtons;
+  for (int i = 0; i < deck.menuCount; i++)
+  {
+    free(menuPools[i]);
+  }
+
+  // Parsing interned the logos of every menu, only the running ones stay
+  releaseUnusedIcons();
+  return written;
+}
+
+/**
+* @brief This function makes a menu resident. When it is not, it is loaded
+*        into the least recently used slot, from the config snapshot if
+*        there is one and from its JSON file otherwise.
+*
+* @param menuIndex The menu index (0 for menu1)
+*
+* @return Menu* the resident menu, NULL if it failed to load
+*
+* @note The menu on screen is never evicted, so it stays intact when
+         loading another menu fails.
+*/
+Menu *loadMenu(int menuIndex)
+{
+  int slot = menuCacheFind(menuCache, menuIndex);
+  if (slot != MENU_CACHE_EMPTY)
+  {
+    menuCacheTouch(menuCache, slot);
+    return &menuSlots[slot];
+  }
+
+  int onScreen = isMenuPage(pageNum) ? pageNum - 1 : MENU_CACHE_EMPTY;
+  slot = menuCacheVictim(menuCache, onScreen);
+  menuCache.menuIndex[slot] = MENU_CACHE_EMPTY;
+
+  MenuPage &page = menuPages[menuIndex];
+  Button *buttons = menuSlots[slot].buttons;
+  ActionPool *pool = &menuParsePool;
+  size_t buttonsSize = page.buttonCount * sizeof(Button);
+  memset(buttons, 0, buttonsSize);
+
+  unsigned long startUs = micros();
+  IconId icons[DECK_MAX_BUTTONS];
+  bool fromSnapshot = loadMenuFromSnapshot(menuIndex, icons, buttons, pool);
+  if (!fromSnapshot)
+  {
+    memset(buttons, 0, buttonsSize);
+    char filename[32];
+    snprintf(filename, sizeof(filename), "/config/menu%d.json", menuIndex + 1);
+    if (!loadMenuConfig(menuIndex, icons, buttons, pool, page.buttonCount) &&
+        !(rollbackConfigFile(filename) &&
+          loadMenuConfig(menuIndex, icons, buttons, pool, page.buttonCount)))
+    {
+      return NULL;
+    }
+  }
+
+  // The slot keeps just the bytes this menu uses
+  ActionPool *actions = actionPoolClone(menuParsePool);
+  if (actions == NULL)
+  {
+    Serial.printf("[ERROR]: No memory for the %u bytes of actions of menu %d\n",
+                  (unsigned)actionPoolStoredSize(menuParsePool), menuIndex + 1);
+    return NULL;
+  }
+  free(menuSlots[slot].actions);
+  menuSlots[slot].actions = actions;
+  unsigned long elapsedUs = micros() - startUs;
+  latencyHistogramRecord(deckMetrics.menuLoadUs, elapsedUs);
+
+  memcpy(page.icons, icons, page.buttonCount * sizeof(IconId));
+  menuCacheAssign(menuCache, slot, menuIndex);
+
+  Serial.printf("[INFO]: Menu %d loaded from %s in %lu us\n", menuIndex + 1,
+                fromSnapshot ? "snapshot" : "JSON", elapsedUs);
+  if (elapsedUs > MENU_LOAD_BUDGET_US)
+  {
+    Serial.printf("[WARNING]: Loading menu %d took longer than %u us\n",
+                  menuIndex + 1, MENU_LOAD_BUDGET_US);
+  }
+  return &menuSlots[slot];
+}
+
+/**
+* @brief This function looks up a menu without loading it.
+*
+* @param menuIndex The menu index (0 for menu1)
+*
+* @return Menu* the resident menu, NULL if it is not resident
+*/
+Menu *residentMenu(int menuIndex)
+{
+  int slot = menuCacheFind(menuCache, menuIndex);
+  return slot == MENU_CACHE_EMPTY ? NULL : &menuSlots[slot];
+}
+
+/**
+* @brief This function gets the menu of the page on screen.
+*
+* @param none
+*
+* @return Menu& the resident menu of pageNum
+*
+* @note navigateToPage() made it resident before pageNum was set.
+*/
+Menu &currentMenu()
+{
+  Menu *menu = residentMenu(pageNum - 1);
+  return menu ? *menu : menuSlots[0];
+}
+
+/**
+* @brief This function checks whether a page is one of the menus of the deck.
+*
+* @param page Page number
+*
+* @return True for pages 1 up to deck.menuCount
+*/
+bool isMenuPage(int page)
+{
+  return page >= 1 && page <= deck.menuCount;
+}
+
+/**
+* @brief This function checks whether a page shows the 6 keys, the home
+         screen, a menu or the settings page.
+*
+* @param page Page number
+*
+* @return False for the pages that show text
+*/
+bool isKeypadPage(int page)
+{
+  return page == PAGE_HOME || page == PAGE_SETTINGS || isMenuPage(page);
+}
+
+/**
+* @brief This function gets the latch state of a key on the page on screen.
+*
+* @param b Key index (0-5)
+*
+* @return True when the key is drawn latched
+*
+* @note The sleep key of the settings page shows whether sleep is enabled.
+*/
+bool isKeyLatched(uint8_t b)
+{
+  if (isMenuPage(pageNum))
+  {
+    const MenuPage &page = menuPages[pageNum - 1];
+    return b < page.buttonCount && latched[page.firstButton + b];
+  }
+  return pageNum == PAGE_SETTINGS && b == 3 && generalconfig.sleepenable;
+}
+
+/**
+* @brief This function opens a menu: it counts the visit and makes it
+*        resident.
+*
+* @param menuIndex The menu index (0 for menu1)
+*
+* @return True when succeeded. False when the menu failed to load.
+*
+* @note Visit counts are saved to NVS only when a menu had to be loaded,
+         which is slow anyway, not on every visit.
+*/
+bool openMenu(int menuIndex)
+{
+  menuCacheCountVisit(menuVisits, menuIndex);
+  if (menuCacheFind(menuCache, menuIndex) != MENU_CACHE_EMPTY)
+  {
+    loadMenu(menuIndex);
+    return true;
+  }
+
+  savedStates.putBytes("menuvisits", menuVisits, sizeof(menuVisits));
+  return loadMenu(menuIndex) != NULL;
+}
+
+/**
+* @brief This function loads the menus that are opened most into the free
+*        menu slots, so opening them does not need to read the filesystem.
+*
+* @param none
+*
+* @return none
+*/
+void prefetchMenus()
+{
+  int8_t order[MENU_CACHE_SLOTS];
+  int count = menuCachePrefetchOrder(menuVisits, order, MENU_CACHE_SLOTS);
+  for (int i = 0; i < count; i++)
+  {
+    // Visits may be left from a deck with more menus
+    if (order[i] < deck.menuCount)
+    {
+      loadMenu(order[i]);
+    }
+  }
+}
+
+/**
+* @brief This function gets the keys of the page on screen that look
+*        different with a new general config.
+*
+* @param before The running general config
+* @param after The general config as reloaded
+*
+* @return uint8_t bit b set when key b has to be drawn again
+*/
+uint8_t generalConfigKeysChanged(const Config &before, const Config &after)
+{
+  if (before.menuButtonColour != after.menuButtonColour ||
+      before.functionButtonColour != after.functionButtonColour ||
+      before.latchedColour != after.latchedColour ||
+      before.backgroundColour != after.backgroundColour)
+  {
+    return CONFIG_ALL_KEYS;
+  }
+  // The sleep key of the settings page shows sleepenable
+  if (pageNum == PAGE_SETTINGS && before.sleepenable != after.sleepenable)
+  {
+    return 1 << 3;
+  }
+  return 0;
+}
+
+/**
+* @brief This function checks whether the touch layout has to be built again
+*        for a new general config.
+*
+* @param before The running general config
+* @param after The general config as reloaded
+*
+* @return True when the touch zones changed
+*/
+bool touchConfigChanged(const Config &before, const Config &after)
+{
+  return before.touchDeadZone != after.touchDeadZone ||
+         before.touchEdgeZone != after.touchEdgeZone ||
+         memcmp(before.touchMinContact, after.touchMinContact,
+                sizeof(before.touchMinContact)) != 0;
+}
+
+/**
+* @brief This function reads homescreen.json again and interns its logos.
+*
+* @param none
+*
+* @return uint8_t the keys of the page on screen that look different
+*
+* @note The running logos are kept when the file has errors.
+*/
+uint8_t reloadHomeIcons()
+{
+  Icons icons;
+  if (!loadHomescreenConfig(icons))
+  {
+    Serial.println("[ERROR]: homescreen.json has errors, keeping the running home screen");
+    return 0;
+  }
+
+  IconId before[6];
+  memcpy(before, homeIcons, sizeof(before));
+  internHomeIcons(icons);
+  if (pageNum != PAGE_HOME)
+  {
+    return 0;
+  }
+  return configKeysChanged(before, homeIcons, sizeof(IconId), 6);
+}
+
+/**
+* @brief This function reads the file of a resident menu again and replaces
+*        its logos, buttons and actions in its slot.
+*
+* @param menuIndex The menu index (0 for menu1)
+*
+* @return uint8_t the keys of the page on screen that look different
+*
+* @note A menu that is not resident is read from the new file when it is
+         opened. The running menu is kept when the file has errors.
+*/
+uint8_t reloadMenu(int menuIndex)
+{
+  Menu *menu = residentMenu(menuIndex);
+  if (menu == NULL)
+  {
+    return 0;
+  }
+
+  MenuPage &page = menuPages[menuIndex];
+  IconId icons[DECK_MAX_BUTTONS];
+  Button buttons[DECK_MAX_BUTTONS] = {};
+  if (!loadMenuConfig(menuIndex, icons, buttons, &menuParsePool, page.buttonCount))
+  {
+    Serial.printf("[ERROR]: menu%d.json has errors, keeping the running menu\n",
+                  menuIndex + 1);
+    return 0;
+  }
+  ActionPool *actions = actionPoolClone(menuParsePool);
+  if (actions == NULL)
+  {
+    Serial.printf("[ERROR]: No memory for the actions of menu %d, keeping the running menu\n",
+                  menuIndex + 1);
+    return 0;
+  }
+
+  uint8_t keys = configKeysChanged(page.icons, icons, sizeof(IconId), page.buttonCount);
+  for (int b = 0; b < page.buttonCount; b++)
+  {
+    if (buttons[b].latch != menu->buttons[b].latch ||
+        buttons[b].latchLogo != menu->buttons[b].latchLogo)
+    {
+      keys |= 1 << b;
+    }
+    // A key that no longer latches is not drawn latched
+    if (!buttons[b].latch)
+    {
+      latched[page.firstButton + b] = 0;
+    }
+  }
+
+  memcpy(page.icons, icons, page.buttonCount * sizeof(IconId));
+  memcpy(menu->buttons, buttons, page.buttonCount * sizeof(Button));
+  free(menu->actions);
+  menu->actions = actions;
+  return pageNum == menuIndex + 1 ? keys : 0;
+}
+
+/**
+* @brief This function gets the keys of the page on screen whose logo was
+*        uploaded or deleted since it was drawn.
+*
+* @param none
+*
+* @return uint8_t bit b set when key b has to be drawn again
+*
+* @note A latch logo that was never drawn counts as well, that only draws a
+         key once more.
+*/
+uint8_t keysWithStaleIcons()
+{
+  uint8_t keys = 0;
+  if (pageNum == PAGE_HOME)
+  {
+    for (int b = 0; b < 6; b++)
+    {
+      if (iconTableStale(iconTable, homeIcons[b]))
+      {
+        keys |= 1 << b;
+      }
+    }
+  }
+  else if (isMenuPage(pageNum))
+  {
+    const MenuPage &page = menuPages[pageNum - 1];
+    for (int b = 0; b < page.buttonCount; b++)
+    {
+      if (iconTableStale(iconTable, page.icons[b]) ||
+          iconTableStale(iconTable, currentMenu().buttons[b].latchLogo))
+      {
+        keys |= 1 << b;
+      }
+    }
+  }
+  return keys;
 }
@@ -0,0 +1,72 @@
+#ifndef CONFIG_RELOAD_H
+#define CONFIG_RELOAD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "DeckArena.h"
+
+// Config files that changed since the running config was loaded. The web
+// server and the serial commands set them, loop() re-reads only those files
+// and redraws only the keys that look different, without a restart.
+#define CONFIG_CHANGED_GENERAL 0x01
+#define CONFIG_CHANGED_HOME 0x02
+#define CONFIG_CHANGED_DECK 0x04  // Needs a restart, the deck arena is sized by it
+#define CONFIG_CHANGED_LOGOS 0x08 // A logo file was uploaded or deleted
+
+// One bit per menu, bits 16 - 31
+#define CONFIG_CHANGED_MENU(i) ((uint32_t)1 << (16 + (i)))
+#define CONFIG_CHANGED_MENUS 0xFFFF0000
+
+// Bits of the keys of a page, key b is bit b
+#define CONFIG_ALL_KEYS 0x3F
+
+/**
+ * @brief Get what a config file holds
+ *
+ * @param path Path or name of the file, e.g. "/config/menu3.json"
+ *
+ * @return uint32_t CONFIG_CHANGED_* bits, 0 for files that are not part of
+ *         the running config (wificonfig.json, default.json, ...)
+ */
+uint32_t configChangedByFile(const char *path) {
+  const char *name = strrchr(path, '/');
+  name = name ? name + 1 : path;
+
+  if (strcmp(name, "general.json") == 0) {
+    return CONFIG_CHANGED_GENERAL;
+  }
+  if (strcmp(name, "homescreen.json") == 0) {
+    return CONFIG_CHANGED_HOME;
+  }
+  if (strcmp(name, "deck.json") == 0) {
+    return CONFIG_CHANGED_DECK;
+  }
+  int menu = deckMenuNumber(name, ".json");
+  return menu ? CONFIG_CHANGED_MENU(menu - 1) : 0;
+}
+
+/**
+ * @brief Compare the records of two versions of a page key by key
+ *
+ * @param before Records as drawn
+ * @param after Records as reloaded
+ * @param size Size of one record
+ * @param count Number of records, at most 6
+ *
+ * @return uint8_t with bit b set when record b differs
+ */
+uint8_t configKeysChanged(const void *before, const void *after, size_t size,
+                          uint8_t count) {
+  const uint8_t *a = (const uint8_t *)before;
+  const uint8_t *b = (const uint8_t *)after;
+  uint8_t keys = 0;
+  for (uint8_t i = 0; i < count && i < 6; i++) {
+    if (memcmp(a + i * size, b + i * size, size) != 0) {
+      keys |= 1 << i;
+    }
+  }
+  return keys;
+}
+
+#endif // CONFIG_RELOAD_H
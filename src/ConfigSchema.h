@@ -0,0 +1,322 @@
+#ifndef CONFIG_SCHEMA_H
+#define CONFIG_SCHEMA_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ActionCode.h"
+#include "DeckArena.h"
+#include "IconTable.h"
+#include "JsonStream.h"
+
+// Config files posted by the configurator are checked against a table of the
+// fields each file may hold before they replace the running file. A field is
+// the path of keys leading to a value, "#" stands for one digit and "[]" for
+// an array element:
+//
+//   "button#.actionarray[]"  matches  "button3": { "actionarray": [ "7" ] }
+//
+// Keys that are not in the table, values of the wrong type, texts that do not
+// fit the struct they are loaded into and numbers out of range are refused,
+// so a bad post never reaches the keypad.
+
+enum ConfigSchemaFile {
+  CONFIG_SCHEMA_NONE = 0,
+  CONFIG_SCHEMA_GENERAL, // general.json
+  CONFIG_SCHEMA_WIFI,    // wificonfig.json
+  CONFIG_SCHEMA_HOME,    // homescreen.json
+  CONFIG_SCHEMA_MENU,    // menu1.json - menuN.json
+  CONFIG_SCHEMA_DECK     // deck.json, used after a restart
+};
+
+// Types a field accepts, one bit per JsonStreamType
+#define CONFIG_FIELD_STRING (1 << JSON_STREAM_STRING)
+#define CONFIG_FIELD_NUMBER (1 << JSON_STREAM_NUMBER)
+#define CONFIG_FIELD_BOOL (1 << JSON_STREAM_BOOL)
+
+// ConfigSchemaField flags
+#define CONFIG_FIELD_REQUIRED 0x01 // The file is refused when no value matches
+
+// Longest path of a refused value kept for the error, e.g. "button3.latch"
+#define CONFIG_SCHEMA_WHERE_SIZE 40
+
+// Logos are loaded as "/logos/" + name into an IconPath
+#define CONFIG_FIELD_LOGO_LENGTH (ICON_PATH_SIZE - 8)
+
+struct ConfigSchemaField {
+  const char *path;
+  uint8_t     types;
+  uint8_t     flags;
+  uint8_t     digits; // "#" matches 0 - digits-1
+  uint8_t     items;  // "[]" matches elements 0 - items-1
+  uint8_t     length; // Longest text
+  uint16_t    max;    // Largest number, numbers are whole and not negative
+};
+
+static const ConfigSchemaField configSchemaGeneral[] = {
+    {"menubuttoncolor", CONFIG_FIELD_STRING, CONFIG_FIELD_REQUIRED, 0, 0, 7, 0},
+    {"functionbuttoncolor", CONFIG_FIELD_STRING, CONFIG_FIELD_REQUIRED, 0, 0, 7, 0},
+    {"latchcolor", CONFIG_FIELD_STRING, CONFIG_FIELD_REQUIRED, 0, 0, 7, 0},
+    {"background", CONFIG_FIELD_STRING, CONFIG_FIELD_REQUIRED, 0, 0, 7, 0},
+    {"sleepenable", CONFIG_FIELD_BOOL, 0, 0, 0, 0, 0},
+    {"sleeptimer", CONFIG_FIELD_NUMBER, 0, 0, 0, 0, 0xFFFF},
+    {"beep", CONFIG_FIELD_BOOL, 0, 0, 0, 0, 0},
+    {"modifier1", CONFIG_FIELD_NUMBER, 0, 0, 0, 0, 0xFF},
+    {"modifier2", CONFIG_FIELD_NUMBER, 0, 0, 0, 0, 0xFF},
+    {"modifier3", CONFIG_FIELD_NUMBER, 0, 0, 0, 0, 0xFF},
+    {"helperdelay", CONFIG_FIELD_NUMBER, 0, 0, 0, 0, 0xFFFF},
+    {"touchdeadzone", CONFIG_FIELD_NUMBER, 0, 0, 0, 0, 0xFF},
+    {"touchedgezone", CONFIG_FIELD_NUMBER, 0, 0, 0, 0, 0xFF},
+    {"touchmincontact[]", CONFIG_FIELD_NUMBER, 0, 0, 6, 0, 0xFF},
+    {"prefetchmenus", CONFIG_FIELD_BOOL, 0, 0, 0, 0, 0},
+};
+
+static const ConfigSchemaField configSchemaWifi[] = {
+    {"ssid", CONFIG_FIELD_STRING, CONFIG_FIELD_REQUIRED, 0, 0, 63, 0},
+    {"password", CONFIG_FIELD_STRING, CONFIG_FIELD_REQUIRED, 0, 0, 63, 0},
+    {"wifimode", CONFIG_FIELD_STRING, CONFIG_FIELD_REQUIRED, 0, 0, 8, 0},
+    {"wifihostname", CONFIG_FIELD_STRING, 0, 0, 0, 63, 0},
+    {"attempts", CONFIG_FIELD_NUMBER, 0, 0, 0, 0, 0xFF},
+    {"attemptdelay", CONFIG_FIELD_NUMBER, 0, 0, 0, 0, 0xFFFF},
+};
+
+static const ConfigSchemaField configSchemaHome[] = {
+    {"logo#", CONFIG_FIELD_STRING, CONFIG_FIELD_REQUIRED, 6, 0,
+     CONFIG_FIELD_LOGO_LENGTH, 0},
+};
+
+static const ConfigSchemaField configSchemaMenu[] = {
+    {"logo#", CONFIG_FIELD_STRING, CONFIG_FIELD_REQUIRED, DECK_MAX_BUTTONS, 0,
+     CONFIG_FIELD_LOGO_LENGTH, 0},
+    {"button#.latch", CONFIG_FIELD_BOOL, 0, DECK_MAX_BUTTONS, 0, 0, 0},
+    {"button#.latchlogo", CONFIG_FIELD_STRING, 0, DECK_MAX_BUTTONS, 0,
+     CONFIG_FIELD_LOGO_LENGTH, 0},
+    {"button#.actionarray[]", CONFIG_FIELD_STRING | CONFIG_FIELD_NUMBER, 0,
+     DECK_MAX_BUTTONS, ACTION_CODE_MAX_OPS, 3, 0xFF},
+    {"button#.valuearray[]", CONFIG_FIELD_STRING | CONFIG_FIELD_NUMBER, 0,
+     DECK_MAX_BUTTONS, ACTION_CODE_MAX_OPS, ACTION_TEXT_SIZE - 1, 0xFFFF},
+};
+
+// A menu of 0 buttons passes, deckManifestValid() refuses it at boot
+static const ConfigSchemaField configSchemaDeck[] = {
+    {"menus[]", CONFIG_FIELD_NUMBER, CONFIG_FIELD_REQUIRED, 0, DECK_MAX_MENUS, 0,
+     DECK_MAX_BUTTONS},
+};
+
+// State of checking one file, the handler of jsonStreamParse()
+struct ConfigSchemaCheck {
+  const ConfigSchemaField *fields;
+  uint8_t                  count;
+  uint32_t                 seen;  // Bit f is set when field f matched a value
+  const char              *error; // NULL while the file is valid
+  char where[CONFIG_SCHEMA_WHERE_SIZE]; // Path of the value that was refused
+};
+
+/**
+ * @brief Get which config file a save is for
+ *
+ * @param name Name the configurator saves under: "general", "wifi",
+ *             "homescreen", "deck" or "menu1" up to "menu" DECK_MAX_MENUS
+ * @param path Set to the path of the file, e.g. "/config/menu3.json"
+ * @param size Size of path
+ *
+ * @return ConfigSchemaFile, CONFIG_SCHEMA_NONE for any other name
+ */
+ConfigSchemaFile configSchemaFile(const char *name, char *path, size_t size) {
+  ConfigSchemaFile file = CONFIG_SCHEMA_NONE;
+  const char *base = name;
+  if (strcmp(name, "general") == 0) {
+    file = CONFIG_SCHEMA_GENERAL;
+  } else if (strcmp(name, "wifi") == 0) {
+    file = CONFIG_SCHEMA_WIFI;
+    base = "wificonfig";
+  } else if (strcmp(name, "homescreen") == 0) {
+    file = CONFIG_SCHEMA_HOME;
+  } else if (strcmp(name, "deck") == 0) {
+    file = CONFIG_SCHEMA_DECK;
+  } else if (deckMenuNumber(name, "")) {
+    file = CONFIG_SCHEMA_MENU;
+  }
+  if (file == CONFIG_SCHEMA_NONE ||
+      (size_t)snprintf(path, size, "/config/%s.json", base) >= size) {
+    return CONFIG_SCHEMA_NONE;
+  }
+  return file;
+}
+
+/**
+ * @brief Check whether a field of the table matches the path of a value
+ */
+bool configSchemaMatch(const ConfigSchemaField &field,
+                       const JsonStreamPath &path) {
+  const char *p = field.path;
+  for (uint8_t level = 0; level < path.depth; level++) {
+    if (path.index[level] >= 0) {
+      if (p[0] != '[' || p[1] != ']' || path.index[level] >= field.items) {
+        return false;
+      }
+      p += 2;
+      continue;
+    }
+    if (level > 0 && *p++ != '.') {
+      return false;
+    }
+    // Keys are cut at JSON_STREAM_KEY_SIZE - 1, so is the field then
+    const char *key = path.key[level];
+    const char *keyEnd = key + JSON_STREAM_KEY_SIZE - 1;
+    for (; *p && *p != '.' && *p != '['; p++) {
+      if (key == keyEnd) {
+        continue;
+      }
+      if (*p == '#' ? *key < '0' || *key >= '0' + field.digits : *p != *key) {
+        return false;
+      }
+      key++;
+    }
+    if (*key) {
+      return false;
+    }
+  }
+  return *p == '\0';
+}
+
+bool configSchemaFail(ConfigSchemaCheck &check, const char *error,
+                      const char *where) {
+  check.error = error;
+  jsonStreamCopy(check.where, sizeof(check.where), NULL, where);
+  return false;
+}
+
+/**
+ * @brief Start checking a file
+ *
+ * @return false for CONFIG_SCHEMA_NONE
+ */
+bool configSchemaBegin(ConfigSchemaCheck &check, ConfigSchemaFile file) {
+  check.seen = 0;
+  check.error = NULL;
+  check.where[0] = '\0';
+  switch (file) {
+  case CONFIG_SCHEMA_GENERAL:
+    check.fields = configSchemaGeneral;
+    check.count = sizeof(configSchemaGeneral) / sizeof(ConfigSchemaField);
+    return true;
+  case CONFIG_SCHEMA_WIFI:
+    check.fields = configSchemaWifi;
+    check.count = sizeof(configSchemaWifi) / sizeof(ConfigSchemaField);
+    return true;
+  case CONFIG_SCHEMA_HOME:
+    check.fields = configSchemaHome;
+    check.count = sizeof(configSchemaHome) / sizeof(ConfigSchemaField);
+    return true;
+  case CONFIG_SCHEMA_MENU:
+    check.fields = configSchemaMenu;
+    check.count = sizeof(configSchemaMenu) / sizeof(ConfigSchemaField);
+    return true;
+  case CONFIG_SCHEMA_DECK:
+    check.fields = configSchemaDeck;
+    check.count = sizeof(configSchemaDeck) / sizeof(ConfigSchemaField);
+    return true;
+  default:
+    check.fields = NULL;
+    check.count = 0;
+    return configSchemaFail(check, "unknown file", "");
+  }
+}
+
+/**
+ * @brief Check one value, a JsonStreamHandler with a ConfigSchemaCheck as
+ *        context. Only the first error is kept.
+ */
+void configSchemaValue(void *context, const JsonStreamPath &path,
+                       JsonStreamType type, const char *value, bool truncated) {
+  ConfigSchemaCheck &check = *(ConfigSchemaCheck *)context;
+  if (check.error) {
+    return;
+  }
+
+  uint8_t f = 0;
+  while (f < check.count && !configSchemaMatch(check.fields[f], path)) {
+    f++;
+  }
+  const char *error = NULL;
+  if (f == check.count) {
+    error = "unknown field";
+  } else if (!(check.fields[f].types & (1 << type))) {
+    error = "wrong type";
+  } else if (type == JSON_STREAM_STRING &&
+             (truncated || strlen(value) > check.fields[f].length)) {
+    error = "too long";
+  } else if (type == JSON_STREAM_NUMBER) {
+    char *end;
+    unsigned long number = strtoul(value, &end, 10);
+    if (value[0] == '-' || *end != '\0') {
+      error = "not a whole number";
+    } else if (number > check.fields[f].max) {
+      error = "out of range";
+    }
+  }
+  if (!error) {
+    check.seen |= (uint32_t)1 << f;
+    return;
+  }
+
+  // "button3.actionarray[2]", cut when it does not fit
+  char where[CONFIG_SCHEMA_WHERE_SIZE];
+  size_t used = 0;
+  where[0] = '\0';
+  for (uint8_t level = 0; level < path.depth && used < sizeof(where); level++) {
+    int n = path.index[level] >= 0
+                ? snprintf(where + used, sizeof(where) - used, "[%d]",
+                           path.index[level])
+                : snprintf(where + used, sizeof(where) - used, "%s%s",
+                           level ? "." : "", path.key[level]);
+    used += n > 0 ? n : 0;
+  }
+  configSchemaFail(check, error, where);
+}
+
+/**
+ * @brief Finish checking a file once all values were handed to
+ *        configSchemaValue()
+ *
+ * @return true when the file may be saved, check.error tells why not
+ */
+bool configSchemaEnd(ConfigSchemaCheck &check) {
+  for (uint8_t f = 0; f < check.count && !check.error; f++) {
+    if ((check.fields[f].flags & CONFIG_FIELD_REQUIRED) &&
+        !(check.seen & ((uint32_t)1 << f))) {
+      return configSchemaFail(check, "missing field", check.fields[f].path);
+    }
+  }
+  return check.error == NULL;
+}
+
+/**
+ * @brief Check a whole file
+ *
+ * @param check ConfigSchemaCheck, holds the error afterwards
+ * @param file Which file it is
+ * @param reader Function reading the file, see jsonStreamParse()
+ * @param readerContext Passed to reader
+ *
+ * @return true when the file is valid JSON and every value is in the table
+ */
+bool configSchemaValidate(ConfigSchemaCheck &check, ConfigSchemaFile file,
+                          JsonStreamReader reader, void *readerContext) {
+  if (!configSchemaBegin(check, file)) {
+    return false;
+  }
+  JsonStream js;
+  if (!jsonStreamParse(js, reader, readerContext, configSchemaValue, &check)) {
+    if (!check.error) {
+      configSchemaFail(check, js.error, "");
+    }
+    return false;
+  }
+  return configSchemaEnd(check);
+}
+
+#endif // CONFIG_SCHEMA_H
@@ -0,0 +1,238 @@
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+#include <stdint.h>
+#include <string.h>
+
+// A config snapshot holds the in-memory config structs exactly as they are
+// after parsing the JSON config files, so loading them only needs a file read
+// and a memcpy per struct. All values are little-endian.
+//
+// Header: "FTCS" magic, version (2 bytes), number of sections (1 byte),
+//         reserved (1 byte), then for every one of CONFIG_SNAPSHOT_MAX_SECTIONS
+//         sections its size (4 bytes) and CRC32 (4 bytes)
+// Payload: the sections, back to back
+//
+// Every section has its own CRC so a single section (e.g. one menu) can be
+// read and checked without reading the whole file. The section sizes double
+// as a layout check: a firmware with different struct sizes sees a stale
+// snapshot and falls back to the JSON files. Bump CONFIG_SNAPSHOT_VERSION
+// when a struct changes without changing size. A section whose size depends
+// on its contents takes its expected size from the header, see
+// configSnapshotStoredSize().
+#define CONFIG_SNAPSHOT_VERSION 6
+
+// General config, home screen logos and three sections for each of up to 16
+// menus
+#define CONFIG_SNAPSHOT_MAX_SECTIONS 50
+#define CONFIG_SNAPSHOT_HEADER_SIZE (8 + 8 * CONFIG_SNAPSHOT_MAX_SECTIONS)
+
+struct ConfigSnapshotSection {
+  void    *data;
+  uint32_t size;
+};
+
+/**
+ * @brief Continue a CRC32 (IEEE 802.3) with the next part of the data
+ *
+ * @param crc CRC32 of the data so far, 0 to start
+ * @param data Next part of the data
+ * @param len Length of the part
+ *
+ * @return uint32_t CRC32 of the data including this part
+ */
+uint32_t configSnapshotCrc32Update(uint32_t crc, const uint8_t *data,
+                                   uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+/**
+ * @brief Calculate the CRC32 (IEEE 802.3) of a buffer
+ *
+ * @param data Buffer
+ * @param len Length of the buffer
+ *
+ * @return uint32_t CRC32
+ */
+uint32_t configSnapshotCrc32(const uint8_t *data, uint32_t len) {
+  return configSnapshotCrc32Update(0, data, len);
+}
+
+void configSnapshotWrite32(uint8_t *buf, uint32_t value) {
+  buf[0] = value & 0xFF;
+  buf[1] = (value >> 8) & 0xFF;
+  buf[2] = (value >> 16) & 0xFF;
+  buf[3] = (value >> 24) & 0xFF;
+}
+
+uint32_t configSnapshotRead32(const uint8_t *buf) {
+  return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+         ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/**
+ * @brief Get the size of a section as stored in a snapshot header
+ */
+uint32_t configSnapshotStoredSize(const uint8_t *header, uint8_t index) {
+  return configSnapshotRead32(&header[8 + index * 8]);
+}
+
+/**
+ * @brief Get the size of a snapshot holding the given sections
+ */
+uint32_t configSnapshotSize(const ConfigSnapshotSection *sections,
+                            uint8_t count) {
+  uint32_t size = CONFIG_SNAPSHOT_HEADER_SIZE;
+  for (uint8_t i = 0; i < count; i++) {
+    size += sections[i].size;
+  }
+  return size;
+}
+
+/**
+ * @brief Get the position of a section in the snapshot file
+ */
+uint32_t configSnapshotSectionOffset(const ConfigSnapshotSection *sections,
+                                     uint8_t index) {
+  return configSnapshotSize(sections, index);
+}
+
+/**
+ * @brief Build the snapshot header. The sections follow it in the file.
+ *
+ * @param sections Sections to store, in the order they are written
+ * @param count Number of sections, at most CONFIG_SNAPSHOT_MAX_SECTIONS
+ * @param header Buffer of CONFIG_SNAPSHOT_HEADER_SIZE bytes
+ *
+ * @return false if there are too many sections
+ */
+bool configSnapshotEncodeHeader(const ConfigSnapshotSection *sections,
+                                uint8_t count, uint8_t *header) {
+  if (count > CONFIG_SNAPSHOT_MAX_SECTIONS) {
+    return false;
+  }
+
+  memcpy(header, "FTCS", 4);
+  header[4] = CONFIG_SNAPSHOT_VERSION & 0xFF;
+  header[5] = CONFIG_SNAPSHOT_VERSION >> 8;
+  header[6] = count;
+  header[7] = 0;
+  for (uint8_t i = 0; i < CONFIG_SNAPSHOT_MAX_SECTIONS; i++) {
+    uint32_t size = 0;
+    uint32_t crc = 0;
+    if (i < count) {
+      size = sections[i].size;
+      crc = configSnapshotCrc32((const uint8_t *)sections[i].data, size);
+    }
+    configSnapshotWrite32(&header[8 + i * 8], size);
+    configSnapshotWrite32(&header[12 + i * 8], crc);
+  }
+  return true;
+}
+
+/**
+ * @brief Build a complete snapshot in memory
+ *
+ * @param sections Sections to store
+ * @param count Number of sections, at most CONFIG_SNAPSHOT_MAX_SECTIONS
+ * @param buf Buffer of configSnapshotSize() bytes
+ *
+ * @return false if there are too many sections
+ */
+bool configSnapshotEncode(const ConfigSnapshotSection *sections, uint8_t count,
+                          uint8_t *buf) {
+  if (!configSnapshotEncodeHeader(sections, count, buf)) {
+    return false;
+  }
+  uint8_t *payload = buf + CONFIG_SNAPSHOT_HEADER_SIZE;
+  for (uint8_t i = 0; i < count; i++) {
+    memcpy(payload, sections[i].data, sections[i].size);
+    payload += sections[i].size;
+  }
+  return true;
+}
+
+/**
+ * @brief Check that a snapshot header matches the expected sections
+ *
+ * @param header Buffer of CONFIG_SNAPSHOT_HEADER_SIZE bytes
+ * @param sections Expected sections, only their sizes are used
+ * @param count Number of sections expected
+ *
+ * @return false if the snapshot is not a snapshot or was made for a
+ *         different layout
+ */
+bool configSnapshotCheckHeader(const uint8_t *header,
+                               const ConfigSnapshotSection *sections,
+                               uint8_t count) {
+  if (memcmp(header, "FTCS", 4) != 0 ||
+      (header[4] | (header[5] << 8)) != CONFIG_SNAPSHOT_VERSION ||
+      header[6] != count || count > CONFIG_SNAPSHOT_MAX_SECTIONS) {
+    return false;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    if (configSnapshotStoredSize(header, i) != sections[i].size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Check the CRC of a single section
+ *
+ * @param header Snapshot header, already checked
+ * @param index Section number
+ * @param data Section as read from the file
+ * @param size Size of the section
+ *
+ * @return true if the section is intact
+ */
+bool configSnapshotCheckSection(const uint8_t *header, uint8_t index,
+                                const uint8_t *data, uint32_t size) {
+  return configSnapshotRead32(&header[12 + index * 8]) ==
+         configSnapshotCrc32(data, size);
+}
+
+/**
+ * @brief Check a complete snapshot and copy its sections into place
+ *
+ * @param buf Snapshot as read from the file
+ * @param len Length of the snapshot
+ * @param sections Where to copy each section to
+ * @param count Number of sections expected
+ *
+ * @return false if the snapshot is corrupt or was made for a different layout.
+ *         Nothing is copied in that case.
+ */
+bool configSnapshotDecode(const uint8_t *buf, uint32_t len,
+                          const ConfigSnapshotSection *sections,
+                          uint8_t count) {
+  if (len < CONFIG_SNAPSHOT_HEADER_SIZE ||
+      !configSnapshotCheckHeader(buf, sections, count) ||
+      len != configSnapshotSize(sections, count)) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t offset = configSnapshotSectionOffset(sections, i);
+    if (!configSnapshotCheckSection(buf, i, buf + offset, sections[i].size)) {
+      return false;
+    }
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    memcpy(sections[i].data, buf + configSnapshotSectionOffset(sections, i),
+           sections[i].size);
+  }
+  return true;
+}
+
+#endif // CONFIG_SNAPSHOT_H
@@ -0,0 +1,194 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ConfigSnapshot.h"
+
+// Config files are never rewritten in place. A save writes <file>.tmp, reads
+// it back and checks its CRC32, renames it to <file>.new and only then swaps
+// it in, keeping the previous generation as <file>.bak:
+//
+//   write .tmp -> check .tmp -> .tmp to .new -> remove .bak
+//              -> file to .bak -> .new to file
+//
+// Whatever step a power loss interrupts, configStoreRecover() at boot ends
+// with either the old or the new file: a .tmp was never checked and is
+// dropped, a .new was checked and is swapped in. SPIFFS does not rename onto
+// an existing file, hence the remove before every rename.
+#define CONFIG_STORE_TMP ".tmp"
+#define CONFIG_STORE_NEW ".new"
+#define CONFIG_STORE_BAK ".bak"
+
+// Longest path of a config file including the suffix and the NUL
+#define CONFIG_STORE_PATH_SIZE 48
+
+// CRC32 and length of a file, summed while it is written or read back
+struct ConfigStoreSum {
+  uint32_t crc;
+  uint32_t len;
+};
+
+// The filesystem operations the store needs, so the steps can be run (and
+// interrupted) on the host as well
+struct ConfigStoreFs {
+  void *context;
+  bool (*exists)(void *context, const char *path);
+  bool (*remove)(void *context, const char *path);
+  bool (*rename)(void *context, const char *from, const char *to);
+  // Create or replace a file with data
+  bool (*write)(void *context, const char *path, const uint8_t *data,
+                size_t len);
+  // Read a file back and sum it
+  bool (*check)(void *context, const char *path, ConfigStoreSum &sum);
+};
+
+enum ConfigStoreRecovery {
+  CONFIG_STORE_CLEAN = 0,   // Nothing was interrupted
+  CONFIG_STORE_FINISHED,    // An interrupted save was completed
+  CONFIG_STORE_ROLLED_BACK, // The file was missing, the previous one is back
+  CONFIG_STORE_FAILED       // The filesystem refused, try again next boot
+};
+
+void configStoreSumAdd(ConfigStoreSum &sum, const uint8_t *data, size_t len) {
+  sum.crc = configSnapshotCrc32Update(sum.crc, data, len);
+  sum.len += len;
+}
+
+void configStorePath(char *buf, const char *path, const char *suffix) {
+  snprintf(buf, CONFIG_STORE_PATH_SIZE, "%s%s", path, suffix);
+}
+
+/**
+ * @brief Swap <path>.new in, the current file becomes <path>.bak
+ *
+ * @return false when a step failed, configStoreRecover() finishes it
+ */
+bool configStoreSwap(const ConfigStoreFs &fs, const char *path) {
+  char next[CONFIG_STORE_PATH_SIZE];
+  char bak[CONFIG_STORE_PATH_SIZE];
+  configStorePath(next, path, CONFIG_STORE_NEW);
+  configStorePath(bak, path, CONFIG_STORE_BAK);
+
+  if (fs.exists(fs.context, path)) {
+    if (fs.exists(fs.context, bak) && !fs.remove(fs.context, bak)) {
+      return false;
+    }
+    if (!fs.rename(fs.context, path, bak)) {
+      return false;
+    }
+  }
+  return fs.rename(fs.context, next, path);
+}
+
+/**
+ * @brief Check a written <path>.tmp and swap it in
+ *
+ * @param fs ConfigStoreFs
+ * @param path Path of the config file
+ * @param expected Sum of the data that was written to <path>.tmp
+ *
+ * @return false when <path>.tmp does not hold the data or a step failed.
+ *         The running file is untouched unless the swap had begun.
+ */
+bool configStoreCommit(const ConfigStoreFs &fs, const char *path,
+                       const ConfigStoreSum &expected) {
+  char tmp[CONFIG_STORE_PATH_SIZE];
+  char next[CONFIG_STORE_PATH_SIZE];
+  configStorePath(tmp, path, CONFIG_STORE_TMP);
+  configStorePath(next, path, CONFIG_STORE_NEW);
+
+  ConfigStoreSum written = {0, 0};
+  if (!fs.check(fs.context, tmp, written) || written.crc != expected.crc ||
+      written.len != expected.len) {
+    fs.remove(fs.context, tmp);
+    return false;
+  }
+  if (fs.exists(fs.context, next) && !fs.remove(fs.context, next)) {
+    return false;
+  }
+  if (!fs.rename(fs.context, tmp, next)) {
+    return false;
+  }
+  return configStoreSwap(fs, path);
+}
+
+/**
+ * @brief Save a config file
+ *
+ * @param fs ConfigStoreFs
+ * @param path Path of the config file
+ * @param data New content
+ * @param len Length of data
+ *
+ * @return true when the new content is in place
+ */
+bool configStoreSave(const ConfigStoreFs &fs, const char *path,
+                     const uint8_t *data, size_t len) {
+  char tmp[CONFIG_STORE_PATH_SIZE];
+  configStorePath(tmp, path, CONFIG_STORE_TMP);
+
+  if (!fs.write(fs.context, tmp, data, len)) {
+    fs.remove(fs.context, tmp);
+    return false;
+  }
+  ConfigStoreSum expected = {0, 0};
+  configStoreSumAdd(expected, data, len);
+  return configStoreCommit(fs, path, expected);
+}
+
+/**
+ * @brief Finish or undo a save that was interrupted
+ *
+ * @param fs ConfigStoreFs
+ * @param path Path of the config file
+ *
+ * @return ConfigStoreRecovery what was done
+ */
+ConfigStoreRecovery configStoreRecover(const ConfigStoreFs &fs,
+                                       const char *path) {
+  char tmp[CONFIG_STORE_PATH_SIZE];
+  char next[CONFIG_STORE_PATH_SIZE];
+  char bak[CONFIG_STORE_PATH_SIZE];
+  configStorePath(tmp, path, CONFIG_STORE_TMP);
+  configStorePath(next, path, CONFIG_STORE_NEW);
+  configStorePath(bak, path, CONFIG_STORE_BAK);
+
+  // Never checked, may be cut short
+  if (fs.exists(fs.context, tmp)) {
+    fs.remove(fs.context, tmp);
+  }
+
+  if (fs.exists(fs.context, next)) {
+    return configStoreSwap(fs, path) ? CONFIG_STORE_FINISHED
+                                     : CONFIG_STORE_FAILED;
+  }
+  if (!fs.exists(fs.context, path) && fs.exists(fs.context, bak)) {
+    return fs.rename(fs.context, bak, path) ? CONFIG_STORE_ROLLED_BACK
+                                            : CONFIG_STORE_FAILED;
+  }
+  return CONFIG_STORE_CLEAN;
+}
+
+/**
+ * @brief Go back to the previous generation of a config file, e.g. when the
+ *        current one does not parse
+ *
+ * @return false when there is no previous generation
+ */
+bool configStoreRollback(const ConfigStoreFs &fs, const char *path) {
+  char bak[CONFIG_STORE_PATH_SIZE];
+  configStorePath(bak, path, CONFIG_STORE_BAK);
+
+  if (!fs.exists(fs.context, bak)) {
+    return false;
+  }
+  if (fs.exists(fs.context, path) && !fs.remove(fs.context, path)) {
+    return false;
+  }
+  return fs.rename(fs.context, bak, path);
+}
+
+#endif // CONFIG_STORE_H
@@ -0,0 +1,192 @@
+#ifndef DECK_ARENA_H
+#define DECK_ARENA_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "JsonStream.h"
+
+// The deck manifest (/config/deck.json) declares how many menus there are
+// and how many buttons each of them has:
+//
+//   { "menus": [5, 5, 5, 5, 5, 3] }
+//
+// Menu i is read from /config/menu<i+1>.json. All records of the deck (icons,
+// buttons, latch states) come from one arena that is sized for exactly this
+// deck, so unused menus and buttons take no RAM.
+#define DECK_MAX_MENUS 16
+
+// A page has 6 keys, the last one is the home button
+#define DECK_MAX_BUTTONS 5
+
+// Used when there is no manifest: the classic 5 menus of 5 buttons
+#define DECK_DEFAULT_MENUS 5
+
+struct DeckManifest {
+  uint8_t menuCount;
+  uint8_t buttonCount[DECK_MAX_MENUS];
+};
+
+/**
+ * @brief Fill a manifest with the deck used when there is no deck.json
+ */
+void deckManifestDefault(DeckManifest &deck) {
+  memset(&deck, 0, sizeof(deck));
+  deck.menuCount = DECK_DEFAULT_MENUS;
+  for (int i = 0; i < DECK_DEFAULT_MENUS; i++) {
+    deck.buttonCount[i] = DECK_MAX_BUTTONS;
+  }
+}
+
+/**
+ * @brief Check that every menu of a manifest has between 1 and
+ *        DECK_MAX_BUTTONS buttons
+ */
+bool deckManifestValid(const DeckManifest &deck) {
+  if (deck.menuCount < 1 || deck.menuCount > DECK_MAX_MENUS) {
+    return false;
+  }
+  for (int i = 0; i < deck.menuCount; i++) {
+    if (deck.buttonCount[i] < 1 || deck.buttonCount[i] > DECK_MAX_BUTTONS) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// State of a manifest while it is being parsed
+struct DeckManifestParse {
+  DeckManifest *deck;
+  bool          valid; // Cleared by anything that does not fit the manifest
+};
+
+/**
+ * @brief JsonStreamHandler filling a DeckManifest from deck.json
+ */
+void deckManifestValue(void *context, const JsonStreamPath &path,
+                       JsonStreamType type, const char *value,
+                       bool truncated) {
+  DeckManifestParse *parse = (DeckManifestParse *)context;
+  if (path.depth != 2 || strcmp(path.key[0], "menus") != 0) {
+    return;
+  }
+  // index is -1 when "menus" is an object instead of an array
+  int menu = path.index[1];
+  int buttons = atoi(value);
+  if (truncated || type != JSON_STREAM_NUMBER || menu < 0 ||
+      menu >= DECK_MAX_MENUS || buttons < 1 || buttons > DECK_MAX_BUTTONS) {
+    parse->valid = false;
+    return;
+  }
+  parse->deck->buttonCount[menu] = buttons;
+  if (menu + 1 > parse->deck->menuCount) {
+    parse->deck->menuCount = menu + 1;
+  }
+}
+
+/**
+ * @brief Get the number of buttons in the whole deck
+ */
+uint16_t deckButtonTotal(const DeckManifest &deck) {
+  uint16_t total = 0;
+  for (int i = 0; i < deck.menuCount; i++) {
+    total += deck.buttonCount[i];
+  }
+  return total;
+}
+
+/**
+ * @brief Get the position of the first button of a menu among all buttons of
+ *        the deck. Latch states and snapshot records are kept in this order.
+ */
+uint16_t deckFirstButton(const DeckManifest &deck, int menuIndex) {
+  uint16_t first = 0;
+  for (int i = 0; i < menuIndex && i < deck.menuCount; i++) {
+    first += deck.buttonCount[i];
+  }
+  return first;
+}
+
+/**
+ * @brief Get the number of buttons of the largest menu
+ */
+uint8_t deckMaxButtons(const DeckManifest &deck) {
+  uint8_t most = 0;
+  for (int i = 0; i < deck.menuCount; i++) {
+    if (deck.buttonCount[i] > most) {
+      most = deck.buttonCount[i];
+    }
+  }
+  return most;
+}
+
+/**
+ * @brief Get the menu number from a name like "menu7" or "menu7.json"
+ *
+ * @param name Name to check
+ * @param suffix What follows the number, e.g. ".json" or ""
+ *
+ * @return int menu number (1 - DECK_MAX_MENUS), 0 if the name is no menu
+ */
+int deckMenuNumber(const char *name, const char *suffix) {
+  if (strncmp(name, "menu", 4) != 0) {
+    return 0;
+  }
+  const char *p = name + 4;
+  int number = 0;
+  int digits = 0;
+  while (*p >= '0' && *p <= '9' && digits < 3) {
+    number = number * 10 + (*p - '0');
+    p++;
+    digits++;
+  }
+  if (digits == 0 || name[4] == '0' || strcmp(p, suffix) != 0 ||
+      number > DECK_MAX_MENUS) {
+    return 0;
+  }
+  return number;
+}
+
+// Bump allocator handing out the records of the deck. Begun without a buffer
+// it only measures, so the same code first sizes the arena and then fills it.
+struct DeckArena {
+  uint8_t *base; // NULL while measuring
+  size_t   size;
+  size_t   used;
+};
+
+void deckArenaBegin(DeckArena &arena, void *buf, size_t size) {
+  arena.base = (uint8_t *)buf;
+  arena.size = size;
+  arena.used = 0;
+}
+
+/**
+ * @brief Take a block from the arena
+ *
+ * @param arena DeckArena
+ * @param size Size of the block
+ * @param align Alignment of the block, a power of two
+ *
+ * @return void* the block, zeroed. NULL while measuring or when the arena is
+ *         full, in both cases arena.used still grows by the block.
+ */
+void *deckArenaAlloc(DeckArena &arena, size_t size, size_t align) {
+  size_t offset = (arena.used + align - 1) & ~(align - 1);
+  arena.used = offset + size;
+  if (!arena.base || arena.used > arena.size) {
+    return NULL;
+  }
+  memset(arena.base + offset, 0, size);
+  return arena.base + offset;
+}
+
+/**
+ * @brief Check whether every block fit in the arena
+ */
+bool deckArenaFits(const DeckArena &arena) {
+  return arena.base && arena.used <= arena.size;
+}
+
+#endif // DECK_ARENA_H
@@ -1,3 +1,50 @@
+// ----------------------------- Screen mirror -----------------------------
+
+/**
+ * @brief Start noting what a key is drawn from, for /screen
+ *
+ * @param fill Fill colour of the key
+ *
+ * @note The logo and the latch dot are added while they are drawn,
+ *       mirrorKeyEnd() keeps the key.
+ */
+void mirrorKeyBegin(uint16_t fill) {
+  mirrorStaged.fill = fill;
+  mirrorStaged.icon = ICON_NONE;
+  mirrorStaged.flags = MIRROR_KEY_DRAWN;
+}
+
+/**
+ * @brief Keep what key b was drawn from, see mirrorKeyBegin()
+ */
+void mirrorKeyEnd(uint8_t b) {
+  portENTER_CRITICAL(&screenMirrorLock);
+  mirrorStaged.generation = screenMirror.keys[b].generation + 1;
+  screenMirror.keys[b] = mirrorStaged;
+  screenMirror.background = generalconfig.backgroundColour;
+  screenMirror.latchColour = generalconfig.latchedColour;
+  portEXIT_CRITICAL(&screenMirrorLock);
+}
+
+/**
+ * @brief Note that key b is drawn pressed, white without its logo
+ */
+void mirrorKeyPressed(uint8_t b) {
+  portENTER_CRITICAL(&screenMirrorLock);
+  screenMirror.keys[b].flags |= MIRROR_KEY_DRAWN | MIRROR_KEY_PRESSED;
+  screenMirror.keys[b].generation++;
+  portEXIT_CRITICAL(&screenMirrorLock);
+}
+
+/**
+ * @brief Copy what the keys were drawn from, for the web server task
+ */
+void mirrorSnapshot(MirrorScreen &copy) {
+  portENTER_CRITICAL(&screenMirrorLock);
+  copy = screenMirror;
+  portEXIT_CRITICAL(&screenMirrorLock);
+}
+
 /**
  * @brief This function draws the a "latched" dot. it uses the logonumber,
  * colomn and row to determine where.
@@ -20,24 +67,30 @@ void drawlatched(int b, int col, int row) {
   tft.fillRoundRect((KEY_X - 37 + col * (KEY_W + KEY_SPACING_X)) - offset,
                     (KEY_Y - 37 + row * (KEY_H + KEY_SPACING_Y)) - offset, 18,
                     18, 4, generalconfig.latchedColour);
+  mirrorStaged.flags |= MIRROR_KEY_LATCH_DOT;
 }
 
 int posX(int col) { return KEY_X - 36 + col * (KEY_W + KEY_SPACING_X); }
 int posY(int row) { return KEY_Y - 36 + row * (KEY_H + KEY_SPACING_Y); }
 
-void drawMenuLogo(int logonumber, bool transparent, bool latch,
-                  const char *defaultLogo, const char *latchLogo, int col,
-                  int row) {
-  const char *logo =
-      latch && strcmp(latchLogo, "/logos/") != 0 ? latchLogo : defaultLogo;
-
+/**
+ * @brief This function draws the logo of a key and notes it for /screen.
+ */
+void drawKeyLogo(IconId logo, int col, int row, bool transparent) {
+  drawIconBmp(logo, posX(col), posY(row), transparent);
+  mirrorStaged.icon = logo;
   if (transparent) {
-    drawBmpTransparent(logo, posX(col), posY(row));
-  } else {
-    drawBmp(logo, posX(col), posY(row));
+    mirrorStaged.flags |= MIRROR_KEY_TRANSPARENT;
   }
+}
+
+void drawMenuLogo(int logonumber, bool transparent, bool latch,
+                  IconId defaultLogo, IconId latchLogo, int col, int row) {
+  IconId logo = latch && latchLogo != ICON_NONE ? latchLogo : defaultLogo;
+
+  drawKeyLogo(logo, col, row, transparent);
 
-  if (latch && strcmp(latchLogo, "/logos/") == 0) {
+  if (latch && latchLogo == ICON_NONE) {
     drawlatched(logonumber, col, row);
   }
 }
@@ -58,47 +111,33 @@ void drawMenuLogo(int logonumber, bool transparent, bool latch,
 */
 void drawIcon(int logonumber, int col, int row, bool transparent, bool latch) {
 
-  if (pageNum == 0) {
+  if (pageNum == PAGE_HOME) {
     // Draw Home screen logos
-    char *logos[] = {screens[0].icons[0], screens[0].icons[1], screens[0].icons[2],
-                     screens[0].icons[3], screens[0].icons[4], systemIcons.settings};
-
-    char *logo = logos[logonumber];
-
-    if (transparent) {
-      drawBmpTransparent(logo, posX(col), posY(row));
-    } else {
-      drawBmp(logo, posX(col), posY(row));
-    }
+    IconId logos[] = {homeIcons[0], homeIcons[1], homeIcons[2],
+                      homeIcons[3], homeIcons[4], systemIcons.settings};
 
-  } else if (pageNum >= 1 && pageNum <= 5) {
-    // Handle MENU 1-5 using array indexing
-    int menuIndex = pageNum - 1;  // Convert pageNum to menu array index (0-4)
-    
-    const char *menuLogos[] = {screens[pageNum].icons[0], screens[pageNum].icons[1],
-                               screens[pageNum].icons[2], screens[pageNum].icons[3],
-                               screens[pageNum].icons[4], systemIcons.homebutton};
+    drawKeyLogo(logos[logonumber], col, row, transparent);
 
-    const char *latchLogos[] = {
-        menus[menuIndex].buttons[0].latchlogo, menus[menuIndex].buttons[1].latchlogo,
-        menus[menuIndex].buttons[2].latchlogo, menus[menuIndex].buttons[3].latchlogo,
-        menus[menuIndex].buttons[4].latchlogo,
-    };
+  } else if (isMenuPage(pageNum)) {
+    // Handle the menus, navigateToPage() made the menu resident
+    const MenuPage &page = menuPages[pageNum - 1];
 
-    const char *defaultLogo = menuLogos[logonumber];
-    const char *latchLogo = latchLogos[logonumber];
-
-    drawMenuLogo(logonumber, transparent, latch, defaultLogo, latchLogo, col, row);
+    if (logonumber == 5) {
+      drawMenuLogo(logonumber, transparent, false, systemIcons.homebutton, ICON_NONE, col,
+                   row);
+    } else if (logonumber < page.buttonCount) {
+      drawMenuLogo(logonumber, transparent, latch, page.icons[logonumber],
+                   currentMenu().buttons[logonumber].latchLogo, col, row);
+    }
+    // Keys after the last button of the menu stay blank
 
-  } else if (pageNum == 6) { // Settings
-    const char *logoPaths[] = {
-        systemIcons.configurator,    "/sys/ico/brightnessdown.bmp",
-        "/sys/ico/brightnessup.bmp", "/sys/ico/sleep.bmp",
-        "/sys/ico/info.bmp",         systemIcons.homebutton};
+  } else if (pageNum == PAGE_SETTINGS) { // Settings
+    IconId logos[] = {systemIcons.configurator, systemIcons.brightnessDown,
+                      systemIcons.brightnessUp, systemIcons.sleep,
+                      systemIcons.info,         systemIcons.homebutton};
 
-    if (logonumber >= 0 &&
-        logonumber < sizeof(logoPaths) / sizeof(logoPaths[0])) {
-      drawBmpTransparent(logoPaths[logonumber], posX(col), posY(row));
+    if (logonumber >= 0 && logonumber < sizeof(logos) / sizeof(logos[0])) {
+      drawKeyLogo(logos[logonumber], col, row, true);
 
       if (logonumber == 3 && latch) {
         drawlatched(logonumber, col, row);
@@ -108,50 +147,78 @@ void drawIcon(int logonumber, int col, int row, bool transparent, bool latch) {
 }
 
 /**
-* @brief This function draws the 6 buttons that are on every page.
+* @brief This function draws one of the 6 buttons of the page on screen.
          Pagenumber is global and doesn't need to be passed.
 *
-* @param none
+* @param b uint8_t key number, 0 is top left
 *
 * @return none
 *
-* @note Three possibilities: pagenumber = 0 means homescreen,
-         pagenumber = 7 means config mode, anything else is a menu.
+* @note The keys of the home screen and the home button use
+         menuButtonColour, the other keys functionButtonColour.
 */
-void drawKeypad() {
-  // Draw the home screen button outlines and fill them with colours
-  if (pageNum == 0) {
-    for (uint8_t row = 0; row < 2; row++) {
-      for (uint8_t col = 0; col < 3; col++) {
-
-        uint8_t  b = col + row * 3;
-        uint16_t buttonBG;
-        bool     drawTransparent;
-        uint16_t imageBGColor = getImageBG(b);
-        if (imageBGColor > 0) {
-          buttonBG = imageBGColor;
-          drawTransparent = false;
-        } else {
-          buttonBG = generalconfig.menuButtonColour;
-          drawTransparent = true;
-        }
-        tft.setFreeFont(LABEL_FONT);
-        key[b].initButton(
-            &tft, KEY_X + col * (KEY_W + KEY_SPACING_X),
-            KEY_Y + row * (KEY_H +
-                           KEY_SPACING_Y), // x, y, w, h, outline, fill, text
-            KEY_W, KEY_H, TFT_WHITE, buttonBG, TFT_WHITE, emptStr,
-            KEY_TEXTSIZE);
-        key[b].drawButton();
-        drawIcon(b, col, row, drawTransparent,
-                 false); // After drawing the button outline we call this to
-                         // draw a logo.
-      }
+void drawKey(uint8_t b) {
+  uint8_t col = b % 3;
+  uint8_t row = b / 3;
+
+  bool     functionKey = pageNum != PAGE_HOME && b != 5;
+  bool     keyLatched = functionKey && isKeyLatched(b);
+  uint16_t buttonBG;
+  bool     drawTransparent;
+  uint16_t imageBGColor = keyLatched ? getLatchImageBG(b) : getImageBG(b);
+
+  if (imageBGColor > 0) {
+    buttonBG = imageBGColor;
+    drawTransparent = false;
+  } else {
+    buttonBG = functionKey ? generalconfig.functionButtonColour
+                           : generalconfig.menuButtonColour;
+    drawTransparent = true;
+  }
+
+  tft.setFreeFont(LABEL_FONT);
+  key[b].initButton(
+      &tft, KEY_X + col * (KEY_W + KEY_SPACING_X),
+      KEY_Y + row * (KEY_H +
+                     KEY_SPACING_Y), // x, y, w, h, outline, fill, text
+      KEY_W, KEY_H, TFT_WHITE, buttonBG, TFT_WHITE, emptStr, KEY_TEXTSIZE);
+  mirrorKeyBegin(buttonBG);
+  key[b].drawButton();
+  // After drawing the button outline we call this to draw a logo.
+  drawIcon(b, col, row, drawTransparent, keyLatched);
+  mirrorKeyEnd(b);
+}
+
+/**
+* @brief This function draws some of the 6 buttons of the page on screen,
+         e.g. the ones that changed after the config was reloaded.
+*
+* @param keys uint8_t bit b set to draw key b
+*
+* @return none
+*/
+void drawKeys(uint8_t keys) {
+  for (uint8_t b = 0; b < 6; b++) {
+    if (keys & (1 << b)) {
+      drawKey(b);
     }
   }
+}
 
-  else if (pageNum == 10) {
-    // Pagenum 10 means that a JSON config failed to load completely.
+/**
+* @brief This function draws the 6 buttons that are on every page.
+         Pagenumber is global and doesn't need to be passed.
+*
+* @param none
+*
+* @return none
+*
+* @note Two possibilities: PAGE_JSON_ERROR, anything else is the home
+         screen, a menu or the settings page.
+*/
+void drawKeypad() {
+  if (pageNum == PAGE_JSON_ERROR) {
+    // A JSON config failed to load completely.
     tft.fillScreen(TFT_BLACK);
     tft.setCursor(0, 0);
     tft.setTextFont(2);
@@ -164,91 +231,7 @@ void drawKeypad() {
     tft.printf("  and typing \"reset %s\"\n", jsonfilefail);
     tft.println("  If you don't do this, the configurator will fail to load.");
   } else {
-    // Draw the button outlines and fill them with colours
-    for (uint8_t row = 0; row < 2; row++) {
-      for (uint8_t col = 0; col < 3; col++) {
-
-        uint8_t b = col + row * 3;
-
-        if (row == 1 && col == 2) {
-
-          // Check if "home.bmp" is a transparent one
-
-          uint16_t buttonBG;
-          bool     drawTransparent;
-          uint16_t imageBGColor;
-
-          imageBGColor = getImageBG(b);
-
-          if (imageBGColor > 0) {
-            buttonBG = imageBGColor;
-            drawTransparent = false;
-          } else {
-            buttonBG = generalconfig.menuButtonColour;
-            drawTransparent = true;
-          }
-
-          tft.setFreeFont(LABEL_FONT);
-          key[b].initButton(
-              &tft, KEY_X + col * (KEY_W + KEY_SPACING_X),
-              KEY_Y + row * (KEY_H +
-                             KEY_SPACING_Y), // x, y, w, h, outline, fill, text
-              KEY_W, KEY_H, TFT_WHITE, buttonBG, TFT_WHITE, emptStr,
-              KEY_TEXTSIZE);
-          key[b].drawButton();
-          drawIcon(b, col, row, drawTransparent, false);
-        } else {
-          // Otherwise use functionButtonColour
-
-          int index;
-
-          if (pageNum == 2) {
-            index = b + 5;
-          } else if (pageNum == 3) {
-            index = b + 10;
-          } else if (pageNum == 4) {
-            index = b + 15;
-          } else if (pageNum == 5) {
-            index = b + 20;
-          } else if (pageNum == 6) {
-            index = b + 25;
-          } else {
-            index = b;
-          }
-
-          uint16_t buttonBG;
-          bool     drawTransparent;
-          uint16_t imageBGColor;
-          if (islatched[index] && b < 5) {
-            imageBGColor = getLatchImageBG(b);
-          } else {
-            imageBGColor = getImageBG(b);
-          }
-
-          if (imageBGColor > 0) {
-            buttonBG = imageBGColor;
-            drawTransparent = false;
-          } else {
-            buttonBG = generalconfig.functionButtonColour;
-            drawTransparent = true;
-          }
-          tft.setFreeFont(LABEL_FONT);
-          key[b].initButton(
-              &tft, KEY_X + col * (KEY_W + KEY_SPACING_X),
-              KEY_Y + row * (KEY_H +
-                             KEY_SPACING_Y), // x, y, w, h, outline, fill, text
-              KEY_W, KEY_H, TFT_WHITE, buttonBG, TFT_WHITE, emptStr,
-              KEY_TEXTSIZE);
-          key[b].drawButton();
-          // After drawing the button outline we call this to draw a logo.
-          if (islatched[index] && b < 5) {
-            drawIcon(b, col, row, drawTransparent, true);
-          } else {
-            drawIcon(b, col, row, drawTransparent, false);
-          }
-        }
-      }
-    }
+    drawKeys(CONFIG_ALL_KEYS);
   }
 }
 
@@ -361,6 +344,14 @@ void printinfo() {
   tft.println("ESP-IDF: ");
   tft.println(esp_get_idf_version());
 
+  tft.println("Last boots:");
+  char line[64];
+  for (int i = 0; i < bootReports.count; i++) {
+    bootReportSummary(line, sizeof(line), bootReports.reports[i], bootStages,
+                      BOOT_STAGE_COUNT);
+    tft.println(line);
+  }
+
   displayinginfo = true;
 }
 
@@ -0,0 +1,250 @@
+#ifndef ICON_TABLE_H
+#define ICON_TABLE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "IconTranscode.h"
+
+// Every logo the keypad draws is interned once in the icon table. Menus,
+// buttons, the home screen and the system icons refer to it by IconId, so a
+// logo used by many buttons (e.g. question.bmp) is stored once. The table
+// also keeps what is known about the bitmap, read from the file the first
+// time it is needed, so filling a key with the background colour of its logo
+// does not open the file again. The table is sized for the deck and taken
+// from the deck arena, see iconTableLogos(). Ids of logos nothing refers to
+// any more are freed by iconTableSweep() and handed out again.
+
+// Logos besides those of the menus: 6 on the home screen, 7 system icons and
+// question.bmp for logos a menu leaves out
+#define ICON_TABLE_FIXED 14
+
+// Longest path including the NUL, the same as IconPath
+#define ICON_PATH_SIZE 32
+
+#define ICON_NONE 0xFF
+
+typedef uint8_t IconId;
+
+// IconInfo flags
+#define ICON_INFO_READ 0x01    // width, height, bpp and background are known
+#define ICON_INFO_MISSING 0x02 // The file is missing or not a bitmap
+#define ICON_INFO_NATIVE 0x04  // A native logo, see IconTranscode.h
+
+struct IconInfo {
+  uint16_t width;
+  uint16_t height;
+  uint16_t background; // RGB565 of the first pixel
+  uint8_t  bpp;
+  uint8_t  flags;
+};
+
+struct IconTable {
+  uint8_t   count;    // Ids handed out so far, some of them may be free
+  uint8_t   capacity; // Entries in icons
+  IconInfo *icons;
+  char     *paths;    // ICON_PATH_SIZE bytes for every id, "" when it is free
+};
+
+/**
+ * @brief Get the number of logos a deck can use at once: the logo and the
+ *        latch logo of every button and the ICON_TABLE_FIXED others
+ *
+ * @param buttons Number of buttons of the whole deck
+ */
+uint8_t iconTableLogos(uint16_t buttons) {
+  uint16_t logos = buttons * 2 + ICON_TABLE_FIXED;
+  return logos < ICON_NONE ? logos : ICON_NONE;
+}
+
+void iconTableReset(IconTable &table) { table.count = 0; }
+
+char *iconTableSlot(const IconTable &table, IconId id) {
+  return table.paths + id * ICON_PATH_SIZE;
+}
+
+/**
+ * @brief Give the table its storage, it starts out empty
+ *
+ * @param table IconTable
+ * @param icons Room for capacity entries
+ * @param paths Room for capacity paths of ICON_PATH_SIZE bytes
+ * @param capacity Number of logos, see iconTableLogos(). 0 when there is no
+ *                 storage, every logo is ICON_NONE then.
+ */
+void iconTableBegin(IconTable &table, IconInfo *icons, char *paths,
+                    uint8_t capacity) {
+  table.icons = icons;
+  table.paths = paths;
+  table.capacity = capacity;
+  iconTableReset(table);
+}
+
+/**
+ * @brief Look up the id of a logo
+ *
+ * @return IconId of the logo, ICON_NONE when it is not in the table
+ */
+IconId iconTableFind(const IconTable &table, const char *path) {
+  // A free id has an empty path
+  if (!path[0]) {
+    return ICON_NONE;
+  }
+  for (uint8_t i = 0; i < table.count; i++) {
+    if (strcmp(iconTableSlot(table, i), path) == 0) {
+      return i;
+    }
+  }
+  return ICON_NONE;
+}
+
+/**
+ * @brief Get the id of a logo, adding it to the table if it is new
+ *
+ * @param table IconTable
+ * @param prefix Directory of the logo, e.g. "/logos/", may be NULL
+ * @param name File name of the logo
+ *
+ * @return IconId of the logo, ICON_NONE when the table is full
+ *
+ * @note Paths longer than ICON_PATH_SIZE - 1 are truncated. A freed id is
+ *       reused before a new one is handed out.
+ */
+IconId iconTableIntern(IconTable &table, const char *prefix, const char *name) {
+  char path[ICON_PATH_SIZE];
+  snprintf(path, sizeof(path), "%s%s", prefix ? prefix : "", name);
+
+  IconId known = iconTableFind(table, path);
+  if (known != ICON_NONE) {
+    return known;
+  }
+
+  IconId id = 0;
+  while (id < table.count && iconTableSlot(table, id)[0]) {
+    id++;
+  }
+  if (id >= table.capacity || id >= ICON_NONE) {
+    return ICON_NONE;
+  }
+  if (id == table.count) {
+    table.count++;
+  }
+  memset(&table.icons[id], 0, sizeof(IconInfo));
+  memcpy(iconTableSlot(table, id), path, sizeof(path));
+  return id;
+}
+
+/**
+ * @brief Note that an id is still referred to, see iconTableSweep()
+ *
+ * @param table IconTable
+ * @param keep One flag for every id the table has handed out
+ * @param id IconId, ICON_NONE is ignored
+ */
+void iconTableKeep(const IconTable &table, uint8_t *keep, IconId id) {
+  if (id < table.count) {
+    keep[id] = 1;
+  }
+}
+
+/**
+ * @brief Free every id that is not kept, e.g. after a reload replaced logos
+ *
+ * @param table IconTable
+ * @param keep Flags set with iconTableKeep()
+ *
+ * @return uint8_t number of ids that were freed
+ *
+ * @note Kept ids do not change and keep what is known about their bitmap.
+ */
+uint8_t iconTableSweep(IconTable &table, const uint8_t *keep) {
+  uint8_t freed = 0;
+  for (uint8_t i = 0; i < table.count; i++) {
+    char *slot = iconTableSlot(table, i);
+    if (!keep[i] && slot[0]) {
+      slot[0] = '\0';
+      freed++;
+    }
+  }
+  while (table.count > 0 && !iconTableSlot(table, table.count - 1)[0]) {
+    table.count--;
+  }
+  return freed;
+}
+
+/**
+ * @brief Get the path of a logo
+ *
+ * @return const char* the path, "" for ICON_NONE
+ */
+const char *iconTablePath(const IconTable &table, IconId id) {
+  return id < table.count ? iconTableSlot(table, id) : "";
+}
+
+/**
+ * @brief Forget what is known about the bitmaps, e.g. after logos were
+ *        uploaded or deleted. It is read again when the logo is next drawn.
+ */
+void iconTableInvalidate(IconTable &table) {
+  for (uint8_t i = 0; i < table.count; i++) {
+    table.icons[i].flags = 0;
+  }
+}
+
+/**
+ * @brief Forget what is known about one bitmap, e.g. after it was replaced.
+ *        Ids that are not in the table are ignored.
+ */
+void iconTableInvalidateIcon(IconTable &table, IconId id) {
+  if (id < table.count) {
+    table.icons[id].flags = 0;
+  }
+}
+
+/**
+ * @brief Check whether a logo was invalidated since it was last read
+ *
+ * @return true for a logo in the table whose header is not read, false for
+ *         ICON_NONE
+ */
+bool iconTableStale(const IconTable &table, IconId id) {
+  return id < table.count && !(table.icons[id].flags & ICON_INFO_READ);
+}
+
+/**
+ * @brief Fill width, height and bpp of an IconInfo from the start of a BMP
+ *        file
+ *
+ * @param header The first bytes of the file
+ * @param len Number of bytes in header, at least 30 are needed
+ * @param info IconInfo to fill
+ * @param dataOffset Set to the offset of the pixels in the file
+ *
+ * @return false if it is no BMP file
+ *
+ * @note A native logo also gets ICON_INFO_NATIVE and, when header holds
+ *       ICON_NATIVE_BLOCK + 2 bytes, its background.
+ */
+bool iconInfoFromBmpHeader(const uint8_t *header, size_t len, IconInfo &info,
+                           uint32_t &dataOffset) {
+  if (len < 30 || header[0] != 'B' || header[1] != 'M') {
+    return false;
+  }
+  dataOffset = header[0x0A] | (header[0x0B] << 8) |
+               ((uint32_t)header[0x0C] << 16) | ((uint32_t)header[0x0D] << 24);
+  info.width = header[0x12] | (header[0x13] << 8);
+  // A negative height is a bitmap stored top down
+  int32_t height = (int32_t)iconGet32(header + 0x16);
+  info.height = height < 0 ? -height : height;
+  info.bpp = header[0x1C];
+  if (iconNativeCheck(header, len)) {
+    info.flags |= ICON_INFO_NATIVE;
+    if (len >= ICON_NATIVE_BLOCK + 2) {
+      info.background = iconGet16(header + ICON_NATIVE_BLOCK);
+    }
+  }
+  return true;
+}
+
+#endif // ICON_TABLE_H
@@ -0,0 +1,453 @@
+#ifndef ICON_TRANSCODE_H
+#define ICON_TRANSCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Logos uploaded to /logos are stored in the format the keys draw fastest,
+// a native logo:
+//
+//   0   BMP file header, reserved = ICON_NATIVE_SIGNATURE
+//   14  BITMAPINFOHEADER, 16 bpp BI_BITFIELDS, negative height (top down)
+//   54  RGB565 masks
+//   66  background(2), then a span(2) per row
+//   ..  RGB565 rows, the top row first, each padded to 4 bytes
+//
+// It is still a BMP, so the configurator shows it as any other logo. The
+// background is the colour the key is filled with, the bottom left pixel as
+// getBMPColor() reads it from a bottom-up BMP. A span is the first and one
+// past the last column of a row that is not black: a transparent draw only
+// pushes those, and skips a row that is all black.
+//
+// An upload is converted while its parts arrive, a byte at a time. The source
+// is never stored, only the logo it is scaled down to, so a large bitmap
+// takes no more memory than a small one.
+#define ICON_NATIVE_SIZE 75              // Largest logo, larger ones are scaled down
+#define ICON_NATIVE_SIGNATURE 0x31445446 // "FTD1" in the reserved bytes
+#define ICON_NATIVE_BLOCK 66             // Offset of the background
+#define ICON_NATIVE_STRIDE(w) (((uint32_t)(w) * 2 + 3) & ~3u)
+#define ICON_NATIVE_HEADER_SIZE(h) ((ICON_NATIVE_BLOCK + 2 + 2 * (uint32_t)(h) + 3) & ~3u)
+#define ICON_NATIVE_HEADER_MAX ICON_NATIVE_HEADER_SIZE(ICON_NATIVE_SIZE)
+
+#define ICON_TRANSCODE_HEADER_SIZE 66   // File and info header up to the masks
+#define ICON_TRANSCODE_MAX_SOURCE 4096  // Widest and highest source taken
+
+enum IconTranscodeState {
+  ICON_TRANSCODE_HEADER = 0, // Reading the headers and the palette
+  ICON_TRANSCODE_PIXELS,
+  ICON_TRANSCODE_DONE,
+  ICON_TRANSCODE_FAILED      // Not a bitmap, or one that is not supported
+};
+
+// Pixel formats of a source
+enum IconTranscodeFormat {
+  ICON_SOURCE_PALETTE = 0, // 1, 4 or 8 bpp
+  ICON_SOURCE_RGB555,
+  ICON_SOURCE_RGB565,
+  ICON_SOURCE_BGR          // 24 or 32 bpp
+};
+
+// Kept for one upload, about 12 kB
+struct IconTranscode {
+  uint8_t  state;  // IconTranscodeState
+  uint8_t  format; // IconTranscodeFormat
+  uint8_t  header[ICON_TRANSCODE_HEADER_SIZE];
+  uint32_t pos; // Bytes of the source taken
+  uint32_t dataOffset;
+  uint32_t compression;
+  uint32_t paletteStart;
+  uint16_t colours;
+  uint16_t palette[256];
+  uint16_t bpp;
+  bool     topDown;
+  uint16_t srcWidth;
+  uint16_t srcHeight;
+  uint32_t srcStride;
+  uint32_t rowBytes; // Bytes of a source row that hold pixels
+  // Where the pixels are
+  uint16_t srcRow; // Source rows taken
+  uint32_t rowByte;
+  uint16_t col;    // Source column of the next pixel
+  uint8_t  acc[4];
+  uint8_t  accLen;
+  int16_t  outRow;     // Row of the logo the source row is sampled into, -1 for none
+  int16_t  nextOutRow; // Next row of the logo to sample
+  uint16_t outCol;     // Next column of the logo to sample
+  uint16_t sampleCol;  // Source column sampled into outCol
+  // The logo
+  uint16_t width;
+  uint16_t height;
+  uint16_t background;
+  uint8_t  spans[ICON_NATIVE_SIZE][2];
+  uint8_t  pixels[ICON_NATIVE_STRIDE(ICON_NATIVE_SIZE) * ICON_NATIVE_SIZE];
+};
+
+uint16_t iconGet16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+uint32_t iconGet32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void iconPut16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+void iconPut32(uint8_t *p, uint32_t v) {
+  for (uint8_t i = 0; i < 4; i++) {
+    p[i] = (v >> (8 * i)) & 0xFF;
+  }
+}
+
+/**
+ * @brief Check whether the start of a file is a native logo
+ *
+ * @param header The first bytes of the file
+ * @param len Number of bytes in header, at least 30 are needed
+ */
+bool iconNativeCheck(const uint8_t *header, size_t len) {
+  return len >= 30 && header[0] == 'B' && header[1] == 'M' &&
+         iconGet32(header + 6) == ICON_NATIVE_SIGNATURE &&
+         iconGet16(header + 0x1C) == 16;
+}
+
+/**
+ * @brief Get the size a source is scaled down to
+ *
+ * @param srcWidth Width of the source
+ * @param srcHeight Height of the source
+ * @param width Set to the width of the logo
+ * @param height Set to the height of the logo
+ *
+ * @note Sources up to ICON_NATIVE_SIZE are kept as they are, larger ones keep
+ *       their aspect ratio. They are never scaled up.
+ */
+void iconTranscodeSize(uint16_t srcWidth, uint16_t srcHeight, uint16_t &width,
+                       uint16_t &height) {
+  width = srcWidth;
+  height = srcHeight;
+  uint16_t longest = srcWidth > srcHeight ? srcWidth : srcHeight;
+  if (longest <= ICON_NATIVE_SIZE) {
+    return;
+  }
+  width = ((uint32_t)srcWidth * ICON_NATIVE_SIZE + longest / 2) / longest;
+  height = ((uint32_t)srcHeight * ICON_NATIVE_SIZE + longest / 2) / longest;
+  width = width ? width : 1;
+  height = height ? height : 1;
+}
+
+/**
+ * @brief Get the source row or column a row or column of the logo is sampled
+ *        from, the one under its centre
+ */
+uint16_t iconTranscodeSample(uint16_t out, uint16_t outSize, uint16_t srcSize) {
+  return ((2 * (uint32_t)out + 1) * srcSize) / (2 * (uint32_t)outSize);
+}
+
+void iconTranscodeBegin(IconTranscode &t) {
+  t.state = ICON_TRANSCODE_HEADER;
+  t.pos = 0;
+  t.dataOffset = 0;
+  t.paletteStart = 0;
+  t.colours = 0;
+  t.width = 0;
+  t.height = 0;
+}
+
+/**
+ * @brief Read the file and info header, once the first 54 bytes are in
+ *
+ * @return false if the source is not a bitmap that can be converted
+ */
+bool iconTranscodeParse(IconTranscode &t) {
+  const uint8_t *h = t.header;
+  if (h[0] != 'B' || h[1] != 'M') {
+    return false;
+  }
+  t.dataOffset = iconGet32(h + 10);
+  uint32_t infoSize = iconGet32(h + 14);
+  int32_t  w = (int32_t)iconGet32(h + 18);
+  int32_t  ht = (int32_t)iconGet32(h + 22);
+  t.bpp = iconGet16(h + 28);
+  t.compression = iconGet32(h + 30);
+  uint32_t colours = iconGet32(h + 46);
+
+  t.topDown = ht < 0;
+  ht = ht < 0 ? -ht : ht;
+  if (infoSize < 40 || iconGet16(h + 26) != 1 || w <= 0 || ht <= 0 ||
+      w > ICON_TRANSCODE_MAX_SOURCE || ht > ICON_TRANSCODE_MAX_SOURCE ||
+      t.dataOffset < 54) {
+    return false;
+  }
+  t.srcWidth = w;
+  t.srcHeight = ht;
+
+  switch (t.bpp) {
+  case 1:
+  case 4:
+  case 8:
+    colours = colours ? colours : 1u << t.bpp;
+    if (t.compression != 0 || colours > (1u << t.bpp)) {
+      return false;
+    }
+    t.format = ICON_SOURCE_PALETTE;
+    t.colours = colours;
+    t.paletteStart = 14 + infoSize;
+    memset(t.palette, 0, sizeof(t.palette));
+    if (t.dataOffset < t.paletteStart + t.colours * 4) {
+      return false;
+    }
+    break;
+  case 16:
+    // BI_RGB is 555, the masks of BI_BITFIELDS are checked at byte 66
+    t.format = ICON_SOURCE_RGB555;
+    if (t.compression != 0 && t.compression != 3) {
+      return false;
+    }
+    break;
+  case 24:
+  case 32:
+    t.format = ICON_SOURCE_BGR;
+    if (t.compression != 0 && !(t.compression == 3 && t.bpp == 32)) {
+      return false;
+    }
+    break;
+  default:
+    return false;
+  }
+  if (t.compression == 3 && t.dataOffset < ICON_TRANSCODE_HEADER_SIZE) {
+    return false;
+  }
+
+  t.rowBytes = ((uint32_t)t.srcWidth * t.bpp + 7) / 8;
+  t.srcStride = (t.rowBytes + 3) & ~3u;
+  iconTranscodeSize(t.srcWidth, t.srcHeight, t.width, t.height);
+  return true;
+}
+
+/**
+ * @brief Check the colour masks of a BI_BITFIELDS source
+ *
+ * @return false for masks other than RGB565, RGB555 or 8 bits a colour
+ */
+bool iconTranscodeMasks(IconTranscode &t) {
+  uint32_t r = iconGet32(t.header + 54);
+  uint32_t g = iconGet32(t.header + 58);
+  uint32_t b = iconGet32(t.header + 62);
+  if (t.bpp == 16 && r == 0xF800 && g == 0x07E0 && b == 0x001F) {
+    t.format = ICON_SOURCE_RGB565;
+    return true;
+  }
+  if (t.bpp == 16) {
+    return r == 0x7C00 && g == 0x03E0 && b == 0x001F;
+  }
+  return r == 0xFF0000 && g == 0xFF00 && b == 0xFF;
+}
+
+void iconTranscodeRowBegin(IconTranscode &t) {
+  uint16_t top = t.topDown ? t.srcRow : t.srcHeight - 1 - t.srcRow;
+  t.outRow = -1;
+  if (t.nextOutRow >= 0 && t.nextOutRow < t.height &&
+      iconTranscodeSample(t.nextOutRow, t.height, t.srcHeight) == top) {
+    t.outRow = t.nextOutRow;
+    t.nextOutRow += t.topDown ? 1 : -1;
+  }
+  t.rowByte = 0;
+  t.col = 0;
+  t.accLen = 0;
+  t.outCol = 0;
+  t.sampleCol = iconTranscodeSample(0, t.width, t.srcWidth);
+}
+
+/**
+ * @brief Work out the background and the spans once every row is in
+ */
+void iconTranscodeFinish(IconTranscode &t) {
+  uint32_t stride = ICON_NATIVE_STRIDE(t.width);
+  for (uint16_t y = 0; y < t.height; y++) {
+    const uint8_t *row = t.pixels + y * stride;
+    uint16_t first = t.width;
+    uint16_t end = 0;
+    for (uint16_t x = 0; x < t.width; x++) {
+      if (row[2 * x] | row[2 * x + 1]) {
+        first = x < first ? x : first;
+        end = x + 1;
+      }
+    }
+    t.spans[y][0] = end ? first : 0;
+    t.spans[y][1] = end;
+  }
+  t.background = iconGet16(t.pixels + (t.height - 1) * stride);
+  t.state = ICON_TRANSCODE_DONE;
+}
+
+void iconTranscodePixel(IconTranscode &t, uint16_t colour) {
+  if (t.outRow >= 0 && t.outCol < t.width && t.col == t.sampleCol) {
+    iconPut16(t.pixels + t.outRow * ICON_NATIVE_STRIDE(t.width) + 2 * t.outCol,
+              colour);
+    t.outCol++;
+    t.sampleCol = iconTranscodeSample(t.outCol, t.width, t.srcWidth);
+  }
+  t.col++;
+}
+
+/**
+ * @brief Convert the pixel gathered in t.acc to RGB565
+ */
+uint16_t iconTranscodeColour(const IconTranscode &t) {
+  if (t.format == ICON_SOURCE_BGR) {
+    return ((t.acc[2] & 0xF8) << 8) | ((t.acc[1] & 0xFC) << 3) | (t.acc[0] >> 3);
+  }
+  uint16_t v = t.acc[0] | (t.acc[1] << 8);
+  if (t.format == ICON_SOURCE_RGB565) {
+    return v;
+  }
+  return ((v & 0x7C00) << 1) | ((v & 0x03E0) << 1) | (v & 0x001F);
+}
+
+void iconTranscodePixelByte(IconTranscode &t, uint8_t b) {
+  if (t.rowByte < t.rowBytes) {
+    if (t.format == ICON_SOURCE_PALETTE) {
+      uint8_t mask = (1 << t.bpp) - 1;
+      for (int8_t shift = 8 - t.bpp; shift >= 0 && t.col < t.srcWidth;
+           shift -= t.bpp) {
+        iconTranscodePixel(t, t.palette[(b >> shift) & mask]);
+      }
+    } else {
+      t.acc[t.accLen++] = b;
+      if (t.accLen == t.bpp / 8) {
+        iconTranscodePixel(t, iconTranscodeColour(t));
+        t.accLen = 0;
+      }
+    }
+  }
+  if (++t.rowByte == t.srcStride) {
+    if (++t.srcRow == t.srcHeight) {
+      iconTranscodeFinish(t);
+    } else {
+      iconTranscodeRowBegin(t);
+    }
+  }
+}
+
+void iconTranscodeHeaderByte(IconTranscode &t, uint8_t b) {
+  if (t.pos < ICON_TRANSCODE_HEADER_SIZE) {
+    t.header[t.pos] = b;
+  }
+  if (t.colours && t.pos >= t.paletteStart &&
+      t.pos < t.paletteStart + t.colours * 4u) {
+    // Palette entries are blue, green, red, reserved
+    uint32_t k = (t.pos - t.paletteStart) & 3;
+    if (k < 3) {
+      t.acc[k] = b;
+    }
+    if (k == 2) {
+      t.palette[(t.pos - t.paletteStart) / 4] =
+          ((t.acc[2] & 0xF8) << 8) | ((t.acc[1] & 0xFC) << 3) | (t.acc[0] >> 3);
+    }
+  }
+  t.pos++;
+
+  if (t.pos == 54 && !iconTranscodeParse(t)) {
+    t.state = ICON_TRANSCODE_FAILED;
+    return;
+  }
+  if (t.pos == ICON_TRANSCODE_HEADER_SIZE && t.compression == 3 &&
+      !iconTranscodeMasks(t)) {
+    t.state = ICON_TRANSCODE_FAILED;
+    return;
+  }
+  if (t.pos >= 54 && t.pos == t.dataOffset) {
+    t.state = ICON_TRANSCODE_PIXELS;
+    memset(t.pixels, 0, sizeof(t.pixels));
+    t.srcRow = 0;
+    t.nextOutRow = t.topDown ? 0 : t.height - 1;
+    iconTranscodeRowBegin(t);
+  }
+}
+
+/**
+ * @brief Convert the next part of a source
+ *
+ * @param t IconTranscode, begun with iconTranscodeBegin()
+ * @param data Part of the source
+ * @param len Length of data
+ *
+ * @return IconTranscodeState ICON_TRANSCODE_DONE once the last row is in,
+ *         bytes after it are ignored
+ */
+IconTranscodeState iconTranscodeFeed(IconTranscode &t, const uint8_t *data,
+                                     size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (t.state == ICON_TRANSCODE_HEADER) {
+      iconTranscodeHeaderByte(t, data[i]);
+    } else if (t.state == ICON_TRANSCODE_PIXELS) {
+      iconTranscodePixelByte(t, data[i]);
+    } else {
+      break;
+    }
+  }
+  return (IconTranscodeState)t.state;
+}
+
+/**
+ * @brief Get the size of the native logo of a finished IconTranscode
+ */
+uint32_t iconNativeFileSize(const IconTranscode &t) {
+  return ICON_NATIVE_HEADER_SIZE(t.height) + ICON_NATIVE_STRIDE(t.width) * t.height;
+}
+
+/**
+ * @brief Write the header of the native logo of a finished IconTranscode, the
+ *        rows follow it as they are in t.pixels
+ *
+ * @param t IconTranscode in ICON_TRANSCODE_DONE
+ * @param buf Buffer, ICON_NATIVE_HEADER_MAX holds any header
+ *
+ * @return size_t length of the header
+ */
+size_t iconNativeHeader(const IconTranscode &t, uint8_t *buf) {
+  uint32_t headerSize = ICON_NATIVE_HEADER_SIZE(t.height);
+  uint32_t imageSize = ICON_NATIVE_STRIDE(t.width) * t.height;
+  memset(buf, 0, headerSize);
+  buf[0] = 'B';
+  buf[1] = 'M';
+  iconPut32(buf + 2, headerSize + imageSize);
+  iconPut32(buf + 6, ICON_NATIVE_SIGNATURE);
+  iconPut32(buf + 10, headerSize);
+  iconPut32(buf + 14, 40);
+  iconPut32(buf + 18, t.width);
+  iconPut32(buf + 22, (uint32_t)-(int32_t)t.height);
+  iconPut16(buf + 26, 1);
+  iconPut16(buf + 28, 16);
+  iconPut32(buf + 30, 3); // BI_BITFIELDS
+  iconPut32(buf + 34, imageSize);
+  iconPut32(buf + 38, 2835); // 72 dpi
+  iconPut32(buf + 42, 2835);
+  iconPut32(buf + 54, 0xF800);
+  iconPut32(buf + 58, 0x07E0);
+  iconPut32(buf + 62, 0x001F);
+  iconPut16(buf + ICON_NATIVE_BLOCK, t.background);
+  memcpy(buf + ICON_NATIVE_BLOCK + 2, t.spans, 2 * t.height);
+  return headerSize;
+}
+
+/**
+ * @brief Check whether an uploaded file is converted to a native logo
+ *
+ * @param filename Name of the upload
+ *
+ * @return true for names ending in .bmp, in any case
+ */
+bool iconTranscodeWanted(const char *filename) {
+  size_t len = strlen(filename);
+  if (len < 4) {
+    return false;
+  }
+  const char *ext = filename + len - 4;
+  return ext[0] == '.' && (ext[1] | 0x20) == 'b' && (ext[2] | 0x20) == 'm' &&
+         (ext[3] | 0x20) == 'p';
+}
+
+#endif // ICON_TRANSCODE_H
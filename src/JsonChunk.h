@@ -0,0 +1,173 @@
+#ifndef JSON_CHUNK_H
+#define JSON_CHUNK_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Writes a JSON array of small objects into the buffers of a chunked HTTP
+// response one entry at a time, so a reply of any length is made in the
+// memory of one entry:
+//
+//   [{"0":"a.bmp"},{"1":"b.bmp"}]
+//
+// The entries come from a callback, e.g. one file of a directory per call.
+// An entry that does not fit the rest of a buffer is continued in the next.
+#define JSON_CHUNK_ENTRY_SIZE 192
+
+// Writes the next entry to entry, returns false when there are no more. An
+// entry left empty is skipped.
+typedef bool (*JsonChunkNext)(void *context, char *entry, size_t size);
+
+enum JsonChunkState {
+  JSON_CHUNK_OPEN = 0,
+  JSON_CHUNK_ENTRIES,
+  JSON_CHUNK_CLOSE,
+  JSON_CHUNK_DONE
+};
+
+struct JsonChunker {
+  JsonChunkNext next;
+  void         *context;
+  char          entry[JSON_CHUNK_ENTRY_SIZE]; // The piece being sent
+  uint16_t      len;                          // Length of the piece
+  uint16_t      pos;                          // Bytes of it already sent
+  uint16_t      count;                        // Entries so far
+  uint8_t       state;
+};
+
+void jsonChunkBegin(JsonChunker &chunker, JsonChunkNext next, void *context) {
+  chunker.next = next;
+  chunker.context = context;
+  chunker.len = 0;
+  chunker.pos = 0;
+  chunker.count = 0;
+  chunker.state = JSON_CHUNK_OPEN;
+}
+
+/**
+ * @brief Fill the buffer of a chunked response
+ *
+ * @param chunker JsonChunker
+ * @param buf Buffer of the response
+ * @param maxLen Size of buf
+ *
+ * @return size_t bytes written, 0 when the array is complete
+ */
+size_t jsonChunkFill(JsonChunker &chunker, uint8_t *buf, size_t maxLen) {
+  size_t used = 0;
+  while (used < maxLen) {
+    if (chunker.pos < chunker.len) {
+      size_t n = chunker.len - chunker.pos;
+      if (n > maxLen - used) {
+        n = maxLen - used;
+      }
+      memcpy(buf + used, chunker.entry + chunker.pos, n);
+      used += n;
+      chunker.pos += n;
+      continue;
+    }
+
+    chunker.pos = 0;
+    chunker.len = 0;
+    switch (chunker.state) {
+    case JSON_CHUNK_OPEN:
+      chunker.entry[chunker.len++] = '[';
+      chunker.state = JSON_CHUNK_ENTRIES;
+      break;
+    case JSON_CHUNK_ENTRIES:
+    {
+      // The separator goes in front of every entry but the first
+      size_t start = chunker.count ? 1 : 0;
+      chunker.entry[0] = ',';
+      chunker.entry[start] = '\0';
+      if (!chunker.next(chunker.context, chunker.entry + start,
+                        sizeof(chunker.entry) - start)) {
+        chunker.state = JSON_CHUNK_CLOSE;
+        break;
+      }
+      if (chunker.entry[start] != '\0') {
+        chunker.len = start + strlen(chunker.entry + start);
+        chunker.count++;
+      }
+      break;
+    }
+    case JSON_CHUNK_CLOSE:
+      chunker.entry[chunker.len++] = ']';
+      chunker.state = JSON_CHUNK_DONE;
+      break;
+    default:
+      return used;
+    }
+  }
+  return used;
+}
+
+/**
+ * @brief Append text, escaped for a JSON string when escape is set
+ *
+ * @param dest Buffer, always terminated
+ * @param room Bytes of dest that may be used, including the NUL
+ * @param len Length of what dest holds, updated
+ * @param text Text to append
+ * @param escape Escape quotes, backslashes and control characters
+ *
+ * @return false when text was cut, no escape sequence is ever cut in half
+ */
+bool jsonChunkAppend(char *dest, size_t room, size_t &len, const char *text,
+                     bool escape) {
+  static const char hex[] = "0123456789abcdef";
+  for (const char *p = text; *p; p++) {
+    char seq[7];
+    size_t n = 0;
+    unsigned char c = *p;
+    if (escape && (c == '"' || c == '\\')) {
+      seq[n++] = '\\';
+      seq[n++] = c;
+    } else if (escape && c < 0x20) {
+      memcpy(seq, "\\u00", 4);
+      n = 4;
+      seq[n++] = hex[c >> 4];
+      seq[n++] = hex[c & 0x0F];
+    } else {
+      seq[n++] = c;
+    }
+    if (len + n >= room) {
+      return false;
+    }
+    memcpy(dest + len, seq, n);
+    len += n;
+    dest[len] = '\0';
+  }
+  return true;
+}
+
+/**
+ * @brief Write an entry {"key":"value"}
+ *
+ * @param entry Buffer
+ * @param size Size of entry
+ * @param key Key, escaped
+ * @param value Value, escaped
+ *
+ * @return false when the value was cut to fit, the entry is valid JSON then
+ *         as well. Without room for the key the entry is "".
+ */
+bool jsonChunkPair(char *entry, size_t size, const char *key,
+                   const char *value) {
+  // Room for the closing "} is kept back
+  size_t room = size - 2;
+  size_t len = 0;
+  entry[0] = '\0';
+  if (!jsonChunkAppend(entry, room, len, "{\"", false) ||
+      !jsonChunkAppend(entry, room, len, key, true) ||
+      !jsonChunkAppend(entry, room, len, "\":\"", false)) {
+    // Not even the key fitted
+    entry[0] = '\0';
+    return false;
+  }
+  bool fits = jsonChunkAppend(entry, room, len, value, true);
+  memcpy(entry + len, "\"}", 3);
+  return fits;
+}
+
+#endif // JSON_CHUNK_H
@@ -0,0 +1,504 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Streaming JSON tokenizer. The document is read in small chunks and every
+// scalar value is handed to a callback together with its path (the keys and
+// array indices leading to it), so the callback can write it straight into
+// the target struct. Nothing is allocated: all state lives in JsonStream,
+// which has a fixed size (sizeof(JsonStream) bytes, on the stack).
+//
+// Strings longer than JSON_STREAM_VALUE_SIZE - 1 bytes and keys longer than
+// JSON_STREAM_KEY_SIZE - 1 bytes are truncated and flagged, never overrun.
+#define JSON_STREAM_MAX_DEPTH 4
+#define JSON_STREAM_KEY_SIZE 16
+#define JSON_STREAM_VALUE_SIZE 72
+#define JSON_STREAM_READ_SIZE 64
+
+enum JsonStreamType {
+  JSON_STREAM_STRING = 0,
+  JSON_STREAM_NUMBER,
+  JSON_STREAM_BOOL,
+  JSON_STREAM_NULL
+};
+
+// Where a value sits in the document. For an object member key[] holds its
+// name and index[] is -1, for an array element key[] is empty and index[]
+// holds its position.
+struct JsonStreamPath {
+  uint8_t depth;
+  char    key[JSON_STREAM_MAX_DEPTH][JSON_STREAM_KEY_SIZE];
+  int16_t index[JSON_STREAM_MAX_DEPTH];
+};
+
+// Reads up to len bytes into buf, returns the number read (0 at the end)
+typedef size_t (*JsonStreamReader)(void *context, uint8_t *buf, size_t len);
+
+// Called for every scalar value. 'truncated' is set when the value did not
+// fit JSON_STREAM_VALUE_SIZE.
+typedef void (*JsonStreamHandler)(void *context, const JsonStreamPath &path,
+                                  JsonStreamType type, const char *value,
+                                  bool truncated);
+
+struct JsonStream {
+  JsonStreamReader  reader;
+  void             *readerContext;
+  JsonStreamHandler handler;
+  void             *handlerContext;
+  uint8_t           buf[JSON_STREAM_READ_SIZE];
+  uint8_t           len;
+  uint8_t           pos;
+  uint32_t          offset; // Bytes consumed, for error messages
+  JsonStreamPath    path;
+  char              value[JSON_STREAM_VALUE_SIZE];
+  const char       *error;  // NULL when the document parsed
+};
+
+/**
+ * @brief Look at the next byte without consuming it
+ *
+ * @return int the byte, -1 at the end of the input
+ */
+int jsonStreamPeek(JsonStream &js) {
+  if (js.pos == js.len) {
+    js.len = js.reader(js.readerContext, js.buf, sizeof(js.buf));
+    js.pos = 0;
+    if (js.len == 0) {
+      return -1;
+    }
+  }
+  return js.buf[js.pos];
+}
+
+/**
+ * @brief Consume the next byte
+ *
+ * @return int the byte, -1 at the end of the input
+ */
+int jsonStreamNext(JsonStream &js) {
+  int c = jsonStreamPeek(js);
+  if (c >= 0) {
+    js.pos++;
+    js.offset++;
+  }
+  return c;
+}
+
+/**
+ * @brief Consume whitespace and return the next byte without consuming it
+ */
+int jsonStreamSkipSpace(JsonStream &js) {
+  int c = jsonStreamPeek(js);
+  while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+    jsonStreamNext(js);
+    c = jsonStreamPeek(js);
+  }
+  return c;
+}
+
+bool jsonStreamFail(JsonStream &js, const char *error) {
+  if (!js.error) {
+    js.error = error;
+  }
+  return false;
+}
+
+/**
+ * @brief Append a byte to a bounded buffer
+ *
+ * @return false if it did not fit
+ */
+bool jsonStreamAppend(char *dest, size_t size, size_t &len, char c) {
+  if (len + 1 >= size) {
+    return false;
+  }
+  dest[len++] = c;
+  dest[len] = '\0';
+  return true;
+}
+
+/**
+ * @brief Read a string, the opening quote has been consumed
+ *
+ * @param dest Buffer for the string, always terminated
+ * @param size Size of dest
+ * @param truncated Set when the string did not fit
+ */
+bool jsonStreamString(JsonStream &js, char *dest, size_t size,
+                      bool &truncated) {
+  size_t len = 0;
+  dest[0] = '\0';
+  truncated = false;
+
+  while (true) {
+    int c = jsonStreamNext(js);
+    if (c < 0) {
+      return jsonStreamFail(js, "unterminated string");
+    }
+    if (c == '"') {
+      return true;
+    }
+    if (c < 0x20) {
+      return jsonStreamFail(js, "control character in string");
+    }
+
+    if (c == '\\') {
+      c = jsonStreamNext(js);
+      switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        break;
+      case 'b':
+        c = '\b';
+        break;
+      case 'f':
+        c = '\f';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'u': {
+        uint16_t code = 0;
+        for (int i = 0; i < 4; i++) {
+          int h = jsonStreamNext(js);
+          code <<= 4;
+          if (h >= '0' && h <= '9') {
+            code |= h - '0';
+          } else if (h >= 'a' && h <= 'f') {
+            code |= h - 'a' + 10;
+          } else if (h >= 'A' && h <= 'F') {
+            code |= h - 'A' + 10;
+          } else {
+            return jsonStreamFail(js, "invalid unicode escape");
+          }
+        }
+        // Encode as UTF-8, surrogate pairs are kept as two code points
+        char utf8[3];
+        int n;
+        if (code < 0x80) {
+          utf8[0] = code;
+          n = 1;
+        } else if (code < 0x800) {
+          utf8[0] = 0xC0 | (code >> 6);
+          utf8[1] = 0x80 | (code & 0x3F);
+          n = 2;
+        } else {
+          utf8[0] = 0xE0 | (code >> 12);
+          utf8[1] = 0x80 | ((code >> 6) & 0x3F);
+          utf8[2] = 0x80 | (code & 0x3F);
+          n = 3;
+        }
+        // A multi-byte character is never split by truncation
+        if (!truncated && len + n < size) {
+          for (int i = 0; i < n; i++) {
+            jsonStreamAppend(dest, size, len, utf8[i]);
+          }
+        } else {
+          truncated = true;
+        }
+        continue;
+      }
+      default:
+        return jsonStreamFail(js, "invalid escape");
+      }
+    }
+
+    if (!truncated && !jsonStreamAppend(dest, size, len, c)) {
+      truncated = true;
+    }
+  }
+}
+
+/**
+ * @brief Read a number, true, false or null into js.value
+ */
+bool jsonStreamLiteral(JsonStream &js, JsonStreamType &type, bool &truncated) {
+  size_t len = 0;
+  js.value[0] = '\0';
+  truncated = false;
+
+  int c = jsonStreamPeek(js);
+  while ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' ||
+         c == '+' || c == '.' || c == 'E') {
+    if (!jsonStreamAppend(js.value, sizeof(js.value), len, c)) {
+      truncated = true;
+    }
+    jsonStreamNext(js);
+    c = jsonStreamPeek(js);
+  }
+
+  if (strcmp(js.value, "true") == 0 || strcmp(js.value, "false") == 0) {
+    type = JSON_STREAM_BOOL;
+  } else if (strcmp(js.value, "null") == 0) {
+    type = JSON_STREAM_NULL;
+  } else if (len > 0 && (js.value[0] == '-' ||
+                         (js.value[0] >= '0' && js.value[0] <= '9'))) {
+    type = JSON_STREAM_NUMBER;
+  } else {
+    return jsonStreamFail(js, "unexpected character");
+  }
+  return true;
+}
+
+bool jsonStreamValue(JsonStream &js);
+
+/**
+ * @brief Enter a nested object or array
+ */
+bool jsonStreamPush(JsonStream &js) {
+  if (js.path.depth >= JSON_STREAM_MAX_DEPTH) {
+    return jsonStreamFail(js, "nested too deep");
+  }
+  js.path.key[js.path.depth][0] = '\0';
+  js.path.index[js.path.depth] = -1;
+  js.path.depth++;
+  return true;
+}
+
+/**
+ * @brief Read an object, the opening brace has been consumed
+ */
+bool jsonStreamObject(JsonStream &js) {
+  if (!jsonStreamPush(js)) {
+    return false;
+  }
+  uint8_t level = js.path.depth - 1;
+
+  if (jsonStreamSkipSpace(js) == '}') {
+    jsonStreamNext(js);
+    js.path.depth--;
+    return true;
+  }
+
+  while (true) {
+    if (jsonStreamSkipSpace(js) != '"') {
+      return jsonStreamFail(js, "expected key");
+    }
+    jsonStreamNext(js);
+    bool keyTruncated;
+    if (!jsonStreamString(js, js.path.key[level], JSON_STREAM_KEY_SIZE,
+                          keyTruncated)) {
+      return false;
+    }
+    if (jsonStreamSkipSpace(js) != ':') {
+      return jsonStreamFail(js, "expected ':'");
+    }
+    jsonStreamNext(js);
+    if (!jsonStreamValue(js)) {
+      return false;
+    }
+
+    int c = jsonStreamSkipSpace(js);
+    jsonStreamNext(js);
+    if (c == '}') {
+      js.path.depth--;
+      return true;
+    }
+    if (c != ',') {
+      return jsonStreamFail(js, "expected ',' or '}'");
+    }
+  }
+}
+
+/**
+ * @brief Read an array, the opening bracket has been consumed
+ */
+bool jsonStreamArray(JsonStream &js) {
+  if (!jsonStreamPush(js)) {
+    return false;
+  }
+  uint8_t level = js.path.depth - 1;
+
+  if (jsonStreamSkipSpace(js) == ']') {
+    jsonStreamNext(js);
+    js.path.depth--;
+    return true;
+  }
+
+  for (int16_t i = 0;; i++) {
+    js.path.index[level] = i;
+    if (!jsonStreamValue(js)) {
+      return false;
+    }
+
+    int c = jsonStreamSkipSpace(js);
+    jsonStreamNext(js);
+    if (c == ']') {
+      js.path.depth--;
+      return true;
+    }
+    if (c != ',') {
+      return jsonStreamFail(js, "expected ',' or ']'");
+    }
+  }
+}
+
+/**
+ * @brief Read any value and hand scalars to the handler
+ */
+bool jsonStreamValue(JsonStream &js) {
+  int c = jsonStreamSkipSpace(js);
+  if (c == '{') {
+    jsonStreamNext(js);
+    return jsonStreamObject(js);
+  }
+  if (c == '[') {
+    jsonStreamNext(js);
+    return jsonStreamArray(js);
+  }
+
+  JsonStreamType type = JSON_STREAM_STRING;
+  bool truncated;
+  if (c == '"') {
+    jsonStreamNext(js);
+    if (!jsonStreamString(js, js.value, sizeof(js.value), truncated)) {
+      return false;
+    }
+  } else if (c < 0) {
+    return jsonStreamFail(js, "unexpected end of input");
+  } else if (!jsonStreamLiteral(js, type, truncated)) {
+    return false;
+  }
+
+  js.handler(js.handlerContext, js.path, type, js.value, truncated);
+  return true;
+}
+
+/**
+ * @brief Parse a complete document
+ *
+ * @param js JsonStream, does not need to be initialised
+ * @param reader Function reading the input
+ * @param readerContext Passed to reader
+ * @param handler Function receiving every scalar value
+ * @param handlerContext Passed to handler
+ *
+ * @return true if the document is valid JSON. On false js.error tells why
+ *         and js.offset where. Values before the error were handled already.
+ */
+bool jsonStreamParse(JsonStream &js, JsonStreamReader reader,
+                     void *readerContext, JsonStreamHandler handler,
+                     void *handlerContext) {
+  js.reader = reader;
+  js.readerContext = readerContext;
+  js.handler = handler;
+  js.handlerContext = handlerContext;
+  js.len = 0;
+  js.pos = 0;
+  js.offset = 0;
+  js.path.depth = 0;
+  js.error = NULL;
+
+  if (!jsonStreamValue(js)) {
+    return false;
+  }
+  if (jsonStreamSkipSpace(js) >= 0) {
+    return jsonStreamFail(js, "trailing characters");
+  }
+  return true;
+}
+
+/**
+ * @brief Copy a prefix and a value into a fixed buffer
+ *
+ * @param dest Buffer, always terminated
+ * @param size Size of dest
+ * @param prefix Copied first, may be NULL
+ * @param value Copied after the prefix
+ *
+ * @return false if the result was truncated
+ */
+bool jsonStreamCopy(char *dest, size_t size, const char *prefix,
+                    const char *value) {
+  size_t len = 0;
+  dest[0] = '\0';
+  bool fits = true;
+  for (const char *p = prefix; fits && p && *p; p++) {
+    fits = jsonStreamAppend(dest, size, len, *p);
+  }
+  for (const char *p = value; fits && *p; p++) {
+    fits = jsonStreamAppend(dest, size, len, *p);
+  }
+  return fits;
+}
+
+// Fields of a menu file (menu1.json - menu5.json)
+enum MenuField {
+  MENU_FIELD_NONE = 0,  // Not a menu field, ignored
+  MENU_FIELD_LOGO,      // "logoN"
+  MENU_FIELD_LATCH,     // "buttonN": { "latch" }
+  MENU_FIELD_LATCHLOGO, // "buttonN": { "latchlogo" }
+  MENU_FIELD_ACTION,    // "buttonN": { "actionarray": [i] }
+  MENU_FIELD_VALUE,     // "buttonN": { "valuearray": [i] }
+  MENU_FIELD_TOO_MANY   // An action or value past MENU_FIELD_ACTIONS, an error
+};
+
+#define MENU_FIELD_BUTTONS 5
+#define MENU_FIELD_ACTIONS 8 // Actions per button, see ActionCode.h
+
+/**
+ * @brief Get the number at the end of a key like "logo3"
+ *
+ * @return int the number, -1 if the key is not prefix followed by one digit
+ */
+int jsonStreamKeyIndex(const char *key, const char *prefix) {
+  size_t len = strlen(prefix);
+  if (strncmp(key, prefix, len) != 0 || key[len] < '0' || key[len] > '9' ||
+      key[len + 1] != '\0') {
+    return -1;
+  }
+  return key[len] - '0';
+}
+
+/**
+ * @brief Find out which field of a menu file a value belongs to
+ *
+ * @param path JsonStreamPath of the value
+ * @param button Set to the logo or button number
+ * @param slot Set to the array index for actions and values
+ *
+ * @return MenuField, MENU_FIELD_NONE for anything the menu does not use
+ */
+MenuField menuFieldAt(const JsonStreamPath &path, int &button, int &slot) {
+  slot = -1;
+  if (path.depth == 1) {
+    button = jsonStreamKeyIndex(path.key[0], "logo");
+    return button >= 0 && button < MENU_FIELD_BUTTONS ? MENU_FIELD_LOGO
+                                                      : MENU_FIELD_NONE;
+  }
+
+  button = jsonStreamKeyIndex(path.key[0], "button");
+  if (button < 0 || button >= MENU_FIELD_BUTTONS) {
+    return MENU_FIELD_NONE;
+  }
+  if (path.depth == 2) {
+    if (strcmp(path.key[1], "latch") == 0) {
+      return MENU_FIELD_LATCH;
+    }
+    if (strcmp(path.key[1], "latchlogo") == 0) {
+      return MENU_FIELD_LATCHLOGO;
+    }
+    return MENU_FIELD_NONE;
+  }
+  if (path.depth == 3 && path.index[2] >= 0 &&
+      (strcmp(path.key[1], "actionarray") == 0 ||
+       strcmp(path.key[1], "valuearray") == 0)) {
+    slot = path.index[2];
+    if (slot >= MENU_FIELD_ACTIONS) {
+      return MENU_FIELD_TOO_MANY;
+    }
+    return path.key[1][0] == 'a' ? MENU_FIELD_ACTION : MENU_FIELD_VALUE;
+  }
+  return MENU_FIELD_NONE;
+}
+
+#endif // JSON_STREAM_H
@@ -0,0 +1,231 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+
+// Stages on the path from a finger landing to the HID report being sent.
+// Every stage is measured relative to the touch detection timestamp.
+enum LatencyStage {
+  LAT_TOUCH = 0,      // Touch detected on a key
+  LAT_JUST_PRESSED,   // key[].justPressed() seen in loop()
+  LAT_BUTTON_HANDLER, // Entry to handleButtonPress()
+  LAT_ACTION,         // Each bleKeyboardAction() call
+  LAT_HID_REPORT,     // Each action once its reports are handed to bleCombo,
+                      // and the release of all keys. Not once per report:
+                      // text sends two reports per character.
+  LAT_STAGE_COUNT
+};
+
+// What the web server was doing when a touch came in. The HID report latency
+// is kept per load as well, to see what the server costs the keys.
+enum LatencyLoad {
+  LATENCY_WEB_OFF = 0, // WiFi and the web server are off
+  LATENCY_WEB_IDLE,    // Running, no request for LATENCY_WEB_BUSY_MS
+  LATENCY_WEB_BUSY,    // Served a request within LATENCY_WEB_BUSY_MS
+  LATENCY_LOAD_COUNT
+};
+
+#define LATENCY_WEB_BUSY_MS 1000
+
+// Histogram buckets are powers of two in microseconds: bucket 0 holds 0-1 us,
+// bucket i holds [2^i, 2^(i+1)) us. The last bucket also holds everything
+// above, 2^21 us is about 2 seconds.
+#define LATENCY_BUCKETS 22
+
+// A touch older than this is not matched with later stages anymore
+#define LATENCY_MAX_TRACK_US 5000000UL
+
+// Budgets for the p95 latency of a stage, in microseconds
+#define LATENCY_BUDGET_BUTTON_HANDLER_US 30000UL
+#define LATENCY_BUDGET_HID_REPORT_US 50000UL
+// Budget for the p95 latency from an HTTP control request to its HID report
+#define LATENCY_BUDGET_CONTROL_US 50000UL
+
+struct LatencyHistogram {
+  uint32_t buckets[LATENCY_BUCKETS];
+  uint32_t count;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t sumUs;
+};
+
+struct LatencyTracker {
+  uint32_t         touchUs;  // Timestamp of the touch being tracked
+  bool             tracking; // True while marks belong to a touch
+  uint8_t          load;     // LatencyLoad of the touch being tracked
+  LatencyHistogram stages[LAT_STAGE_COUNT];
+  LatencyHistogram reports[LATENCY_LOAD_COUNT]; // LAT_HID_REPORT per load
+};
+
+/**
+ * @brief Clear a histogram
+ *
+ * @param h LatencyHistogram to clear
+ */
+void latencyHistogramReset(LatencyHistogram &h) {
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    h.buckets[i] = 0;
+  }
+  h.count = 0;
+  h.minUs = UINT32_MAX;
+  h.maxUs = 0;
+  h.sumUs = 0;
+}
+
+/**
+ * @brief Get the histogram bucket a latency falls in
+ *
+ * @param us Latency in microseconds
+ *
+ * @return int bucket index (0 - LATENCY_BUCKETS-1)
+ */
+int latencyBucket(uint32_t us) {
+  int bucket = 0;
+  while (us > 1 && bucket < LATENCY_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+/**
+ * @brief Add a single latency sample to a histogram
+ *
+ * @param h LatencyHistogram to add to
+ * @param us Latency in microseconds
+ */
+void latencyHistogramRecord(LatencyHistogram &h, uint32_t us) {
+  h.buckets[latencyBucket(us)]++;
+  h.count++;
+  h.sumUs += us;
+  if (us < h.minUs) {
+    h.minUs = us;
+  }
+  if (us > h.maxUs) {
+    h.maxUs = us;
+  }
+}
+
+/**
+ * @brief Estimate a percentile from a histogram
+ *
+ * @param h LatencyHistogram to read
+ * @param percentile Percentile to get (0-100)
+ *
+ * @return uint32_t upper bound of the bucket holding the percentile in
+ *         microseconds, never above the largest recorded sample. 0 if empty.
+ */
+uint32_t latencyHistogramPercentile(const LatencyHistogram &h,
+                                    uint8_t percentile) {
+  if (h.count == 0) {
+    return 0;
+  }
+
+  // Rank of the sample we are looking for, rounded up
+  uint64_t rank = ((uint64_t)h.count * percentile + 99) / 100;
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += h.buckets[i];
+    if (seen >= rank) {
+      uint32_t upper = (i == 0) ? 1 : ((2UL << i) - 1);
+      return upper < h.maxUs ? upper : h.maxUs;
+    }
+  }
+  return h.maxUs;
+}
+
+/**
+ * @brief Clear all histograms of a tracker and stop tracking
+ *
+ * @param t LatencyTracker to clear
+ */
+void latencyReset(LatencyTracker &t) {
+  t.touchUs = 0;
+  t.tracking = false;
+  t.load = LATENCY_WEB_OFF;
+  for (int i = 0; i < LAT_STAGE_COUNT; i++) {
+    latencyHistogramReset(t.stages[i]);
+  }
+  for (int i = 0; i < LATENCY_LOAD_COUNT; i++) {
+    latencyHistogramReset(t.reports[i]);
+  }
+}
+
+/**
+ * @brief Start tracking a new touch. Later marks are measured from here.
+ *
+ * @param t LatencyTracker
+ * @param nowUs Current time in microseconds
+ * @param load LatencyLoad the touch came in under
+ */
+void latencyBegin(LatencyTracker &t, uint32_t nowUs,
+                  uint8_t load = LATENCY_WEB_OFF) {
+  t.touchUs = nowUs;
+  t.tracking = true;
+  t.load = load < LATENCY_LOAD_COUNT ? load : (uint8_t)LATENCY_WEB_OFF;
+  latencyHistogramRecord(t.stages[LAT_TOUCH], 0);
+}
+
+/**
+ * @brief Record that a stage was reached for the touch being tracked
+ *
+ * @param t LatencyTracker
+ * @param stage LatencyStage that was reached
+ * @param nowUs Current time in microseconds
+ *
+ * @note Marks without a tracked touch (e.g. serial commands) are ignored.
+ */
+void latencyMark(LatencyTracker &t, LatencyStage stage, uint32_t nowUs) {
+  if (!t.tracking || stage <= LAT_TOUCH || stage >= LAT_STAGE_COUNT) {
+    return;
+  }
+
+  // Unsigned subtraction handles micros() wrapping around
+  uint32_t elapsed = nowUs - t.touchUs;
+  if (elapsed > LATENCY_MAX_TRACK_US) {
+    t.tracking = false;
+    return;
+  }
+  latencyHistogramRecord(t.stages[stage], elapsed);
+  if (stage == LAT_HID_REPORT) {
+    latencyHistogramRecord(t.reports[t.load], elapsed);
+  }
+}
+
+/**
+ * @brief Get a printable name for a stage
+ *
+ * @param stage LatencyStage
+ *
+ * @return const char* name of the stage
+ */
+const char *latencyStageName(int stage) {
+  static const char *names[LAT_STAGE_COUNT] = {"touch", "justpressed",
+                                               "handler", "action", "report"};
+  if (stage < 0 || stage >= LAT_STAGE_COUNT) {
+    return "unknown";
+  }
+  return names[stage];
+}
+
+/**
+ * @brief Get a printable name for a load
+ *
+ * @param load LatencyLoad
+ *
+ * @return const char* name of the load
+ */
+const char *latencyLoadName(int load) {
+  static const char *names[LATENCY_LOAD_COUNT] = {"web-off", "web-idle",
+                                                  "web-busy"};
+  if (load < 0 || load >= LATENCY_LOAD_COUNT) {
+    return "unknown";
+  }
+  return names[load];
+}
+
+#endif // LATENCY_STATS_H
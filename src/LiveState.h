@@ -0,0 +1,159 @@
+#ifndef LIVE_STATE_H
+#define LIVE_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "RemoteControl.h"
+
+// The state of the deck pushed to WebSocket clients in binary frames:
+//
+//   frame:  kind(1) seq(2) field...
+//   field:  id(1) value(1 or 2)
+//
+// A snapshot frame holds every field, a delta frame only the ones that
+// changed. Numbers are little endian. The state is small, so a client that
+// could not take a frame is not sent what it missed but a new snapshot.
+#define LIVE_FRAME_SIZE 16
+#define LIVE_MAX_CLIENTS 4
+#define LIVE_PUSH_INTERVAL_MS 50 // Changes within this time go in one frame
+
+enum LiveFrameKind {
+  LIVE_SNAPSHOT = 0x01,
+  LIVE_DELTA = 0x02,
+  LIVE_ERROR = 0x03 // Reply to a command: kind(1) status(2)
+};
+
+enum LiveField {
+  LIVE_PAGE = 0x01,       // int16, page number as pageNum
+  LIVE_LATCHES = 0x02,    // uint8, bit n: key n of the page is latched
+  LIVE_BRIGHTNESS = 0x03, // uint8, backlight 0-255
+  LIVE_LINK = 0x04        // uint8, LIVE_LINK_* bits
+};
+
+#define LIVE_LINK_BLE 0x01  // A host is connected over BLE
+#define LIVE_LINK_WIFI 0x02 // Connected to a WiFi network or running as AP
+
+// Commands sent by a client, in binary frames
+enum LiveCommand {
+  LIVE_CMD_BUTTON = 0x10,  // button(1) action(1) page(2), page -1: current
+  LIVE_CMD_PAGE = 0x11,    // page(2)
+  LIVE_CMD_SNAPSHOT = 0x12 // Send a snapshot
+};
+
+struct LiveState {
+  int16_t page;
+  uint8_t latches;
+  uint8_t brightness;
+  uint8_t link;
+};
+
+/**
+ * @brief Encode a state as a snapshot or as the fields that changed
+ *
+ * @param buf Frame buffer, LIVE_FRAME_SIZE holds a snapshot
+ * @param size Size of buf
+ * @param seq Sequence number of the frame
+ * @param sent State the clients have, NULL for a snapshot
+ * @param state Current state
+ *
+ * @return size_t length of the frame, 0 when nothing changed or buf is too
+ *         small
+ */
+size_t liveEncode(uint8_t *buf, size_t size, uint16_t seq,
+                  const LiveState *sent, const LiveState &state) {
+  if (size < LIVE_FRAME_SIZE) {
+    return 0;
+  }
+  size_t len = 0;
+  buf[len++] = sent ? LIVE_DELTA : LIVE_SNAPSHOT;
+  buf[len++] = seq & 0xFF;
+  buf[len++] = seq >> 8;
+  if (!sent || sent->page != state.page) {
+    buf[len++] = LIVE_PAGE;
+    buf[len++] = (uint16_t)state.page & 0xFF;
+    buf[len++] = (uint16_t)state.page >> 8;
+  }
+  if (!sent || sent->latches != state.latches) {
+    buf[len++] = LIVE_LATCHES;
+    buf[len++] = state.latches;
+  }
+  if (!sent || sent->brightness != state.brightness) {
+    buf[len++] = LIVE_BRIGHTNESS;
+    buf[len++] = state.brightness;
+  }
+  if (!sent || sent->link != state.link) {
+    buf[len++] = LIVE_LINK;
+    buf[len++] = state.link;
+  }
+  return len > 3 ? len : 0;
+}
+
+/**
+ * @brief Encode the error reply to a command
+ *
+ * @param buf Frame buffer, at least 3 bytes
+ * @param status HTTP status of the command, as /api/button would answer
+ *
+ * @return size_t length of the frame
+ */
+size_t liveEncodeError(uint8_t *buf, uint16_t status) {
+  buf[0] = LIVE_ERROR;
+  buf[1] = status & 0xFF;
+  buf[2] = status >> 8;
+  return 3;
+}
+
+/**
+ * @brief Decode a command sent by a client
+ *
+ * @param data Frame payload
+ * @param len Length of data
+ * @param menuCount Number of menus of the deck
+ * @param settingsPage Page number of the settings page
+ * @param command Set to the command to queue
+ * @param snapshot Set when the client asked for a snapshot instead
+ *
+ * @return true if data is a valid command
+ */
+bool liveParseCommand(const uint8_t *data, size_t len, uint8_t menuCount,
+                      int settingsPage, ControlCommand &command,
+                      bool &snapshot) {
+  snapshot = false;
+  if (len == 0) {
+    return false;
+  }
+  int16_t page;
+  switch (data[0]) {
+  case LIVE_CMD_SNAPSHOT:
+    snapshot = len == 1;
+    return snapshot;
+  case LIVE_CMD_BUTTON:
+    if (len != 5 || data[1] > 5 || data[2] > CONTROL_RELEASE) {
+      return false;
+    }
+    page = (int16_t)(data[3] | (data[4] << 8));
+    command.op = data[2];
+    command.button = data[1];
+    break;
+  case LIVE_CMD_PAGE:
+    if (len != 3) {
+      return false;
+    }
+    page = (int16_t)(data[1] | (data[2] << 8));
+    command.op = CONTROL_PAGE;
+    command.button = 0;
+    break;
+  default:
+    return false;
+  }
+  bool current = page == CONTROL_PAGE_CURRENT && command.op != CONTROL_PAGE;
+  if (!current && page != 0 && page != settingsPage &&
+      !(page >= 1 && page <= menuCount)) {
+    return false;
+  }
+  command.page = page;
+  return true;
+}
+
+#endif // LIVE_STATE_H
@@ -0,0 +1,135 @@
+#ifndef MENU_CACHE_H
+#define MENU_CACHE_H
+
+#include <stdint.h>
+
+// Bookkeeping for the menus that are resident in memory. Only
+// MENU_CACHE_SLOTS menus are loaded at a time, the least recently used one
+// is evicted to make room for a menu that is opened.
+#define MENU_CACHE_SLOTS 2
+
+// Largest number of menus that can be cached, the same as DECK_MAX_MENUS
+#define MENU_CACHE_MENUS 16
+
+#define MENU_CACHE_EMPTY -1
+
+struct MenuCache {
+  int8_t   menuIndex[MENU_CACHE_SLOTS]; // Menu held by a slot, or MENU_CACHE_EMPTY
+  uint32_t lastUsed[MENU_CACHE_SLOTS];  // Value of 'clock' at the last use
+  uint32_t clock;
+};
+
+/**
+ * @brief Empty all slots
+ */
+void menuCacheReset(MenuCache &cache) {
+  for (int i = 0; i < MENU_CACHE_SLOTS; i++) {
+    cache.menuIndex[i] = MENU_CACHE_EMPTY;
+    cache.lastUsed[i] = 0;
+  }
+  cache.clock = 0;
+}
+
+/**
+ * @brief Find the slot holding a menu
+ *
+ * @return int slot, or MENU_CACHE_EMPTY if the menu is not resident
+ */
+int menuCacheFind(const MenuCache &cache, int menuIndex) {
+  for (int i = 0; i < MENU_CACHE_SLOTS; i++) {
+    if (cache.menuIndex[i] == menuIndex) {
+      return i;
+    }
+  }
+  return MENU_CACHE_EMPTY;
+}
+
+/**
+ * @brief Mark a slot as just used
+ */
+void menuCacheTouch(MenuCache &cache, int slot) {
+  cache.lastUsed[slot] = ++cache.clock;
+}
+
+/**
+ * @brief Pick the slot to load a menu into
+ *
+ * @param cache MenuCache
+ * @param pinnedMenu Menu that must stay resident (the one on screen), or
+ *                   MENU_CACHE_EMPTY
+ *
+ * @return int an empty slot if there is one, otherwise the least recently
+ *         used slot that does not hold pinnedMenu
+ */
+int menuCacheVictim(const MenuCache &cache, int pinnedMenu) {
+  int victim = MENU_CACHE_EMPTY;
+  for (int i = 0; i < MENU_CACHE_SLOTS; i++) {
+    if (cache.menuIndex[i] == MENU_CACHE_EMPTY) {
+      return i;
+    }
+    if (cache.menuIndex[i] == pinnedMenu) {
+      continue;
+    }
+    if (victim == MENU_CACHE_EMPTY ||
+        cache.lastUsed[i] < cache.lastUsed[victim]) {
+      victim = i;
+    }
+  }
+  return victim;
+}
+
+/**
+ * @brief Record that a slot now holds a menu and mark it as used
+ */
+void menuCacheAssign(MenuCache &cache, int slot, int menuIndex) {
+  cache.menuIndex[slot] = menuIndex;
+  menuCacheTouch(cache, slot);
+}
+
+/**
+ * @brief Count a visit to a menu. All counts are halved when one of them
+ *        would overflow, so old habits fade out.
+ *
+ * @param visits Visit count per menu
+ * @param menuIndex Menu that was opened
+ */
+void menuCacheCountVisit(uint16_t *visits, int menuIndex) {
+  if (visits[menuIndex] == UINT16_MAX) {
+    for (int i = 0; i < MENU_CACHE_MENUS; i++) {
+      visits[i] /= 2;
+    }
+  }
+  visits[menuIndex]++;
+}
+
+/**
+ * @brief Get the menus that are opened most
+ *
+ * @param visits Visit count per menu
+ * @param order Filled with up to 'max' menu indices, most visited first.
+ *              Ties go to the lower menu.
+ * @param max Number of menus wanted
+ *
+ * @return int number of menus written, menus never visited are left out
+ */
+int menuCachePrefetchOrder(const uint16_t *visits, int8_t *order, int max) {
+  bool taken[MENU_CACHE_MENUS] = {false};
+  int count = 0;
+  while (count < max) {
+    int best = MENU_CACHE_EMPTY;
+    for (int i = 0; i < MENU_CACHE_MENUS; i++) {
+      if (!taken[i] && visits[i] > 0 &&
+          (best == MENU_CACHE_EMPTY || visits[i] > visits[best])) {
+        best = i;
+      }
+    }
+    if (best == MENU_CACHE_EMPTY) {
+      break;
+    }
+    taken[best] = true;
+    order[count++] = best;
+  }
+  return count;
+}
+
+#endif // MENU_CACHE_H
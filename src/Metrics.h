@@ -0,0 +1,239 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "LatencyStats.h"
+
+// Counters and timings of the deck in the Prometheus text format, for
+// /metrics and the serial "metrics" command. The reply is written one metric
+// at a time from a MetricsSnapshot taken when the request came in, so it
+// takes the memory of one metric however many there are.
+#define METRICS_ENTRY_SIZE 512
+#define METRICS_PREFIX "freetouchdeck_"
+
+// Kept by loop() and the code it runs
+struct DeckMetrics {
+  LatencyHistogram loopUs;       // From one loop() to the next
+  LatencyHistogram menuLoadUs;   // loadMenu(), from the snapshot or JSON
+  LatencyHistogram reloadUs;     // applyConfigChanges()
+  uint32_t         configBootUs; // bootConfig()
+  uint32_t         loopStartUs;  // micros() when loop() last started
+  uint32_t         touches;      // Touches on a key
+  uint32_t         hidReports;   // Reports sent to the host
+  uint32_t         iconHits;     // iconInfo() answered from the icon table
+  uint32_t         iconMisses;   // iconInfo() read the logo file
+};
+
+// Everything /metrics reports, read at once
+struct MetricsSnapshot {
+  uint32_t    uptimeMs;
+  uint32_t    heapFree;
+  uint32_t    heapMinFree;
+  uint32_t    heapLargestBlock;
+  uint32_t    psramSize; // 0 without PSRAM
+  uint32_t    psramFree;
+  uint32_t    fsUsed;
+  uint32_t    fsTotal;
+  uint8_t     bleConnected;
+  DeckMetrics deck;
+};
+
+// Where a /metrics reply is
+struct MetricsWalk {
+  MetricsSnapshot snapshot;
+  char            entry[METRICS_ENTRY_SIZE]; // The metric being sent
+  uint16_t        len;
+  uint16_t        pos;
+  uint8_t         index; // Next metric
+};
+
+void metricsReset(DeckMetrics &metrics) {
+  latencyHistogramReset(metrics.loopUs);
+  latencyHistogramReset(metrics.menuLoadUs);
+  latencyHistogramReset(metrics.reloadUs);
+  metrics.configBootUs = 0;
+  metrics.loopStartUs = 0;
+  metrics.touches = 0;
+  metrics.hidReports = 0;
+  metrics.iconHits = 0;
+  metrics.iconMisses = 0;
+}
+
+/**
+ * @brief Note that loop() started, the time since the last start is one
+ *        iteration
+ *
+ * @param metrics DeckMetrics
+ * @param nowUs micros()
+ */
+void metricsLoopStart(DeckMetrics &metrics, uint32_t nowUs) {
+  if (metrics.loopStartUs) {
+    latencyHistogramRecord(metrics.loopUs, nowUs - metrics.loopStartUs);
+  }
+  metrics.loopStartUs = nowUs ? nowUs : 1;
+}
+
+/**
+ * @brief Write a metric with one sample
+ *
+ * @param buf Buffer
+ * @param size Size of buf
+ * @param name Name without METRICS_PREFIX
+ * @param type "gauge" or "counter"
+ * @param help Description
+ * @param value Sample
+ *
+ * @return size_t length, 0 when it did not fit
+ */
+size_t metricsValue(char *buf, size_t size, const char *name, const char *type,
+                    const char *help, unsigned long value) {
+  int len = snprintf(buf, size,
+                     "# HELP " METRICS_PREFIX "%s %s\n"
+                     "# TYPE " METRICS_PREFIX "%s %s\n" METRICS_PREFIX "%s %lu\n",
+                     name, help, name, type, name, value);
+  return len > 0 && (size_t)len < size ? len : 0;
+}
+
+/**
+ * @brief Write a histogram as a summary in seconds, with its median, p90 and
+ *        p99
+ *
+ * @return size_t length, 0 when it did not fit
+ *
+ * @note The quantiles are the upper bounds of the LatencyHistogram buckets.
+ */
+size_t metricsSummary(char *buf, size_t size, const char *name,
+                      const char *help, const LatencyHistogram &h) {
+  static const uint8_t     percentiles[] = {50, 90, 99};
+  static const char *const quantiles[] = {"0.5", "0.9", "0.99"};
+  int len = snprintf(buf, size,
+                     "# HELP " METRICS_PREFIX "%s %s\n"
+                     "# TYPE " METRICS_PREFIX "%s summary\n",
+                     name, help, name);
+  for (uint8_t i = 0; i < sizeof(percentiles) && len > 0 && (size_t)len < size; i++) {
+    len += snprintf(buf + len, size - len,
+                    METRICS_PREFIX "%s{quantile=\"%s\"} %.6f\n", name,
+                    quantiles[i],
+                    latencyHistogramPercentile(h, percentiles[i]) / 1000000.0);
+  }
+  if (len > 0 && (size_t)len < size) {
+    len += snprintf(buf + len, size - len,
+                    METRICS_PREFIX "%s_sum %.6f\n" METRICS_PREFIX "%s_count %lu\n",
+                    name, h.sumUs / 1000000.0, name, (unsigned long)h.count);
+  }
+  return len > 0 && (size_t)len < size ? len : 0;
+}
+
+/**
+ * @brief Write one metric of a snapshot
+ *
+ * @param s MetricsSnapshot
+ * @param index Metric, from 0
+ * @param buf Buffer, METRICS_ENTRY_SIZE holds every metric
+ * @param size Size of buf
+ *
+ * @return size_t length, 0 after the last metric
+ */
+size_t metricsEntry(const MetricsSnapshot &s, uint8_t index, char *buf,
+                    size_t size) {
+  switch (index) {
+  case 0:
+    return metricsValue(buf, size, "uptime_seconds", "gauge",
+                        "Time since the deck started.", s.uptimeMs / 1000);
+  case 1:
+    return metricsValue(buf, size, "heap_free_bytes", "gauge", "Free heap.",
+                        s.heapFree);
+  case 2:
+    return metricsValue(buf, size, "heap_min_free_bytes", "gauge",
+                        "Least free heap since the deck started.", s.heapMinFree);
+  case 3:
+    return metricsValue(buf, size, "heap_largest_block_bytes", "gauge",
+                        "Largest block of heap that can be allocated.",
+                        s.heapLargestBlock);
+  case 4:
+    return metricsValue(buf, size, "psram_size_bytes", "gauge",
+                        "PSRAM, 0 without PSRAM.", s.psramSize);
+  case 5:
+    return metricsValue(buf, size, "psram_used_bytes", "gauge", "PSRAM in use.",
+                        s.psramSize - s.psramFree);
+  case 6:
+    return metricsValue(buf, size, "filesystem_used_bytes", "gauge",
+                        "Space used on SPIFFS.", s.fsUsed);
+  case 7:
+    return metricsValue(buf, size, "filesystem_total_bytes", "gauge",
+                        "Size of SPIFFS.", s.fsTotal);
+  case 8:
+    return metricsSummary(buf, size, "loop_seconds",
+                          "Time of one loop() iteration.", s.deck.loopUs);
+  case 9:
+    return metricsValue(buf, size, "touches_total", "counter",
+                        "Touches on a key.", s.deck.touches);
+  case 10:
+    return metricsValue(buf, size, "hid_reports_total", "counter",
+                        "Reports sent to the host.", s.deck.hidReports);
+  case 11:
+    return metricsValue(buf, size, "ble_connected", "gauge",
+                        "1 while a host is connected over BLE.", s.bleConnected);
+  case 12:
+    return metricsValue(buf, size, "icon_cache_hits_total", "counter",
+                        "Logo headers found in the icon table.", s.deck.iconHits);
+  case 13:
+    return metricsValue(buf, size, "icon_cache_misses_total", "counter",
+                        "Logo headers read from their file.", s.deck.iconMisses);
+  case 14:
+    return metricsValue(buf, size, "config_boot_microseconds", "gauge",
+                        "Time to load the config at boot.", s.deck.configBootUs);
+  case 15:
+    return metricsSummary(buf, size, "menu_load_seconds",
+                          "Time to load a menu that was not resident.",
+                          s.deck.menuLoadUs);
+  case 16:
+    return metricsSummary(buf, size, "config_reload_seconds",
+                          "Time to apply a saved config file.", s.deck.reloadUs);
+  default:
+    return 0;
+  }
+}
+
+void metricsBegin(MetricsWalk &walk) {
+  walk.len = 0;
+  walk.pos = 0;
+  walk.index = 0;
+}
+
+/**
+ * @brief Fill the buffer of a chunked /metrics reply
+ *
+ * @param walk MetricsWalk, its snapshot taken
+ * @param buf Buffer of the response
+ * @param maxLen Size of buf
+ *
+ * @return size_t bytes written, 0 when every metric was sent
+ */
+size_t metricsFill(MetricsWalk &walk, uint8_t *buf, size_t maxLen) {
+  size_t used = 0;
+  while (used < maxLen) {
+    if (walk.pos == walk.len) {
+      walk.pos = 0;
+      walk.len = metricsEntry(walk.snapshot, walk.index, walk.entry,
+                              sizeof(walk.entry));
+      if (walk.len == 0) {
+        break;
+      }
+      walk.index++;
+    }
+    size_t n = walk.len - walk.pos;
+    if (n > maxLen - used) {
+      n = maxLen - used;
+    }
+    memcpy(buf + used, walk.entry + walk.pos, n);
+    used += n;
+    walk.pos += n;
+  }
+  return used;
+}
+
+#endif // METRICS_H
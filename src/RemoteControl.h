@@ -0,0 +1,148 @@
+#ifndef REMOTE_CONTROL_H
+#define REMOTE_CONTROL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Button presses and page switches sent over HTTP. The web server parses a
+// request into a ControlCommand and queues it, loop() runs it through the
+// same handlers as a touch, so the screen and the BLE reports are only ever
+// used from one task.
+#define CONTROL_QUEUE_SIZE 8
+#define CONTROL_PAGE_CURRENT -1 // Press on the page that is shown
+#define CONTROL_STATE_SIZE 96
+
+enum ControlOp {
+  CONTROL_TAP = 0, // Press and release
+  CONTROL_PRESS,   // Press and hold, modifiers stay down for a chord
+  CONTROL_RELEASE, // Let go of a held press
+  CONTROL_PAGE     // Switch to a page
+};
+
+struct ControlCommand {
+  uint8_t  op;       // ControlOp
+  uint8_t  button;   // Key 0-5
+  int16_t  page;     // Page number, CONTROL_PAGE_CURRENT for the current one
+  uint32_t queuedUs; // micros() when the request came in
+};
+
+/**
+ * @brief Parse the action of a button request
+ *
+ * @param text "tap", "press" or "release", empty for "tap"
+ * @param op Set to the ControlOp
+ *
+ * @return true if text is an action
+ */
+bool controlParseOp(const char *text, uint8_t &op) {
+  if (text[0] == '\0' || strcmp(text, "tap") == 0) {
+    op = CONTROL_TAP;
+  } else if (strcmp(text, "press") == 0) {
+    op = CONTROL_PRESS;
+  } else if (strcmp(text, "release") == 0) {
+    op = CONTROL_RELEASE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Parse a key number
+ *
+ * @param text "0" up to "5"
+ * @param button Set to the key
+ *
+ * @return true if text is a key
+ */
+bool controlParseButton(const char *text, uint8_t &button) {
+  if (text[0] < '0' || text[0] > '5' || text[1] != '\0') {
+    return false;
+  }
+  button = text[0] - '0';
+  return true;
+}
+
+/**
+ * @brief Parse a page
+ *
+ * @param text "home", "settings", "menuN" or N for menu N
+ * @param menuCount Number of menus of the deck
+ * @param settingsPage Page number of the settings page
+ * @param page Set to the page number, 0 is home
+ *
+ * @return true if text is a page of the deck
+ */
+bool controlParsePage(const char *text, uint8_t menuCount, int settingsPage,
+                      int16_t &page) {
+  if (strcmp(text, "home") == 0) {
+    page = 0;
+    return true;
+  }
+  if (strcmp(text, "settings") == 0) {
+    page = settingsPage;
+    return true;
+  }
+  if (strncmp(text, "menu", 4) == 0) {
+    text += 4;
+  }
+  int number = 0;
+  const char *p = text;
+  for (; *p >= '0' && *p <= '9' && p - text < 3; p++) {
+    number = number * 10 + (*p - '0');
+  }
+  if (p == text || *p != '\0' || number < 1 || number > menuCount) {
+    return false;
+  }
+  page = number;
+  return true;
+}
+
+/**
+ * @brief Write the name of a page as controlParsePage() reads it
+ *
+ * @param buf Buffer
+ * @param size Size of buf
+ * @param page Page number
+ * @param menuCount Number of menus of the deck
+ * @param settingsPage Page number of the settings page
+ */
+void controlPageName(char *buf, size_t size, int page, uint8_t menuCount,
+                     int settingsPage) {
+  if (page == 0) {
+    snprintf(buf, size, "home");
+  } else if (page == settingsPage) {
+    snprintf(buf, size, "settings");
+  } else if (page >= 1 && page <= menuCount) {
+    snprintf(buf, size, "menu%d", page);
+  } else {
+    // Info, config mode and error pages take no presses
+    snprintf(buf, size, "other");
+  }
+}
+
+/**
+ * @brief Write the state reply {"page":"menu2","latched":[0,1,0]}
+ *
+ * @param buf Buffer
+ * @param size Size of buf, CONTROL_STATE_SIZE holds every page
+ * @param pageName Name of the page
+ * @param latched Latch state of the keys of the page
+ * @param count Number of keys, at most 6
+ *
+ * @return size_t length of the reply
+ */
+size_t controlStateJson(char *buf, size_t size, const char *pageName,
+                        const bool *latched, uint8_t count) {
+  int len = snprintf(buf, size, "{\"page\":\"%s\",\"latched\":[", pageName);
+  for (uint8_t i = 0; i < count && len > 0 && (size_t)len < size; i++) {
+    len += snprintf(buf + len, size - len, i ? ",%d" : "%d", latched[i] ? 1 : 0);
+  }
+  if (len > 0 && (size_t)len < size) {
+    len += snprintf(buf + len, size - len, "]}");
+  }
+  return len > 0 && (size_t)len < size ? len : 0;
+}
+
+#endif // REMOTE_CONTROL_H
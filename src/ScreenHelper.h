@@ -67,6 +67,56 @@ unsigned int convertRGB888ToRGB565(unsigned long rgb)
   return (((rgb & 0xf80000) >> 8) | ((rgb & 0xfc00) >> 5) | ((rgb & 0xf8) >> 3));
 }
 
+/**
+* @brief This function draws a native logo, see IconTranscode.h. Its rows are
+         RGB565 already and pushed as they are read.
+*
+* @param &bmpFS File, after the info header was read
+* @param x int16_t
+* @param y int16_t
+* @param w uint16_t width
+* @param h uint16_t height
+* @param seekOffset uint32_t offset of the top row
+* @param transparent bool - if true, only the span of a row that is not black
+         is pushed and black pixels in it are not drawn
+*
+* @return none
+*/
+void drawNativeBmp(fs::File &bmpFS, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                   uint32_t seekOffset, bool transparent)
+{
+  if (w > ICON_NATIVE_SIZE || h > ICON_NATIVE_SIZE)
+  {
+    Serial.printf("[WARNING]: Native logo of %ux%u is larger than a key\n", w, h);
+    return;
+  }
+
+  uint8_t spans[ICON_NATIVE_SIZE][2];
+  bmpFS.seek(ICON_NATIVE_BLOCK + 2);
+  bmpFS.read((uint8_t *)spans, 2 * h);
+
+  bool oldSwapBytes = tft.getSwapBytes();
+  tft.setSwapBytes(true);
+  bmpFS.seek(seekOffset);
+  uint32_t stride = ICON_NATIVE_STRIDE(w);
+  uint16_t lineBuffer[ICON_NATIVE_STRIDE(ICON_NATIVE_SIZE) / 2];
+
+  for (uint16_t row = 0; row < h; row++, y++)
+  {
+    bmpFS.read((uint8_t *)lineBuffer, stride);
+    if (!transparent)
+    {
+      tft.pushImage(x, y, w, 1, lineBuffer);
+    }
+    else if (spans[row][1] > spans[row][0])
+    {
+      tft.pushImage(x + spans[row][0], y, spans[row][1] - spans[row][0], 1,
+                    lineBuffer + spans[row][0], TFT_BLACK);
+    }
+  }
+  tft.setSwapBytes(oldSwapBytes);
+}
+
 /**
 * @brief Internal function that draws a BMP on the TFT screen according
          to the given x and y coordinates. Supports 1-bit, 4-bit, 16-bit, and 24-bit BMPs
@@ -106,11 +156,12 @@ void drawBmpInternal(const char *filename, int16_t x, int16_t y, bool transparen
   uint16_t w, h, row;
   uint8_t r, g, b;
   uint16_t bitsPerPixel;
+  uint32_t reserved;
 
   if (read16(bmpFS) == 0x4D42)
   {
     read32(bmpFS);
-    read32(bmpFS);
+    reserved = read32(bmpFS);
     seekOffset = read32(bmpFS);
     read32(bmpFS);
     w = read32(bmpFS);
@@ -119,7 +170,11 @@ void drawBmpInternal(const char *filename, int16_t x, int16_t y, bool transparen
     bitsPerPixel = read16(bmpFS);
     read32(bmpFS); // compression
   
-    if (bitsPerPixel == 24) {
+    if (reserved == ICON_NATIVE_SIGNATURE && bitsPerPixel == 16) {
+      // An uploaded logo, stored top down, the height is negative
+      drawNativeBmp(bmpFS, x, y, w, -(int16_t)h, seekOffset, transparent);
+    }
+    else if (bitsPerPixel == 24) {
       // Original 24-bit BMP handling
       y += h - 1;
 
@@ -435,61 +490,125 @@ uint16_t getBMPColor(const char *filename)
 }
 
 /**
-* @brief This function returns the RGB565 colour of the first pixel for a
-         given the logo number. The pagenumber is global.
+* @brief This function returns what is known about a logo. The header of the
+         bitmap is read the first time and kept in the icon table.
 *
-* @param logonumber int
+* @param id IconId
 *
-* @return uint16_t
+* @return IconInfo&
 *
-* @note Uses getBMPColor to read the actual image data.
+* @note Logos that cannot be read get ICON_INFO_MISSING and a black
+         background, they are not read again until they are invalidated.
 */
-uint16_t getImageBG(int iconNumber)
+IconInfo &iconInfo(IconId id)
 {
-  // Logo 5 on each screen is the back home button except on the home screen
-  if (iconNumber == 5 && pageNum > 0)
+  static IconInfo none = {0, 0, 0x0000, 0, ICON_INFO_READ | ICON_INFO_MISSING};
+  if (id >= iconTable.count)
   {
-    return getBMPColor("/logos/home.bmp");
+    return none;
   }
 
-  // Bounds checking
-  if (pageNum < 0 || pageNum > 6 || iconNumber < 0 || iconNumber >= 6)
+  IconInfo &info = iconTable.icons[id];
+  if (info.flags & ICON_INFO_READ)
   {
-    return 0x0000;
+    deckMetrics.iconHits++;
+    return info;
   }
-  
-  // Screen6 has no logos
-  if (pageNum == 6)
+  deckMetrics.iconMisses++;
+
+  info.flags = ICON_INFO_READ;
+  const char *path = iconTablePath(iconTable, id);
+  File bmpFS = FILESYSTEM.open(path, FILE_READ);
+  // Up to the background of a native logo, other bitmaps need 30 bytes
+  uint8_t header[ICON_NATIVE_BLOCK + 2];
+  uint32_t dataOffset;
+  size_t len = bmpFS ? bmpFS.read(header, sizeof(header)) : 0;
+  bool isBmp = iconInfoFromBmpHeader(header, len, info, dataOffset);
+  bmpFS.close();
+
+  if (!isBmp)
   {
-    return 0x0000;
+    Serial.printf("[WARNING]: Logo %s is missing or no bitmap\n", path);
+    info.flags |= ICON_INFO_MISSING;
+    info.background = 0x0000;
+    return info;
   }
-  
-  // Use global screens array
-  return getBMPColor(screens[pageNum].icons[iconNumber]);
+  if (!(info.flags & ICON_INFO_NATIVE))
+  {
+    info.background = getBMPColor(path);
+  }
+  return info;
 }
 
-#include "LatchImageHelper.h"
+/**
+* @brief This function returns the RGB565 colour of the first pixel of a logo.
+*
+* @param id IconId
+*
+* @return uint16_t
+*
+* @note Only reads the file the first time, see iconInfo().
+*/
+uint16_t iconBackground(IconId id)
+{
+  return iconInfo(id).background;
+}
+
+/**
+* @brief This function draws a logo from the icon table.
+*
+* @param id IconId
+* @param x int16_t
+* @param y int16_t
+* @param transparent bool - if true, black pixels (0x0000) are not drawn
+*
+* @return none
+*/
+void drawIconBmp(IconId id, int16_t x, int16_t y, bool transparent)
+{
+  drawBmpInternal(iconTablePath(iconTable, id), x, y, transparent);
+}
 
 /**
-* @brief Helper function to get latch logo path for a specific menu and button
+* @brief This function returns the RGB565 colour of the first pixel for a
+         given the logo number. The pagenumber is global.
+*
+* @param logonumber int
 *
-* @param menuNum int - menu number (1-5)
-* @param buttonNum int - button number (0-4)
+* @return uint16_t
 *
-* @return const char* - path to latch logo or nullptr if invalid
+* @note Uses iconBackground, the file is read once.
 */
-const char* getLatchIconPath(int pageNum, int buttonNum)
+uint16_t getImageBG(int iconNumber)
 {
+  // Logo 5 on each screen is the back home button except on the home screen
+  if (iconNumber == 5 && pageNum != PAGE_HOME)
+  {
+    return iconBackground(systemIcons.homebutton);
+  }
+
   // Bounds checking
-  if (pageNum < 1 || pageNum > 5 || buttonNum < 0 || buttonNum >= 5)
+  if (iconNumber < 0 || iconNumber >= 6)
   {
-    return nullptr;
+    return 0x0000;
   }
-  
-  // Use global menus array (pageNum 1-5 maps to array indices 0-4)
-  return menus[pageNum - 1].buttons[buttonNum].latchlogo;
+
+  if (pageNum == PAGE_HOME)
+  {
+    return iconBackground(homeIcons[iconNumber]);
+  }
+
+  // The settings page has no logos, neither have the keys after the last
+  // button of a menu
+  if (!isMenuPage(pageNum) || iconNumber >= menuPages[pageNum - 1].buttonCount)
+  {
+    return 0x0000;
+  }
+  return iconBackground(menuPages[pageNum - 1].icons[iconNumber]);
 }
 
+#include "LatchImageHelper.h"
+
 /**
 * @brief This function returns the RGB565 colour of the first pixel of the image which
 *          is being latched to for a given the logo number. The pagenumber is global.
@@ -498,25 +617,17 @@ const char* getLatchIconPath(int pageNum, int buttonNum)
 *
 * @return uint16_t
 *
-* @note Uses getBMPColor to read the actual image data.
+* @note A button without a latch logo keeps the background of its logo.
 */
 uint16_t getLatchImageBG(int logonumber)
 {
   // Bounds checking
-  if (pageNum < 1 || pageNum > 5 || logonumber < 0 || logonumber >= 5)
+  if (!isMenuPage(pageNum) || logonumber < 0 ||
+      logonumber >= menuPages[pageNum - 1].buttonCount)
   {
     return 0x0000;
   }
-  
-  // Prepare arrays for pure function
-  const char* menuButtons[5];
-  const char* screenLogos[5];
-  
-  for (int i = 0; i < 5; i++)
-  {
-    menuButtons[i] = menus[pageNum - 1].buttons[i].latchlogo;
-    screenLogos[i] = screens[pageNum].icons[i];
-  }
-  
-  return getLatchImageBGPure(pageNum, logonumber, menuButtons, screenLogos, getBMPColor);
+
+  return iconBackground(getLatchImageIcon(menuPages[pageNum - 1].icons[logonumber],
+                                          currentMenu().buttons[logonumber].latchLogo));
 }
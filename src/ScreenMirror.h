@@ -0,0 +1,445 @@
+#ifndef SCREEN_MIRROR_H
+#define SCREEN_MIRROR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "IconTable.h"
+
+// A copy of the keypad for /screen, kept as what each key was drawn from:
+// its fill colour, its logo and its latch dot. An image is rendered from it
+// and the logo files a row at a time, the display is never read back. Each
+// draw of a key bumps its generation, so a stream only sends the keys that
+// were drawn since its last frame.
+//
+// /screen/stream sends frames one after the other:
+//
+//   frame:  'S' seq(2) regions(1) region...
+//   region: key(1) x(2) y(2) w(2) h(2) row...
+//   row:    the w pixels of a row, RLE, top row first
+//
+// key is 0-5, or MIRROR_REGION_SCREEN for the whole screen, which is sent
+// first and when the background changed. A row is RLE as runs of a byte n:
+// n & 0x80, the next pixel (n & 0x7F) + 1 times, otherwise n + 1 pixels.
+// Numbers and RGB565 pixels are little endian.
+#define MIRROR_KEYS 6
+#define MIRROR_MAX_RENDERS 2          // /screen and /screen/stream at once
+#define MIRROR_FRAME_INTERVAL_MS 200  // Draws within this time go in one frame
+#define MIRROR_LOGO_WIDTH 96          // Logos are cut off after this
+#define MIRROR_BMP_HEADER_SIZE 66
+#define MIRROR_FRAME_HEADER_SIZE 4
+#define MIRROR_REGION_HEADER_SIZE 9
+#define MIRROR_FRAME 'S'
+#define MIRROR_REGION_SCREEN 0xFF
+#define MIRROR_DAMAGE_SCREEN 0x80 // mirrorDamage(): send the whole screen
+
+// Most bytes a row of count pixels takes in RLE
+#define MIRROR_RLE_SIZE(count) ((count) * 2 + (count) / 128 + 2)
+
+#define MIRROR_OUTLINE 0xFFFF // Keys have a white outline, pressed ones are white
+#define MIRROR_DOT_SIZE 18
+#define MIRROR_DOT_RADIUS 4
+
+// MirrorKey flags
+#define MIRROR_KEY_DRAWN 0x01
+#define MIRROR_KEY_TRANSPARENT 0x02 // Black pixels of the logo are not drawn
+#define MIRROR_KEY_LATCH_DOT 0x04
+#define MIRROR_KEY_PRESSED 0x08 // White without a logo while it is touched
+
+struct MirrorKey {
+  uint16_t fill;
+  uint16_t generation; // Bumped each time the key is drawn
+  IconId   icon;       // ICON_NONE for a blank key
+  uint8_t  flags;
+};
+
+struct MirrorScreen {
+  uint16_t  background;
+  uint16_t  latchColour;
+  MirrorKey keys[MIRROR_KEYS];
+};
+
+// Where the keys are, from the KEY_* defines
+struct MirrorLayout {
+  int16_t width;
+  int16_t height;
+  int16_t left; // Top left corner of key 0
+  int16_t top;
+  int16_t keyW;
+  int16_t keyH;
+  int16_t stepX; // From one key to the next
+  int16_t stepY;
+  int16_t logoX; // Top left corner of the logo in a key
+  int16_t logoY;
+  int16_t dotX; // Top left corner of the latch dot in a key
+  int16_t dotY;
+};
+
+// Row of the logo of a key, decoded to RGB565
+struct MirrorLogoRow {
+  const uint16_t *pixels; // NULL when the logo has no pixels in this row
+  uint16_t        width;
+};
+
+/**
+ * @brief Work out where the keys are drawn
+ *
+ * @param layout MirrorLayout to fill
+ * @param width Width of the screen
+ * @param height Height of the screen
+ * @param centreX Centre of key 0, KEY_X
+ * @param centreY Centre of key 0, KEY_Y
+ * @param keyW Width of a key
+ * @param keyH Height of a key
+ * @param spacingX Gap between two keys
+ * @param spacingY Gap between two rows of keys
+ * @param dotOffset How far the latch dot sticks out of the logo
+ *
+ * @note The logo is drawn 36 pixels up and left of the centre, as posX()
+ *       and posY() do, the latch dot one further as drawlatched() does.
+ */
+void mirrorLayoutInit(MirrorLayout &layout, int16_t width, int16_t height,
+                      int16_t centreX, int16_t centreY, int16_t keyW,
+                      int16_t keyH, int16_t spacingX, int16_t spacingY,
+                      int16_t dotOffset) {
+  layout.width = width;
+  layout.height = height;
+  // TFT_eSPI_Button::initButton() takes the centre
+  layout.left = centreX - keyW / 2;
+  layout.top = centreY - keyH / 2;
+  layout.keyW = keyW;
+  layout.keyH = keyH;
+  layout.stepX = keyW + spacingX;
+  layout.stepY = keyH + spacingY;
+  layout.logoX = centreX - 36 - layout.left;
+  layout.logoY = centreY - 36 - layout.top;
+  layout.dotX = centreX - 37 - dotOffset - layout.left;
+  layout.dotY = centreY - 37 - dotOffset - layout.top;
+}
+
+int16_t mirrorKeyLeft(const MirrorLayout &layout, uint8_t b) {
+  return layout.left + (b % 3) * layout.stepX;
+}
+
+int16_t mirrorKeyTop(const MirrorLayout &layout, uint8_t b) {
+  return layout.top + (b / 3) * layout.stepY;
+}
+
+/**
+ * @brief Get the row of keys a screen row goes through
+ *
+ * @return int8_t 0 or 1, -1 when the row is between or outside the keys
+ */
+int8_t mirrorKeyRow(const MirrorLayout &layout, int16_t y) {
+  for (uint8_t row = 0; row < MIRROR_KEYS / 3; row++) {
+    int16_t top = mirrorKeyTop(layout, row * 3);
+    if (y >= top && y < top + layout.keyH) {
+      return row;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Get the rectangle of a region of a frame
+ *
+ * @param region Key 0-5 or MIRROR_REGION_SCREEN
+ */
+void mirrorRegionRect(const MirrorLayout &layout, uint8_t region, int16_t &x,
+                      int16_t &y, int16_t &w, int16_t &h) {
+  if (region == MIRROR_REGION_SCREEN) {
+    x = 0;
+    y = 0;
+    w = layout.width;
+    h = layout.height;
+  } else {
+    x = mirrorKeyLeft(layout, region);
+    y = mirrorKeyTop(layout, region);
+    w = layout.keyW;
+    h = layout.keyH;
+  }
+}
+
+/**
+ * @brief Check whether a pixel is inside a rounded rectangle
+ *
+ * @param px Column, from the left of the rectangle
+ * @param py Row, from the top of the rectangle
+ * @param w Width
+ * @param h Height
+ * @param r Radius of the corners
+ *
+ * @return true if fillRoundRect() draws the pixel
+ */
+bool mirrorInRoundRect(int16_t px, int16_t py, int16_t w, int16_t h,
+                       int16_t r) {
+  if (px < 0 || py < 0 || px >= w || py >= h) {
+    return false;
+  }
+  int32_t dx = px < r ? r - px : (px > w - r - 1 ? px - (w - r - 1) : 0);
+  int32_t dy = py < r ? r - py : (py > h - r - 1 ? py - (h - r - 1) : 0);
+  return dx * dx + dy * dy <= (int32_t)r * r;
+}
+
+/**
+ * @brief Render a row of the screen
+ *
+ * @param screen What the keys were drawn from
+ * @param layout MirrorLayout
+ * @param y Row
+ * @param logos Row y of the logo of each key, may be NULL
+ * @param out layout.width pixels
+ *
+ * @note Draws what drawKey() does, in the same order: the key with its
+ *       outline, the logo and the latch dot.
+ */
+void mirrorRenderRow(const MirrorScreen &screen, const MirrorLayout &layout,
+                     int16_t y, const MirrorLogoRow *logos, uint16_t *out) {
+  for (int16_t x = 0; x < layout.width; x++) {
+    out[x] = screen.background;
+  }
+  int8_t row = mirrorKeyRow(layout, y);
+  if (row < 0) {
+    return;
+  }
+  int16_t r = (layout.keyW < layout.keyH ? layout.keyW : layout.keyH) / 4;
+  for (uint8_t b = row * 3; b < row * 3 + 3; b++) {
+    const MirrorKey &key = screen.keys[b];
+    if (!(key.flags & MIRROR_KEY_DRAWN)) {
+      continue;
+    }
+    int16_t left = mirrorKeyLeft(layout, b);
+    int16_t py = y - mirrorKeyTop(layout, b);
+    bool    pressed = key.flags & MIRROR_KEY_PRESSED;
+
+    for (int16_t px = 0; px < layout.keyW && left + px < layout.width; px++) {
+      if (left + px < 0 || !mirrorInRoundRect(px, py, layout.keyW, layout.keyH, r)) {
+        continue;
+      }
+      bool edge = !mirrorInRoundRect(px - 1, py - 1, layout.keyW - 2,
+                                     layout.keyH - 2, r - 1);
+      out[left + px] = edge || pressed ? MIRROR_OUTLINE : key.fill;
+    }
+    if (pressed) {
+      continue;
+    }
+
+    if (logos && logos[b].pixels) {
+      int16_t logoLeft = left + layout.logoX;
+      for (uint16_t i = 0; i < logos[b].width; i++) {
+        uint16_t pixel = logos[b].pixels[i];
+        int16_t  x = logoLeft + i;
+        if (x < 0 || x >= layout.width ||
+            (pixel == 0 && (key.flags & MIRROR_KEY_TRANSPARENT))) {
+          continue;
+        }
+        out[x] = pixel;
+      }
+    }
+
+    if (key.flags & MIRROR_KEY_LATCH_DOT) {
+      int16_t dotLeft = left + layout.dotX;
+      int16_t dotRow = py - layout.dotY;
+      for (int16_t px = 0; px < MIRROR_DOT_SIZE; px++) {
+        int16_t x = dotLeft + px;
+        if (x >= 0 && x < layout.width &&
+            mirrorInRoundRect(px, dotRow, MIRROR_DOT_SIZE, MIRROR_DOT_SIZE,
+                              MIRROR_DOT_RADIUS)) {
+          out[x] = screen.latchColour;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Find what was drawn since a client was sent a frame
+ *
+ * @param sent Screen the client was last sent, NULL for a new client
+ * @param screen Screen now
+ *
+ * @return uint8_t bit b for key b, MIRROR_DAMAGE_SCREEN for the whole screen,
+ *         0 when nothing was drawn
+ */
+uint8_t mirrorDamage(const MirrorScreen *sent, const MirrorScreen &screen) {
+  if (!sent || sent->background != screen.background) {
+    return MIRROR_DAMAGE_SCREEN;
+  }
+  uint8_t damage = 0;
+  for (uint8_t b = 0; b < MIRROR_KEYS; b++) {
+    if (sent->keys[b].generation != screen.keys[b].generation) {
+      damage |= 1 << b;
+    }
+  }
+  return damage;
+}
+
+/**
+ * @brief Get the RGB565 colour of a pixel of a BMP row
+ *
+ * @param line Row as read from the file
+ * @param bpp Bits per pixel, 1, 4, 16 or 24
+ * @param col Column
+ * @param palette Colours of a 1 or 4 bit BMP
+ *
+ * @note The same conversions as drawBmpInternal().
+ */
+uint16_t mirrorBmpPixel(const uint8_t *line, uint16_t bpp, uint16_t col,
+                        const uint16_t *palette) {
+  switch (bpp) {
+  case 24: {
+    const uint8_t *p = line + col * 3;
+    return ((p[2] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[0] >> 3);
+  }
+  case 16:
+    return line[col * 2] | (line[col * 2 + 1] << 8);
+  case 4:
+    return palette[(col % 2 ? line[col / 2] : line[col / 2] >> 4) & 0x0F];
+  case 1:
+    return palette[(line[col / 8] >> (7 - col % 8)) & 1];
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Get the bytes of a BMP row including its padding
+ */
+uint32_t mirrorBmpStride(uint16_t width, uint16_t bpp) {
+  return ((uint32_t)width * bpp + 31) / 32 * 4;
+}
+
+void mirrorPut16(uint8_t *buf, uint16_t value) {
+  buf[0] = value & 0xFF;
+  buf[1] = value >> 8;
+}
+
+void mirrorPut32(uint8_t *buf, uint32_t value) {
+  mirrorPut16(buf, value & 0xFFFF);
+  mirrorPut16(buf + 2, value >> 16);
+}
+
+/**
+ * @brief Get the size of the /screen image
+ */
+uint32_t mirrorBmpSize(int16_t width, int16_t height) {
+  return MIRROR_BMP_HEADER_SIZE + mirrorBmpStride(width, 16) * height;
+}
+
+/**
+ * @brief Write the header of a 16 bit RGB565 BMP, top row first
+ *
+ * @param buf MIRROR_BMP_HEADER_SIZE bytes
+ *
+ * @return size_t MIRROR_BMP_HEADER_SIZE
+ */
+size_t mirrorBmpHeader(uint8_t *buf, int16_t width, int16_t height) {
+  memset(buf, 0, MIRROR_BMP_HEADER_SIZE);
+  buf[0] = 'B';
+  buf[1] = 'M';
+  mirrorPut32(buf + 2, mirrorBmpSize(width, height));
+  mirrorPut32(buf + 10, MIRROR_BMP_HEADER_SIZE);
+  mirrorPut32(buf + 14, 40);
+  mirrorPut32(buf + 18, width);
+  mirrorPut32(buf + 22, (uint32_t)-height); // Negative: top row first
+  mirrorPut16(buf + 26, 1);
+  mirrorPut16(buf + 28, 16);
+  mirrorPut32(buf + 30, 3); // BI_BITFIELDS, with the masks after the header
+  mirrorPut32(buf + 34, mirrorBmpStride(width, 16) * height);
+  mirrorPut32(buf + 38, 2835); // 72 dpi
+  mirrorPut32(buf + 42, 2835);
+  mirrorPut32(buf + 54, 0xF800);
+  mirrorPut32(buf + 58, 0x07E0);
+  mirrorPut32(buf + 62, 0x001F);
+  return MIRROR_BMP_HEADER_SIZE;
+}
+
+/**
+ * @brief Write the header of a stream frame
+ *
+ * @param regions Number of regions that follow
+ */
+size_t mirrorFrameHeader(uint8_t *buf, uint16_t seq, uint8_t regions) {
+  buf[0] = MIRROR_FRAME;
+  mirrorPut16(buf + 1, seq);
+  buf[3] = regions;
+  return MIRROR_FRAME_HEADER_SIZE;
+}
+
+/**
+ * @brief Write the header of a region of a stream frame
+ *
+ * @param region Key 0-5 or MIRROR_REGION_SCREEN
+ */
+size_t mirrorRegionHeader(uint8_t *buf, const MirrorLayout &layout,
+                          uint8_t region) {
+  int16_t x, y, w, h;
+  mirrorRegionRect(layout, region, x, y, w, h);
+  buf[0] = region;
+  mirrorPut16(buf + 1, x);
+  mirrorPut16(buf + 3, y);
+  mirrorPut16(buf + 5, w);
+  mirrorPut16(buf + 7, h);
+  return MIRROR_REGION_HEADER_SIZE;
+}
+
+/**
+ * @brief Get the number of regions a damage is sent as
+ */
+uint8_t mirrorRegionCount(uint8_t damage) {
+  if (damage & MIRROR_DAMAGE_SCREEN) {
+    return 1;
+  }
+  uint8_t count = 0;
+  for (; damage; damage &= damage - 1) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief Encode a row of pixels
+ *
+ * @param pixels RGB565 pixels
+ * @param count Number of pixels
+ * @param out MIRROR_RLE_SIZE(count) bytes
+ *
+ * @return size_t bytes written
+ *
+ * @note Two pixels the same already go in a run, the fill of a key and the
+ *       flat backgrounds of most logos take a few bytes a row.
+ */
+size_t mirrorRleRow(const uint16_t *pixels, uint16_t count, uint8_t *out) {
+  size_t   len = 0;
+  uint16_t i = 0;
+  while (i < count) {
+    uint16_t run = 1;
+    while (i + run < count && run < 128 && pixels[i + run] == pixels[i]) {
+      run++;
+    }
+    if (run > 1) {
+      out[len++] = 0x80 | (run - 1);
+      mirrorPut16(out + len, pixels[i]);
+      len += 2;
+      i += run;
+      continue;
+    }
+    // Up to where the next run starts
+    uint16_t literal = 1;
+    while (i + literal < count && literal < 128 &&
+           !(i + literal + 1 < count &&
+             pixels[i + literal] == pixels[i + literal + 1])) {
+      literal++;
+    }
+    out[len++] = literal - 1;
+    for (uint16_t j = 0; j < literal; j++) {
+      mirrorPut16(out + len, pixels[i + j]);
+      len += 2;
+    }
+    i += literal;
+  }
+  return len;
+}
+
+#endif // SCREEN_MIRROR_H
@@ -4,11 +4,28 @@
 
 #ifdef USECAPTOUCH
 #include <FT6236.h>
+#include <Wire.h>
 extern FT6236 ts;
+
+#ifndef FT6236_ADDR
+#define FT6236_ADDR 0x38
+#endif
+
+// The FT6236 register block holding the touch count and both touch points
+// (0x00 - 0x0F) is read in one I2C transaction.
+#define FT6236_REG_BLOCK_SIZE 16
 #endif
 
+// The FT6236 reports up to two touch points
+#define MAX_TOUCH_POINTS 2
+
+#include "LatencyStats.h"
+#include "TouchTrace.h"
+#include "TouchRegions.h"
+
 extern TFT_eSPI tft;
 extern TFT_eSPI_Button key[6];
+extern LatencyTracker inputLatency;
 
 // Touch handling structure for consistent coordinate and state management
 struct TouchState {
@@ -18,6 +35,25 @@ struct TouchState {
   bool valid;
 };
 
+// All touch points reported during one poll of the touch controller
+struct MultiTouchState {
+  uint8_t    count;
+  TouchState points[MAX_TOUCH_POINTS];
+};
+
+// Touch traces are recorded to and replayed from TOUCH_TRACE_FILE
+enum TouchTraceMode { TRACE_OFF, TRACE_RECORDING, TRACE_REPLAYING };
+
+// Stop recording when the trace gets this big to keep space on the FILESYSTEM
+#define TOUCH_TRACE_MAX_BYTES 65536
+
+TouchTraceMode   touchTraceMode = TRACE_OFF;
+File             touchTraceFile;
+unsigned long    touchTraceStartMs = 0;
+size_t           touchTraceBytes = 0;
+TouchTraceSample touchTraceLast;
+TouchTraceReplay touchTraceReplay;
+
 /**
  * @brief Initialize touch handling based on touch type (capacitive or resistive)
  * @return true if touch initialization was successful
@@ -43,32 +79,335 @@ bool initializeTouchHandling() {
 #endif // defined(USECAPTOUCH)
 }
 
+#ifdef USECAPTOUCH
 /**
- * @brief Get touch input from either capacitive or resistive touch screen
- * @return TouchState containing coordinates and press state
+ * @brief Read the touch count and both touch points from the FT6236 in a
+ *        single I2C transaction.
+ * @param regs Buffer of FT6236_REG_BLOCK_SIZE bytes to hold registers 0x00-0x0F
+ * @return true if the full register block was read
  */
-TouchState getTouchInput() {
-  TouchState touch = {0, 0, false, false};
-  
+bool readCapTouchRegisters(uint8_t *regs) {
+  Wire.beginTransmission(FT6236_ADDR);
+  Wire.write((uint8_t)0);
+  if (Wire.endTransmission() != 0) {
+    return false;
+  }
+
+  if (Wire.requestFrom((uint8_t)FT6236_ADDR, (uint8_t)FT6236_REG_BLOCK_SIZE) !=
+      FT6236_REG_BLOCK_SIZE) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < FT6236_REG_BLOCK_SIZE; i++) {
+    regs[i] = Wire.read();
+  }
+  return true;
+}
+#endif // defined(USECAPTOUCH)
+
+#if !defined(USECAPTOUCH)
+
+#include "TouchCalibration.h"
+
+extern Preferences savedStates;
+
+// Raw pressure above which the resistive screen counts as touched
+#define TOUCH_Z_THRESHOLD 600
+
+// Two raw readings of one touch may differ this much, otherwise the finger is
+// still landing or lifting
+#define TOUCH_RAW_TOLERANCE 40
+
+// A calibration is redone when a point is off by more than this many pixels
+#define TOUCH_CAL_MAX_ERROR 10
+
+// Bump when the layout of StoredTouchCalibration changes
+#define TOUCH_CAL_VERSION 1
+
+// The affine model stored in NVS (Preferences) under TOUCH_CAL_KEY
+struct StoredTouchCalibration {
+  uint8_t           version;
+  AffineCalibration cal;
+};
+
+AffineCalibration touchCalibration;
+
+/**
+ * @brief Read a stable raw reading from the resistive touch controller
+ * @param rawX Raw X reading
+ * @param rawY Raw Y reading
+ * @return true if the screen is touched and both readings agree
+ */
+bool readRawTouch(uint16_t &rawX, uint16_t &rawY) {
+  if (tft.getTouchRawZ() < TOUCH_Z_THRESHOLD) {
+    return false;
+  }
+
+  uint16_t x1, y1, x2, y2;
+  tft.getTouchRaw(&x1, &y1);
+  tft.getTouchRaw(&x2, &y2);
+
+  if (abs((int)x1 - (int)x2) > TOUCH_RAW_TOLERANCE ||
+      abs((int)y1 - (int)y2) > TOUCH_RAW_TOLERANCE ||
+      tft.getTouchRawZ() < TOUCH_Z_THRESHOLD) {
+    return false;
+  }
+
+  rawX = (x1 + x2) / 2;
+  rawY = (y1 + y2) / 2;
+  return true;
+}
+
+/**
+ * @brief Get a touch in screen coordinates using the affine calibration
+ * @param x Touched X at the current rotation
+ * @param y Touched Y at the current rotation
+ * @return true if the screen is touched inside the visible area
+ */
+bool getCalibratedTouch(uint16_t *x, uint16_t *y) {
+  uint16_t rawX, rawY;
+  if (!readRawTouch(rawX, rawY)) {
+    return false;
+  }
+
+  float nativeX, nativeY;
+  applyAffineCalibration(touchCalibration, rawX, rawY, nativeX, nativeY);
+
+  int32_t screenX, screenY;
+  nativeToRotated(lroundf(nativeX), lroundf(nativeY), tft.getRotation(),
+                  TFT_WIDTH, TFT_HEIGHT, screenX, screenY);
+
+  if (screenX < 0 || screenY < 0 || screenX >= tft.width() ||
+      screenY >= tft.height()) {
+    return false;
+  }
+
+  *x = screenX;
+  *y = screenY;
+  return true;
+}
+#endif // !defined(USECAPTOUCH)
+
+/**
+ * @brief Read all touch points from either capacitive or resistive touch screen
+ * @return MultiTouchState containing up to MAX_TOUCH_POINTS touches
+ *
+ * @note Capacitive touch reads the count and both points with one I2C
+ *       transaction instead of calling ts.touched() and ts.getPoint() per point.
+ */
+MultiTouchState readTouchHardware() {
+  MultiTouchState multi = {};
+
 #ifdef USECAPTOUCH
-  if (ts.touched()) {
-    // Retrieve a point from capacitive touch
-    TS_Point p = ts.getPoint();
-    
+  uint8_t regs[FT6236_REG_BLOCK_SIZE];
+  if (!readCapTouchRegisters(regs)) {
+    return multi;
+  }
+
+  // Register 0x02 holds the number of touch points, anything above 2 is noise
+  uint8_t touches = regs[0x02] & 0x0F;
+  if (touches > MAX_TOUCH_POINTS) {
+    touches = 0;
+  }
+
+  for (uint8_t i = 0; i < touches; i++) {
+    // Each point is 6 registers wide, starting at 0x03
+    const uint8_t *p = &regs[0x03 + i * 6];
+    uint16_t rawX = ((p[0] & 0x0F) << 8) | p[1];
+    uint16_t rawY = ((p[2] & 0x0F) << 8) | p[3];
+
     // Flip coordinates to match screen rotation
-    p.x = map(p.x, 0, 320, 320, 0);
-    touch.y = p.x;
-    touch.x = p.y;
-    touch.pressed = true;
-    touch.valid = true;
+    rawX = map(rawX, 0, 320, 320, 0);
+    multi.points[i].y = rawX;
+    multi.points[i].x = rawY;
+    multi.points[i].pressed = true;
+    multi.points[i].valid = true;
   }
+  multi.count = touches;
 #else
-  // Get touch from resistive touch screen
-  touch.pressed = tft.getTouch(&touch.x, &touch.y);
+  // Resistive touch only ever reports a single point
+  TouchState &touch = multi.points[0];
+  touch.pressed = getCalibratedTouch(&touch.x, &touch.y);
   touch.valid = true;
+  multi.count = touch.pressed ? 1 : 0;
 #endif // defined(USECAPTOUCH)
-  
-  return touch;
+
+  return multi;
+}
+
+/**
+ * @brief Convert a touch state to a trace sample
+ * @param multi MultiTouchState to convert
+ * @param timeMs Time of the sample since the trace started
+ * @return TouchTraceSample
+ */
+TouchTraceSample touchStateToTraceSample(const MultiTouchState &multi,
+                                         uint32_t timeMs) {
+  TouchTraceSample sample = {};
+  sample.timeMs = timeMs;
+  sample.count = multi.count;
+  for (uint8_t i = 0; i < multi.count && i < TOUCH_TRACE_POINTS; i++) {
+    sample.x[i] = multi.points[i].x;
+    sample.y[i] = multi.points[i].y;
+  }
+  return sample;
+}
+
+/**
+ * @brief Convert a trace sample back to a touch state
+ * @param sample TouchTraceSample to convert
+ * @return MultiTouchState
+ */
+MultiTouchState traceSampleToTouchState(const TouchTraceSample &sample) {
+  MultiTouchState multi = {};
+  multi.count = sample.count;
+  for (uint8_t i = 0; i < sample.count && i < MAX_TOUCH_POINTS; i++) {
+    multi.points[i].x = sample.x[i];
+    multi.points[i].y = sample.y[i];
+    multi.points[i].pressed = true;
+    multi.points[i].valid = true;
+  }
+  return multi;
+}
+
+/**
+ * @brief Stop recording or replaying a touch trace
+ */
+void stopTouchTrace() {
+  if (touchTraceMode == TRACE_RECORDING) {
+    Serial.printf("[INFO]: Touch trace recorded, %u bytes\n", touchTraceBytes);
+  } else if (touchTraceMode == TRACE_REPLAYING) {
+    Serial.println("[INFO]: Touch trace replay finished");
+  }
+  if (touchTraceMode != TRACE_OFF) {
+    touchTraceFile.close();
+  }
+  touchTraceMode = TRACE_OFF;
+}
+
+/**
+ * @brief Start recording every change of the touch state to TOUCH_TRACE_FILE
+ * @return true if the trace file could be created
+ */
+bool startTouchTraceRecording() {
+  stopTouchTrace();
+
+  touchTraceFile = FILESYSTEM.open(TOUCH_TRACE_FILE, "w");
+  if (!touchTraceFile) {
+    Serial.println("[WARNING]: Failed to create touch trace file");
+    return false;
+  }
+
+  uint8_t header[TOUCH_TRACE_HEADER_SIZE];
+  touchTraceEncodeHeader(header);
+  touchTraceFile.write(header, sizeof(header));
+
+  touchTraceBytes = sizeof(header);
+  touchTraceLast = TouchTraceSample();
+  touchTraceStartMs = millis();
+  touchTraceMode = TRACE_RECORDING;
+  Serial.println("[INFO]: Recording touch trace");
+  return true;
+}
+
+/**
+ * @brief Append a sample to the trace being recorded if the state changed
+ * @param multi The touch state that was just read from the hardware
+ */
+void recordTouchTraceSample(const MultiTouchState &multi) {
+  TouchTraceSample sample =
+      touchStateToTraceSample(multi, millis() - touchTraceStartMs);
+  if (touchTraceSameState(sample, touchTraceLast)) {
+    return;
+  }
+
+  uint8_t buf[TOUCH_TRACE_SAMPLE_SIZE];
+  touchTraceEncodeSample(sample, buf);
+  touchTraceFile.write(buf, sizeof(buf));
+  touchTraceBytes += sizeof(buf);
+  touchTraceLast = sample;
+
+  if (touchTraceBytes + TOUCH_TRACE_SAMPLE_SIZE > TOUCH_TRACE_MAX_BYTES) {
+    Serial.println("[WARNING]: Touch trace is full");
+    stopTouchTrace();
+  }
+}
+
+/**
+ * @brief TouchTraceReader reading the next sample from the trace file
+ */
+bool readTouchTraceSample(void *context, TouchTraceSample &sample) {
+  File *file = (File *)context;
+  uint8_t buf[TOUCH_TRACE_SAMPLE_SIZE];
+  if (file->read(buf, sizeof(buf)) != sizeof(buf)) {
+    return false;
+  }
+  return touchTraceDecodeSample(buf, sample);
+}
+
+/**
+ * @brief Start feeding TOUCH_TRACE_FILE to the touch handling instead of the
+ *        touch screen
+ * @return true if a valid trace was found
+ */
+bool startTouchTraceReplay() {
+  stopTouchTrace();
+
+  touchTraceFile = FILESYSTEM.open(TOUCH_TRACE_FILE, "r");
+  uint8_t header[TOUCH_TRACE_HEADER_SIZE];
+  if (!touchTraceFile ||
+      touchTraceFile.read(header, sizeof(header)) != sizeof(header) ||
+      !touchTraceCheckHeader(header)) {
+    Serial.println("[WARNING]: No valid touch trace to replay");
+    touchTraceFile.close();
+    return false;
+  }
+
+  touchTraceReplayBegin(touchTraceReplay, readTouchTraceSample,
+                        &touchTraceFile);
+  touchTraceStartMs = millis();
+  touchTraceMode = TRACE_REPLAYING;
+  Serial.println("[INFO]: Replaying touch trace");
+  return true;
+}
+
+/**
+ * @brief Get all touch points, from the touch screen or from a trace replay
+ * @return MultiTouchState containing up to MAX_TOUCH_POINTS touches
+ *
+ * @note While recording, every change is written to the trace as well.
+ */
+MultiTouchState getMultiTouchInput() {
+  if (touchTraceMode == TRACE_REPLAYING) {
+    bool more = touchTraceReplayAdvance(touchTraceReplay,
+                                        millis() - touchTraceStartMs,
+                                        readTouchTraceSample, &touchTraceFile);
+    MultiTouchState multi = traceSampleToTouchState(touchTraceReplay.current);
+    if (!more) {
+      // The last sample has been replayed, return to the real touch screen
+      stopTouchTrace();
+    }
+    return multi;
+  }
+
+  MultiTouchState multi = readTouchHardware();
+  if (touchTraceMode == TRACE_RECORDING) {
+    recordTouchTraceSample(multi);
+  }
+  return multi;
+}
+
+/**
+ * @brief Get touch input from either capacitive or resistive touch screen
+ * @return TouchState containing coordinates and press state of the first point
+ */
+TouchState getTouchInput() {
+  MultiTouchState multi = getMultiTouchInput();
+  if (multi.count == 0) {
+    TouchState none = {0, 0, false, false};
+    return none;
+  }
+  return multi.points[0];
 }
 
 /**
@@ -99,105 +438,227 @@ bool handleSimpleButtonTouch(uint16_t buttonX1, uint16_t buttonY1, uint16_t butt
   return isTouchInBounds(touch, buttonX1, buttonY1, buttonX2, buttonY2);
 }
 
+TouchRegionLayout  touchLayout;
+TouchRegionTracker touchRegions;
+
+/**
+ * @brief Build the touch lookup tables for the key grid from the dead zones
+ *        and minimum contact times in generalconfig
+ */
+void buildTouchLayout() {
+  if (!touchRegionBuildKeypad(touchLayout, SCREEN_WIDTH, SCREEN_HEIGHT, KEY_X,
+                              KEY_Y, KEY_W, KEY_H, KEY_SPACING_X,
+                              KEY_SPACING_Y, generalconfig.touchDeadZone,
+                              generalconfig.touchEdgeZone,
+                              generalconfig.touchMinContact)) {
+    Serial.println("[ERROR]: Key grid does not fit the touch layout");
+  }
+  touchRegionReset(touchRegions);
+}
+
 /**
  * @brief Process touch input for button grid and update button states
  * @param resetSleepTimer Callback function to reset sleep timer when touch is detected
- * @return TouchState for further processing if needed
+ * @return TouchState of the first touch point for further processing if needed
+ *
+ * @note Every touch point is checked, so two buttons can be held at once.
+ *       Touches in dead zones, shorter than the minimum contact time of a key
+ *       or sliding in from elsewhere are ignored, see TouchRegions.h.
  */
 TouchState processButtonGridTouch(std::function<void()> resetSleepTimer = nullptr) {
-  TouchState touch = getTouchInput();
-  
-  // Check if the X and Y coordinates of the touch are within any button
+  MultiTouchState multi = getMultiTouchInput();
+  uint32_t touchUs = micros();
+  bool newPress = false;
+
+  uint16_t xs[MAX_TOUCH_POINTS], ys[MAX_TOUCH_POINTS];
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < multi.count; i++) {
+    if (multi.points[i].pressed && multi.points[i].valid) {
+      xs[count] = multi.points[i].x;
+      ys[count] = multi.points[i].y;
+      count++;
+    }
+  }
+
+  uint8_t pressedKeys =
+      touchRegionUpdate(touchRegions, touchLayout, xs, ys, count, millis());
+
   for (uint8_t b = 0; b < 6; b++) {
-    if (touch.pressed && touch.valid && key[b].contains(touch.x, touch.y)) {
-      key[b].press(true); // tell the button it is pressed
-      
-      // Reset sleep timer if callback provided
-      if (resetSleepTimer) {
-        resetSleepTimer();
-      }
-    } else {
-      key[b].press(false); // tell the button it is NOT pressed
+    bool pressed = pressedKeys & (1 << b);
+
+    if (pressed && !key[b].isPressed()) {
+      newPress = true;
+    }
+    key[b].press(pressed); // tell the button whether it is pressed
+
+    // Reset sleep timer if callback provided
+    if (pressed && resetSleepTimer) {
+      resetSleepTimer();
     }
   }
-  
-  return touch;
+
+  // A key that was not pressed before starts a new latency measurement
+  if (newPress) {
+    latencyBegin(inputLatency, touchUs, webServerLoad());
+    deckMetrics.touches++;
+  }
+
+  if (multi.count == 0) {
+    TouchState none = {0, 0, false, false};
+    return none;
+  }
+  return multi.points[0];
+}
+
+#if !defined(USECAPTOUCH)
+
+/**
+ * @brief Load the affine calibration from NVS
+ * @return true if a calibration of the current version was found
+ */
+bool loadTouchCalibration() {
+  StoredTouchCalibration stored;
+  if (savedStates.getBytes(TOUCH_CAL_KEY, &stored, sizeof(stored)) !=
+          sizeof(stored) ||
+      stored.version != TOUCH_CAL_VERSION) {
+    return false;
+  }
+  touchCalibration = stored.cal;
+  return true;
+}
+
+/**
+ * @brief Save the affine calibration to NVS
+ */
+void saveTouchCalibration() {
+  StoredTouchCalibration stored;
+  stored.version = TOUCH_CAL_VERSION;
+  stored.cal = touchCalibration;
+  savedStates.putBytes(TOUCH_CAL_KEY, &stored, sizeof(stored));
+}
+
+/**
+ * @brief Draw or erase a calibration target
+ */
+void drawCalibrationTarget(int16_t x, int16_t y, uint16_t colour) {
+  tft.drawFastHLine(x - 10, y, 21, colour);
+  tft.drawFastVLine(x, y - 10, 21, colour);
+  tft.drawCircle(x, y, 4, colour);
+}
+
+/**
+ * @brief Wait for the target to be touched and average the raw readings
+ * @param rawX Averaged raw X reading
+ * @param rawY Averaged raw Y reading
+ */
+void readCalibrationPoint(uint16_t &rawX, uint16_t &rawY) {
+  uint16_t x, y;
+
+  // Wait for the previous touch to be released
+  while (readRawTouch(x, y)) {
+    delay(10);
+  }
+
+  uint32_t sumX = 0, sumY = 0;
+  uint8_t samples = 0;
+  while (samples < 16) {
+    if (readRawTouch(x, y)) {
+      sumX += x;
+      sumY += y;
+      samples++;
+    }
+    delay(10);
+  }
+
+  rawX = sumX / samples;
+  rawY = sumY / samples;
 }
 
 /**
- * @brief This function presents the user with 4 points to touch and saves
-         that data to a calibration file.
+ * @brief This function presents the user with 5 points to touch, fits an
+         affine calibration to them and stores it in NVS.
 *
 * @param none
 *
 * @return none
 *
-* @note If USECAPTOUCH is defined we do not need to calibrate touch
+* @note The calibration is done once and holds for any screen rotation.
+         Loading it at boot does not touch the FILESYSTEM. If USECAPTOUCH
+         is defined we do not need to calibrate touch.
 */
-
-#if !defined(USECAPTOUCH)
 void touch_calibrate()
 {
-  uint16_t calData[5];
-  uint8_t calDataOK = 0;
-
-  // check if calibration file exists and size is correct
-  if (FILESYSTEM.exists(CALIBRATION_FILE))
+  if (!REPEAT_CAL && loadTouchCalibration())
   {
-    if (REPEAT_CAL)
-    {
-      // Delete if we want to re-calibrate
-      FILESYSTEM.remove(CALIBRATION_FILE);
-    }
-    else
-    {
-      File f = FILESYSTEM.open(CALIBRATION_FILE, "r");
-      if (f)
-      {
-        if (f.readBytes((char *)calData, 14) == 14)
-          calDataOK = 1;
-        f.close();
-      }
-    }
+    // calibration data valid
+    return;
   }
 
-  if (calDataOK && !REPEAT_CAL)
+  // data not valid so recalibrate
+  tft.fillScreen(TFT_BLACK);
+  tft.setCursor(20, 0);
+  tft.setTextFont(2);
+  tft.setTextSize(1);
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+
+  tft.println("Touch the crosses as indicated");
+
+  tft.setTextFont(1);
+  tft.println();
+
+  if (REPEAT_CAL)
   {
-    // calibration data valid
-    tft.setTouch(calData);
+    tft.setTextColor(TFT_RED, TFT_BLACK);
+    tft.println("Set REPEAT_CAL to false to stop this running again!");
   }
-  else
-  {
-    // data not valid so recalibrate
-    tft.fillScreen(TFT_BLACK);
-    tft.setCursor(20, 0);
-    tft.setTextFont(2);
-    tft.setTextSize(1);
-    tft.setTextColor(TFT_WHITE, TFT_BLACK);
 
-    tft.println("Touch corners as indicated");
+  // Four corners and the centre
+  const int16_t inset = 20;
+  const int16_t w = tft.width();
+  const int16_t h = tft.height();
+  const int16_t targetX[TOUCH_CAL_MIN_POINTS] = {inset, (int16_t)(w - 1 - inset),
+                                                 inset, (int16_t)(w - 1 - inset),
+                                                 (int16_t)(w / 2)};
+  const int16_t targetY[TOUCH_CAL_MIN_POINTS] = {inset, inset,
+                                                 (int16_t)(h - 1 - inset),
+                                                 (int16_t)(h - 1 - inset),
+                                                 (int16_t)(h / 2)};
 
-    tft.setTextFont(1);
-    tft.println();
+  uint16_t rawX[TOUCH_CAL_MIN_POINTS], rawY[TOUCH_CAL_MIN_POINTS];
+  int16_t  nativeX[TOUCH_CAL_MIN_POINTS], nativeY[TOUCH_CAL_MIN_POINTS];
 
-    if (REPEAT_CAL)
+  while (true)
+  {
+    for (int i = 0; i < TOUCH_CAL_MIN_POINTS; i++)
     {
-      tft.setTextColor(TFT_RED, TFT_BLACK);
-      tft.println("Set REPEAT_CAL to false to stop this running again!");
-    }
-
-    tft.calibrateTouch(calData, TFT_MAGENTA, TFT_BLACK, 15);
+      drawCalibrationTarget(targetX[i], targetY[i], TFT_MAGENTA);
+      readCalibrationPoint(rawX[i], rawY[i]);
+      drawCalibrationTarget(targetX[i], targetY[i], TFT_BLACK);
 
-    tft.setTextColor(TFT_GREEN, TFT_BLACK);
-    tft.println("Calibration complete!");
+      int32_t nx, ny;
+      rotatedToNative(targetX[i], targetY[i], tft.getRotation(), TFT_WIDTH,
+                      TFT_HEIGHT, nx, ny);
+      nativeX[i] = nx;
+      nativeY[i] = ny;
+    }
 
-    // store data
-    File f = FILESYSTEM.open(CALIBRATION_FILE, "w");
-    if (f)
+    if (solveAffineCalibration(rawX, rawY, nativeX, nativeY,
+                               TOUCH_CAL_MIN_POINTS, touchCalibration) &&
+        affineCalibrationError(touchCalibration, rawX, rawY, nativeX, nativeY,
+                               TOUCH_CAL_MIN_POINTS) <= TOUCH_CAL_MAX_ERROR)
     {
-      f.write((const unsigned char *)calData, 14);
-      f.close();
+      break;
     }
+
+    tft.setTextColor(TFT_RED, TFT_BLACK);
+    tft.println("Calibration inaccurate, try again.");
+    Serial.println("[WARNING]: Touch calibration inaccurate, repeating");
   }
+
+  tft.setTextColor(TFT_GREEN, TFT_BLACK);
+  tft.println("Calibration complete!");
+
+  // store data
+  saveTouchCalibration();
 }
 #endif //!defined(USECAPTOUCH)
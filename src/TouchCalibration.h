@@ -0,0 +1,239 @@
+#ifndef TOUCH_CALIBRATION_H
+#define TOUCH_CALIBRATION_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Least-squares affine model mapping raw resistive touch readings to pixels
+// of the panel in its native orientation (rotation 0):
+//
+//   nativeX = a * rawX + b * rawY + c
+//   nativeY = d * rawX + e * rawY + f
+//
+// Because the model is rotation independent, it stays valid when the screen
+// rotation changes. Touches are rotated to the current orientation after the
+// model is applied.
+struct AffineCalibration {
+  float a, b, c;
+  float d, e, f;
+};
+
+// At least this many points are needed, 3 would fit exactly without averaging
+// out any noise.
+#define TOUCH_CAL_MIN_POINTS 5
+
+/**
+ * @brief Solve a 3x3 linear system with Gaussian elimination
+ *
+ * @param m Matrix, row major. Destroyed.
+ * @param v Right hand side, replaced by the solution
+ *
+ * @return false if the system is singular
+ */
+bool solve3x3(double m[3][3], double v[3]) {
+  for (int col = 0; col < 3; col++) {
+    // Partial pivoting
+    int pivot = col;
+    for (int row = col + 1; row < 3; row++) {
+      if (fabs(m[row][col]) > fabs(m[pivot][col])) {
+        pivot = row;
+      }
+    }
+    if (fabs(m[pivot][col]) < 1e-9) {
+      return false;
+    }
+    if (pivot != col) {
+      for (int k = 0; k < 3; k++) {
+        double tmp = m[col][k];
+        m[col][k] = m[pivot][k];
+        m[pivot][k] = tmp;
+      }
+      double tmp = v[col];
+      v[col] = v[pivot];
+      v[pivot] = tmp;
+    }
+
+    for (int row = col + 1; row < 3; row++) {
+      double factor = m[row][col] / m[col][col];
+      for (int k = col; k < 3; k++) {
+        m[row][k] -= factor * m[col][k];
+      }
+      v[row] -= factor * v[col];
+    }
+  }
+
+  for (int row = 2; row >= 0; row--) {
+    for (int k = row + 1; k < 3; k++) {
+      v[row] -= m[row][k] * v[k];
+    }
+    v[row] /= m[row][row];
+  }
+  return true;
+}
+
+/**
+ * @brief Fit an affine calibration to a set of touched points
+ *
+ * @param rawX Raw X readings for each point
+ * @param rawY Raw Y readings for each point
+ * @param nativeX Expected X in native panel pixels for each point
+ * @param nativeY Expected Y in native panel pixels for each point
+ * @param count Number of points, at least TOUCH_CAL_MIN_POINTS
+ * @param cal AffineCalibration to fill
+ *
+ * @return false if there are too few points or they are (nearly) collinear
+ *
+ * @note Raw readings are centred on their mean before solving the normal
+ *       equations to keep them well conditioned.
+ */
+bool solveAffineCalibration(const uint16_t *rawX, const uint16_t *rawY,
+                            const int16_t *nativeX, const int16_t *nativeY,
+                            int count, AffineCalibration &cal) {
+  if (count < TOUCH_CAL_MIN_POINTS) {
+    return false;
+  }
+
+  double meanX = 0, meanY = 0;
+  for (int i = 0; i < count; i++) {
+    meanX += rawX[i];
+    meanY += rawY[i];
+  }
+  meanX /= count;
+  meanY /= count;
+
+  double m[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+  double vx[3] = {0, 0, 0};
+  double vy[3] = {0, 0, 0};
+
+  for (int i = 0; i < count; i++) {
+    double p[3] = {rawX[i] - meanX, rawY[i] - meanY, 1.0};
+    for (int r = 0; r < 3; r++) {
+      for (int k = 0; k < 3; k++) {
+        m[r][k] += p[r] * p[k];
+      }
+      vx[r] += p[r] * nativeX[i];
+      vy[r] += p[r] * nativeY[i];
+    }
+  }
+
+  double mCopy[3][3];
+  for (int r = 0; r < 3; r++) {
+    for (int k = 0; k < 3; k++) {
+      mCopy[r][k] = m[r][k];
+    }
+  }
+
+  if (!solve3x3(m, vx) || !solve3x3(mCopy, vy)) {
+    return false;
+  }
+
+  // Undo the centring: n = a * (x - meanX) + b * (y - meanY) + c
+  cal.a = vx[0];
+  cal.b = vx[1];
+  cal.c = vx[2] - vx[0] * meanX - vx[1] * meanY;
+  cal.d = vy[0];
+  cal.e = vy[1];
+  cal.f = vy[2] - vy[0] * meanX - vy[1] * meanY;
+  return true;
+}
+
+/**
+ * @brief Map a raw touch reading to native panel pixels
+ *
+ * @param cal AffineCalibration to apply
+ * @param rawX Raw X reading
+ * @param rawY Raw Y reading
+ * @param nativeX Resulting X, may be outside the panel
+ * @param nativeY Resulting Y, may be outside the panel
+ */
+void applyAffineCalibration(const AffineCalibration &cal, uint16_t rawX,
+                            uint16_t rawY, float &nativeX, float &nativeY) {
+  nativeX = cal.a * rawX + cal.b * rawY + cal.c;
+  nativeY = cal.d * rawX + cal.e * rawY + cal.f;
+}
+
+/**
+ * @brief Get the largest distance between calibrated and expected points
+ *
+ * @return float error in pixels, used to reject a sloppy calibration
+ */
+float affineCalibrationError(const AffineCalibration &cal,
+                             const uint16_t *rawX, const uint16_t *rawY,
+                             const int16_t *nativeX, const int16_t *nativeY,
+                             int count) {
+  float worst = 0;
+  for (int i = 0; i < count; i++) {
+    float x, y;
+    applyAffineCalibration(cal, rawX[i], rawY[i], x, y);
+    float dist = sqrtf((x - nativeX[i]) * (x - nativeX[i]) +
+                       (y - nativeY[i]) * (y - nativeY[i]));
+    if (dist > worst) {
+      worst = dist;
+    }
+  }
+  return worst;
+}
+
+/**
+ * @brief Convert native panel coordinates to coordinates at a rotation
+ *
+ * @param nativeX X at rotation 0
+ * @param nativeY Y at rotation 0
+ * @param rotation Screen rotation (0-3), each step is 90 degrees clockwise
+ * @param nativeWidth Panel width at rotation 0
+ * @param nativeHeight Panel height at rotation 0
+ * @param x Resulting X
+ * @param y Resulting Y
+ */
+void nativeToRotated(int32_t nativeX, int32_t nativeY, uint8_t rotation,
+                     int32_t nativeWidth, int32_t nativeHeight, int32_t &x,
+                     int32_t &y) {
+  switch (rotation & 3) {
+  case 0:
+    x = nativeX;
+    y = nativeY;
+    break;
+  case 1:
+    x = nativeY;
+    y = nativeWidth - 1 - nativeX;
+    break;
+  case 2:
+    x = nativeWidth - 1 - nativeX;
+    y = nativeHeight - 1 - nativeY;
+    break;
+  default:
+    x = nativeHeight - 1 - nativeY;
+    y = nativeX;
+    break;
+  }
+}
+
+/**
+ * @brief Convert coordinates at a rotation back to native panel coordinates
+ *
+ * @note Inverse of nativeToRotated()
+ */
+void rotatedToNative(int32_t x, int32_t y, uint8_t rotation,
+                     int32_t nativeWidth, int32_t nativeHeight,
+                     int32_t &nativeX, int32_t &nativeY) {
+  switch (rotation & 3) {
+  case 0:
+    nativeX = x;
+    nativeY = y;
+    break;
+  case 1:
+    nativeX = nativeWidth - 1 - y;
+    nativeY = x;
+    break;
+  case 2:
+    nativeX = nativeWidth - 1 - x;
+    nativeY = nativeHeight - 1 - y;
+    break;
+  default:
+    nativeX = y;
+    nativeY = nativeHeight - 1 - x;
+    break;
+  }
+}
+
+#endif // TOUCH_CALIBRATION_H
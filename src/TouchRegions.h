@@ -0,0 +1,235 @@
+#ifndef TOUCH_REGIONS_H
+#define TOUCH_REGIONS_H
+
+#include <stdint.h>
+
+// Touches are matched to keys through two lookup tables, one per axis, that
+// hold the column (or row) for every pixel. Pixels in the gaps between keys,
+// in the dead zone along the border of every key and in the dead zone along
+// the screen edges map to TOUCH_REGION_NONE. Finding the key for a touch is
+// two table reads, all decisions are made when the layout is built.
+#define TOUCH_REGION_NONE 0xFF
+
+// Largest screen side the tables can hold (ILI9488 is 480 pixels wide)
+#define TOUCH_LAYOUT_MAX_SIZE 480
+
+// Largest number of keys in the grid
+#define TOUCH_REGION_MAX_KEYS 8
+
+struct TouchRegionLayout {
+  uint8_t  colAt[TOUCH_LAYOUT_MAX_SIZE];
+  uint8_t  rowAt[TOUCH_LAYOUT_MAX_SIZE];
+  uint16_t width;
+  uint16_t height;
+  uint8_t  cols;
+  uint8_t  keys;
+  uint8_t  minContactMs[TOUCH_REGION_MAX_KEYS];
+};
+
+enum TouchRegionState {
+  REGION_IDLE = 0, // Not touched
+  REGION_PENDING,  // Touched, minimum contact time not reached yet
+  REGION_ACCEPTED, // Pressed
+  REGION_REJECTED  // Contact slid in from elsewhere, ignored until released
+};
+
+struct TouchRegionTracker {
+  uint8_t  state[TOUCH_REGION_MAX_KEYS];
+  uint32_t contactStartMs[TOUCH_REGION_MAX_KEYS];
+  uint8_t  lastCount; // Number of touch points in the previous sample
+};
+
+/**
+ * @brief Fill the lookup table of one axis
+ *
+ * @param table Table to fill
+ * @param size Screen size along this axis
+ * @param first Left (or top) edge of the first key
+ * @param keySize Key width (or height)
+ * @param pitch Distance between the left (or top) edges of two keys
+ * @param count Number of keys along this axis
+ * @param deadZone Pixels along both sides of a key that are not accepted
+ * @param edgeZone Pixels along both screen edges that are not accepted
+ */
+void touchRegionFillAxis(uint8_t *table, uint16_t size, int16_t first,
+                         int16_t keySize, int16_t pitch, uint8_t count,
+                         uint8_t deadZone, uint8_t edgeZone) {
+  for (uint16_t p = 0; p < size; p++) {
+    table[p] = TOUCH_REGION_NONE;
+  }
+  for (uint8_t k = 0; k < count; k++) {
+    int32_t from = first + k * pitch + deadZone;
+    int32_t to = first + k * pitch + keySize - deadZone; // Exclusive
+    if (from < edgeZone) {
+      from = edgeZone;
+    }
+    if (to > size - edgeZone) {
+      to = size - edgeZone;
+    }
+    for (int32_t p = from; p < to; p++) {
+      table[p] = k;
+    }
+  }
+}
+
+/**
+ * @brief Build the lookup tables for a grid of keys
+ *
+ * @param layout TouchRegionLayout to build
+ * @param width Screen width, at most TOUCH_LAYOUT_MAX_SIZE
+ * @param height Screen height, at most TOUCH_LAYOUT_MAX_SIZE
+ * @param x1 Left edge of the first key
+ * @param y1 Top edge of the first key
+ * @param keyW Key width
+ * @param keyH Key height
+ * @param pitchX Horizontal distance between two keys
+ * @param pitchY Vertical distance between two keys
+ * @param cols Number of columns
+ * @param rows Number of rows, cols * rows at most TOUCH_REGION_MAX_KEYS
+ * @param deadZone Pixels along the border of every key that are not accepted
+ * @param edgeZone Pixels along the screen edges that are not accepted
+ * @param minContactMs Minimum contact time per key, may be nullptr for none
+ *
+ * @return false if the grid does not fit the tables
+ */
+bool touchRegionBuild(TouchRegionLayout &layout, uint16_t width,
+                      uint16_t height, int16_t x1, int16_t y1, int16_t keyW,
+                      int16_t keyH, int16_t pitchX, int16_t pitchY,
+                      uint8_t cols, uint8_t rows, uint8_t deadZone,
+                      uint8_t edgeZone, const uint8_t *minContactMs) {
+  if (width > TOUCH_LAYOUT_MAX_SIZE || height > TOUCH_LAYOUT_MAX_SIZE ||
+      cols * rows > TOUCH_REGION_MAX_KEYS) {
+    return false;
+  }
+
+  layout.width = width;
+  layout.height = height;
+  layout.cols = cols;
+  layout.keys = cols * rows;
+  touchRegionFillAxis(layout.colAt, width, x1, keyW, pitchX, cols, deadZone,
+                      edgeZone);
+  touchRegionFillAxis(layout.rowAt, height, y1, keyH, pitchY, rows, deadZone,
+                      edgeZone);
+  for (uint8_t k = 0; k < TOUCH_REGION_MAX_KEYS; k++) {
+    layout.minContactMs[k] =
+        (minContactMs && k < layout.keys) ? minContactMs[k] : 0;
+  }
+  return true;
+}
+
+/**
+ * @brief Build the lookup tables for the keypad, a grid of 3 columns and 2
+ *        rows described like the KEY_* defines of main.cpp
+ *
+ * @param layout TouchRegionLayout to build
+ * @param width Screen width
+ * @param height Screen height
+ * @param keyX Centre of the first key, KEY_X
+ * @param keyY Centre of the first key, KEY_Y
+ * @param keyW Key width, KEY_W
+ * @param keyH Key height, KEY_H
+ * @param spacingX Gap between two keys, KEY_SPACING_X
+ * @param spacingY Gap between two keys, KEY_SPACING_Y
+ * @param deadZone Pixels along the border of every key that are not accepted
+ * @param edgeZone Pixels along the screen edges that are not accepted
+ * @param minContactMs Minimum contact time per key, may be nullptr for none
+ *
+ * @return false if the grid does not fit the tables
+ */
+bool touchRegionBuildKeypad(TouchRegionLayout &layout, uint16_t width,
+                            uint16_t height, int16_t keyX, int16_t keyY,
+                            int16_t keyW, int16_t keyH, int16_t spacingX,
+                            int16_t spacingY, uint8_t deadZone,
+                            uint8_t edgeZone, const uint8_t *minContactMs) {
+  return touchRegionBuild(layout, width, height, keyX - keyW / 2,
+                          keyY - keyH / 2, keyW, keyH, keyW + spacingX,
+                          keyH + spacingY, 3, 2, deadZone, edgeZone,
+                          minContactMs);
+}
+
+/**
+ * @brief Get the key at a screen position
+ *
+ * @return uint8_t key index, or TOUCH_REGION_NONE for a dead zone
+ */
+uint8_t touchRegionAt(const TouchRegionLayout &layout, uint16_t x,
+                      uint16_t y) {
+  if (x >= layout.width || y >= layout.height) {
+    return TOUCH_REGION_NONE;
+  }
+  uint8_t col = layout.colAt[x];
+  uint8_t row = layout.rowAt[y];
+  if (col == TOUCH_REGION_NONE || row == TOUCH_REGION_NONE) {
+    return TOUCH_REGION_NONE;
+  }
+  return row * layout.cols + col;
+}
+
+/**
+ * @brief Reset a tracker to no keys touched
+ */
+void touchRegionReset(TouchRegionTracker &tracker) {
+  for (uint8_t k = 0; k < TOUCH_REGION_MAX_KEYS; k++) {
+    tracker.state[k] = REGION_IDLE;
+    tracker.contactStartMs[k] = 0;
+  }
+  tracker.lastCount = 0;
+}
+
+/**
+ * @brief Feed a touch sample to the tracker
+ *
+ * @param tracker TouchRegionTracker
+ * @param layout TouchRegionLayout of the current page
+ * @param x X of every touch point
+ * @param y Y of every touch point
+ * @param count Number of touch points
+ * @param nowMs Current time in milliseconds
+ *
+ * @return uint8_t bit mask of the keys that are pressed
+ *
+ * @note A key is pressed once it has been touched for its minimum contact
+ *       time. A contact that enters a key without a new touch point landing
+ *       (a finger or palm sliding over from another key, a gap or the screen
+ *       edge) spans several cells and is rejected until that key is released.
+ */
+uint8_t touchRegionUpdate(TouchRegionTracker &tracker,
+                          const TouchRegionLayout &layout, const uint16_t *x,
+                          const uint16_t *y, uint8_t count, uint32_t nowMs) {
+  uint8_t touched = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t region = touchRegionAt(layout, x[i], y[i]);
+    if (region != TOUCH_REGION_NONE) {
+      touched |= 1 << region;
+    }
+  }
+
+  // Contact that was already there moved, no new point landed
+  bool moved = tracker.lastCount > 0 && count <= tracker.lastCount;
+  tracker.lastCount = count;
+
+  uint8_t pressed = 0;
+  for (uint8_t k = 0; k < layout.keys; k++) {
+    if (!(touched & (1 << k))) {
+      tracker.state[k] = REGION_IDLE;
+      continue;
+    }
+
+    if (tracker.state[k] == REGION_IDLE) {
+      tracker.state[k] = moved ? REGION_REJECTED : REGION_PENDING;
+      tracker.contactStartMs[k] = nowMs;
+    }
+
+    if (tracker.state[k] == REGION_PENDING &&
+        nowMs - tracker.contactStartMs[k] >= layout.minContactMs[k]) {
+      tracker.state[k] = REGION_ACCEPTED;
+    }
+
+    if (tracker.state[k] == REGION_ACCEPTED) {
+      pressed |= 1 << k;
+    }
+  }
+  return pressed;
+}
+
+#endif // TOUCH_REGIONS_H
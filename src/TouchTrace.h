@@ -0,0 +1,167 @@
+#ifndef TOUCH_TRACE_H
+#define TOUCH_TRACE_H
+
+#include <stdint.h>
+
+// A touch trace file is an 8 byte header followed by 16 byte samples. A sample
+// is only written when the touch state changes, the state in between samples
+// is the one of the last sample. All values are little-endian.
+//
+// Header: "FTTT" magic, version (1 byte), 3 reserved bytes
+// Sample: time in ms since recording started (4 bytes), number of points
+//         (1 byte), reserved (1 byte), x0, y0, x1, y1 (2 bytes each),
+//         reserved (2 bytes)
+#define TOUCH_TRACE_VERSION 1
+#define TOUCH_TRACE_HEADER_SIZE 8
+#define TOUCH_TRACE_SAMPLE_SIZE 16
+#define TOUCH_TRACE_POINTS 2
+
+struct TouchTraceSample {
+  uint32_t timeMs;
+  uint8_t  count;
+  uint16_t x[TOUCH_TRACE_POINTS];
+  uint16_t y[TOUCH_TRACE_POINTS];
+};
+
+// Replay cursor. 'current' is the touch state at the last advanced time,
+// 'next' is the sample that becomes current once its time is reached.
+struct TouchTraceReplay {
+  TouchTraceSample current;
+  TouchTraceSample next;
+  bool             hasNext;
+};
+
+// Reads the next sample of a trace, returns false at the end of the trace
+typedef bool (*TouchTraceReader)(void *context, TouchTraceSample &sample);
+
+/**
+ * @brief Write a trace file header
+ *
+ * @param buf Buffer of TOUCH_TRACE_HEADER_SIZE bytes
+ */
+void touchTraceEncodeHeader(uint8_t *buf) {
+  buf[0] = 'F';
+  buf[1] = 'T';
+  buf[2] = 'T';
+  buf[3] = 'T';
+  buf[4] = TOUCH_TRACE_VERSION;
+  buf[5] = 0;
+  buf[6] = 0;
+  buf[7] = 0;
+}
+
+/**
+ * @brief Check a trace file header
+ *
+ * @param buf Buffer of TOUCH_TRACE_HEADER_SIZE bytes
+ *
+ * @return true if this is a trace this firmware can replay
+ */
+bool touchTraceCheckHeader(const uint8_t *buf) {
+  return buf[0] == 'F' && buf[1] == 'T' && buf[2] == 'T' && buf[3] == 'T' &&
+         buf[4] == TOUCH_TRACE_VERSION;
+}
+
+void touchTraceWrite16(uint8_t *buf, uint16_t value) {
+  buf[0] = value & 0xFF;
+  buf[1] = value >> 8;
+}
+
+uint16_t touchTraceRead16(const uint8_t *buf) {
+  return buf[0] | (buf[1] << 8);
+}
+
+/**
+ * @brief Serialize a sample
+ *
+ * @param sample TouchTraceSample to write
+ * @param buf Buffer of TOUCH_TRACE_SAMPLE_SIZE bytes
+ */
+void touchTraceEncodeSample(const TouchTraceSample &sample, uint8_t *buf) {
+  buf[0] = sample.timeMs & 0xFF;
+  buf[1] = (sample.timeMs >> 8) & 0xFF;
+  buf[2] = (sample.timeMs >> 16) & 0xFF;
+  buf[3] = (sample.timeMs >> 24) & 0xFF;
+  buf[4] = sample.count;
+  buf[5] = 0;
+  for (int i = 0; i < TOUCH_TRACE_POINTS; i++) {
+    touchTraceWrite16(&buf[6 + i * 4], sample.x[i]);
+    touchTraceWrite16(&buf[8 + i * 4], sample.y[i]);
+  }
+  buf[14] = 0;
+  buf[15] = 0;
+}
+
+/**
+ * @brief Deserialize a sample
+ *
+ * @param buf Buffer of TOUCH_TRACE_SAMPLE_SIZE bytes
+ * @param sample TouchTraceSample to fill
+ *
+ * @return false if the sample is corrupt (more points than supported)
+ */
+bool touchTraceDecodeSample(const uint8_t *buf, TouchTraceSample &sample) {
+  sample.timeMs = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+                  ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+  sample.count = buf[4];
+  for (int i = 0; i < TOUCH_TRACE_POINTS; i++) {
+    sample.x[i] = touchTraceRead16(&buf[6 + i * 4]);
+    sample.y[i] = touchTraceRead16(&buf[8 + i * 4]);
+  }
+  return sample.count <= TOUCH_TRACE_POINTS;
+}
+
+/**
+ * @brief Compare the touch state of two samples, ignoring their time
+ *
+ * @return true if both samples hold the same points
+ */
+bool touchTraceSameState(const TouchTraceSample &a, const TouchTraceSample &b) {
+  if (a.count != b.count) {
+    return false;
+  }
+  for (int i = 0; i < a.count && i < TOUCH_TRACE_POINTS; i++) {
+    if (a.x[i] != b.x[i] || a.y[i] != b.y[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Start replaying a trace. The touch state is released until the first
+ *        sample is due.
+ *
+ * @param replay TouchTraceReplay cursor to initialise
+ * @param reader Function reading the next sample
+ * @param context Passed to reader
+ */
+void touchTraceReplayBegin(TouchTraceReplay &replay, TouchTraceReader reader,
+                           void *context) {
+  replay.current = TouchTraceSample();
+  replay.hasNext = reader(context, replay.next);
+}
+
+/**
+ * @brief Advance a replay to the given time
+ *
+ * @param replay TouchTraceReplay cursor
+ * @param elapsedMs Time since the replay started
+ * @param reader Function reading the next sample
+ * @param context Passed to reader
+ *
+ * @return true while there are samples left to replay
+ *
+ * @note Samples that fall between two calls are skipped, exactly like touches
+ *       that are shorter than a loop() iteration are missed on the device.
+ */
+bool touchTraceReplayAdvance(TouchTraceReplay &replay, uint32_t elapsedMs,
+                             TouchTraceReader reader, void *context) {
+  while (replay.hasNext && replay.next.timeMs <= elapsedMs) {
+    replay.current = replay.next;
+    replay.hasNext = reader(context, replay.next);
+  }
+  return replay.hasNext;
+}
+
+#endif // TOUCH_TRACE_H
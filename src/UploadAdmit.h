@@ -0,0 +1,166 @@
+#ifndef UPLOAD_ADMIT_H
+#define UPLOAD_ADMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A logo upload is admitted or rejected as a whole when the first part of its
+// body arrives, before anything is written to the filesystem. The
+// Content-Length of the request is the sum of all its parts plus their
+// multipart headers, so it bounds what a batch of files can write however
+// many files it holds.
+#define UPLOAD_FREE_RESERVE 100000  // Always left free on the filesystem
+#define UPLOAD_REQUEST_QUOTA 262144 // Most one request may write
+#define UPLOAD_TEXT_SIZE 160
+
+enum UploadVerdict {
+  UPLOAD_ADMITTED = 0,
+  UPLOAD_NO_LENGTH,    // No Content-Length, the size is not known up front
+  UPLOAD_OVER_QUOTA,   // Larger than UPLOAD_REQUEST_QUOTA
+  UPLOAD_NO_SPACE,     // Would leave less than UPLOAD_FREE_RESERVE free
+  UPLOAD_WRITE_FAILED, // Admitted, but a file could not be written
+  UPLOAD_BAD_IMAGE,    // A .bmp that could not be converted, see IconTranscode.h
+  UPLOAD_NO_MEMORY     // The state of the request could not be allocated
+};
+
+// Kept in the request while its body arrives
+struct UploadBudget {
+  uint32_t length;    // Content-Length of the request
+  uint32_t cost;      // Filesystem space the request may take
+  uint32_t available; // Space that was free above the reserve
+  uint32_t written;   // Bytes written so far
+  uint8_t  files;     // Files started so far
+  uint8_t  verdict;   // UploadVerdict
+};
+
+/**
+ * @brief Estimate the filesystem space a number of bytes takes
+ *
+ * @param bytes Bytes of file content
+ *
+ * @return uint32_t bytes including the page headers and object index of SPIFFS
+ *
+ * @note SPIFFS keeps a few bytes of header in every 256 byte page and an index
+ *       page per file, 1/16 covers both for files the size of a logo.
+ */
+uint32_t uploadFlashCost(uint32_t bytes) { return bytes + bytes / 16; }
+
+/**
+ * @brief Decide on an upload before any of it is written
+ *
+ * @param budget UploadBudget, set up for the request
+ * @param contentLength Content-Length of the request, 0 when not sent
+ * @param freeBytes Free space of the filesystem
+ * @param quota Most one request may write
+ *
+ * @return UploadVerdict UPLOAD_ADMITTED when the files may be written
+ */
+UploadVerdict uploadAdmit(UploadBudget &budget, size_t contentLength,
+                          size_t freeBytes, size_t quota) {
+  budget.length = contentLength;
+  budget.cost = uploadFlashCost(contentLength);
+  budget.available =
+      freeBytes > UPLOAD_FREE_RESERVE ? freeBytes - UPLOAD_FREE_RESERVE : 0;
+  budget.written = 0;
+  budget.files = 0;
+  if (contentLength == 0) {
+    budget.verdict = UPLOAD_NO_LENGTH;
+  } else if (contentLength > quota) {
+    budget.verdict = UPLOAD_OVER_QUOTA;
+  } else if (budget.cost > budget.available) {
+    budget.verdict = UPLOAD_NO_SPACE;
+  } else {
+    budget.verdict = UPLOAD_ADMITTED;
+  }
+  return (UploadVerdict)budget.verdict;
+}
+
+/**
+ * @brief Get the HTTP status of a verdict
+ */
+int uploadVerdictStatus(uint8_t verdict) {
+  switch (verdict) {
+  case UPLOAD_ADMITTED:
+    return 200;
+  case UPLOAD_NO_LENGTH:
+    return 411;
+  case UPLOAD_OVER_QUOTA:
+    return 413;
+  case UPLOAD_NO_SPACE:
+    return 507;
+  case UPLOAD_BAD_IMAGE:
+    return 415;
+  default:
+    return 500;
+  }
+}
+
+/**
+ * @brief Get the error code shown on the error page for a verdict
+ */
+const char *uploadVerdictCode(uint8_t verdict) {
+  switch (verdict) {
+  case UPLOAD_NO_SPACE:
+    return "103";
+  case UPLOAD_OVER_QUOTA:
+    return "105";
+  case UPLOAD_NO_LENGTH:
+    return "106";
+  case UPLOAD_BAD_IMAGE:
+    return "108";
+  case UPLOAD_NO_MEMORY:
+    return "109";
+  default:
+    return "107";
+  }
+}
+
+/**
+ * @brief Explain a rejected upload
+ *
+ * @param budget UploadBudget of the request
+ * @param buf Buffer for the text
+ * @param size Size of buf
+ */
+void uploadVerdictText(const UploadBudget &budget, char *buf, size_t size) {
+  switch (budget.verdict) {
+  case UPLOAD_NO_LENGTH:
+    snprintf(buf, size, "The upload did not tell its size. Please try again "
+                        "from the configurator.");
+    break;
+  case UPLOAD_OVER_QUOTA:
+    snprintf(buf, size,
+             "The upload is %lu kB, at most %lu kB can be uploaded at once. "
+             "Please upload fewer logos at a time.",
+             (unsigned long)(budget.length / 1024),
+             (unsigned long)(UPLOAD_REQUEST_QUOTA / 1024));
+    break;
+  case UPLOAD_NO_SPACE:
+    snprintf(buf, size,
+             "There is not enough free space left to upload these logos, they "
+             "need %lu kB and %lu kB is left. Please delete unused logos and "
+             "try again.",
+             (unsigned long)(budget.cost / 1024),
+             (unsigned long)(budget.available / 1024));
+    break;
+  case UPLOAD_BAD_IMAGE:
+    snprintf(buf, size,
+             "A logo is not a bitmap that can be read. Logos must be "
+             "uncompressed BMP files with 1, 4, 8, 16, 24 or 32 bits per "
+             "pixel.");
+    break;
+  case UPLOAD_NO_MEMORY:
+    snprintf(buf, size,
+             "There was not enough memory to receive the upload, nothing was "
+             "stored. Please try again, or restart FreeTouchDeck first.");
+    break;
+  default:
+    snprintf(buf, size,
+             "A logo could not be written, it was removed. Logo names can be "
+             "at most 24 characters long. Please try again.");
+    break;
+  }
+}
+
+#endif // UPLOAD_ADMIT_H
@@ -1,179 +1,240 @@
+// A directory listed into a chunked response, see JsonChunk.h
+struct FileListWalk {
+  File        root;
+  int         count;
+  bool        apis; // Only the API files of /uploads, not their configs
+  JsonChunker chunker;
+};
+
 /**
-* @brief This function returns all the files in a given directory in a json
-         formatted string.
+* @brief Writes the next file of a directory as {"n":"name"}, a JsonChunkNext
+*/
+bool nextFileListEntry(void *context, char *entry, size_t size) {
+  FileListWalk *walk = (FileListWalk *)context;
+  if (!walk->root || !walk->root.isDirectory()) {
+    return false;
+  }
+  while (File file = walk->root.openNextFile()) {
+    // Older cores give the full path, newer ones the name
+    const char *name = strrchr(file.name(), '/');
+    name = name ? name + 1 : file.name();
+    char number[12];
+    snprintf(number, sizeof(number), "%d", walk->count++);
+    if (walk->apis && strncmp(name, "config_", 7) == 0) {
+      continue;
+    }
+    jsonChunkPair(entry, size, number, name);
+    return true;
+  }
+  return false;
+}
+
+/**
+* @brief This function sends all the files in a given directory as a json
+         array, one file at a time.
 *
-* @param path String
+* @param *request AsyncWebServerRequest
+* @param dir Directory to list
+* @param apis Leave out the config files of the APIs in /uploads
 *
-* @return String
+* @return none
 *
-* @note none
+* @note The reply is chunked, it takes the memory of one file name however
+        many files there are.
 */
-String handleFileList(String path) {
-
-  File root = FILESYSTEM.open(path);
-  path = String();
-  int filecount = 0;
-
-  String output = "[";
-  if (root.isDirectory()) {
-    File file = root.openNextFile();
-    while (file) {
-      if (output != "[") {
-        output += ',';
-      }
+void sendFileList(AsyncWebServerRequest *request, const char *dir, bool apis) {
+  std::shared_ptr<FileListWalk> walk = std::make_shared<FileListWalk>();
+  walk->root = FILESYSTEM.open(dir);
+  walk->count = 0;
+  walk->apis = apis;
+  jsonChunkBegin(walk->chunker, nextFileListEntry, walk.get());
+  request->send(request->beginChunkedResponse(
+      "application/json", [walk](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        return jsonChunkFill(walk->chunker, buf, maxLen);
+      }));
+}
 
-      output += "{\"";
-      output += filecount;
-      output += "\":\"";
+// Where /info is in its list of entries
+struct InfoWalk {
+  uint8_t     step;
+  JsonChunker chunker;
+};
 
-#ifdef ESP_ARDUINO_VERSION_MAJOR
-      output += String(file.name());
+/**
+* @brief Writes the next entry of /info, a JsonChunkNext
+*/
+bool nextInfoEntry(void *context, char *entry, size_t size) {
+  InfoWalk *walk = (InfoWalk *)context;
+  char value[160];
+  const char *key = NULL;
+  while (!key) {
+    uint8_t step = walk->step++;
+    switch (step) {
+    case 0:
+      key = "Version";
+      snprintf(value, sizeof(value), "%s", versionnumber);
+      break;
+    case 1:
+      key = "Free Space";
+      snprintf(value, sizeof(value), "%.2f kB",
+               (FILESYSTEM.totalBytes() - FILESYSTEM.usedBytes()) / 1000.0);
+      break;
+    case 2:
+#if defined(USEUSBHID)
+      key = "Keyboard Type";
+      snprintf(value, sizeof(value), "Using USB");
 #else
-      output += String(file.name()).substring(7);
+      key = "BLE Keyboard Version";
+      snprintf(value, sizeof(value), "%s", BLE_KEYBOARD_VERSION);
+#endif // if defined(USEUSBHID)
+      break;
+    case 3:
+      key = "ArduinoJson Version";
+      snprintf(value, sizeof(value), "%s", ARDUINOJSON_VERSION);
+      break;
+    case 4:
+      key = "TFT_eSPI Version";
+      snprintf(value, sizeof(value), "%s", TFT_ESPI_VERSION);
+      break;
+    case 5:
+      key = "ESP-IDF";
+      snprintf(value, sizeof(value), "%s", esp_get_idf_version());
+      break;
+    case 6:
+      key = "WiFi Mode";
+      snprintf(value, sizeof(value), "%s", wificonfig.wifimode);
+      break;
+    case 7:
+      key = "Sleep";
+#ifdef touchInterruptPin
+      if (generalconfig.sleepenable) {
+        snprintf(value, sizeof(value), "Enabled. Timer: %u minutes",
+                 generalconfig.sleeptimer);
+        break;
+      }
 #endif
-
-      output += "\"}";
-      file = root.openNextFile();
-      filecount++;
+      snprintf(value, sizeof(value), "Disabled");
+      break;
+    case 8:
+    case 9:
+    {
+      // Waking from deep sleep is reported apart from a cold boot
+      const BootReport *report = bootReportLatest(bootReports, step == 9);
+      if (report) {
+        key = step == 9 ? "Wake To Ready" : "Cold Boot To Ready";
+        snprintf(value, sizeof(value), "%u ms", report->readyMs);
+      }
+      break;
+    }
+    default:
+    {
+      // Every stored boot with the time every stage took
+      int i = step - 10;
+      if (i >= bootReports.count) {
+        return false;
+      }
+      const BootReport &report = bootReports.reports[i];
+      char name[32];
+      snprintf(name, sizeof(name), "Boot %lu %s", (unsigned long)report.number,
+               report.wake ? "(wake)" : "(cold)");
+      int len = snprintf(value, sizeof(value), "keypad %u ms, ready %u ms",
+                         report.keypadMs, report.readyMs);
+      for (int s = 0; s < report.stageCount && s < BOOT_STAGE_COUNT &&
+                      len > 0 && len < (int)sizeof(value);
+           s++) {
+        len += snprintf(value + len, sizeof(value) - len, ", %s %u", bootStages[s].name,
+                        (unsigned)(report.endMs[s] - report.startMs[s]));
+      }
+      jsonChunkPair(entry, size, name, value);
+      return true;
+    }
     }
-
-    file.close();
   }
-  output += "]";
-  root.close();
-  return output;
+  jsonChunkPair(entry, size, key, value);
+  return true;
 }
 
-String handleAPISList() {
-
-  File root = FILESYSTEM.open("/uploads");
-
-  int filecount = 0;
-
-  String output = "[";
-  if (root.isDirectory()) {
-    File file = root.openNextFile();
-    while (file) {
-      String filepath = String(file.name()).substring(0, 16);
-      if (filepath == "/uploads/config_") {
-
-        file = root.openNextFile();
-        filecount++;
+/**
+* @brief This function sends information about FreeTouchDeck as a json array,
+         one entry at a time.
+*
+* @param *request AsyncWebServerRequest
+*
+* @return none
+*/
+void sendInfo(AsyncWebServerRequest *request) {
+  std::shared_ptr<InfoWalk> walk = std::make_shared<InfoWalk>();
+  walk->step = 0;
+  jsonChunkBegin(walk->chunker, nextInfoEntry, walk.get());
+  request->send(request->beginChunkedResponse(
+      "application/json", [walk](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        return jsonChunkFill(walk->chunker, buf, maxLen);
+      }));
+}
 
-      } else {
-        String filename = String(file.name()).substring(9);
-        if (output != "[") {
-          output += ',';
-        }
-
-        output += "{\"";
-        output += filecount;
-        output += "\":\"";
-        output += String(file.name()).substring(9);
-        output += "\"}";
-        file = root.openNextFile();
-        filecount++;
-      }
+/**
+* @brief This function appends one latency histogram as a json object.
+*
+* @param output String to append to
+* @param stage Name of the stage
+* @param h LatencyHistogram
+*
+* @return none
+*
+* @note none
+*/
+void appendLatencyJson(String &output, const char *stage,
+                       const LatencyHistogram &h) {
+  output += "{\"stage\":\"";
+  output += stage;
+  output += "\",\"count\":";
+  output += String(h.count);
+  output += ",\"min\":";
+  output += String(h.count ? h.minUs : 0);
+  output += ",\"p50\":";
+  output += String(latencyHistogramPercentile(h, 50));
+  output += ",\"p95\":";
+  output += String(latencyHistogramPercentile(h, 95));
+  output += ",\"p99\":";
+  output += String(latencyHistogramPercentile(h, 99));
+  output += ",\"max\":";
+  output += String(h.maxUs);
+  output += ",\"buckets\":[";
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    if (b > 0) {
+      output += ',';
     }
-    file.close();
+    output += String(h.buckets[b]);
   }
-  output += "]";
-  root.close();
-  return output;
+  output += "]}";
 }
 
 /**
-* @brief This function returns information about FreeTouchDeck in a json
-         formatted string.
+* @brief This function returns the touch to HID report latency histograms in
+         a json formatted string.
 *
 * @param none
 *
 * @return String
 *
-* @note none
+* @note Latencies are in microseconds, measured from touch detection. The
+        "web-off", "web-idle" and "web-busy" stages are the HID reports of
+        touches by what the web server was doing, the "http" stage is
+        measured from a control request coming in.
 */
-String handleInfo() {
-
-  float freemem = FILESYSTEM.totalBytes() - FILESYSTEM.usedBytes();
+String handleLatency() {
 
   String output = "[";
 
-  output += "{\"";
-  output += "Version";
-  output += "\":\"";
-  output += String(versionnumber);
-  output += "\"},";
-
-  output += "{\"";
-  output += "Free Space";
-  output += "\":\"";
-  output += String(freemem / 1000);
-  output += " kB\"},";
-
-#if defined(USEUSBHID)
-
-  output += "{\"";
-  output += "Keyboard Type";
-  output += "\":\"";
-  output += String("Using USB");
-  output += "\"},";
-
-#else
-
-  output += "{\"";
-  output += "BLE Keyboard Version";
-  output += "\":\"";
-  output += String(BLE_KEYBOARD_VERSION);
-  output += "\"},";
-
-#endif // if defined(USEUSBHID)
-
-  output += "{\"";
-  output += "ArduinoJson Version";
-  output += "\":\"";
-  output += String(ARDUINOJSON_VERSION);
-  output += "\"},";
-
-  output += "{\"";
-  output += "TFT_eSPI Version";
-  output += "\":\"";
-  output += String(TFT_ESPI_VERSION);
-  output += "\"},";
-
-  output += "{\"";
-  output += "ESP-IDF";
-  output += "\":\"";
-  output += String(esp_get_idf_version());
-  output += "\"},";
-
-  output += "{\"";
-  output += "WiFi Mode";
-  output += "\":\"";
-  output += String(wificonfig.wifimode);
-  output += "\"},";
-
-#ifdef touchInterruptPin
-  output += "{\"";
-  output += "Sleep";
-  output += "\":\"";
-  if (generalconfig.sleepenable) {
-    output += String("Enabled. ");
-    output += String("Timer: ");
-    output += String(generalconfig.sleeptimer);
-    output += String(" minutes");
-    output += "\"}";
-  } else {
-    output += String("Disabled");
-    output += "\"}";
+  for (int i = LAT_JUST_PRESSED; i < LAT_STAGE_COUNT; i++) {
+    appendLatencyJson(output, latencyStageName(i), inputLatency.stages[i]);
+    output += ',';
   }
-#else
-  output += "{\"";
-  output += "Sleep";
-  output += "\":\"";
-  output += String("Disabled");
-  output += "\"}";
-
-#endif
+  for (int i = 0; i < LATENCY_LOAD_COUNT; i++) {
+    appendLatencyJson(output, latencyLoadName(i), inputLatency.reports[i]);
+    output += ',';
+  }
+  appendLatencyJson(output, "http", controlLatency.stages[LAT_HID_REPORT]);
 
   output += "]";
 
@@ -203,9 +264,9 @@ String processor(const String &var) {
 }
 
 /**
- * @brief This function handles JSON file uploads. only menu1.json, menu2.json,
- * menu3.json, menu4.json menu5.json, colors.json, and homescreen.json are
- * accepted.
+ * @brief This function handles JSON file uploads. only menu1.json up to
+ * menu16.json, deck.json, general.json, homescreen.json and wificonfig.json
+ * are accepted.
  *
  * @param *request AsyncWebServerRequest
  * @param filename String
@@ -220,39 +281,52 @@ String processor(const String &var) {
  */
 void handleJSONUpload(AsyncWebServerRequest *request, String filename,
                       size_t index, uint8_t *data, size_t len, bool final) {
-  if (filename != "menu1.json" && filename != "menu2.json" &&
-      filename != "menu3.json" && filename != "menu4.json" &&
-      filename != "menu5.json" && filename != "general.json" &&
-      filename != "homescreen.json" && filename != "wificonfig.json") {
+  if (deckMenuNumber(filename.c_str(), ".json") == 0 && filename != "deck.json" &&
+      filename != "general.json" && filename != "homescreen.json" &&
+      filename != "wificonfig.json") {
     Serial.printf("[INFO]: JSON has invalid name: %s\n", filename.c_str());
     errorCode = "102";
     errorText = "JSON file has an invalid name. You can only upload JSON files "
                 "with the following file names:";
-    errorText += "<ul><li>menu1.json</li><li>menu2.json</li><li>menu3.json</"
-                 "li><li>menu4.json</li><li>menu5.json</li>";
+    errorText += "<ul><li>menu1.json up to menu" + String(DECK_MAX_MENUS) +
+                 ".json</li><li>deck.json</li>";
     errorText += "<li>general.json</li><li>homescreen.json</"
                  "li><li>wificonfig.json</li></ul>";
     request->send(FILESYSTEM, "/error.htm", String(), false, processor);
     return;
   }
+  String path = "/config/" + filename;
   if (!index) {
     Serial.printf("[INFO]: JSON Upload Start: %s\n", filename.c_str());
-    filename =
-        "/config/" +
-        filename; // TODO: Does the config directory need to be hardcoded?
 
-    // Open the file on first call and store the file handle in the request
-    // object
-    request->_tempFile = FILESYSTEM.open(filename, "w");
+    // The upload is written next to the current file and swapped in when it
+    // is complete. Open the file on first call and store the file handle in
+    // the request object, the sum of what was written goes along with it.
+    request->_tempFile = FILESYSTEM.open(path + CONFIG_STORE_TMP, "w");
+    request->_tempObject = calloc(1, sizeof(ConfigStoreSum));
   }
+  ConfigStoreSum *sum = (ConfigStoreSum *)request->_tempObject;
   if (len) {
     // Stream the incoming chunk to the opened file
     request->_tempFile.write(data, len);
+    if (sum) {
+      configStoreSumAdd(*sum, data, len);
+    }
   }
   if (final) {
-    Serial.printf("[INFO]: JSON Uploaded: %s\n", filename.c_str());
     // Close the file handle as the upload is now done
     request->_tempFile.close();
+    if (!sum || !configStoreCommit(configStoreFs, path.c_str(), *sum)) {
+      Serial.printf("[ERROR]: JSON Upload of %s failed, keeping the current version\n",
+                    filename.c_str());
+      errorCode = "104";
+      errorText = "The JSON file could not be saved, the current version is kept. "
+                  "Please try again.";
+      request->send(FILESYSTEM, "/error.htm", String(), false, processor);
+      return;
+    }
+    Serial.printf("[INFO]: JSON Uploaded: %s\n", path.c_str());
+    configFileChanged(path.c_str());
     request->send(FILESYSTEM, "/upload.htm");
   }
 }
@@ -296,23 +370,69 @@ void handleAPIUpload(AsyncWebServerRequest *request, String filename,
   }
 }
 
-/* --------------- Checking for free space on FILESYSTEM ----------------
-Purpose: This checks if the free memory on the FILESYSTEM is bigger then a set
-threshold Input  : none Output : boolean Note   : none
-*/
+// Kept in an /upload request while its body arrives, freed along with it.
+// When it does not fit the heap only the budget is allocated, with
+// UPLOAD_NO_MEMORY, so use the rest only while the upload is admitted.
+struct UploadRequest {
+  UploadBudget  budget;
+  bool          transcode; // The file is converted to a native logo
+  bool          keep;      // The file is written as it arrives
+  IconTranscode icon;
+};
 
-bool spaceLeft() {
-  float minmem = 100000.00; // Always leave 100 kB free pace on FILESYSTEM
-  float freeMemory = FILESYSTEM.totalBytes() - FILESYSTEM.usedBytes();
-  Serial.printf("[INFO]: Free memory left: %f bytes\n", freeMemory);
-  if (freeMemory < minmem) {
-    return false;
+/**
+* @brief This function writes the native logo an uploaded file was converted
+         to.
+*
+* @param upload UploadRequest, the whole file fed to its icon
+* @param path Path of the logo
+*
+* @return UploadVerdict UPLOAD_ADMITTED when the logo was written
+*
+* @note A converted 1 bpp logo is larger than the file that was sent, so the
+        space is checked again with what is really written.
+*/
+UploadVerdict writeNativeLogo(UploadRequest &upload, const String &path) {
+  IconTranscode &icon = upload.icon;
+  if (icon.state != ICON_TRANSCODE_DONE) {
+    Serial.printf("[ERROR]: %s is no bitmap that can be converted\n",
+                  path.c_str());
+    return UPLOAD_BAD_IMAGE;
+  }
+  uint32_t size = iconNativeFileSize(icon);
+  if (uploadFlashCost(upload.budget.written + size) > upload.budget.available) {
+    upload.budget.cost = uploadFlashCost(upload.budget.written + size);
+    return UPLOAD_NO_SPACE;
   }
 
-  return true;
+  uint8_t header[ICON_NATIVE_HEADER_MAX];
+  size_t  headerLen = iconNativeHeader(icon, header);
+  size_t  pixelsLen = size - headerLen;
+  File    file = FILESYSTEM.open(path, "w");
+  if (!file || file.write(header, headerLen) != headerLen ||
+      file.write(icon.pixels, pixelsLen) != pixelsLen) {
+    Serial.printf("[ERROR]: Could not write %s, removing it\n", path.c_str());
+    file.close();
+    FILESYSTEM.remove(path);
+    return UPLOAD_WRITE_FAILED;
+  }
+  file.close();
+  upload.budget.written += size;
+  Serial.printf("[INFO]: Logo %s converted from %ux%u %u bpp to %ux%u RGB565, "
+                "%u bytes\n",
+                path.c_str(), icon.srcWidth, icon.srcHeight, icon.bpp,
+                icon.width, icon.height, size);
+  return UPLOAD_ADMITTED;
 }
+
 /**
-* @brief This function handles a file upload used by the Webserver
+* @brief This function handles a file upload used by the Webserver. The upload
+* is admitted or rejected from its Content-Length when the first part arrives,
+* before anything is written, see UploadAdmit.h. /upload answers once the whole
+* body is in.
+*
+* A .bmp is converted to a native logo while it arrives, see IconTranscode.h,
+* and only that is written. Other files are written as they are.
 *
 * @param *request
 * @param filename String
@@ -323,47 +443,937 @@ bool spaceLeft() {
 *
 * @return none
 *
-* @note The reason the file is first uploaded and then deleted if there is not
-enough free space, is that if the request is not handled, the ESP32 craches. So
-we have to accept the upload but can delete it.
+* @note A rejected upload is still received to its end and dropped, if the
+request is not handled the ESP32 crashes.
 */
 void handleUpload(AsyncWebServerRequest *request, String filename, size_t index,
                   uint8_t *data, size_t len, bool final) {
+  // The budget is the first member of an UploadRequest
+  UploadBudget *budget = (UploadBudget *)request->_tempObject;
+  if (!budget) {
+    // First part of the request, the budget is freed along with it
+    budget = (UploadBudget *)calloc(1, sizeof(UploadRequest));
+    if (budget) {
+      size_t freeBytes = FILESYSTEM.totalBytes() - FILESYSTEM.usedBytes();
+      if (uploadAdmit(*budget, request->contentLength(), freeBytes,
+                      UPLOAD_REQUEST_QUOTA) != UPLOAD_ADMITTED) {
+        Serial.printf("[WARNING]: Upload of %u bytes rejected, %u bytes free\n",
+                      request->contentLength(), freeBytes);
+      }
+    } else {
+      // Only the budget, to tell handleUploadDone() that nothing was stored
+      Serial.printf("[ERROR]: No memory for an upload, %u bytes needed\n",
+                    sizeof(UploadRequest));
+      budget = (UploadBudget *)calloc(1, sizeof(UploadBudget));
+      if (!budget) {
+        return;
+      }
+      budget->verdict = UPLOAD_NO_MEMORY;
+    }
+    request->_tempObject = budget;
+  }
+  if (budget->verdict != UPLOAD_ADMITTED) {
+    return;
+  }
+  UploadRequest *upload = (UploadRequest *)budget;
+
+  String path = "/logos/" + filename;
   if (!index) {
     Serial.printf("[INFO]: File Upload Start: %s\n", filename.c_str());
-    filename = "/logos/" + filename;
+    upload->transcode = iconTranscodeWanted(filename.c_str());
+    upload->keep = !upload->transcode;
+#ifdef UPLOAD_KEEP_ORIGINAL_LOGOS
+    upload->keep = true;
+#endif
+    if (upload->transcode) {
+      iconTranscodeBegin(upload->icon);
+    }
+    budget->files++;
+  }
+  // A kept .bmp is written next to the logo it is converted to
+  String keptPath = path;
+  if (upload->transcode) {
+    keptPath = "/orig/" + filename;
+  }
+  if (!index && upload->keep) {
     // Open the file on first call and store the file handle in the request
     // object
-    request->_tempFile = FILESYSTEM.open(filename, "w");
+    request->_tempFile = FILESYSTEM.open(keptPath, "w");
   }
-  if (len) {
+  if (len && upload->transcode) {
+    iconTranscodeFeed(upload->icon, data, len);
+  }
+  if (len && upload->keep) {
     // Stream the incoming chunk to the opened file
-    request->_tempFile.write(data, len);
+    if (!request->_tempFile || request->_tempFile.write(data, len) != len) {
+      Serial.printf("[ERROR]: Could not write %s, removing it\n",
+                    keptPath.c_str());
+      request->_tempFile.close();
+      FILESYSTEM.remove(keptPath);
+      budget->verdict = UPLOAD_WRITE_FAILED;
+      return;
+    }
+    budget->written += len;
   }
   if (final) {
-    Serial.printf("[INFO]: File Uploaded: %s\n", filename.c_str());
     // Close the file handle as the upload is now done
     request->_tempFile.close();
+    if (upload->transcode) {
+      budget->verdict = writeNativeLogo(*upload, path);
+      if (budget->verdict != UPLOAD_ADMITTED) {
+        return;
+      }
+    }
+    Serial.printf("[INFO]: File Uploaded: %s\n", path.c_str());
+    // A logo may have been replaced, redraw the keys showing it
+    logoFileChanged(path.c_str());
+  }
+}
 
-    // If there is not enough space left, we have to delete the recently
-    // uploaded file
-    if (!spaceLeft()) {
-      Serial.println("[WARNING]: Not enough free space left");
-      errorCode = "103";
-      errorText = "There is not enough free space left to upload a logo. "
-                  "Please delete unused logos and try again.";
-      request->send(FILESYSTEM, "/error.htm", String(), false, processor);
+/**
+* @brief This function answers /upload once the whole body is in
+*
+* @param *request
+*
+* @return none
+*
+* @note Files that arrived without an UploadRequest were not stored, that is
+        answered with 500 rather than the upload page.
+*/
+void handleUploadDone(AsyncWebServerRequest *request) {
+  UploadBudget *budget = (UploadBudget *)request->_tempObject;
+  UploadBudget  noMemory = {};
+  if (!budget) {
+    bool fileSent = false;
+    for (size_t i = 0; i < request->params(); i++) {
+      fileSent |= request->getParam(i)->isFile();
+    }
+    if (!fileSent) {
+      request->send(FILESYSTEM, "/upload.htm");
+      return;
+    }
+    // Files came in, but not even the budget could be allocated for them
+    noMemory.verdict = UPLOAD_NO_MEMORY;
+    budget = &noMemory;
+  }
+  if (budget->verdict == UPLOAD_ADMITTED) {
+    Serial.printf("[INFO]: Uploaded %u files, %u bytes\n", budget->files,
+                  budget->written);
+    request->send(FILESYSTEM, "/upload.htm");
+    return;
+  }
+  char text[UPLOAD_TEXT_SIZE];
+  uploadVerdictText(*budget, text, sizeof(text));
+  errorCode = uploadVerdictCode(budget->verdict);
+  errorText = text;
+  AsyncWebServerResponse *response = request->beginResponse(
+      FILESYSTEM, "/error.htm", String(), false, processor);
+  response->setCode(uploadVerdictStatus(budget->verdict));
+  request->send(response);
+}
+
+// A config file posted to /saveconfig while its body arrives
+struct ConfigPost {
+  ConfigSchemaFile file;
+  char             path[CONFIG_STORE_PATH_SIZE];
+  ConfigStoreSum   sum;
+  uint32_t         startUs;
+  uint32_t         startHeap;
+  uint32_t         lowHeap; // Lowest free heap seen during the save
+};
+
+void configPostSampleHeap(ConfigPost *post) {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap < post->lowHeap) {
+    post->lowHeap = freeHeap;
+  }
+}
 
-      // Remove the recently uploaded file
-      String fileToDelete = "/logos/";
-      fileToDelete += filename;
-      FILESYSTEM.remove(fileToDelete);
-      Serial.println("[WARNING]: File removed to keep enough free space");
+/**
+* @brief This function receives the body of a config file posted to
+         /saveconfig?save=<name> and writes it next to the current file as it
+         arrives, the whole file is never held in RAM.
+*
+* @param *request AsyncWebServerRequest
+* @param *data uint8_t
+* @param len size_t
+* @param index size_t
+* @param total size_t
+*
+* @return none
+*
+* @note handleConfigPost() checks and swaps in the file once the body is
+        complete. Bodies for an unknown name are dropped.
+*/
+void handleConfigPostBody(AsyncWebServerRequest *request, uint8_t *data,
+                          size_t len, size_t index, size_t total) {
+  if (!index) {
+    uint32_t startUs = micros();
+    uint32_t startHeap = ESP.getFreeHeap();
+    char path[CONFIG_STORE_PATH_SIZE];
+    AsyncWebParameter *save = request->getParam("save");
+    ConfigSchemaFile file =
+        save ? configSchemaFile(save->value().c_str(), path, sizeof(path))
+             : CONFIG_SCHEMA_NONE;
+    if (file == CONFIG_SCHEMA_NONE) {
+      return;
+    }
+    ConfigPost *post = (ConfigPost *)calloc(1, sizeof(ConfigPost));
+    if (!post) {
       return;
+    }
+    post->file = file;
+    memcpy(post->path, path, sizeof(path));
+    post->startUs = startUs;
+    post->startHeap = startHeap;
+    post->lowHeap = startHeap;
+    char tmp[CONFIG_STORE_PATH_SIZE];
+    configStorePath(tmp, path, CONFIG_STORE_TMP);
+    request->_tempFile = FILESYSTEM.open(tmp, "w");
+    request->_tempObject = post;
+  }
+  ConfigPost *post = (ConfigPost *)request->_tempObject;
+  if (!post) {
+    return;
+  }
+  if (len) {
+    request->_tempFile.write(data, len);
+    configStoreSumAdd(post->sum, data, len);
+  }
+  configPostSampleHeap(post);
+  if (index + len >= total) {
+    request->_tempFile.close();
+  }
+}
+
+/**
+* @brief This function finishes a config file posted to /saveconfig. The file
+         is checked against the fields of ConfigSchema.h and swapped in, the
+         running config is updated without a restart.
+*
+* @param *request AsyncWebServerRequest
+*
+* @return none
+*
+* @note Answers with JSON: the time and the heap the save took, or what was
+        wrong with the file. A refused file leaves the current one in place.
+*/
+void handleConfigPost(AsyncWebServerRequest *request) {
+  ConfigPost *post = (ConfigPost *)request->_tempObject;
+  if (!post) {
+    request->send(400, "application/json",
+                  "{\"error\":\"expected a JSON body and save=general, wifi, "
+                  "homescreen, deck or menuN\",\"field\":\"\"}");
+    return;
+  }
+
+  char tmp[CONFIG_STORE_PATH_SIZE];
+  configStorePath(tmp, post->path, CONFIG_STORE_TMP);
+  ConfigSchemaCheck check;
+  bool valid = false;
+  File file = FILESYSTEM.open(tmp, "r");
+  if (file) {
+    valid = configSchemaValidate(check, post->file, readConfigFile, &file);
+    file.close();
+  } else {
+    configSchemaFail(check, "not written", "");
+  }
+  configPostSampleHeap(post);
+
+  if (!valid) {
+    Serial.printf("[WARNING]: %s refused: %s %s\n", post->path, check.error, check.where);
+    configStoreFs.remove(configStoreFs.context, tmp);
+    request->send(400, "application/json",
+                  String("{\"error\":\"") + check.error + "\",\"field\":\"" +
+                      check.where + "\"}");
+    return;
+  }
+  if (!configStoreCommit(configStoreFs, post->path, post->sum)) {
+    Serial.printf("[ERROR]: Saving %s failed, keeping the current version\n", post->path);
+    request->send(500, "application/json",
+                  "{\"error\":\"could not be saved\",\"field\":\"\"}");
+    return;
+  }
+  configFileChanged(post->path);
+  configPostSampleHeap(post);
+
+  uint32_t elapsedUs = micros() - post->startUs;
+  uint32_t heapUsed = post->startHeap - post->lowHeap;
+  Serial.printf("[INFO]: Saved %s (%u bytes) in %u us, %u bytes of heap\n", post->path,
+                post->sum.len, elapsedUs, heapUsed);
+  request->send(200, "application/json",
+                String("{\"saved\":\"") + post->path + "\",\"bytes\":" + post->sum.len +
+                    ",\"us\":" + elapsedUs + ",\"heap\":" + heapUsed + "}");
+}
+
+// ----------------------------- Remote control -----------------------------
+
+/**
+* @brief This function gets a parameter from the query or the form body.
+*
+* @param *request AsyncWebServerRequest
+* @param name Name of the parameter
+*
+* @return String the value, empty when it was not sent
+*
+* @note none
+*/
+String controlParam(AsyncWebServerRequest *request, const char *name) {
+  if (request->hasParam(name)) {
+    return request->getParam(name)->value();
+  }
+  if (request->hasParam(name, true)) {
+    return request->getParam(name, true)->value();
+  }
+  return String();
+}
+
+/**
+* @brief This function queues a control command for loop(), which runs it
+         through the same handlers as a touch.
+*
+* @param command ControlCommand
+*
+* @return int HTTP status: 202 queued, 409 the keypad is off or a press on
+          the current page while no keys are shown, 503 the queue is full
+*
+* @note none
+*/
+int controlQueueCommand(ControlCommand &command) {
+  if (pageNum == PAGE_CONFIG_MODE ||
+      (command.page == CONTROL_PAGE_CURRENT && command.op != CONTROL_PAGE &&
+       !isKeypadPage(pageNum))) {
+    return 409;
+  }
+  command.queuedUs = micros();
+  if (xQueueSend(controlQueue, &command, 0) != pdTRUE) {
+    Serial.println("[WARNING]: Control queue full, command dropped");
+    return 503;
+  }
+  return 202;
+}
+
+/**
+* @brief This function queues the control command of a request and answers
+         it.
+*
+* @param *request AsyncWebServerRequest
+* @param command ControlCommand
+*
+* @return none
+*
+* @note Answers 202 as soon as the command is queued, the time it took to
+        reach the HID report is in /latency as "http".
+*/
+void queueControlCommand(AsyncWebServerRequest *request,
+                         ControlCommand &command) {
+  switch (controlQueueCommand(command)) {
+  case 409:
+    request->send(409, "application/json",
+                  pageNum == PAGE_CONFIG_MODE
+                      ? "{\"error\":\"the keypad is off in configurator mode\"}"
+                      : "{\"error\":\"no keys on screen, name the page\"}");
+    break;
+  case 503:
+    request->send(503, "application/json",
+                  "{\"error\":\"too many commands queued\"}");
+    break;
+  default:
+    request->send(202, "application/json",
+                  String("{\"queued\":") +
+                      uxQueueMessagesWaiting(controlQueue) + "}");
+    break;
+  }
+}
+
+/**
+* @brief This function handles POST /api/button: button=0-5, page=home,
+         settings or menuN (default the page shown) and action=tap, press or
+         release (default tap).
+*
+* @param *request AsyncWebServerRequest
+*
+* @return none
+*
+* @note A press holds modifier-only keys down for a chord until the release.
+*/
+void handleControlButton(AsyncWebServerRequest *request) {
+  ControlCommand command;
+  command.page = CONTROL_PAGE_CURRENT;
+  String page = controlParam(request, "page");
+  if (!controlParseButton(controlParam(request, "button").c_str(),
+                          command.button) ||
+      !controlParseOp(controlParam(request, "action").c_str(), command.op) ||
+      (page.length() && !controlParsePage(page.c_str(), deck.menuCount,
+                                          PAGE_SETTINGS, command.page))) {
+    request->send(400, "application/json",
+                  "{\"error\":\"expected button=0-5, page=home, settings or "
+                  "menuN and action=tap, press or release\"}");
+    return;
+  }
+  queueControlCommand(request, command);
+}
+
+/**
+* @brief This function handles POST /api/page: page=home, settings or menuN.
+*
+* @param *request AsyncWebServerRequest
+*
+* @return none
+*
+* @note none
+*/
+void handleControlPage(AsyncWebServerRequest *request) {
+  ControlCommand command;
+  command.op = CONTROL_PAGE;
+  command.button = 0;
+  if (!controlParsePage(controlParam(request, "page").c_str(), deck.menuCount,
+                        PAGE_SETTINGS, command.page)) {
+    request->send(400, "application/json",
+                  "{\"error\":\"expected page=home, settings or menuN\"}");
+    return;
+  }
+  queueControlCommand(request, command);
+}
+
+/**
+* @brief This function handles GET /api/state: the page shown and the latch
+         state of its keys, or with page=menuN of the keys of that menu.
+*
+* @param *request AsyncWebServerRequest
+*
+* @return none
+*
+* @note none
+*/
+void handleControlState(AsyncWebServerRequest *request) {
+  int16_t page = pageNum;
+  String  pageParam = controlParam(request, "page");
+  if (pageParam.length() && !controlParsePage(pageParam.c_str(), deck.menuCount,
+                                              PAGE_SETTINGS, page)) {
+    request->send(400, "application/json",
+                  "{\"error\":\"expected page=home, settings or menuN\"}");
+    return;
+  }
+
+  bool    keys[6] = {false};
+  uint8_t count = 0;
+  if (isMenuPage(page)) {
+    const MenuPage &menu = menuPages[page - 1];
+    count = menu.buttonCount;
+    for (uint8_t b = 0; b < count; b++) {
+      keys[b] = latched[menu.firstButton + b];
+    }
+  } else if (page == PAGE_SETTINGS) {
+    // The sleep key shows whether sleep is enabled
+    count = 6;
+    keys[3] = generalconfig.sleepenable;
+  }
+
+  char name[12];
+  char reply[CONTROL_STATE_SIZE];
+  controlPageName(name, sizeof(name), page, deck.menuCount, PAGE_SETTINGS);
+  controlStateJson(reply, sizeof(reply), name, keys, count);
+  request->send(200, "application/json", reply);
+}
+
+// ----------------------------- Live state -----------------------------
+
+LiveState     liveSent;          // What the clients were last sent
+uint16_t      liveSeq = 0;       // Sequence number of the next frame
+unsigned long livePushMs = 0;    // When loop() last looked for changes
+unsigned long liveHeldMs = 0;    // Since when frames are held back
+bool          liveHeld = false;  // A client is too slow for the last frame
+volatile bool liveResync = true; // Send a snapshot next, set by the clients
+
+// A slow client holds back frames for this long, then it is sent past
+#define LIVE_HOLD_MS 2000
+
+/**
+* @brief This function reads the state of the deck that clients are shown.
+*
+* @param none
+*
+* @return LiveState
+*
+* @note none
+*/
+LiveState currentLiveState() {
+  LiveState state;
+  state.page = pageNum;
+  state.latches = 0;
+  for (uint8_t b = 0; b < 6; b++) {
+    if (isKeyLatched(b)) {
+      state.latches |= 1 << b;
+    }
+  }
+  state.brightness = ledBrightness;
+  state.link = 0;
+  if (bleCombo.isConnected()) {
+    state.link |= LIVE_LINK_BLE;
+  }
+  if (WiFi.status() == WL_CONNECTED || (WiFi.getMode() & WIFI_AP)) {
+    state.link |= LIVE_LINK_WIFI;
+  }
+  return state;
+}
+
+/**
+* @brief This function pushes what changed to the WebSocket clients. Called
+         from loop().
+*
+* @param none
+*
+* @return none
+*
+* @note While a client cannot take a frame nothing is queued for it: the
+        changes add up in the next delta, which takes no more memory than
+        one. A client that stays behind for LIVE_HOLD_MS is passed by, the
+        library drops frames for it then and it asks for a snapshot when the
+        sequence numbers show a gap.
+*/
+void pushLiveState() {
+  if (liveSocket.count() == 0 || millis() - livePushMs < LIVE_PUSH_INTERVAL_MS) {
+    return;
+  }
+  livePushMs = millis();
+  liveSocket.cleanupClients(LIVE_MAX_CLIENTS);
+
+  LiveState state = currentLiveState();
+  bool      snapshot = liveResync;
+  uint8_t   frame[LIVE_FRAME_SIZE];
+  size_t    len = liveEncode(frame, sizeof(frame), liveSeq,
+                             snapshot ? NULL : &liveSent, state);
+  if (len == 0) {
+    return;
+  }
+  if (!liveSocket.availableForWriteAll()) {
+    if (!liveHeld) {
+      liveHeld = true;
+      liveHeldMs = millis();
+    }
+    if (millis() - liveHeldMs < LIVE_HOLD_MS) {
+      return;
+    }
+    Serial.println("[WARNING]: Live client too slow, sending past it");
+  }
+  liveHeld = false;
+  liveResync = false;
+  liveSocket.binaryAll(frame, len);
+  liveSent = state;
+  liveSeq++;
+}
+
+/**
+* @brief This function handles the events of the live WebSocket. Clients get
+         a snapshot when they connect and send commands as binary frames, see
+         LiveState.h.
+*
+* @param *server AsyncWebSocket
+* @param *client AsyncWebSocketClient
+* @param type AwsEventType
+* @param *arg AwsFrameInfo for data
+* @param *data uint8_t
+* @param len size_t
+*
+* @return none
+*
+* @note A command that is not queued is answered with a LIVE_ERROR frame
+        holding the status /api/button would answer.
+*/
+void onLiveEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
+                 AwsEventType type, void *arg, uint8_t *data, size_t len) {
+  if (type == WS_EVT_CONNECT) {
+    Serial.printf("[INFO]: Live client %u connected\n", client->id());
+    liveResync = true;
+    return;
+  }
+  if (type != WS_EVT_DATA) {
+    return;
+  }
+  webActiveMs = millis();
+
+  // Commands are a few bytes, they always come in one frame
+  AwsFrameInfo  *info = (AwsFrameInfo *)arg;
+  uint8_t        reply[3];
+  ControlCommand command;
+  bool           snapshot;
+  if (!info->final || info->index != 0 || info->len != len ||
+      info->opcode != WS_BINARY ||
+      !liveParseCommand(data, len, deck.menuCount, PAGE_SETTINGS, command,
+                        snapshot)) {
+    client->binary(reply, liveEncodeError(reply, 400));
+    return;
+  }
+  if (snapshot) {
+    liveResync = true;
+    return;
+  }
+  int status = controlQueueCommand(command);
+  if (status != 202) {
+    client->binary(reply, liveEncodeError(reply, status));
+  }
+}
+
+// ----------------------------- Screen mirror -----------------------------
+
+// A logo read a row at a time for /screen
+struct MirrorLogo {
+  File     file;
+  uint32_t offset; // Of the bottom row, a BMP is stored bottom up
+  uint32_t stride;
+  uint16_t width;
+  uint16_t height;
+  uint16_t bpp;
+  bool     topDown; // Of the top row instead, e.g. a native logo
+  uint16_t palette[16];
+};
+
+uint8_t screenRenders = 0; // /screen replies being sent
+
+// Where a /screen or /screen/stream reply is
+struct ScreenRender {
+  bool          stream;
+  bool          started; // sent holds what the client was sent
+  MirrorScreen  frame;   // The keys being sent
+  MirrorScreen  sent;
+  uint8_t       damage; // Regions of the frame still to send
+  uint8_t       region; // Region being sent
+  int16_t       x;      // Columns of the region
+  int16_t       w;
+  int16_t       y; // Next row of the region
+  int16_t       yEnd;
+  int8_t        band; // Row of keys whose logos are open, -1 for none
+  uint8_t       open; // Bit b: the logo of key b is open
+  uint16_t      seq;
+  unsigned long frameMs;
+  MirrorLogo    logos[MIRROR_KEYS];
+  uint16_t      logoPixels[3][MIRROR_LOGO_WIDTH];
+  uint8_t       line[MIRROR_LOGO_WIDTH * 3];
+  uint16_t      pixels[SCREEN_WIDTH];
+  uint8_t       out[MIRROR_RLE_SIZE(SCREEN_WIDTH) + MIRROR_BMP_HEADER_SIZE];
+  size_t        outLen;
+  size_t        outPos;
+
+  ScreenRender() { screenRenders++; }
+  ~ScreenRender() { screenRenders--; }
+};
+
+/**
+* @brief This function opens the logo of a key for /screen and reads its
+         header.
+*
+* @param logo MirrorLogo
+* @param key MirrorKey
+*
+* @return true if rows can be read
+*
+* @note A missing logo of a transparent key is question.bmp, as
+        drawBmpInternal() draws it.
+*/
+bool mirrorLogoOpen(MirrorLogo &logo, const MirrorKey &key) {
+  if (key.icon == ICON_NONE || (key.flags & MIRROR_KEY_PRESSED)) {
+    return false;
+  }
+  logo.file = FILESYSTEM.open(iconTablePath(iconTable, key.icon), "r");
+  if (logo.file.size() == 0 && (key.flags & MIRROR_KEY_TRANSPARENT)) {
+    logo.file = FILESYSTEM.open("/sys/ico/question.bmp", "r");
+  }
+  if (logo.file.size() == 0 || read16(logo.file) != 0x4D42) {
+    logo.file.close();
+    return false;
+  }
+  read32(logo.file);
+  read32(logo.file);
+  logo.offset = read32(logo.file);
+  read32(logo.file);
+  logo.width = read32(logo.file);
+  int32_t height = (int32_t)read32(logo.file);
+  logo.topDown = height < 0;
+  logo.height = height < 0 ? -height : height;
+  read16(logo.file); // planes
+  logo.bpp = read16(logo.file);
+  if (logo.bpp != 1 && logo.bpp != 4 && logo.bpp != 16 && logo.bpp != 24) {
+    logo.file.close();
+    return false;
+  }
+  logo.stride = mirrorBmpStride(logo.width, logo.bpp);
+  if (logo.bpp <= 4) {
+    logo.file.seek(0x36);
+    for (int i = 0; i < (1 << logo.bpp); i++) {
+      uint8_t rgba[4];
+      logo.file.read(rgba, sizeof(rgba));
+      logo.palette[i] = ((rgba[2] & 0xF8) << 8) | ((rgba[1] & 0xFC) << 3) | (rgba[0] >> 3);
+    }
+  }
+  return true;
+}
+
+/**
+* @brief This function closes the logos a /screen reply has open.
+*/
+void screenRenderClose(ScreenRender &render) {
+  for (uint8_t b = 0; b < MIRROR_KEYS; b++) {
+    if (render.open & (1 << b)) {
+      render.logos[b].file.close();
+    }
+  }
+  render.open = 0;
+  render.band = -1;
+}
+
+/**
+* @brief This function renders row y of the screen into render.pixels.
+*
+* @param render ScreenRender
+* @param y Row
+* @param keys Bit b: read the logo of key b, the others are left out
+*
+* @return none
+*
+* @note The logos of a row of keys stay open while its rows are rendered.
+*/
+void screenRenderRow(ScreenRender &render, int16_t y, uint8_t keys) {
+  int8_t band = mirrorKeyRow(screenLayout, y);
+  if (band != render.band) {
+    screenRenderClose(render);
+    render.band = band;
+    for (uint8_t b = 0; b < MIRROR_KEYS; b++) {
+      if (b / 3 == band && (keys & (1 << b)) &&
+          mirrorLogoOpen(render.logos[b], render.frame.keys[b])) {
+        render.open |= 1 << b;
+      }
+    }
+  }
+
+  MirrorLogoRow rows[MIRROR_KEYS] = {};
+  for (uint8_t b = 0; b < MIRROR_KEYS; b++) {
+    MirrorLogo &logo = render.logos[b];
+    int16_t     row = y - mirrorKeyTop(screenLayout, b) - screenLayout.logoY;
+    if (!(render.open & (1 << b)) || row < 0 || row >= logo.height) {
+      continue;
+    }
+    uint16_t width = min(logo.width, (uint16_t)MIRROR_LOGO_WIDTH);
+    uint16_t fileRow = logo.topDown ? row : logo.height - 1 - row;
+    logo.file.seek(logo.offset + (uint32_t)fileRow * logo.stride);
+    logo.file.read(render.line, ((uint32_t)width * logo.bpp + 7) / 8);
+    for (uint16_t col = 0; col < width; col++) {
+      render.logoPixels[b % 3][col] =
+          mirrorBmpPixel(render.line, logo.bpp, col, logo.palette);
+    }
+    rows[b].pixels = render.logoPixels[b % 3];
+    rows[b].width = width;
+  }
+  mirrorRenderRow(render.frame, screenLayout, y, rows, render.pixels);
+}
+
+/**
+* @brief This function puts the next part of a /screen reply in render.out:
+         a header or a row.
+*
+* @param render ScreenRender
+*
+* @return false when there is nothing to send, for now or at all
+*
+* @note A stream starts a frame when keys were drawn, at most every
+        MIRROR_FRAME_INTERVAL_MS.
+*/
+bool screenRenderNext(ScreenRender &render) {
+  render.outPos = 0;
+  render.outLen = 0;
+  if (render.y < render.yEnd) {
+    uint8_t keys =
+        render.region == MIRROR_REGION_SCREEN ? 0x3F : 1 << render.region;
+    screenRenderRow(render, render.y++, keys);
+    if (render.stream) {
+      render.outLen = mirrorRleRow(render.pixels + render.x, render.w, render.out);
     } else {
-      request->send(FILESYSTEM, "/upload.htm");
+      memset(render.out, 0, mirrorBmpStride(render.w, 16));
+      for (int16_t x = 0; x < render.w; x++) {
+        mirrorPut16(render.out + x * 2, render.pixels[render.x + x]);
+      }
+      render.outLen = mirrorBmpStride(render.w, 16);
+    }
+    return true;
+  }
+
+  // The region is done, another one opens its own logos
+  screenRenderClose(render);
+  if (!render.stream) {
+    return false;
+  }
+
+  if (render.damage) {
+    int16_t y, h;
+    if (render.damage & MIRROR_DAMAGE_SCREEN) {
+      render.region = MIRROR_REGION_SCREEN;
+      render.damage = 0;
+    } else {
+      render.region = 0;
+      while (!(render.damage & (1 << render.region))) {
+        render.region++;
+      }
+      render.damage &= render.damage - 1;
     }
+    mirrorRegionRect(screenLayout, render.region, render.x, y, render.w, h);
+    render.y = y;
+    render.yEnd = y + h;
+    render.outLen = mirrorRegionHeader(render.out, screenLayout, render.region);
+    return true;
+  }
+
+  // A text page is not sent, the client keeps the keys
+  if (millis() - render.frameMs < MIRROR_FRAME_INTERVAL_MS ||
+      !isKeypadPage(pageNum)) {
+    return false;
   }
+  mirrorSnapshot(render.frame);
+  uint8_t damage = mirrorDamage(render.started ? &render.sent : NULL, render.frame);
+  if (!damage) {
+    return false;
+  }
+  render.sent = render.frame;
+  render.started = true;
+  render.damage = damage;
+  render.frameMs = millis();
+  render.outLen = mirrorFrameHeader(render.out, render.seq++, mirrorRegionCount(damage));
+  return true;
+}
+
+/**
+* @brief This function fills a buffer of a /screen reply.
+*
+* @return size_t bytes written, RESPONSE_TRY_AGAIN when a stream has no new
+          frame yet
+*/
+size_t screenRenderFill(ScreenRender &render, uint8_t *buf, size_t maxLen) {
+  size_t len = 0;
+  while (len < maxLen) {
+    if (render.outPos == render.outLen && !screenRenderNext(render)) {
+      break;
+    }
+    size_t n = min(maxLen - len, render.outLen - render.outPos);
+    memcpy(buf + len, render.out + render.outPos, n);
+    render.outPos += n;
+    len += n;
+  }
+  if (len == 0 && render.stream) {
+    return RESPONSE_TRY_AGAIN;
+  }
+  return len;
+}
+
+/**
+* @brief This function sets up a /screen reply.
+*
+* @param *request AsyncWebServerRequest
+* @param stream Send frames until the client goes away
+*
+* @return std::shared_ptr<ScreenRender> empty when MIRROR_MAX_RENDERS are
+          being sent already, the request was answered
+*/
+std::shared_ptr<ScreenRender> screenRenderBegin(AsyncWebServerRequest *request,
+                                                bool stream) {
+  if (screenRenders >= MIRROR_MAX_RENDERS) {
+    request->send(503, "application/json",
+                  "{\"error\":\"the screen is sent to too many clients\"}");
+    return std::shared_ptr<ScreenRender>();
+  }
+  std::shared_ptr<ScreenRender> render = std::make_shared<ScreenRender>();
+  render->stream = stream;
+  render->started = false;
+  render->damage = 0;
+  render->region = MIRROR_REGION_SCREEN;
+  render->x = 0;
+  render->w = SCREEN_WIDTH;
+  render->y = 0;
+  render->yEnd = 0;
+  render->band = -1;
+  render->open = 0;
+  render->seq = 0;
+  render->frameMs = millis() - MIRROR_FRAME_INTERVAL_MS;
+  render->outLen = 0;
+  render->outPos = 0;
+  return render;
+}
+
+/**
+* @brief This function handles GET /screen: the keys on screen as a BMP.
+*
+* @param *request AsyncWebServerRequest
+*
+* @return none
+*
+* @note Rendered a row at a time while it is sent, from what the keys were
+        drawn from and the logo files.
+*/
+void handleScreen(AsyncWebServerRequest *request) {
+  if (!isKeypadPage(pageNum)) {
+    request->send(409, "application/json", "{\"error\":\"no keys on screen\"}");
+    return;
+  }
+  std::shared_ptr<ScreenRender> render = screenRenderBegin(request, false);
+  if (!render) {
+    return;
+  }
+  mirrorSnapshot(render->frame);
+  render->yEnd = SCREEN_HEIGHT;
+  render->outLen = mirrorBmpHeader(render->out, SCREEN_WIDTH, SCREEN_HEIGHT);
+  AsyncWebServerResponse *response = request->beginResponse(
+      "image/bmp", mirrorBmpSize(SCREEN_WIDTH, SCREEN_HEIGHT),
+      [render](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        return screenRenderFill(*render, buf, maxLen);
+      });
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
+}
+
+/**
+* @brief This function handles GET /screen/stream: the whole screen, then
+         the keys that are drawn, see ScreenMirror.h.
+*
+* @param *request AsyncWebServerRequest
+*
+* @return none
+*
+* @note A frame is only rendered when the client took the last one.
+*/
+void handleScreenStream(AsyncWebServerRequest *request) {
+  std::shared_ptr<ScreenRender> render = screenRenderBegin(request, true);
+  if (!render) {
+    return;
+  }
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "application/octet-stream",
+      [render](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        return screenRenderFill(*render, buf, maxLen);
+      });
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
+}
+
+/**
+* @brief This function handles GET /metrics: the counters of Metrics.h in the
+         Prometheus text format, one metric at a time.
+*
+* @param *request AsyncWebServerRequest
+*
+* @return none
+*
+* @note The snapshot is taken here, in the web server task, so loop() does not
+        wait for the reply.
+*/
+void handleMetrics(AsyncWebServerRequest *request) {
+  std::shared_ptr<MetricsWalk> walk = std::make_shared<MetricsWalk>();
+  takeMetricsSnapshot(walk->snapshot);
+  metricsBegin(*walk);
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "text/plain; version=0.0.4",
+      [walk](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        return metricsFill(*walk, buf, maxLen);
+      });
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
 }
 
 String resultHeader;
@@ -393,6 +1403,146 @@ String deleteProcessor(const String &var) {
   return String();
 }
 
+/**
+* @brief This function fills the asset cache: for every file of the
+         configurator it finds out whether a .gz is there and computes the
+         ETag of what will be sent.
+*
+* @param none
+*
+* @return none
+*
+* @note Runs once at boot, the files only change with a new filesystem image.
+*/
+void loadAssetCache() {
+  assetCacheReset(assetCache);
+  unsigned long startUs = micros();
+#ifdef CONFIGURATOR_ASSETS_IN_FLASH
+  // Built in by npm run build, the CRCs were computed then
+  for (size_t i = 0; i < sizeof(flashAssets) / sizeof(FlashAsset); i++) {
+    const FlashAsset &flash = flashAssets[i];
+    for (size_t j = 0; j < sizeof(configuratorAssets) / sizeof(AssetSpec); j++) {
+      if (strcmp(flash.path, configuratorAssets[j].path) != 0) {
+        continue;
+      }
+      Asset *asset = assetCacheAdd(assetCache, configuratorAssets[j], flash.crc,
+                                   flash.length, flash.gzipped);
+      if (asset) {
+        asset->data = flash.data;
+        Serial.printf("[INFO]: Serving %s from flash, %u bytes, ETag %s\n",
+                      asset->path, asset->length, asset->etag);
+      }
+    }
+  }
+#endif // defined(CONFIGURATOR_ASSETS_IN_FLASH)
+  for (size_t i = 0; i < sizeof(configuratorAssets) / sizeof(AssetSpec); i++) {
+    const AssetSpec &spec = configuratorAssets[i];
+    if (assetCacheFind(assetCache, spec.path)) {
+      continue; // In flash
+    }
+    String path = spec.path;
+    bool gzipped = FILESYSTEM.exists(path + ".gz");
+    if (gzipped) {
+      path += ".gz";
+    }
+    File file = FILESYSTEM.open(path, "r");
+    if (!file) {
+      continue;
+    }
+    uint32_t crc = 0;
+    uint32_t length = 0;
+    uint8_t buf[512];
+    size_t n;
+    while ((n = file.read(buf, sizeof(buf))) > 0) {
+      crc = configSnapshotCrc32Update(crc, buf, n);
+      length += n;
+    }
+    file.close();
+    const Asset *asset = assetCacheAdd(assetCache, spec, crc, length, gzipped);
+    if (asset) {
+      Serial.printf("[INFO]: Serving %s, %u bytes, ETag %s\n", path.c_str(), length,
+                    asset->etag);
+    }
+  }
+  Serial.printf("[INFO]: Asset cache of %u files in %lu us\n", assetCache.count,
+                micros() - startUs);
+}
+
+/**
+* @brief This function sends a file of the configurator from the asset cache
+*
+* @param *request AsyncWebServerRequest
+* @param asset Asset to send
+*
+* @return none
+*
+* @note Answers 304 without a body when the browser has the asset already.
+*/
+void sendAsset(AsyncWebServerRequest *request, const Asset &asset) {
+  char cacheControl[40];
+  assetCacheControl(asset, cacheControl, sizeof(cacheControl));
+
+  AsyncWebServerResponse *response;
+  if (request->hasHeader("If-None-Match") &&
+      assetEtagMatches(request->header("If-None-Match").c_str(), asset.etag)) {
+    response = request->beginResponse(304);
+  } else if (asset.data) {
+    response = request->beginResponse_P(200, assetContentType(asset.path),
+                                        asset.data, asset.length);
+    if (asset.gzipped) {
+      response->addHeader("Content-Encoding", "gzip");
+    }
+  } else {
+    String path = asset.path;
+    if (asset.gzipped) {
+      path += ".gz";
+    }
+    response = request->beginResponse(FILESYSTEM, path, assetContentType(asset.path));
+    if (asset.gzipped) {
+      response->addHeader("Content-Encoding", "gzip");
+    }
+  }
+  response->addHeader("ETag", asset.etag);
+  response->addHeader("Cache-Control", cacheControl);
+  request->send(response);
+}
+
+// ----------------------------- Web server load -----------------------------
+
+/**
+* @brief A handler that takes no request but sees every one first, it notes
+*        when the web server was last busy.
+*/
+class WebActivity : public AsyncWebHandler {
+public:
+  bool canHandle(AsyncWebServerRequest *request) override {
+    webActiveMs = millis();
+    return false;
+  }
+};
+
+WebActivity webActivity;
+
+/**
+* @brief This function tells what the web server is doing, touches are
+*        measured per load.
+*
+* @param none
+*
+* @return uint8_t LatencyLoad
+*
+* @note none
+*/
+uint8_t webServerLoad() {
+  if (!webServerRunning) {
+    return LATENCY_WEB_OFF;
+  }
+  if (millis() - webActiveMs < LATENCY_WEB_BUSY_MS) {
+    return LATENCY_WEB_BUSY;
+  }
+  return LATENCY_WEB_IDLE;
+}
+
 /**
  * @brief This function adds all the handlers we need to the webserver.
  *
@@ -405,1369 +1555,76 @@ String deleteProcessor(const String &var) {
  */
 void handlerSetup() {
 
+  // First, so it sees every request
+  webserver.addHandler(&webActivity);
+
+  //----------- configurator files -----------------
+
+  // Registered before the static handler, which would serve them otherwise
+  loadAssetCache();
+  const Asset *home = assetCacheFind(assetCache, "/");
+  if (home) {
+    webserver.on("/", HTTP_GET,
+                 [home](AsyncWebServerRequest *request) { sendAsset(request, *home); });
+  }
+  for (uint8_t i = 0; i < assetCache.count; i++) {
+    const Asset &asset = assetCache.assets[i];
+    webserver.on(asset.path, HTTP_GET,
+                 [&asset](AsyncWebServerRequest *request) { sendAsset(request, asset); });
+  }
   webserver.serveStatic("/", FILESYSTEM, "/").setDefaultFile("index.htm");
+
   //----------- index.htm handler -----------------
 
+  // The pages shown after a save post back here. Redirected, the browser
+  // gets the configurator with a GET that its cache can answer.
   webserver.on("/index.htm", HTTP_POST, [](AsyncWebServerRequest *request) {
-    request->send(FILESYSTEM, "/index.htm");
-    // After trying to serve content of gzip from here seems like async web
-    // server already has it implemented, seems like you just have to have the
-    // .gz file available in the FS and the request to any of those files,
-    // without .gz in the extension will automatically be serve with the gzip
-    // file with required headers
-
-    // String path = "/index.html.gz";
-    // if (!FILESYSTEM.exists(path)) {
-    //   request->send(404);
-    // }
-
-    // AsyncWebServerResponse *response =
-    //     request->beginResponse(FILESYSTEM, &path, 'text/html', false);
-    // response->addHeader("content-encoding", "gzip");
-    // request->send(response);
+    request->redirect("/");
   });
 
   //----------- saveconfig handler -----------------
 
-  webserver.on("/saveconfig", HTTP_POST, [](AsyncWebServerRequest *request) {
-    if (request->hasParam("save", true)) {
-      AsyncWebParameter *p = request->getParam("save", true);
-      String             savemode = p->value().c_str();
-
-      if (savemode == "general") {
-
-        // --- Saving general config
-        Serial.println("[INFO]: Saving General Config");
-
-        FILESYSTEM.remove("/config/general.json");
-        File file = FILESYSTEM.open("/config/general.json", "w");
-        if (!file) {
-          Serial.println("[WARNING]: Failed to create file");
-          return;
-        }
-
-        JsonDocument doc;
-
-        JsonObject general = doc.to<JsonObject>();
-
-        AsyncWebParameter *menubuttoncolor =
-            request->getParam("menubuttoncolor", true);
-        general["menubuttoncolor"] = menubuttoncolor->value().c_str();
-        AsyncWebParameter *functionbuttoncolor =
-            request->getParam("functionbuttoncolor", true);
-        general["functionbuttoncolor"] = functionbuttoncolor->value().c_str();
-        AsyncWebParameter *latchcolor = request->getParam("latchcolor", true);
-        general["latchcolor"] = latchcolor->value().c_str();
-        AsyncWebParameter *background = request->getParam("background", true);
-        general["background"] = background->value().c_str();
-
-        AsyncWebParameter *sleepenable = request->getParam("sleepenable", true);
-        String             sleepEnable = sleepenable->value().c_str();
-
-        if (sleepEnable == "true") {
-          general["sleepenable"] = true;
-        } else {
-          general["sleepenable"] = false;
-        }
-
-        AsyncWebParameter *beep = request->getParam("beep", true);
-        String             Beep = beep->value().c_str();
-
-        if (Beep == "true") {
-          general["beep"] = true;
-        } else {
-          general["beep"] = false;
-        }
-
-        // Sleep timer
-        AsyncWebParameter *sleeptimer = request->getParam("sleeptimer", true);
-
-        String sleepTimer = sleeptimer->value().c_str();
-        general["sleeptimer"] = sleepTimer.toInt();
-
-        // Modifiers
-
-        AsyncWebParameter *modifier1 = request->getParam("modifier1", true);
-        String             Modifier1 = modifier1->value().c_str();
-        general["modifier1"] = Modifier1.toInt();
-
-        AsyncWebParameter *modifier2 = request->getParam("modifier2", true);
-        String             Modifier2 = modifier2->value().c_str();
-        general["modifier2"] = Modifier2.toInt();
-
-        AsyncWebParameter *modifier3 = request->getParam("modifier3", true);
-        String             Modifier3 = modifier3->value().c_str();
-        general["modifier3"] = Modifier3.toInt();
-
-        AsyncWebParameter *helperdelay = request->getParam("helperdelay", true);
-        String             Helperdelay = helperdelay->value().c_str();
-        general["helperdelay"] = Helperdelay.toInt();
-
-        if (serializeJsonPretty(doc, file) == 0) {
-          Serial.println("[WARNING]: Failed to write to file");
-        }
-        file.close();
-      } else if (savemode == "wifi") {
-
-        // --- Saving wifi config
-        Serial.println("[INFO]: Saving Wifi Config");
-
-        FILESYSTEM.remove("/config/wificonfig.json");
-        File file = FILESYSTEM.open("/config/wificonfig.json", "w");
-        if (!file) {
-          Serial.println("[WARNING]: Failed to create file");
-          return;
-        }
-
-        JsonDocument doc;
-
-        JsonObject wifi = doc.to<JsonObject>();
-
-        AsyncWebParameter *menubuttoncolor = request->getParam("ssid", true);
-        wifi["ssid"] = menubuttoncolor->value().c_str();
-        AsyncWebParameter *functionbuttoncolor =
-            request->getParam("password", true);
-        wifi["password"] = functionbuttoncolor->value().c_str();
-        AsyncWebParameter *latchcolor = request->getParam("wifimode", true);
-        wifi["wifimode"] = latchcolor->value().c_str();
-        AsyncWebParameter *background = request->getParam("wifihostname", true);
-        wifi["wifihostname"] = background->value().c_str();
-
-        AsyncWebParameter *attempts = request->getParam("attempts", true);
-        String             Attempts = attempts->value().c_str();
-        wifi["attempts"] = Attempts.toInt();
-
-        AsyncWebParameter *attemptdelay =
-            request->getParam("attemptdelay", true);
-        String Attemptdelay = attemptdelay->value().c_str();
-        wifi["attemptdelay"] = Attemptdelay.toInt();
-
-        if (serializeJsonPretty(doc, file) == 0) {
-          Serial.println("[WARNING]: Failed to write to file");
-        }
-        file.close();
-
-      } else if (savemode == "homescreen") {
-
-        // --- Saving Homescreen
-
-        Serial.println("[INFO]: Saving Homescreen");
-
-        FILESYSTEM.remove("/config/homescreen.json");
-        File file = FILESYSTEM.open("/config/homescreen.json", "w");
-        if (!file) {
-          Serial.println("[WARNING]: Failed to create file");
-          return;
-        }
-
-        JsonDocument doc;
-
-        JsonObject homescreen = doc.to<JsonObject>();
-
-        AsyncWebParameter *homescreenlogo0 =
-            request->getParam("homescreenlogo0", true);
-        homescreen["logo0"] = homescreenlogo0->value().c_str();
-        AsyncWebParameter *homescreenlogo1 =
-            request->getParam("homescreenlogo1", true);
-        homescreen["logo1"] = homescreenlogo1->value().c_str();
-        AsyncWebParameter *homescreenlogo2 =
-            request->getParam("homescreenlogo2", true);
-        homescreen["logo2"] = homescreenlogo2->value().c_str();
-        AsyncWebParameter *homescreenlogo3 =
-            request->getParam("homescreenlogo3", true);
-        homescreen["logo3"] = homescreenlogo3->value().c_str();
-        AsyncWebParameter *homescreenlogo4 =
-            request->getParam("homescreenlogo4", true);
-        homescreen["logo4"] = homescreenlogo4->value().c_str();
-        AsyncWebParameter *homescreenlogo5 =
-            request->getParam("homescreenlogo5", true);
-        homescreen["logo5"] = homescreenlogo5->value().c_str();
-
-        if (serializeJsonPretty(doc, file) == 0) {
-          Serial.println("[WARNING]: Failed to write to file");
-        }
-        file.close();
-      } else if (savemode == "menu1") {
-
-        // --- Save menu 1
-
-        Serial.println("[INFO]: Saving Menu 1");
-        FILESYSTEM.remove("/config/menu1.json");
-        File file = FILESYSTEM.open("/config/menu1.json", "w");
-        if (!file) {
-          Serial.println("[WARNING]: Failed to create menu1.json");
-          return;
-        }
-
-        JsonDocument doc;
-
-        JsonObject menu = doc.to<JsonObject>();
-
-        AsyncWebParameter *screen1logo0 =
-            request->getParam("screen1logo0", true);
-        menu["logo0"] = screen1logo0->value().c_str();
-        AsyncWebParameter *screen1logo1 =
-            request->getParam("screen1logo1", true);
-        menu["logo1"] = screen1logo1->value().c_str();
-        AsyncWebParameter *screen1logo2 =
-            request->getParam("screen1logo2", true);
-        menu["logo2"] = screen1logo2->value().c_str();
-        AsyncWebParameter *screen1logo3 =
-            request->getParam("screen1logo3", true);
-        menu["logo3"] = screen1logo3->value().c_str();
-        AsyncWebParameter *screen1logo4 =
-            request->getParam("screen1logo4", true);
-        menu["logo4"] = screen1logo4->value().c_str();
-
-        JsonObject button0 = doc["button0"].to<JsonObject>();
-
-        if (request->hasParam("screen1button0latch", true)) {
-          button0["latch"] = true;
-        } else {
-          button0["latch"] = false;
-        }
-
-        AsyncWebParameter *screen1latchlogo0 =
-            request->getParam("screen1latchlogo0", true);
-        Serial.println(screen1latchlogo0->value().c_str());
-        if (strcmp(screen1latchlogo0->value().c_str(), "---") == 0) {
-          button0["latchlogo"] = "";
-        } else {
-          button0["latchlogo"] = screen1latchlogo0->value().c_str();
-        }
-
-        JsonArray button0_actionarray = button0["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen1button0action0 =
-            request->getParam("screen1button0action0", true);
-        button0_actionarray.add(screen1button0action0->value().c_str());
-        AsyncWebParameter *screen1button0action1 =
-            request->getParam("screen1button0action1", true);
-        button0_actionarray.add(screen1button0action1->value().c_str());
-        AsyncWebParameter *screen1button0action2 =
-            request->getParam("screen1button0action2", true);
-        button0_actionarray.add(screen1button0action2->value().c_str());
-
-        JsonArray button0_valuearray = button0["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen1button0value0 =
-            request->getParam("screen1button0value0", true);
-        button0_valuearray.add(screen1button0value0->value().c_str());
-        AsyncWebParameter *screen1button0value1 =
-            request->getParam("screen1button0value1", true);
-        button0_valuearray.add(screen1button0value1->value().c_str());
-        AsyncWebParameter *screen1button0value2 =
-            request->getParam("screen1button0value2", true);
-        button0_valuearray.add(screen1button0value2->value().c_str());
-
-        JsonObject button1 = doc["button1"].to<JsonObject>();
-
-        if (request->hasParam("screen1button1latch", true)) {
-          button1["latch"] = true;
-        } else {
-          button1["latch"] = false;
-        }
-
-        AsyncWebParameter *screen1latchlogo1 =
-            request->getParam("screen1latchlogo1", true);
-        Serial.println(screen1latchlogo1->value().c_str());
-        if (strcmp(screen1latchlogo1->value().c_str(), "---") == 0) {
-          Serial.println(screen1latchlogo1->value().c_str());
-          button1["latchlogo"] = "";
-        } else {
-          Serial.println(screen1latchlogo1->value().c_str());
-          button1["latchlogo"] = screen1latchlogo1->value().c_str();
-        }
-
-        JsonArray button1_actionarray = button1["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen1button1action0 =
-            request->getParam("screen1button1action0", true);
-        button1_actionarray.add(screen1button1action0->value().c_str());
-        AsyncWebParameter *screen1button1action1 =
-            request->getParam("screen1button1action1", true);
-        button1_actionarray.add(screen1button1action1->value().c_str());
-        AsyncWebParameter *screen1button1action2 =
-            request->getParam("screen1button1action2", true);
-        button1_actionarray.add(screen1button1action2->value().c_str());
-
-        JsonArray button1_valuearray = button1["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen1button1value0 =
-            request->getParam("screen1button1value0", true);
-        button1_valuearray.add(screen1button1value0->value().c_str());
-        AsyncWebParameter *screen1button1value1 =
-            request->getParam("screen1button1value1", true);
-        button1_valuearray.add(screen1button1value1->value().c_str());
-        AsyncWebParameter *screen1button1value2 =
-            request->getParam("screen1button1value2", true);
-        button1_valuearray.add(screen1button1value2->value().c_str());
-
-        JsonObject button2 = doc["button2"].to<JsonObject>();
-
-        if (request->hasParam("screen1button2latch", true)) {
-          button2["latch"] = true;
-        } else {
-          button2["latch"] = false;
-        }
-
-        AsyncWebParameter *screen1latchlogo2 =
-            request->getParam("screen1latchlogo2", true);
-        Serial.println(screen1latchlogo2->value().c_str());
-        if (strcmp(screen1latchlogo2->value().c_str(), "---") == 0) {
-          button2["latchlogo"] = "";
-        } else {
-          button2["latchlogo"] = screen1latchlogo2->value().c_str();
-        }
-
-        JsonArray button2_actionarray = button2["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen1button2action0 =
-            request->getParam("screen1button2action0", true);
-        button2_actionarray.add(screen1button2action0->value().c_str());
-        AsyncWebParameter *screen1button2action1 =
-            request->getParam("screen1button2action1", true);
-        button2_actionarray.add(screen1button2action1->value().c_str());
-        AsyncWebParameter *screen1button2action2 =
-            request->getParam("screen1button2action2", true);
-        button2_actionarray.add(screen1button2action2->value().c_str());
-
-        JsonArray button2_valuearray = button2["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen1button2value0 =
-            request->getParam("screen1button2value0", true);
-        button2_valuearray.add(screen1button2value0->value().c_str());
-        AsyncWebParameter *screen1button2value1 =
-            request->getParam("screen1button2value1", true);
-        button2_valuearray.add(screen1button2value1->value().c_str());
-        AsyncWebParameter *screen1button2value2 =
-            request->getParam("screen1button2value2", true);
-        button2_valuearray.add(screen1button2value2->value().c_str());
-
-        JsonObject button3 = doc["button3"].to<JsonObject>();
-
-        if (request->hasParam("screen1button3latch", true)) {
-          button3["latch"] = true;
-        } else {
-          button3["latch"] = false;
-        }
-
-        AsyncWebParameter *screen1latchlogo3 =
-            request->getParam("screen1latchlogo3", true);
-        Serial.println(screen1latchlogo3->value().c_str());
-        if (strcmp(screen1latchlogo3->value().c_str(), "---") == 0) {
-          button3["latchlogo"] = "";
-        } else {
-          button3["latchlogo"] = screen1latchlogo3->value().c_str();
-        }
-
-        JsonArray button3_actionarray = button3["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen1button3action0 =
-            request->getParam("screen1button3action0", true);
-        button3_actionarray.add(screen1button3action0->value().c_str());
-        AsyncWebParameter *screen1button3action1 =
-            request->getParam("screen1button3action1", true);
-        button3_actionarray.add(screen1button3action1->value().c_str());
-        AsyncWebParameter *screen1button3action2 =
-            request->getParam("screen1button3action2", true);
-        button3_actionarray.add(screen1button3action2->value().c_str());
-
-        JsonArray button3_valuearray = button3["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen1button3value0 =
-            request->getParam("screen1button3value0", true);
-        button3_valuearray.add(screen1button3value0->value().c_str());
-        AsyncWebParameter *screen1button3value1 =
-            request->getParam("screen1button3value1", true);
-        button3_valuearray.add(screen1button3value1->value().c_str());
-        AsyncWebParameter *screen1button3value2 =
-            request->getParam("screen1button3value2", true);
-        button3_valuearray.add(screen1button3value2->value().c_str());
-
-        JsonObject button4 = doc["button4"].to<JsonObject>();
-
-        if (request->hasParam("screen1button4latch", true)) {
-          button4["latch"] = true;
-        } else {
-          button4["latch"] = false;
-        }
-
-        AsyncWebParameter *screen1latchlogo4 =
-            request->getParam("screen1latchlogo4", true);
-        Serial.println(screen1latchlogo4->value().c_str());
-        if (strcmp(screen1latchlogo4->value().c_str(), "---") == 0) {
-          button4["latchlogo"] = "";
-        } else {
-          button4["latchlogo"] = screen1latchlogo4->value().c_str();
-        }
-
-        JsonArray button4_actionarray = button4["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen1button4action0 =
-            request->getParam("screen1button4action0", true);
-        button4_actionarray.add(screen1button4action0->value().c_str());
-        AsyncWebParameter *screen1button4action1 =
-            request->getParam("screen1button4action1", true);
-        button4_actionarray.add(screen1button4action1->value().c_str());
-        AsyncWebParameter *screen1button4action2 =
-            request->getParam("screen1button4action2", true);
-        button4_actionarray.add(screen1button4action2->value().c_str());
-
-        JsonArray button4_valuearray = button4["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen1button4value0 =
-            request->getParam("screen1button4value0", true);
-        button4_valuearray.add(screen1button4value0->value().c_str());
-        AsyncWebParameter *screen1button4value1 =
-            request->getParam("screen1button4value1", true);
-        button4_valuearray.add(screen1button4value1->value().c_str());
-        AsyncWebParameter *screen1button4value2 =
-            request->getParam("screen1button4value2", true);
-        button4_valuearray.add(screen1button4value2->value().c_str());
-
-        if (serializeJsonPretty(doc, file) == 0) {
-          Serial.println("[WARNING]: Failed to write to file");
-        }
-        file.close();
-      } else if (savemode == "menu2") {
-
-        // --- Save menu 2
-
-        Serial.println("[INFO]: Saving Menu 2");
-        FILESYSTEM.remove("/config/menu2.json");
-        File file = FILESYSTEM.open("/config/menu2.json", "w");
-        if (!file) {
-          Serial.println("[WARNING]: Failed to create menu2.json");
-          return;
-        }
-
-        JsonDocument doc;
-
-        JsonObject menu = doc.to<JsonObject>();
-
-        AsyncWebParameter *screen2logo0 =
-            request->getParam("screen2logo0", true);
-        menu["logo0"] = screen2logo0->value().c_str();
-        AsyncWebParameter *screen2logo1 =
-            request->getParam("screen2logo1", true);
-        menu["logo1"] = screen2logo1->value().c_str();
-        AsyncWebParameter *screen2logo2 =
-            request->getParam("screen2logo2", true);
-        menu["logo2"] = screen2logo2->value().c_str();
-        AsyncWebParameter *screen2logo3 =
-            request->getParam("screen2logo3", true);
-        menu["logo3"] = screen2logo3->value().c_str();
-        AsyncWebParameter *screen2logo4 =
-            request->getParam("screen2logo4", true);
-        menu["logo4"] = screen2logo4->value().c_str();
-
-        JsonObject button0 = doc["button0"].to<JsonObject>();
-
-        if (request->hasParam("screen2button0latch", true)) {
-          button0["latch"] = true;
-        } else {
-          button0["latch"] = false;
-        }
-
-        AsyncWebParameter *screen2latchlogo0 =
-            request->getParam("screen2latchlogo0", true);
-        Serial.println(screen2latchlogo0->value().c_str());
-        if (strcmp(screen2latchlogo0->value().c_str(), "---") == 0) {
-          button0["latchlogo"] = "";
-        } else {
-          button0["latchlogo"] = screen2latchlogo0->value().c_str();
-        }
-
-        JsonArray button0_actionarray = button0["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen2button0action0 =
-            request->getParam("screen2button0action0", true);
-        button0_actionarray.add(screen2button0action0->value().c_str());
-        AsyncWebParameter *screen2button0action1 =
-            request->getParam("screen2button0action1", true);
-        button0_actionarray.add(screen2button0action1->value().c_str());
-        AsyncWebParameter *screen2button0action2 =
-            request->getParam("screen2button0action2", true);
-        button0_actionarray.add(screen2button0action2->value().c_str());
-
-        JsonArray button0_valuearray = button0["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen2button0value0 =
-            request->getParam("screen2button0value0", true);
-        button0_valuearray.add(screen2button0value0->value().c_str());
-        AsyncWebParameter *screen2button0value1 =
-            request->getParam("screen2button0value1", true);
-        button0_valuearray.add(screen2button0value1->value().c_str());
-        AsyncWebParameter *screen2button0value2 =
-            request->getParam("screen2button0value2", true);
-        button0_valuearray.add(screen2button0value2->value().c_str());
-
-        JsonObject button1 = doc["button1"].to<JsonObject>();
-
-        if (request->hasParam("screen2button1latch", true)) {
-          button1["latch"] = true;
-        } else {
-          button1["latch"] = false;
-        }
-
-        AsyncWebParameter *screen2latchlogo1 =
-            request->getParam("screen2latchlogo1", true);
-        Serial.println(screen2latchlogo1->value().c_str());
-        if (strcmp(screen2latchlogo1->value().c_str(), "---") == 0) {
-          button1["latchlogo"] = "";
-        } else {
-          button1["latchlogo"] = screen2latchlogo1->value().c_str();
-        }
-
-        JsonArray button1_actionarray = button1["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen2button1action0 =
-            request->getParam("screen2button1action0", true);
-        button1_actionarray.add(screen2button1action0->value().c_str());
-        AsyncWebParameter *screen2button1action1 =
-            request->getParam("screen2button1action1", true);
-        button1_actionarray.add(screen2button1action1->value().c_str());
-        AsyncWebParameter *screen2button1action2 =
-            request->getParam("screen2button1action2", true);
-        button1_actionarray.add(screen2button1action2->value().c_str());
-
-        JsonArray button1_valuearray = button1["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen2button1value0 =
-            request->getParam("screen2button1value0", true);
-        button1_valuearray.add(screen2button1value0->value().c_str());
-        AsyncWebParameter *screen2button1value1 =
-            request->getParam("screen2button1value1", true);
-        button1_valuearray.add(screen2button1value1->value().c_str());
-        AsyncWebParameter *screen2button1value2 =
-            request->getParam("screen2button1value2", true);
-        button1_valuearray.add(screen2button1value2->value().c_str());
-
-        JsonObject button2 = doc["button2"].to<JsonObject>();
-
-        if (request->hasParam("screen2button2latch", true)) {
-          button2["latch"] = true;
-        } else {
-          button2["latch"] = false;
-        }
-
-        AsyncWebParameter *screen2latchlogo2 =
-            request->getParam("screen2latchlogo2", true);
-        Serial.println(screen2latchlogo2->value().c_str());
-        if (strcmp(screen2latchlogo2->value().c_str(), "---") == 0) {
-          button2["latchlogo"] = "";
-        } else {
-          button2["latchlogo"] = screen2latchlogo2->value().c_str();
-        }
-
-        JsonArray button2_actionarray = button2["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen2button2action0 =
-            request->getParam("screen2button2action0", true);
-        button2_actionarray.add(screen2button2action0->value().c_str());
-        AsyncWebParameter *screen2button2action1 =
-            request->getParam("screen2button2action1", true);
-        button2_actionarray.add(screen2button2action1->value().c_str());
-        AsyncWebParameter *screen2button2action2 =
-            request->getParam("screen2button2action2", true);
-        button2_actionarray.add(screen2button2action2->value().c_str());
-
-        JsonArray button2_valuearray = button2["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen2button2value0 =
-            request->getParam("screen2button2value0", true);
-        button2_valuearray.add(screen2button2value0->value().c_str());
-        AsyncWebParameter *screen2button2value1 =
-            request->getParam("screen2button2value1", true);
-        button2_valuearray.add(screen2button2value1->value().c_str());
-        AsyncWebParameter *screen2button2value2 =
-            request->getParam("screen2button2value2", true);
-        button2_valuearray.add(screen2button2value2->value().c_str());
-
-        JsonObject button3 = doc["button3"].to<JsonObject>();
-
-        if (request->hasParam("screen2button3latch", true)) {
-          button3["latch"] = true;
-        } else {
-          button3["latch"] = false;
-        }
-
-        AsyncWebParameter *screen2latchlogo3 =
-            request->getParam("screen2latchlogo3", true);
-        Serial.println(screen2latchlogo3->value().c_str());
-        if (strcmp(screen2latchlogo3->value().c_str(), "---") == 0) {
-          button3["latchlogo"] = "";
-        } else {
-          button3["latchlogo"] = screen2latchlogo3->value().c_str();
-        }
-
-        JsonArray button3_actionarray = button3["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen2button3action0 =
-            request->getParam("screen2button3action0", true);
-        button3_actionarray.add(screen2button3action0->value().c_str());
-        AsyncWebParameter *screen2button3action1 =
-            request->getParam("screen2button3action1", true);
-        button3_actionarray.add(screen2button3action1->value().c_str());
-        AsyncWebParameter *screen2button3action2 =
-            request->getParam("screen2button3action2", true);
-        button3_actionarray.add(screen2button3action2->value().c_str());
-
-        JsonArray button3_valuearray = button3["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen2button3value0 =
-            request->getParam("screen2button3value0", true);
-        button3_valuearray.add(screen2button3value0->value().c_str());
-        AsyncWebParameter *screen2button3value1 =
-            request->getParam("screen2button3value1", true);
-        button3_valuearray.add(screen2button3value1->value().c_str());
-        AsyncWebParameter *screen2button3value2 =
-            request->getParam("screen2button3value2", true);
-        button3_valuearray.add(screen2button3value2->value().c_str());
-
-        JsonObject button4 = doc["button4"].to<JsonObject>();
-
-        if (request->hasParam("screen2button4latch", true)) {
-          button4["latch"] = true;
-        } else {
-          button4["latch"] = false;
-        }
-
-        AsyncWebParameter *screen2latchlogo4 =
-            request->getParam("screen2latchlogo4", true);
-        Serial.println(screen2latchlogo4->value().c_str());
-        if (strcmp(screen2latchlogo4->value().c_str(), "---") == 0) {
-          button4["latchlogo"] = "";
-        } else {
-          button4["latchlogo"] = screen2latchlogo4->value().c_str();
-        }
-
-        JsonArray button4_actionarray = button4["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen2button4action0 =
-            request->getParam("screen2button4action0", true);
-        button4_actionarray.add(screen2button4action0->value().c_str());
-        AsyncWebParameter *screen2button4action1 =
-            request->getParam("screen2button4action1", true);
-        button4_actionarray.add(screen2button4action1->value().c_str());
-        AsyncWebParameter *screen2button4action2 =
-            request->getParam("screen2button4action2", true);
-        button4_actionarray.add(screen2button4action2->value().c_str());
-
-        JsonArray button4_valuearray = button4["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen2button4value0 =
-            request->getParam("screen2button4value0", true);
-        button4_valuearray.add(screen2button4value0->value().c_str());
-        AsyncWebParameter *screen2button4value1 =
-            request->getParam("screen2button4value1", true);
-        button4_valuearray.add(screen2button4value1->value().c_str());
-        AsyncWebParameter *screen2button4value2 =
-            request->getParam("screen2button4value2", true);
-        button4_valuearray.add(screen2button4value2->value().c_str());
-
-        if (serializeJsonPretty(doc, file) == 0) {
-          Serial.println("[WARNING]: Failed to write to file");
-        }
-        file.close();
-      } else if (savemode == "menu3") {
-
-        // --- Save menu 3
-
-        Serial.println("[INFO]: Saving Menu 3");
-        FILESYSTEM.remove("/config/menu3.json");
-        File file = FILESYSTEM.open("/config/menu3.json", "w");
-        if (!file) {
-          Serial.println("[WARNING]: Failed to create menu3.json");
-          return;
-        }
-
-        JsonDocument doc;
-
-        JsonObject menu = doc.to<JsonObject>();
-
-        AsyncWebParameter *screen3logo0 =
-            request->getParam("screen3logo0", true);
-        menu["logo0"] = screen3logo0->value().c_str();
-        AsyncWebParameter *screen3logo1 =
-            request->getParam("screen3logo1", true);
-        menu["logo1"] = screen3logo1->value().c_str();
-        AsyncWebParameter *screen3logo2 =
-            request->getParam("screen3logo2", true);
-        menu["logo2"] = screen3logo2->value().c_str();
-        AsyncWebParameter *screen3logo3 =
-            request->getParam("screen3logo3", true);
-        menu["logo3"] = screen3logo3->value().c_str();
-        AsyncWebParameter *screen3logo4 =
-            request->getParam("screen3logo4", true);
-        menu["logo4"] = screen3logo4->value().c_str();
-
-        JsonObject button0 = doc["button0"].to<JsonObject>();
-
-        if (request->hasParam("screen3button0latch", true)) {
-          button0["latch"] = true;
-        } else {
-          button0["latch"] = false;
-        }
-
-        AsyncWebParameter *screen3latchlogo0 =
-            request->getParam("screen3latchlogo0", true);
-        Serial.println(screen3latchlogo0->value().c_str());
-        if (strcmp(screen3latchlogo0->value().c_str(), "---") == 0) {
-          button0["latchlogo"] = "";
-        } else {
-          button0["latchlogo"] = screen3latchlogo0->value().c_str();
-        }
-
-        JsonArray button0_actionarray = button0["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen3button0action0 =
-            request->getParam("screen3button0action0", true);
-        button0_actionarray.add(screen3button0action0->value().c_str());
-        AsyncWebParameter *screen3button0action1 =
-            request->getParam("screen3button0action1", true);
-        button0_actionarray.add(screen3button0action1->value().c_str());
-        AsyncWebParameter *screen3button0action2 =
-            request->getParam("screen3button0action2", true);
-        button0_actionarray.add(screen3button0action2->value().c_str());
-
-        JsonArray button0_valuearray = button0["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen3button0value0 =
-            request->getParam("screen3button0value0", true);
-        button0_valuearray.add(screen3button0value0->value().c_str());
-        AsyncWebParameter *screen3button0value1 =
-            request->getParam("screen3button0value1", true);
-        button0_valuearray.add(screen3button0value1->value().c_str());
-        AsyncWebParameter *screen3button0value2 =
-            request->getParam("screen3button0value2", true);
-        button0_valuearray.add(screen3button0value2->value().c_str());
-
-        JsonObject button1 = doc["button1"].to<JsonObject>();
-
-        if (request->hasParam("screen3button1latch", true)) {
-          button1["latch"] = true;
-        } else {
-          button1["latch"] = false;
-        }
-
-        AsyncWebParameter *screen3latchlogo1 =
-            request->getParam("screen3latchlogo1", true);
-        Serial.println(screen3latchlogo1->value().c_str());
-        if (strcmp(screen3latchlogo1->value().c_str(), "---") == 0) {
-          button1["latchlogo"] = "";
-        } else {
-          button1["latchlogo"] = screen3latchlogo1->value().c_str();
-        }
-
-        JsonArray button1_actionarray = button1["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen3button1action0 =
-            request->getParam("screen3button1action0", true);
-        button1_actionarray.add(screen3button1action0->value().c_str());
-        AsyncWebParameter *screen3button1action1 =
-            request->getParam("screen3button1action1", true);
-        button1_actionarray.add(screen3button1action1->value().c_str());
-        AsyncWebParameter *screen3button1action2 =
-            request->getParam("screen3button1action2", true);
-        button1_actionarray.add(screen3button1action2->value().c_str());
-
-        JsonArray button1_valuearray = button1["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen3button1value0 =
-            request->getParam("screen3button1value0", true);
-        button1_valuearray.add(screen3button1value0->value().c_str());
-        AsyncWebParameter *screen3button1value1 =
-            request->getParam("screen3button1value1", true);
-        button1_valuearray.add(screen3button1value1->value().c_str());
-        AsyncWebParameter *screen3button1value2 =
-            request->getParam("screen3button1value2", true);
-        button1_valuearray.add(screen3button1value2->value().c_str());
-
-        JsonObject button2 = doc["button2"].to<JsonObject>();
-
-        if (request->hasParam("screen3button2latch", true)) {
-          button2["latch"] = true;
-        } else {
-          button2["latch"] = false;
-        }
-
-        AsyncWebParameter *screen3latchlogo2 =
-            request->getParam("screen3latchlogo2", true);
-        Serial.println(screen3latchlogo2->value().c_str());
-        if (strcmp(screen3latchlogo2->value().c_str(), "---") == 0) {
-          button2["latchlogo"] = "";
-        } else {
-          button2["latchlogo"] = screen3latchlogo2->value().c_str();
-        }
-
-        JsonArray button2_actionarray = button2["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen3button2action0 =
-            request->getParam("screen3button2action0", true);
-        button2_actionarray.add(screen3button2action0->value().c_str());
-        AsyncWebParameter *screen3button2action1 =
-            request->getParam("screen3button2action1", true);
-        button2_actionarray.add(screen3button2action1->value().c_str());
-        AsyncWebParameter *screen3button2action2 =
-            request->getParam("screen3button2action2", true);
-        button2_actionarray.add(screen3button2action2->value().c_str());
-
-        JsonArray button2_valuearray = button2["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen3button2value0 =
-            request->getParam("screen3button2value0", true);
-        button2_valuearray.add(screen3button2value0->value().c_str());
-        AsyncWebParameter *screen3button2value1 =
-            request->getParam("screen3button2value1", true);
-        button2_valuearray.add(screen3button2value1->value().c_str());
-        AsyncWebParameter *screen3button2value2 =
-            request->getParam("screen3button2value2", true);
-        button2_valuearray.add(screen3button2value2->value().c_str());
-
-        JsonObject button3 = doc["button3"].to<JsonObject>();
-
-        if (request->hasParam("screen3button3latch", true)) {
-          button3["latch"] = true;
-        } else {
-          button3["latch"] = false;
-        }
-
-        AsyncWebParameter *screen3latchlogo3 =
-            request->getParam("screen3latchlogo3", true);
-        Serial.println(screen3latchlogo3->value().c_str());
-        if (strcmp(screen3latchlogo3->value().c_str(), "---") == 0) {
-          button3["latchlogo"] = "";
-        } else {
-          button3["latchlogo"] = screen3latchlogo3->value().c_str();
-        }
-
-        JsonArray button3_actionarray = button3["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen3button3action0 =
-            request->getParam("screen3button3action0", true);
-        button3_actionarray.add(screen3button3action0->value().c_str());
-        AsyncWebParameter *screen3button3action1 =
-            request->getParam("screen3button3action1", true);
-        button3_actionarray.add(screen3button3action1->value().c_str());
-        AsyncWebParameter *screen3button3action2 =
-            request->getParam("screen3button3action2", true);
-        button3_actionarray.add(screen3button3action2->value().c_str());
-
-        JsonArray button3_valuearray = button3["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen3button3value0 =
-            request->getParam("screen3button3value0", true);
-        button3_valuearray.add(screen3button3value0->value().c_str());
-        AsyncWebParameter *screen3button3value1 =
-            request->getParam("screen3button3value1", true);
-        button3_valuearray.add(screen3button3value1->value().c_str());
-        AsyncWebParameter *screen3button3value2 =
-            request->getParam("screen3button3value2", true);
-        button3_valuearray.add(screen3button3value2->value().c_str());
-
-        JsonObject button4 = doc["button4"].to<JsonObject>();
-
-        if (request->hasParam("screen3button4latch", true)) {
-          button4["latch"] = true;
-        } else {
-          button4["latch"] = false;
-        }
-
-        AsyncWebParameter *screen3latchlogo4 =
-            request->getParam("screen3latchlogo4", true);
-        Serial.println(screen3latchlogo4->value().c_str());
-        if (strcmp(screen3latchlogo4->value().c_str(), "---") == 0) {
-          button4["latchlogo"] = "";
-        } else {
-          button4["latchlogo"] = screen3latchlogo4->value().c_str();
-        }
-
-        JsonArray button4_actionarray = button4["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen3button4action0 =
-            request->getParam("screen3button4action0", true);
-        button4_actionarray.add(screen3button4action0->value().c_str());
-        AsyncWebParameter *screen3button4action1 =
-            request->getParam("screen3button4action1", true);
-        button4_actionarray.add(screen3button4action1->value().c_str());
-        AsyncWebParameter *screen3button4action2 =
-            request->getParam("screen3button4action2", true);
-        button4_actionarray.add(screen3button4action2->value().c_str());
-
-        JsonArray button4_valuearray = button4["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen3button4value0 =
-            request->getParam("screen3button4value0", true);
-        button4_valuearray.add(screen3button4value0->value().c_str());
-        AsyncWebParameter *screen3button4value1 =
-            request->getParam("screen3button4value1", true);
-        button4_valuearray.add(screen3button4value1->value().c_str());
-        AsyncWebParameter *screen3button4value2 =
-            request->getParam("screen3button4value2", true);
-        button4_valuearray.add(screen3button4value2->value().c_str());
-
-        if (serializeJsonPretty(doc, file) == 0) {
-          Serial.println("[WARNING]: Failed to write to file");
-        }
-        file.close();
-      } else if (savemode == "menu4") {
-
-        // --- Save menu 4
-
-        Serial.println("[INFO]: Saving Menu 4");
-        FILESYSTEM.remove("/config/menu4.json");
-        File file = FILESYSTEM.open("/config/menu4.json", "w");
-        if (!file) {
-          Serial.println("[WARNING]: Failed to create menu3.json");
-          return;
-        }
-
-        JsonDocument doc;
-
-        JsonObject menu = doc.to<JsonObject>();
-
-        AsyncWebParameter *screen4logo0 =
-            request->getParam("screen4logo0", true);
-        menu["logo0"] = screen4logo0->value().c_str();
-        AsyncWebParameter *screen4logo1 =
-            request->getParam("screen4logo1", true);
-        menu["logo1"] = screen4logo1->value().c_str();
-        AsyncWebParameter *screen4logo2 =
-            request->getParam("screen4logo2", true);
-        menu["logo2"] = screen4logo2->value().c_str();
-        AsyncWebParameter *screen4logo3 =
-            request->getParam("screen4logo3", true);
-        menu["logo3"] = screen4logo3->value().c_str();
-        AsyncWebParameter *screen4logo4 =
-            request->getParam("screen4logo4", true);
-        menu["logo4"] = screen4logo4->value().c_str();
-
-        JsonObject button0 = doc["button0"].to<JsonObject>();
-
-        if (request->hasParam("screen4button0latch", true)) {
-          button0["latch"] = true;
-        } else {
-          button0["latch"] = false;
-        }
-
-        AsyncWebParameter *screen4latchlogo0 =
-            request->getParam("screen4latchlogo0", true);
-        Serial.println(screen4latchlogo0->value().c_str());
-        if (strcmp(screen4latchlogo0->value().c_str(), "---") == 0) {
-          button0["latchlogo"] = "";
-        } else {
-          button0["latchlogo"] = screen4latchlogo0->value().c_str();
-        }
-
-        JsonArray button0_actionarray = button0["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen4button0action0 =
-            request->getParam("screen4button0action0", true);
-        button0_actionarray.add(screen4button0action0->value().c_str());
-        AsyncWebParameter *screen4button0action1 =
-            request->getParam("screen4button0action1", true);
-        button0_actionarray.add(screen4button0action1->value().c_str());
-        AsyncWebParameter *screen4button0action2 =
-            request->getParam("screen4button0action2", true);
-        button0_actionarray.add(screen4button0action2->value().c_str());
-
-        JsonArray button0_valuearray = button0["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen4button0value0 =
-            request->getParam("screen4button0value0", true);
-        button0_valuearray.add(screen4button0value0->value().c_str());
-        AsyncWebParameter *screen4button0value1 =
-            request->getParam("screen4button0value1", true);
-        button0_valuearray.add(screen4button0value1->value().c_str());
-        AsyncWebParameter *screen4button0value2 =
-            request->getParam("screen4button0value2", true);
-        button0_valuearray.add(screen4button0value2->value().c_str());
-
-        JsonObject button1 = doc["button1"].to<JsonObject>();
-
-        if (request->hasParam("screen4button1latch", true)) {
-          button1["latch"] = true;
-        } else {
-          button1["latch"] = false;
-        }
-
-        AsyncWebParameter *screen4latchlogo1 =
-            request->getParam("screen4latchlogo1", true);
-        Serial.println(screen4latchlogo1->value().c_str());
-        if (strcmp(screen4latchlogo1->value().c_str(), "---") == 0) {
-          button1["latchlogo"] = "";
-        } else {
-          button1["latchlogo"] = screen4latchlogo1->value().c_str();
-        }
-
-        JsonArray button1_actionarray = button1["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen4button1action0 =
-            request->getParam("screen4button1action0", true);
-        button1_actionarray.add(screen4button1action0->value().c_str());
-        AsyncWebParameter *screen4button1action1 =
-            request->getParam("screen4button1action1", true);
-        button1_actionarray.add(screen4button1action1->value().c_str());
-        AsyncWebParameter *screen4button1action2 =
-            request->getParam("screen4button1action2", true);
-        button1_actionarray.add(screen4button1action2->value().c_str());
-
-        JsonArray button1_valuearray = button1["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen4button1value0 =
-            request->getParam("screen4button1value0", true);
-        button1_valuearray.add(screen4button1value0->value().c_str());
-        AsyncWebParameter *screen4button1value1 =
-            request->getParam("screen4button1value1", true);
-        button1_valuearray.add(screen4button1value1->value().c_str());
-        AsyncWebParameter *screen4button1value2 =
-            request->getParam("screen4button1value2", true);
-        button1_valuearray.add(screen4button1value2->value().c_str());
-
-        JsonObject button2 = doc["button2"].to<JsonObject>();
-
-        if (request->hasParam("screen4button2latch", true)) {
-          button2["latch"] = true;
-        } else {
-          button2["latch"] = false;
-        }
-
-        AsyncWebParameter *screen4latchlogo2 =
-            request->getParam("screen4latchlogo2", true);
-        Serial.println(screen4latchlogo2->value().c_str());
-        if (strcmp(screen4latchlogo2->value().c_str(), "---") == 0) {
-          button2["latchlogo"] = "";
-        } else {
-          button2["latchlogo"] = screen4latchlogo2->value().c_str();
-        }
-
-        JsonArray button2_actionarray = button2["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen4button2action0 =
-            request->getParam("screen4button2action0", true);
-        button2_actionarray.add(screen4button2action0->value().c_str());
-        AsyncWebParameter *screen4button2action1 =
-            request->getParam("screen4button2action1", true);
-        button2_actionarray.add(screen4button2action1->value().c_str());
-        AsyncWebParameter *screen4button2action2 =
-            request->getParam("screen4button2action2", true);
-        button2_actionarray.add(screen4button2action2->value().c_str());
-
-        JsonArray button2_valuearray = button2["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen4button2value0 =
-            request->getParam("screen4button2value0", true);
-        button2_valuearray.add(screen4button2value0->value().c_str());
-        AsyncWebParameter *screen4button2value1 =
-            request->getParam("screen4button2value1", true);
-        button2_valuearray.add(screen4button2value1->value().c_str());
-        AsyncWebParameter *screen4button2value2 =
-            request->getParam("screen4button2value2", true);
-        button2_valuearray.add(screen4button2value2->value().c_str());
-
-        JsonObject button3 = doc["button3"].to<JsonObject>();
-
-        if (request->hasParam("screen4button3latch", true)) {
-          button3["latch"] = true;
-        } else {
-          button3["latch"] = false;
-        }
-
-        AsyncWebParameter *screen4latchlogo3 =
-            request->getParam("screen4latchlogo3", true);
-        Serial.println(screen4latchlogo3->value().c_str());
-        if (strcmp(screen4latchlogo3->value().c_str(), "---") == 0) {
-          button3["latchlogo"] = "";
-        } else {
-          button3["latchlogo"] = screen4latchlogo3->value().c_str();
-        }
-
-        JsonArray button3_actionarray = button3["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen4button3action0 =
-            request->getParam("screen4button3action0", true);
-        button3_actionarray.add(screen4button3action0->value().c_str());
-        AsyncWebParameter *screen4button3action1 =
-            request->getParam("screen4button3action1", true);
-        button3_actionarray.add(screen4button3action1->value().c_str());
-        AsyncWebParameter *screen4button3action2 =
-            request->getParam("screen4button3action2", true);
-        button3_actionarray.add(screen4button3action2->value().c_str());
-
-        JsonArray button3_valuearray = button3["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen4button3value0 =
-            request->getParam("screen4button3value0", true);
-        button3_valuearray.add(screen4button3value0->value().c_str());
-        AsyncWebParameter *screen4button3value1 =
-            request->getParam("screen4button3value1", true);
-        button3_valuearray.add(screen4button3value1->value().c_str());
-        AsyncWebParameter *screen4button3value2 =
-            request->getParam("screen4button3value2", true);
-        button3_valuearray.add(screen4button3value2->value().c_str());
-
-        JsonObject button4 = doc["button4"].to<JsonObject>();
-
-        if (request->hasParam("screen4button4latch", true)) {
-          button4["latch"] = true;
-        } else {
-          button4["latch"] = false;
-        }
-
-        AsyncWebParameter *screen4latchlogo4 =
-            request->getParam("screen4latchlogo4", true);
-        Serial.println(screen4latchlogo4->value().c_str());
-        if (strcmp(screen4latchlogo4->value().c_str(), "---") == 0) {
-          button4["latchlogo"] = "";
-        } else {
-          button4["latchlogo"] = screen4latchlogo4->value().c_str();
-        }
-
-        JsonArray button4_actionarray = button4["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen4button4action0 =
-            request->getParam("screen4button4action0", true);
-        button4_actionarray.add(screen4button4action0->value().c_str());
-        AsyncWebParameter *screen4button4action1 =
-            request->getParam("screen4button4action1", true);
-        button4_actionarray.add(screen4button4action1->value().c_str());
-        AsyncWebParameter *screen4button4action2 =
-            request->getParam("screen4button4action2", true);
-        button4_actionarray.add(screen4button4action2->value().c_str());
-
-        JsonArray button4_valuearray = button4["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen4button4value0 =
-            request->getParam("screen4button4value0", true);
-        button4_valuearray.add(screen4button4value0->value().c_str());
-        AsyncWebParameter *screen4button4value1 =
-            request->getParam("screen4button4value1", true);
-        button4_valuearray.add(screen4button4value1->value().c_str());
-        AsyncWebParameter *screen4button4value2 =
-            request->getParam("screen4button4value2", true);
-        button4_valuearray.add(screen4button4value2->value().c_str());
-
-        if (serializeJsonPretty(doc, file) == 0) {
-          Serial.println("[WARNING]: Failed to write to file");
-        }
-        file.close();
-      } else if (savemode == "menu5") {
-
-        // --- Save menu 5
-
-        Serial.println("[INFO]: Saving Menu 5");
-        FILESYSTEM.remove("/config/menu5.json");
-        File file = FILESYSTEM.open("/config/menu5.json", "w");
-        if (!file) {
-          Serial.println("[WARNING]: Failed to create menu5.json");
-          return;
-        }
-
-        JsonDocument doc;
-
-        JsonObject menu = doc.to<JsonObject>();
-
-        AsyncWebParameter *screen5logo0 =
-            request->getParam("screen5logo0", true);
-        menu["logo0"] = screen5logo0->value().c_str();
-        AsyncWebParameter *screen5logo1 =
-            request->getParam("screen5logo1", true);
-        menu["logo1"] = screen5logo1->value().c_str();
-        AsyncWebParameter *screen5logo2 =
-            request->getParam("screen5logo2", true);
-        menu["logo2"] = screen5logo2->value().c_str();
-        AsyncWebParameter *screen5logo3 =
-            request->getParam("screen5logo3", true);
-        menu["logo3"] = screen5logo3->value().c_str();
-        AsyncWebParameter *screen5logo4 =
-            request->getParam("screen5logo4", true);
-        menu["logo4"] = screen5logo4->value().c_str();
-
-        JsonObject button0 = doc["button0"].to<JsonObject>();
-
-        if (request->hasParam("screen5button0latch", true)) {
-          button0["latch"] = true;
-        } else {
-          button0["latch"] = false;
-        }
-
-        AsyncWebParameter *screen5latchlogo0 =
-            request->getParam("screen5latchlogo0", true);
-        Serial.println(screen5latchlogo0->value().c_str());
-        if (strcmp(screen5latchlogo0->value().c_str(), "---") == 0) {
-          button0["latchlogo"] = "";
-        } else {
-          button0["latchlogo"] = screen5latchlogo0->value().c_str();
-        }
-
-        JsonArray button0_actionarray = button0["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen5button0action0 =
-            request->getParam("screen5button0action0", true);
-        button0_actionarray.add(screen5button0action0->value().c_str());
-        AsyncWebParameter *screen5button0action1 =
-            request->getParam("screen5button0action1", true);
-        button0_actionarray.add(screen5button0action1->value().c_str());
-        AsyncWebParameter *screen5button0action2 =
-            request->getParam("screen5button0action2", true);
-        button0_actionarray.add(screen5button0action2->value().c_str());
-
-        JsonArray button0_valuearray = button0["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen5button0value0 =
-            request->getParam("screen5button0value0", true);
-        button0_valuearray.add(screen5button0value0->value().c_str());
-        AsyncWebParameter *screen5button0value1 =
-            request->getParam("screen5button0value1", true);
-        button0_valuearray.add(screen5button0value1->value().c_str());
-        AsyncWebParameter *screen5button0value2 =
-            request->getParam("screen5button0value2", true);
-        button0_valuearray.add(screen5button0value2->value().c_str());
-
-        JsonObject button1 = doc["button1"].to<JsonObject>();
-
-        if (request->hasParam("screen5button1latch", true)) {
-          button1["latch"] = true;
-        } else {
-          button1["latch"] = false;
-        }
-
-        AsyncWebParameter *screen5latchlogo1 =
-            request->getParam("screen5latchlogo1", true);
-        Serial.println(screen5latchlogo1->value().c_str());
-        if (strcmp(screen5latchlogo1->value().c_str(), "---") == 0) {
-          button1["latchlogo"] = "";
-        } else {
-          button1["latchlogo"] = screen5latchlogo1->value().c_str();
-        }
-
-        JsonArray button1_actionarray = button1["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen5button1action0 =
-            request->getParam("screen5button1action0", true);
-        button1_actionarray.add(screen5button1action0->value().c_str());
-        AsyncWebParameter *screen5button1action1 =
-            request->getParam("screen5button1action1", true);
-        button1_actionarray.add(screen5button1action1->value().c_str());
-        AsyncWebParameter *screen5button1action2 =
-            request->getParam("screen5button1action2", true);
-        button1_actionarray.add(screen5button1action2->value().c_str());
-
-        JsonArray button1_valuearray = button1["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen5button1value0 =
-            request->getParam("screen5button1value0", true);
-        button1_valuearray.add(screen5button1value0->value().c_str());
-        AsyncWebParameter *screen5button1value1 =
-            request->getParam("screen5button1value1", true);
-        button1_valuearray.add(screen5button1value1->value().c_str());
-        AsyncWebParameter *screen5button1value2 =
-            request->getParam("screen5button1value2", true);
-        button1_valuearray.add(screen5button1value2->value().c_str());
-
-        JsonObject button2 = doc["button2"].to<JsonObject>();
-
-        if (request->hasParam("screen5button2latch", true)) {
-          button2["latch"] = true;
-        } else {
-          button2["latch"] = false;
-        }
-
-        AsyncWebParameter *screen5latchlogo2 =
-            request->getParam("screen5latchlogo2", true);
-        Serial.println(screen5latchlogo2->value().c_str());
-        if (strcmp(screen5latchlogo2->value().c_str(), "---") == 0) {
-          button2["latchlogo"] = "";
-        } else {
-          button2["latchlogo"] = screen5latchlogo2->value().c_str();
-        }
-
-        JsonArray button2_actionarray = button2["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen5button2action0 =
-            request->getParam("screen5button2action0", true);
-        button2_actionarray.add(screen5button2action0->value().c_str());
-        AsyncWebParameter *screen5button2action1 =
-            request->getParam("screen5button2action1", true);
-        button2_actionarray.add(screen5button2action1->value().c_str());
-        AsyncWebParameter *screen5button2action2 =
-            request->getParam("screen5button2action2", true);
-        button2_actionarray.add(screen5button2action2->value().c_str());
-
-        JsonArray button2_valuearray = button2["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen5button2value0 =
-            request->getParam("screen5button2value0", true);
-        button2_valuearray.add(screen5button2value0->value().c_str());
-        AsyncWebParameter *screen5button2value1 =
-            request->getParam("screen5button2value1", true);
-        button2_valuearray.add(screen5button2value1->value().c_str());
-        AsyncWebParameter *screen5button2value2 =
-            request->getParam("screen5button2value2", true);
-        button2_valuearray.add(screen5button2value2->value().c_str());
-
-        JsonObject button3 = doc["button3"].to<JsonObject>();
-
-        if (request->hasParam("screen5button3latch", true)) {
-          button3["latch"] = true;
-        } else {
-          button3["latch"] = false;
-        }
-
-        AsyncWebParameter *screen5latchlogo3 =
-            request->getParam("screen5latchlogo3", true);
-        Serial.println(screen5latchlogo3->value().c_str());
-        if (strcmp(screen5latchlogo3->value().c_str(), "---") == 0) {
-          button3["latchlogo"] = "";
-        } else {
-          button3["latchlogo"] = screen5latchlogo3->value().c_str();
-        }
-
-        JsonArray button3_actionarray = button3["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen5button3action0 =
-            request->getParam("screen5button3action0", true);
-        button3_actionarray.add(screen5button3action0->value().c_str());
-        AsyncWebParameter *screen5button3action1 =
-            request->getParam("screen5button3action1", true);
-        button3_actionarray.add(screen5button3action1->value().c_str());
-        AsyncWebParameter *screen5button3action2 =
-            request->getParam("screen5button3action2", true);
-        button3_actionarray.add(screen5button3action2->value().c_str());
-
-        JsonArray button3_valuearray = button3["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen5button3value0 =
-            request->getParam("screen5button3value0", true);
-        button3_valuearray.add(screen5button3value0->value().c_str());
-        AsyncWebParameter *screen5button3value1 =
-            request->getParam("screen5button3value1", true);
-        button3_valuearray.add(screen5button3value1->value().c_str());
-        AsyncWebParameter *screen5button3value2 =
-            request->getParam("screen5button3value2", true);
-        button3_valuearray.add(screen5button3value2->value().c_str());
-
-        JsonObject button4 = doc["button4"].to<JsonObject>();
-
-        if (request->hasParam("screen5button4latch", true)) {
-          button4["latch"] = true;
-        } else {
-          button4["latch"] = false;
-        }
-
-        AsyncWebParameter *screen5latchlogo4 =
-            request->getParam("screen5latchlogo4", true);
-        Serial.println(screen5latchlogo4->value().c_str());
-        if (strcmp(screen5latchlogo4->value().c_str(), "---") == 0) {
-          button4["latchlogo"] = "";
-        } else {
-          button4["latchlogo"] = screen5latchlogo4->value().c_str();
-        }
-
-        JsonArray button4_actionarray = button4["actionarray"].to<JsonArray>();
-        AsyncWebParameter *screen5button4action0 =
-            request->getParam("screen5button4action0", true);
-        button4_actionarray.add(screen5button4action0->value().c_str());
-        AsyncWebParameter *screen5button4action1 =
-            request->getParam("screen5button4action1", true);
-        button4_actionarray.add(screen5button4action1->value().c_str());
-        AsyncWebParameter *screen5button4action2 =
-            request->getParam("screen5button4action2", true);
-        button4_actionarray.add(screen5button4action2->value().c_str());
-
-        JsonArray button4_valuearray = button4["valuearray"].to<JsonArray>();
-        AsyncWebParameter *screen5button4value0 =
-            request->getParam("screen5button4value0", true);
-        button4_valuearray.add(screen5button4value0->value().c_str());
-        AsyncWebParameter *screen5button4value1 =
-            request->getParam("screen5button4value1", true);
-        button4_valuearray.add(screen5button4value1->value().c_str());
-        AsyncWebParameter *screen5button4value2 =
-            request->getParam("screen5button4value2", true);
-        button4_valuearray.add(screen5button4value2->value().c_str());
-
-        if (serializeJsonPretty(doc, file) == 0) {
-          Serial.println("[WARNING]: Failed to write to file");
-        }
-        file.close();
-      }
-
-      request->send(FILESYSTEM, "/saveconfig.htm");
-    }
-  });
+  webserver.on("/saveconfig", HTTP_POST, handleConfigPost, NULL,
+               handleConfigPostBody);
 
   //----------- File list handler -----------------
 
   webserver.on("/list", HTTP_GET, [](AsyncWebServerRequest *request) {
     if (request->hasParam("dir")) {
       AsyncWebParameter *p = request->getParam("dir");
-      request->send(200, "application/json",
-                    handleFileList(p->value().c_str()));
+      sendFileList(request, p->value().c_str(), false);
     }
   });
 
   webserver.on("/apislist", HTTP_GET, [](AsyncWebServerRequest *request) {
-    request->send(200, "application/json", handleAPISList());
+    sendFileList(request, "/uploads", true);
   });
 
   webserver.on("/info", HTTP_GET, [](AsyncWebServerRequest *request) {
-    request->send(200, "application/json", handleInfo());
+    sendInfo(request);
+  });
+
+  webserver.on("/latency", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send(200, "application/json", handleLatency());
   });
 
+  webserver.on("/metrics", HTTP_GET, handleMetrics);
+
+  //----------- Remote control handlers -----------------
+
+  webserver.on("/api/button", HTTP_POST, handleControlButton);
+  webserver.on("/api/page", HTTP_POST, handleControlPage);
+  webserver.on("/api/state", HTTP_GET, handleControlState);
+
+  liveSocket.onEvent(onLiveEvent);
+  webserver.addHandler(&liveSocket);
+
+  //----------- Screen mirror handlers -----------------
+
+  // The stream first, "/screen" would take it otherwise
+  webserver.on("/screen/stream", HTTP_GET, handleScreenStream);
+  webserver.on("/screen", HTTP_GET, handleScreen);
+
   //----------- 404 handler -----------------
 
   webserver.onNotFound([](AsyncWebServerRequest *request) {
@@ -1840,12 +1697,7 @@ void handlerSetup() {
       Serial.printf("BodyEnd: %u\n", total);
   });
 
-  webserver.on(
-      "/upload", HTTP_POST,
-      [](AsyncWebServerRequest *request) {
-        request->send(FILESYSTEM, "/upload.htm");
-      },
-      handleUpload);
+  webserver.on("/upload", HTTP_POST, handleUploadDone, handleUpload);
 
   webserver.on("/restart", HTTP_POST, [](AsyncWebServerRequest *request) {
     // First send some text to the browser otherwise an ugly browser error shows
@@ -1879,6 +1731,7 @@ void handlerSetup() {
       filename += p->value().c_str();
       if (FILESYSTEM.exists(filename)) {
         FILESYSTEM.remove(filename);
+        logoFileChanged(filename.c_str());
       }
 
       resultFiles += p->value().c_str();
@@ -0,0 +1,54 @@
+// Writes src/WebAssets.h: the configurator files of data/ as arrays in flash,
+// for a build with CONFIGURATOR_ASSETS_IN_FLASH. Run by "npm run build" after
+// the .gz files are made. The paths and the order match configuratorAssets in
+// src/AssetCache.h.
+const fs = require("fs");
+const path = require("path");
+
+const dataDir = path.join(__dirname, "..", "..", "data");
+const output = path.join(__dirname, "..", "WebAssets.h");
+const assets = ["/index.htm", "/jquery-3.5.1.slim.min.js", "/favicon.ico"];
+
+// The CRC32 of configSnapshotCrc32Update(), the ETags match a SPIFFS build
+function crc32(bytes) {
+  let crc = 0xffffffff;
+  for (const byte of bytes) {
+    crc ^= byte;
+    for (let bit = 0; bit < 8; bit++) {
+      crc = (crc >>> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+  }
+  return (crc ^ 0xffffffff) >>> 0;
+}
+
+const lines = [
+  "// Generated by src/configurator/embed-assets.js from data/, do not edit",
+  "#ifndef WEB_ASSETS_H",
+  "#define WEB_ASSETS_H",
+  "",
+];
+const entries = [];
+assets.forEach((asset, i) => {
+  let file = path.join(dataDir, asset);
+  const gzipped = fs.existsSync(file + ".gz");
+  if (gzipped) {
+    file += ".gz";
+  }
+  if (!fs.existsSync(file)) {
+    return;
+  }
+  const bytes = fs.readFileSync(file);
+  lines.push(`static const uint8_t webAsset${i}[] PROGMEM = {`);
+  for (let pos = 0; pos < bytes.length; pos += 16) {
+    const row = Array.from(bytes.subarray(pos, pos + 16), (b) => "0x" + b.toString(16).padStart(2, "0"));
+    lines.push("    " + row.join(", ") + ",");
+  }
+  lines.push("};", "");
+  entries.push(
+    `    {"${asset}", webAsset${i}, ${bytes.length}, 0x${crc32(bytes).toString(16).padStart(8, "0")}, ${gzipped}},`
+  );
+});
+lines.push("static const FlashAsset flashAssets[] = {", ...entries, "};", "", "#endif // WEB_ASSETS_H", "");
+
+fs.writeFileSync(output, lines.join("\n"));
+console.log(`Wrote ${entries.length} assets to ${output}`);
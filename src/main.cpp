@@ -34,9 +34,9 @@
       - Dustin Watts FT6236 Library (version 1.0.2),
   https://github.com/DustinWatts/FT6236
 
-  The FILESYSTEM (SPI FLASH filing system) is used to hold touch screen
-  calibration data. It has to be runs at least once when using resistive touch.
-  After that you can set REPEAT_CAL to false (default).
+  Touch screen calibration data is kept in NVS (Preferences). Calibration runs
+  once when using resistive touch and holds for any screen rotation. Set
+  REPEAT_CAL to true to force it on every boot, or send "cal" over serial.
 
   !-- Make sure you have setup your TFT display and ESP setup correctly in
   TFT_eSPI/user_setup.h --!
@@ -78,6 +78,20 @@
 
 #define USE_AIR_MOUSE
 
+// ------- Keep the BLE keyboard working while the configurator runs. WiFi and
+// BLE then share the radio and the heap, see shareRadioWithWifi(). Comment
+// out to stop BLE for the configurator, which leaves the most heap to it -------
+#define CONFIGURATOR_KEEP_BLE
+
+// ------- Uncomment to serve the configurator pages from flash instead of
+// SPIFFS. Run "npm run build" in src/configurator first, it writes
+// src/WebAssets.h from data/ -------
+// #define CONFIGURATOR_ASSETS_IN_FLASH
+
+// ------- Uploaded .bmp logos are converted to RGB565 and the upload itself is
+// not stored. Uncomment to also keep it, as /orig/<name> -------
+// #define UPLOAD_KEEP_ORIGINAL_LOGOS
+
 // Define the filesystem to be used. For now just SPIFFS.
 #define FILESYSTEM SPIFFS
 
@@ -97,6 +111,7 @@ const char *versionnumber = "0.9.18a";
 #include <FS.h>       // Filesystem support header
 #include <pgmspace.h> // PROGMEM support header
 #include <functional> // For std::function support
+#include <memory>     // std::shared_ptr for chunked responses
 
 #include <Preferences.h> // Used to store states before sleep/reboot
 
@@ -140,6 +155,7 @@ BLECombo bleCombo;
 #include "esp_bt_device.h" // Additional BLE functionaity
 #include "esp_bt_main.h"   // Additional BLE functionaity
 #include "esp_sleep.h"     // Additional BLE functionaity
+#include "esp_coexist.h"   // WiFi and BLE sharing the radio
 
 #include <ArduinoJson.h> // Using ArduinoJson to read and write config files
 
@@ -150,6 +166,30 @@ BLECombo bleCombo;
 
 #include <ESPmDNS.h> // DNS functionality
 
+#include "LatencyStats.h" // Touch to HID report latency histograms
+#include "MenuCache.h"    // Resident menu slots
+#include "DeckArena.h"    // Menus and buttons declared by the deck manifest
+#include "ActionCode.h"   // Button actions as bytecode with a text pool
+#include "IconTable.h"    // Logos interned once, referenced by id
+#include "ConfigReload.h" // Config files applied without a restart
+#include "ConfigSchema.h" // Fields the configurator may save
+#include "JsonChunk.h"    // JSON replies written one entry at a time
+#include "AssetCache.h"   // Configurator files with ETags and gzip
+#include "UploadAdmit.h"  // Logo uploads checked before they are written
+#include "IconTranscode.h" // Uploaded logos converted to RGB565 as they arrive
+#include "RemoteControl.h" // Button presses sent over HTTP
+#include "LiveState.h"     // Deck state pushed over a WebSocket
+#include "ScreenMirror.h"  // The keypad as an image for /screen
+#include "Metrics.h"       // Counters for /metrics and the serial monitor
+#ifdef CONFIGURATOR_ASSETS_IN_FLASH
+#include "WebAssets.h"     // Configurator files in flash, made by npm run build
+#endif
+#include "BootPlan.h"     // Boot stages that run on both cores
+#include "BootReport.h"   // Timings of the last boots
+
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+
 #ifdef USECAPTOUCH
 #include <FT6236.h>
 #include <Wire.h>
@@ -158,18 +198,47 @@ FT6236 ts = FT6236();
 
 AsyncWebServer webserver(80);
 
+// Pushes the state of the deck to the configurator, see LiveState.h
+AsyncWebSocket liveSocket("/ws");
+
+// The configurator is running, and BLE was kept running next to it
+bool webServerRunning = false;
+bool bleKeptWithWifi = false;
+// millis() of the last request, for the latency under load
+volatile unsigned long webActiveMs = 0;
+
+// Files of the configurator with their ETags, see AssetCache.h
+AssetCache assetCache;
+
 TFT_eSPI tft = TFT_eSPI();
 
 Preferences savedStates;
 
-// This is the file name used to store the calibration data
-// You can change this to create new calibration files.
-// The FILESYSTEM file name must start with "/".
-#define CALIBRATION_FILE "/TouchCalData"
+// This is the NVS key used to store the touch calibration data
+#define TOUCH_CAL_KEY "touchcal"
+
+// This is the NVS key the reports of the last boots are stored under
+#define BOOT_REPORT_KEY "bootreports"
+
+// This is the file touch traces are recorded to and replayed from.
+#define TOUCH_TRACE_FILE "/touchtrace.bin"
+
+// This is the manifest declaring the menus and their buttons, see DeckArena.h
+#define DECK_MANIFEST_FILE "/config/deck.json"
+
+// This is the file the parsed JSON config is cached in, see ConfigSnapshot.h
+#define CONFIG_SNAPSHOT_FILE "/config/snapshot.bin"
+
+// Snapshot sections: general config, home screen logos, then the logos, the
+// buttons and the action pool of every menu of the deck
+#define CONFIG_SNAPSHOT_SECTIONS (2 + 3 * deck.menuCount)
+#define CONFIG_SNAPSHOT_MENU(menuIndex) (2 + 3 * (menuIndex))
+
+// Opening a menu that is not resident should not take longer than this
+#define MENU_LOAD_BUDGET_US 20000
 
 // Set REPEAT_CAL to true instead of false to run calibration
 // again, otherwise it will only be done once.
-// Repeat calibration if you change the screen rotation.
 #define REPEAT_CAL false
 
 // Set the width and height of your screen here:
@@ -202,8 +271,17 @@ Preferences savedStates;
 #include "AirMouse.h"
 #endif
 
+// Pages. 1 - deck.menuCount are the menus, the special pages are numbered
+// above the largest possible deck.
+#define PAGE_HOME 0
+#define PAGE_SETTINGS 100
+#define PAGE_CONFIG_MODE 101 // STA or AP mode, only the restart button
+#define PAGE_INFO 102
+#define PAGE_WIFI_FAIL 103
+#define PAGE_JSON_ERROR 104  // A config file failed to load, see jsonfilefail
+
 // placeholder for the pagenumber we are on (0 indicates home)
-int pageNum = 0;
+int pageNum = PAGE_HOME;
 
 // Initial LED brightness
 int ledBrightness = 255;
@@ -213,44 +291,50 @@ char logopath[64] = "/logos/";
 
 char emptStr[] = "";
 
-// templogopath is used to hold the complete path of an image. It is empty for
-// now.
-char templogopath[64] = "";
+// Path of a logo as stored in the config snapshot, in RAM logos are IconIds
+typedef char IconPath[ICON_PATH_SIZE];
 
-// Struct to hold the logos per screen
+// Struct to hold the paths of the logos of the home screen
 struct Icons {
   char icons[6][32];  // 6 logos per screen, max 32 chars per path
 };
 
-// Struct for individual action with action, value and symbol
-struct Action {
-  uint8_t action;
-  uint8_t value;
-  char    symbol[64];
+// Each button has its actions as bytecode in the ActionPool of its menu
+struct Button {
+  struct ActionCode actions;
+  bool              latch;
+  IconId            latchLogo; // ICON_NONE: a latched key gets a dot instead
 };
 
-// Struct Actions: 3 actions per button
-struct Actions {
-  struct Action actions[3];
+// Logos of a button as stored in the config snapshot
+struct ButtonIconNames {
+  IconPath logo;
+  IconPath latchLogo; // "" when there is none
 };
 
-// Each button has an action struct in it
-struct Button {
-  struct Actions actions;
-  bool           latch;
-  char           latchlogo[32];
+// Buttons of a resident menu, in the deck arena
+struct Menu {
+  struct Button     *buttons;
+  struct ActionPool *actions; // Texts and bytecode of the buttons, on the heap
+                              // with just the bytes the menu uses
 };
 
-// Each menu has 6 buttons
-struct Menu {
-  struct Button buttons[6];  // 6 buttons per menu
+// A menu of the deck, records are in the deck arena
+struct MenuPage {
+  uint8_t   buttonCount;
+  uint16_t  firstButton; // Position of its first button in the whole deck
+  IconId   *icons;       // One logo per button
 };
 
 // Struct to hold the general logos.
 struct SystemIcons {
-  char settings[64];
-  char homebutton[64];
-  char configurator[64];
+  IconId settings;
+  IconId homebutton;
+  IconId configurator;
+  IconId brightnessDown;
+  IconId brightnessUp;
+  IconId sleep;
+  IconId info;
 };
 
 // Struct to hold the general config like colours.
@@ -266,6 +350,10 @@ struct Config {
   uint8_t  modifier2;
   uint8_t  modifier3;
   uint16_t helperdelay;
+  uint8_t  touchDeadZone;      // Pixels along the border of a key that are ignored
+  uint8_t  touchEdgeZone;      // Pixels along the screen edges that are ignored
+  uint8_t  touchMinContact[6]; // Minimum contact time per key in ms
+  bool     prefetchMenus;      // Load the most opened menus at boot
 };
 
 struct Wificonfig {
@@ -277,10 +365,6 @@ struct Wificonfig {
   uint16_t attemptdelay;
 };
 
-// Array to hold all the latching statuses
-bool islatched[30] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-
 // Create instances of the structs
 Wificonfig wificonfig;
 
@@ -288,9 +372,74 @@ Config generalconfig;
 
 SystemIcons systemIcons;
 
-Icons screens[7];  // Array for screen0 through screen6
+// Every logo that is drawn, see IconTable.h
+IconTable iconTable;
+
+IconId homeIcons[6];
+
+// Menus and buttons of the deck, see buildDeck()
+DeckManifest deck;
+DeckArena    deckArena;
+MenuPage    *menuPages;
+
+// Latch state of every button of the deck, in deck order
+uint8_t *latched;
+
+// Only MENU_CACHE_SLOTS menus are in memory, see loadMenu(). Each slot holds
+// as many buttons as the largest menu.
+Menu menuSlots[MENU_CACHE_SLOTS];
+
+// Menu files and snapshot sections are read into this pool, a resident menu
+// keeps a copy of the bytes it uses, see loadMenu()
+ActionPool menuParsePool;
+
+MenuCache menuCache;
+
+// How often each menu was opened, used to prefetch menus
+uint16_t menuVisits[MENU_CACHE_MENUS];
+static_assert(MENU_CACHE_MENUS == DECK_MAX_MENUS,
+              "every menu of the deck needs a visit count");
+
+// Name of the menu config file that failed to load, for jsonfilefail
+char menuFailName[8];
+
+// Set when a JSON config file changed and the snapshot has to be rebuilt
+volatile bool configSnapshotPending = false;
+
+// CONFIG_CHANGED_* bits of the config files loop() has to apply, see
+// applyConfigChanges()
+volatile uint32_t configChanged = 0;
+
+// Boot stages, in the order they run on their core. Core 1 (where setup()
+// and loop() run) owns the display, core 0 (where the BT controller runs)
+// brings up the HID link and the IMU meanwhile.
+enum BootStageId {
+  BOOT_NVS = 0,
+  BOOT_DISPLAY,
+  BOOT_TOUCH,
+  BOOT_FILESYSTEM,
+  BOOT_SPLASH,
+  BOOT_CALIBRATION,
+  BOOT_CONFIG,
+  BOOT_KEYPAD,
+  BOOT_HID,
+  BOOT_WIFI_CONFIG,
+  BOOT_WEB_HANDLERS,
+  BOOT_IMU,
+  BOOT_STAGE_COUNT
+};
+
+// Core the boot worker task runs on, setup() runs on the display core
+#define BOOT_WORKER_CORE 0
+#define BOOT_DISPLAY_CORE 1
 
-Menu menus[6];
+EventGroupHandle_t bootEvents;
+BootTimeline       bootTimeline;
+unsigned long      bootStartUs;
+BootReportLog      bootReports;
+
+// Defined next to the boot stage functions, before setup()
+extern const BootStage bootStages[BOOT_STAGE_COUNT];
 
 unsigned long previousMillis = 0;
 unsigned long Interval = 0;
@@ -300,9 +449,37 @@ const char* jsonfilefail = "";
 // Invoke the TFT_eSPI button class and create all the button objects
 TFT_eSPI_Button key[6];
 
+// What the keys were last drawn from, for /screen, see ScreenMirror.h
+MirrorScreen screenMirror;
+MirrorKey    mirrorStaged; // The key being drawn
+MirrorLayout screenLayout;
+// screenMirror is copied by the web server task
+portMUX_TYPE screenMirrorLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Bitmask of keys whose modifier-only actions are held down for a chord
+uint8_t chordHeldKeys = 0;
+
+// Latency from touch detection to HID report, per stage
+LatencyTracker inputLatency;
+
+// Loop time, touches, reports and load times, see Metrics.h
+DeckMetrics deckMetrics;
+
+// Button presses and page switches queued by the web server for loop()
+QueueHandle_t  controlQueue;
+// Latency from a control request coming in to its HID report
+LatencyTracker controlLatency;
+
 //--------- Function declarations ------------
 void playBeepTone(int frequency, int duration);
-void processButtonActions(struct Button* button, int latchIndex);
+void processButtonActions(const struct ActionPool& pool, struct Button* button,
+                          int latchIndex, int keyIndex = -1);
+void releaseKeysKeepingChord();
+void releaseChord();
+void printLatencyReport();
+void takeMetricsSnapshot(MetricsSnapshot &snapshot);
+void printMetrics();
+void handleTouchTraceCommand(const char* mode);
 bool loadConfigWithErrorHandling(const char* configName);
 void checkConfigFileExists(const char* filename);
 bool handleMenuSwitchCommand(const char* command);
@@ -310,12 +487,23 @@ void getButtonCoordinates(int buttonIndex, int& col, int& row);
 bool readSerialValue(char* buffer, size_t bufferSize);
 bool handleWifiConfigCommand(const char* command, const char* configType);
 void navigateToPage(int newPageNum, bool enableMouse = false);
+bool isMenuPage(int page);
+bool isKeypadPage(int page);
+bool isKeyLatched(uint8_t b);
+Menu *loadMenu(int menuIndex);
+Menu *residentMenu(int menuIndex);
+Menu &currentMenu();
 
 // Button handler function declarations
 void handleHomePageButton(int buttonIndex);
 void handleMenuPageButton(int buttonIndex);
 void handleSettingsPageButton(int buttonIndex);
 void handleButtonPress(int buttonIndex);
+void handleButtonRelease(int buttonIndex);
+void drawKeyUp(uint8_t b);
+void runControlCommands();
+void pushLiveState();
+uint8_t webServerLoad();
 
 //--------- Internal references ------------
 // (this needs to be below all structs etc..)
@@ -331,30 +519,27 @@ void handleButtonPress(int buttonIndex);
 //-------------------------------- SETUP
 //--------------------------------------------------------------
 
-void setup() {
-
-  // Use serial port
-  Serial.begin(115200);
-  Serial.setDebugOutput(true);
-  Serial.println("");
-
+/**
+ * @brief Read the saved states from NVS
+ */
+void bootNvs() {
   Serial.println("[INFO]: Loading saved brightness state");
   savedStates.begin("ftd", false);
 
   ledBrightness = savedStates.getInt("ledBrightness", 255);
 
-  Serial.println("[INFO]: Reading latch stated back from memory:");
-  savedStates.getBytes("latched", islatched, sizeof(islatched));
-
-  for (int i = 0; i < sizeof(islatched); i++) {
-
-    Serial.print(islatched[i]);
-  }
-  Serial.println("");
+  latencyReset(inputLatency);
+  latencyReset(controlLatency);
+  metricsReset(deckMetrics);
 
-  // Initialize touch handling
-  initializeTouchHandling();
+  menuCacheReset(menuCache);
+  savedStates.getBytes("menuvisits", menuVisits, sizeof(menuVisits));
+}
 
+/**
+ * @brief Switch on the backlight and initialise the TFT screen
+ */
+void bootDisplay() {
   // Setup PWM channel and attach pin bl_pin
   ledcSetup(0, 5000, 8);
 #ifdef TFT_BL
@@ -364,8 +549,6 @@ void setup() {
 #endif                         // defined(TFT_BL)
   ledcWrite(0, ledBrightness); // Start @ initial Brightness
 
-  // --------------- Init Display -------------------------
-
   // Initialise the TFT screen
   tft.init();
 
@@ -375,11 +558,19 @@ void setup() {
   // Clear the screen
   tft.fillScreen(TFT_BLACK);
 
-  esp_sleep_wakeup_cause_t wakeup_reason;
-  wakeup_reason = esp_sleep_get_wakeup_cause();
+  mirrorLayoutInit(screenLayout, SCREEN_WIDTH, SCREEN_HEIGHT, KEY_X, KEY_Y,
+                   KEY_W, KEY_H, KEY_SPACING_X, KEY_SPACING_Y,
+                   SCREEN_WIDTH < 480 ? 2 : 12);
+}
 
-  // -------------- Start filesystem ----------------------
+void bootTouch() {
+  initializeTouchHandling();
+}
 
+/**
+ * @brief Mount the filesystem, stops with a message on the screen if it fails
+ */
+void bootFilesystem() {
   if (!FILESYSTEM.begin()) {
     Serial.println("[ERROR]: FILESYSTEM initialisation failed!");
     drawErrorMessage(
@@ -389,29 +580,18 @@ void setup() {
   }
   Serial.println("[INFO]: FILESYSTEM initialised.");
 
+  // Finish config saves a power loss interrupted
+  recoverConfigFiles();
+
   // Check for free space
 
   Serial.print("[INFO]: Free Space: ");
   Serial.println(FILESYSTEM.totalBytes() - FILESYSTEM.usedBytes());
+}
 
-  //------------------ Load Wifi Config
-  //----------------------------------------------
-
-  Serial.println("[INFO]: Loading Wifi Config");
-  if (!loadMainConfig()) {
-    Serial.println("[WARNING]: Failed to load WiFi Credentials!");
-  } else {
-    Serial.println("[INFO]: WiFi Credentials Loaded");
-  }
-
-  // ----------------- Load webserver ---------------------
-
-  handlerSetup();
-
-  // ------------------- Splash screen ------------------
-
+void bootSplash() {
   // If we are woken up we do not need the splash screen
-  if (wakeup_reason > 0) {
+  if (esp_sleep_get_wakeup_cause() > 0) {
     // But we do draw something to indicate we are waking up
     tft.setTextFont(2);
     tft.println(" Waking up...");
@@ -426,31 +606,85 @@ void setup() {
     tft.printf("Loading version %s\n", versionnumber);
     Serial.printf("[INFO]: Loading version %s\n", versionnumber);
   }
+}
 
+void bootCalibration() {
 // Calibrate the touch screen and retrieve the scaling factors
 #ifndef USECAPTOUCH
   Serial.println("[INFO]: Waiting for touch calibration...");
   touch_calibrate();
   Serial.println("[INFO]: Touch calibration completed!");
 #endif // !defined(USECAPTOUCH)
+}
+
+/**
+ * @brief Load the config snapshot, only parse the JSON config files when it
+ *        is missing or stale. Menus are loaded when they are opened.
+ */
+void bootConfig() {
+  unsigned long configStartUs = micros();
+
+  // The deck decides the number of menus, so it comes first
+  buildDeck();
+
+  bool fromSnapshot = loadConfigSnapshot();
+  if (!fromSnapshot) {
+    // Check if all required configuration files exist
+    checkConfigFileExists("/config/general.json");
+    checkConfigFileExists("/config/homescreen.json");
+    for (int i = 1; i <= deck.menuCount; i++) {
+      char filename[24];
+      snprintf(filename, sizeof(filename), "/config/menu%d.json", i);
+      checkConfigFileExists(filename);
+    }
+
+    fromSnapshot = compileConfigSnapshot() && loadConfigSnapshot();
+  }
+
+  if (fromSnapshot) {
+    deckMetrics.configBootUs = micros() - configStartUs;
+    Serial.printf("[INFO]: Config loaded from snapshot in %lu us\n",
+                  (unsigned long)deckMetrics.configBootUs);
+  } else {
+    // The JSON config has errors, load the files one by one to find them
+    // Load all configuration files with error handling
+    loadConfigWithErrorHandling("general");
+    loadConfigWithErrorHandling("homescreen");
+    for (int i = 1; i <= deck.menuCount; i++) {
+      snprintf(menuFailName, sizeof(menuFailName), "menu%d", i);
+      if (!loadConfigWithErrorHandling(menuFailName)) {
+        break; // jsonfilefail points at menuFailName
+      }
+    }
+    deckMetrics.configBootUs = micros() - configStartUs;
+    Serial.printf("[INFO]: Config parsed from JSON in %lu us\n",
+                  (unsigned long)deckMetrics.configBootUs);
+  }
+
+  Serial.println("[INFO]: All configs loaded");
 
-  // Check if all required configuration files exist
-  checkConfigFileExists("/config/general.json");
-  checkConfigFileExists("/config/homescreen.json");
-  checkConfigFileExists("/config/menu1.json");
-  checkConfigFileExists("/config/menu2.json");
-  checkConfigFileExists("/config/menu3.json");
-  checkConfigFileExists("/config/menu4.json");
-  checkConfigFileExists("/config/menu5.json");
-
-  // After checking the config files exist, actually load them
-  if (!loadConfig("general")) {
-    Serial.println("[WARNING]: general.json seems to be corrupted!");
-    Serial.println("[WARNING]: To reset to default type 'reset general'.");
-    jsonfilefail = "general";
-    pageNum = 10;
+  if (generalconfig.prefetchMenus) {
+    prefetchMenus();
   }
 
+  // The key grid is the same on every page, the touch layout only depends on
+  // the general config
+  buildTouchLayout();
+
+  systemIcons.settings = internIcon("/sys/ico/", "settings.bmp");
+  systemIcons.homebutton = internIcon("/sys/ico/", "home.bmp");
+  systemIcons.configurator = internIcon("/sys/ico/", "wifi.bmp");
+  systemIcons.brightnessDown = internIcon("/sys/ico/", "brightnessdown.bmp");
+  systemIcons.brightnessUp = internIcon("/sys/ico/", "brightnessup.bmp");
+  systemIcons.sleep = internIcon("/sys/ico/", "sleep.bmp");
+  systemIcons.info = internIcon("/sys/ico/", "info.bmp");
+  Serial.printf("[INFO]: General logos loaded, %u logos in use\n", iconTable.count);
+}
+
+/**
+ * @brief Draw the first page, from here on the keypad can be used
+ */
+void bootKeypad() {
   // Setup PWM channel for Piezo speaker
 
 #ifdef speakerPin
@@ -463,26 +697,29 @@ void setup() {
 
 #endif // defined(speakerPin)
 
-  // Load all configuration files with error handling
-  loadConfigWithErrorHandling("homescreen");
-  loadConfigWithErrorHandling("menu1");
-  loadConfigWithErrorHandling("menu2");
-  loadConfigWithErrorHandling("menu3");
-  loadConfigWithErrorHandling("menu4");
-  loadConfigWithErrorHandling("menu5");
-  Serial.println("[INFO]: All configs loaded");
-
-  strcpy(systemIcons.settings, "/sys/ico/settings.bmp");
-  strcpy(systemIcons.homebutton, "/sys/ico/home.bmp");
-  strcpy(systemIcons.configurator, "/sys/ico/wifi.bmp");
-  Serial.println("[INFO]: General logos loaded.");
-
   // Setup the Font used for plain text
   tft.setFreeFont(LABEL_FONT);
 
-  //------------------BLE Initialization
-  //------------------------------------------------------------------------
+  // Draw background
+  tft.fillScreen(generalconfig.backgroundColour);
+
+  // Draw keypad
+  Serial.println("[INFO]: Drawing keypad");
+  drawKeypad();
+
+#ifdef touchInterruptPin
+  if (generalconfig.sleepenable) {
+    pinMode(touchInterruptPin, INPUT_PULLUP);
+    Interval = generalconfig.sleeptimer * 60000;
+    Serial.println("[INFO]: Sleep enabled.");
+    Serial.print("[INFO]: Sleep timer = ");
+    Serial.print(generalconfig.sleeptimer);
+    Serial.println(" minutes");
+  }
+#endif // defined(touchInterruptPin)
+}
 
+void bootHid() {
 #if defined(USEUSBHID)
 
   // initialize control over the keyboard:
@@ -490,11 +727,31 @@ void setup() {
   USB.begin();
 
 #else
+  // Classic Bluetooth is never used, its controller memory is left to WiFi
+  // and the web server. Only possible before the controller starts.
+  esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT);
   bleCombo.begin();
   Serial.println("[INFO]: Starting BLE");
 
 #endif // if defined(USEUSBHID)
+}
+
+void bootWifiConfig() {
+  Serial.println("[INFO]: Loading Wifi Config");
+  if (!loadMainConfig() &&
+      !(rollbackConfigFile("/config/wificonfig.json") && loadMainConfig())) {
+    Serial.println("[WARNING]: Failed to load WiFi Credentials!");
+  } else {
+    Serial.println("[INFO]: WiFi Credentials Loaded");
+  }
+}
+
+void bootWebHandlers() {
+  controlQueue = xQueueCreate(CONTROL_QUEUE_SIZE, sizeof(ControlCommand));
+  handlerSetup();
+}
 
+void bootImu() {
 #ifdef USE_AIR_MOUSE
 
   Wire.begin(I2C_GYRO_SDA, I2C_GYRO_SCL, 100000);
@@ -514,6 +771,120 @@ void setup() {
     ;
 
 #endif
+}
+
+// The IMU shares the I2C bus with the capacitive touch controller, so it is
+// only started after the touch controller. Nothing on core 0 draws.
+const BootStage bootStages[BOOT_STAGE_COUNT] = {
+    {"nvs", BOOT_DISPLAY_CORE, 0, bootNvs},
+    {"display", BOOT_DISPLAY_CORE, BOOT_AFTER(BOOT_NVS), bootDisplay},
+    {"touch", BOOT_DISPLAY_CORE, 0, bootTouch},
+    {"filesystem", BOOT_DISPLAY_CORE, BOOT_AFTER(BOOT_DISPLAY),
+     bootFilesystem},
+    {"splash", BOOT_DISPLAY_CORE, BOOT_AFTER(BOOT_FILESYSTEM), bootSplash},
+    {"calibration", BOOT_DISPLAY_CORE,
+     BOOT_AFTER(BOOT_SPLASH) | BOOT_AFTER(BOOT_TOUCH), bootCalibration},
+    {"config", BOOT_DISPLAY_CORE,
+     BOOT_AFTER(BOOT_FILESYSTEM) | BOOT_AFTER(BOOT_NVS), bootConfig},
+    {"keypad", BOOT_DISPLAY_CORE,
+     BOOT_AFTER(BOOT_CONFIG) | BOOT_AFTER(BOOT_CALIBRATION), bootKeypad},
+    {"hid", BOOT_WORKER_CORE, 0, bootHid},
+    {"wificonfig", BOOT_WORKER_CORE, BOOT_AFTER(BOOT_FILESYSTEM),
+     bootWifiConfig},
+    {"webhandlers", BOOT_WORKER_CORE, BOOT_AFTER(BOOT_FILESYSTEM),
+     bootWebHandlers},
+    {"imu", BOOT_WORKER_CORE, BOOT_AFTER(BOOT_TOUCH), bootImu},
+};
+
+/**
+ * @brief Run the boot stages of one core, each after the stages it depends on
+ */
+void runBootStages(uint8_t core) {
+  for (uint8_t i = 0; i < BOOT_STAGE_COUNT; i++) {
+    const BootStage &stage = bootStages[i];
+    if (stage.core != core) {
+      continue;
+    }
+    if (stage.after) {
+      xEventGroupWaitBits(bootEvents, stage.after, pdFALSE, pdTRUE,
+                          portMAX_DELAY);
+    }
+    bootTimeline.startUs[i] = micros() - bootStartUs;
+    stage.run();
+    bootTimeline.endUs[i] = micros() - bootStartUs;
+    xEventGroupSetBits(bootEvents, BOOT_AFTER(i));
+  }
+}
+
+void bootWorker(void *parameter) {
+  runBootStages(BOOT_WORKER_CORE);
+  vTaskDelete(NULL);
+}
+
+/**
+ * @brief Print when every boot stage ran and how long it took until the
+ *        keypad could be used
+ */
+void printBootTimeline(uint32_t totalUs) {
+  char line[96];
+  Serial.println("[INFO]: Boot timeline:");
+  for (uint8_t i = 0; i < BOOT_STAGE_COUNT; i++) {
+    bootTimelineLine(line, sizeof(line), bootStages[i], bootTimeline.startUs[i],
+                     bootTimeline.endUs[i], totalUs, 40);
+    Serial.printf("[INFO]:   %s\n", line);
+  }
+  Serial.printf("[INFO]: Keypad drawn after %.1f ms, usable after %.1f ms\n",
+                bootTimeline.endUs[BOOT_KEYPAD] / 1000.0, totalUs / 1000.0);
+}
+
+/**
+ * @brief Add the report of this boot to the ones stored in NVS
+ *
+ * @param totalUs Time from the start of setup() until the keypad was usable
+ *
+ * @note Waking from deep sleep runs the same stages as a cold boot, the
+ *       reports are marked so the wake-to-ready time can be told apart.
+ */
+void saveBootReport(uint32_t totalUs) {
+  size_t len = savedStates.getBytes(BOOT_REPORT_KEY, &bootReports,
+                                    sizeof(bootReports));
+  if (!bootReportLogValid(bootReports, len)) {
+    bootReportLogReset(bootReports);
+  }
+
+  bool wake = esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED;
+  BootReport &report = bootReportLogAdd(bootReports, bootTimeline,
+                                        BOOT_STAGE_COUNT, BOOT_KEYPAD, totalUs,
+                                        wake);
+  savedStates.putBytes(BOOT_REPORT_KEY, &bootReports, sizeof(bootReports));
+
+  char line[64];
+  bootReportSummary(line, sizeof(line), report, bootStages, BOOT_STAGE_COUNT);
+  Serial.printf("[INFO]: Boot report %s\n", line);
+}
+
+void setup() {
+
+  // Use serial port
+  Serial.begin(115200);
+  Serial.setDebugOutput(true);
+  Serial.println("");
+
+  if (!bootPlanValid(bootStages, BOOT_STAGE_COUNT)) {
+    Serial.println("[ERROR]: Boot stages wait on each other, fix bootStages!");
+  }
+
+  bootStartUs = micros();
+  bootEvents = xEventGroupCreate();
+  xTaskCreatePinnedToCore(bootWorker, "boot", 8192, NULL, 1, NULL,
+                          BOOT_WORKER_CORE);
+  runBootStages(BOOT_DISPLAY_CORE);
+
+  // loop() needs the HID link, so wait for the worker too
+  uint32_t all = BOOT_AFTER(BOOT_STAGE_COUNT) - 1;
+  xEventGroupWaitBits(bootEvents, all, pdFALSE, pdTRUE, portMAX_DELAY);
+  uint32_t totalUs = micros() - bootStartUs;
+  vEventGroupDelete(bootEvents);
 
     // ---------------- Printing version numbers
     // -----------------------------------------------
@@ -530,34 +901,93 @@ void setup() {
   Serial.print("[INFO]: TFT_eSPI version: ");
   Serial.println(TFT_ESPI_VERSION);
 
-  // ---------------- Start the first keypad -------------
+  printBootTimeline(totalUs);
+  saveBootReport(totalUs);
+  Serial.println("[INFO]: Boot completed and successful!");
+}
 
-  // Draw background
-  tft.fillScreen(generalconfig.backgroundColour);
+/**
+ * @brief Apply the config files that changed without a restart. Only those
+ *        files are read again and only the keys on screen that look
+ *        different are drawn again, the HID connection stays up.
+ *
+ * @note A file with errors leaves the running config as it is. A new deck
+ *       manifest needs a restart, the deck arena is sized by it.
+ */
+void applyConfigChanges() {
+  uint32_t changed = __atomic_exchange_n(&configChanged, 0, __ATOMIC_SEQ_CST);
+  unsigned long startUs = micros();
+  uint8_t keys = 0;
+  bool wholeScreen = false;
+
+  if (changed & CONFIG_CHANGED_DECK) {
+    Serial.println("[WARNING]: deck.json changed, restart to use the new deck");
+  }
 
-  // Draw keypad
-  Serial.println("[INFO]: Drawing keypad");
-  drawKeypad();
+  if (changed & CONFIG_CHANGED_GENERAL) {
+    Config config;
+    if (loadGeneralConfig(config)) {
+      keys |= generalConfigKeysChanged(generalconfig, config);
+      wholeScreen = config.backgroundColour != generalconfig.backgroundColour;
+      bool touchChanged = touchConfigChanged(generalconfig, config);
+      generalconfig = config;
+      if (touchChanged) {
+        buildTouchLayout();
+      }
+      if (generalconfig.sleepenable) {
+        Interval = generalconfig.sleeptimer * 60000;
+      }
+    } else {
+      Serial.println("[ERROR]: general.json has errors, keeping the running config");
+    }
+  }
 
-#ifdef touchInterruptPin
-  if (generalconfig.sleepenable) {
-    pinMode(touchInterruptPin, INPUT_PULLUP);
-    Interval = generalconfig.sleeptimer * 60000;
-    Serial.println("[INFO]: Sleep enabled.");
-    Serial.print("[INFO]: Sleep timer = ");
-    Serial.print(generalconfig.sleeptimer);
-    Serial.println(" minutes");
-    islatched[28] = 1;
+  if (changed & CONFIG_CHANGED_HOME) {
+    keys |= reloadHomeIcons();
   }
-#endif // defined(touchInterruptPin)
 
-  Serial.println("[INFO]: Boot completed and successful!");
+  for (int i = 0; i < deck.menuCount; i++) {
+    if (changed & CONFIG_CHANGED_MENU(i)) {
+      keys |= reloadMenu(i);
+    }
+  }
+
+  if (changed & CONFIG_CHANGED_LOGOS) {
+    keys |= keysWithStaleIcons();
+  }
+
+  // Logos that were replaced leave their ids behind
+  releaseUnusedIcons();
+
+  // A file that failed to load may just have been fixed or reset
+  if (pageNum == PAGE_JSON_ERROR && (changed & ~CONFIG_CHANGED_LOGOS)) {
+    pageNum = PAGE_HOME;
+    wholeScreen = true;
+  }
+
+  if (!isKeypadPage(pageNum)) {
+    keys = 0;
+  } else if (wholeScreen) {
+    tft.fillScreen(generalconfig.backgroundColour);
+    keys = CONFIG_ALL_KEYS;
+  }
+  drawKeys(keys);
+
+  uint8_t drawn = 0;
+  for (uint8_t b = 0; b < 6; b++) {
+    drawn += (keys >> b) & 1;
+  }
+  unsigned long elapsedUs = micros() - startUs;
+  latencyHistogramRecord(deckMetrics.reloadUs, elapsedUs);
+  Serial.printf("[INFO]: Config reloaded in %lu us, %u keys drawn again\n",
+                elapsedUs, drawn);
 }
 
 //--------------------- LOOP
 //---------------------------------------------------------------------
 bool mouseEnabled = false;
 void loop(void) {
+  metricsLoopStart(deckMetrics, micros());
 
   if (mouseEnabled) {
     while (i2cRead(0x3B, i2cData, 14))
@@ -581,6 +1011,19 @@ void loop(void) {
     delay(6);
   }
 
+  // A JSON config file was saved, apply it and rebuild the config snapshot
+  // for the next boot
+  if (configChanged) {
+    applyConfigChanges();
+  }
+  if (configSnapshotPending) {
+    compileConfigSnapshot();
+  }
+
+  // Presses and page switches sent to the web server
+  runControlCommands();
+  pushLiveState();
+
   // Check if there is data available on the serial input that needs to be
   // handled.
 
@@ -591,12 +1034,24 @@ void loop(void) {
     command[len] = '\0';  // Null terminate
 
     if (strcmp(command, "cal") == 0) {
-      FILESYSTEM.remove(CALIBRATION_FILE);
+      savedStates.remove(TOUCH_CAL_KEY);
       ESP.restart();
     } else if (handleWifiConfigCommand(command, "setssid") ||
                handleWifiConfigCommand(command, "setpassword") ||
                handleWifiConfigCommand(command, "setwifimode")) {
       // WiFi config commands handled by helper function
+    } else if (strcmp(command, "trace") == 0) {
+      char mode[16];
+      if (readSerialValue(mode, sizeof(mode))) {
+        handleTouchTraceCommand(mode);
+      }
+    } else if (strcmp(command, "latency") == 0) {
+      printLatencyReport();
+    } else if (strcmp(command, "metrics") == 0) {
+      printMetrics();
+    } else if (strcmp(command, "latencyreset") == 0) {
+      latencyReset(inputLatency);
+      Serial.println("[INFO]: Latency histograms cleared");
     } else if (strcmp(command, "restart") == 0) {
       Serial.println("[WARNING]: Restarting");
       ESP.restart();
@@ -612,16 +1067,23 @@ void loop(void) {
     }
   }
 
-  if (pageNum == 7) {
-    // If pageNum = 7, we are in STA or AP mode.
+  if (pageNum == PAGE_CONFIG_MODE) {
+    // We are in STA or AP mode.
     // Check if the restart button is pressed and restart if so.
-    if (handleSimpleButtonTouch(140, 180, 340, 260)) {
+    TouchState touch = getTouchInput();
+    if (isTouchInBounds(touch, 140, 180, 340, 260)) {
       // Touch falls within the restart button boundaries
       Serial.println("[WARNING]: Restarting");
       ESP.restart();
+    } else if (bleKeptWithWifi && touch.pressed && touch.valid) {
+      // The keyboard still works, go back to it. The configurator keeps
+      // running.
+      pageNum = PAGE_SETTINGS;
+      tft.fillScreen(generalconfig.backgroundColour);
+      drawKeypad();
     }
 
-  } else if (pageNum == 8) {
+  } else if (pageNum == PAGE_INFO) {
 
     if (!displayinginfo) {
       printinfo();
@@ -631,11 +1093,11 @@ void loop(void) {
     TouchState touch = getTouchInput();
     if (touch.pressed && touch.valid) {
       displayinginfo = false;
-      pageNum = 6;
+      pageNum = PAGE_SETTINGS;
       tft.fillScreen(generalconfig.backgroundColour);
       drawKeypad();
     }
-  } else if (pageNum == 9) {
+  } else if (pageNum == PAGE_WIFI_FAIL) {
 
     // We were unable to connect to WiFi. Waiting for touch to get back to the
     // settings menu.
@@ -643,11 +1105,11 @@ void loop(void) {
     if (touch.pressed && touch.valid) {
       // Return to Settings page
       displayinginfo = false;
-      pageNum = 6;
+      pageNum = PAGE_SETTINGS;
       tft.fillScreen(generalconfig.backgroundColour);
       drawKeypad();
     }
-  } else if (pageNum == 10) {
+  } else if (pageNum == PAGE_JSON_ERROR) {
 
     // A JSON file failed to load. We are drawing an error message. And waiting
     // for a touch.
@@ -655,7 +1117,7 @@ void loop(void) {
     if (touch.pressed && touch.valid) {
       // Load home screen
       displayinginfo = false;
-      pageNum = 0;
+      pageNum = PAGE_HOME;
       tft.fillScreen(generalconfig.backgroundColour);
       drawKeypad();
     }
@@ -676,15 +1138,7 @@ void loop(void) {
         playBeepTone(600, 150);
         Serial.println("[INFO]: Saving latched states");
 
-        //        You could uncomment this to see the latch stated before going
-        //        to sleep for(int i = 0; i < sizeof(islatched); i++){
-        //
-        //        Serial.print(islatched[i]);
-        //
-        //        }
-        //        Serial.println("");
-
-        savedStates.putBytes("latched", &islatched, sizeof(islatched));
+        savedStates.putBytes("latched", latched, deckButtonTotal(deck));
         esp_sleep_enable_ext0_wakeup(touchInterruptPin, 0);
         esp_deep_sleep_start();
       }
@@ -697,62 +1151,14 @@ void loop(void) {
     // Check if any key has changed state
     for (uint8_t b = 0; b < 6; b++) {
       if (key[b].justReleased()) {
-
-        // Draw normal button space (non inverted)
-
-        int col, row;
-        getButtonCoordinates(b, col, row);
-
-        int latchIdx;
-
-       latchIdx = b + (pageNum > 1 ? (pageNum - 1) * 5 : 0);
-
-        uint16_t buttonBG;
-        bool     drawTransparent;
-
-        uint16_t imageBGColor;
-        if (islatched[latchIdx] && b < 5) {
-          imageBGColor = getLatchImageBG(b);
-        } else {
-          imageBGColor = getImageBG(b);
-        }
-
-        if (imageBGColor > 0) {
-          buttonBG = imageBGColor;
-          drawTransparent = false;
-        } else {
-          if (pageNum == 0) {
-            buttonBG = generalconfig.menuButtonColour;
-            drawTransparent = true;
-          } else {
-            if (pageNum == 6 && b == 5) {
-              buttonBG = generalconfig.menuButtonColour;
-              drawTransparent = true;
-            } else {
-              buttonBG = generalconfig.functionButtonColour;
-              drawTransparent = true;
-            }
-          }
-        }
-        tft.setFreeFont(LABEL_FONT);
-        key[b].initButton(
-            &tft, KEY_X + col * (KEY_W + KEY_SPACING_X),
-            KEY_Y + row * (KEY_H +
-                           KEY_SPACING_Y), // x, y, w, h, outline, fill, text
-            KEY_W, KEY_H, TFT_WHITE, buttonBG, TFT_WHITE, emptStr,
-            KEY_TEXTSIZE);
-        key[b].drawButton();
-
-        // After drawing the button outline we call this to draw a logo.
-        if (islatched[latchIdx] && b < 5) {
-          drawIcon(b, col, row, drawTransparent, true);
-        } else {
-          drawIcon(b, col, row, drawTransparent, false);
-        }
+        handleButtonRelease(b);
+        drawKeyUp(b);
       }
 
       if (key[b].justPressed()) {
 
+        latencyMark(inputLatency, LAT_JUST_PRESSED, micros());
+
         // Beep
         // Play button press beep
         playBeepTone(600, 50);
@@ -769,6 +1175,7 @@ void loop(void) {
             KEY_W, KEY_H, TFT_WHITE, TFT_WHITE, TFT_WHITE, emptStr,
             KEY_TEXTSIZE);
         key[b].drawButton();
+        mirrorKeyPressed(b);
 
         //---Button press handeling
         //--------------------------------------------------
@@ -781,6 +1188,58 @@ void loop(void) {
   }
 }
 
+/**
+ * @brief Draw a key as it looks when it is not pressed
+ * @param b Index of the key (0-5)
+ */
+void drawKeyUp(uint8_t b) {
+  int col, row;
+  getButtonCoordinates(b, col, row);
+
+  bool keyLatched = isKeyLatched(b);
+
+  uint16_t buttonBG;
+  bool     drawTransparent;
+
+  uint16_t imageBGColor;
+  if (keyLatched) {
+    imageBGColor = getLatchImageBG(b);
+  } else {
+    imageBGColor = getImageBG(b);
+  }
+
+  if (imageBGColor > 0) {
+    buttonBG = imageBGColor;
+    drawTransparent = false;
+  } else {
+    if (pageNum == PAGE_HOME) {
+      buttonBG = generalconfig.menuButtonColour;
+      drawTransparent = true;
+    } else {
+      if (pageNum == PAGE_SETTINGS && b == 5) {
+        buttonBG = generalconfig.menuButtonColour;
+        drawTransparent = true;
+      } else {
+        buttonBG = generalconfig.functionButtonColour;
+        drawTransparent = true;
+      }
+    }
+  }
+  tft.setFreeFont(LABEL_FONT);
+  key[b].initButton(
+      &tft, KEY_X + col * (KEY_W + KEY_SPACING_X),
+      KEY_Y + row * (KEY_H +
+                     KEY_SPACING_Y), // x, y, w, h, outline, fill, text
+      KEY_W, KEY_H, TFT_WHITE, buttonBG, TFT_WHITE, emptStr,
+      KEY_TEXTSIZE);
+  mirrorKeyBegin(buttonBG);
+  key[b].drawButton();
+
+  // After drawing the button outline we call this to draw a logo.
+  drawIcon(b, col, row, drawTransparent, keyLatched);
+  mirrorKeyEnd(b);
+}
+
 /**
  * @brief Play a beep tone on the speaker
  * @param frequency The frequency of the tone in Hz
@@ -799,44 +1258,96 @@ void playBeepTone(int frequency, int duration) {
 }
 
 /**
- * @brief Process button actions (3 sequential actions) and handle latch state
+ * @brief Run the actions of a button in order and handle latch state
+ * @param pool ActionPool of the menu the button is on
  * @param button Pointer to the button structure containing the actions
- * @param latchIndex Index in the islatched array for this button
+ * @param latchIndex Index in the latched array for this button
+ * @param keyIndex Index of the pressed key, used to hold modifiers for chords
+ *
+ * @note A button that only presses modifiers keeps them held for as long as
+ *       its key is touched, so a second key pressed meanwhile is combined
+ *       with them (e.g. CTRL held on one key, "t" sent by another).
  */
-void processButtonActions(struct Button* button, int latchIndex) {
-  // Execute the three button actions sequentially
-  bleKeyboardAction(button->actions.actions[0].action,
-                    button->actions.actions[0].value,
-                    button->actions.actions[0].symbol);
-  bleKeyboardAction(button->actions.actions[1].action,
-                    button->actions.actions[1].value,
-                    button->actions.actions[1].symbol);
-  bleKeyboardAction(button->actions.actions[2].action,
-                    button->actions.actions[2].value,
-                    button->actions.actions[2].symbol);
-  bleCombo.keyReleaseAll();
+void processButtonActions(const struct ActionPool& pool, struct Button* button,
+                          int latchIndex, int keyIndex) {
+  // Execute the button actions sequentially
+  ActionOp op;
+  uint8_t  pos = 0;
+  while (actionCodeNext(pool, button->actions, pos, op)) {
+    bleKeyboardAction(op.action, op.value, op.text);
+  }
+
+  if (keyIndex >= 0 && actionCodeModifiersOnly(pool, button->actions)) {
+    // Keep the modifiers down until the key is released
+    chordHeldKeys |= (1 << keyIndex);
+  } else {
+    releaseKeysKeepingChord();
+  }
   
   // Handle latch state if this button is configured as a latch
   if (button->latch) {
-    if (islatched[latchIndex]) {
-      islatched[latchIndex] = 0;
-    } else {
-      islatched[latchIndex] = 1;
+    latched[latchIndex] = !latched[latchIndex];
+  }
+}
+
+/**
+ * @brief Release all keys, then press again the modifiers of keys that are
+ *        still held for a chord
+ */
+void releaseKeysKeepingChord() {
+  bleCombo.keyReleaseAll();
+  deckMetrics.hidReports++;
+  latencyMark(inputLatency, LAT_HID_REPORT, micros());
+
+  if (chordHeldKeys == 0 || !isMenuPage(pageNum)) {
+    return;
+  }
+
+  Menu& menu = currentMenu();
+  for (uint8_t b = 0; b < menuPages[pageNum - 1].buttonCount; b++) {
+    if (chordHeldKeys & (1 << b)) {
+      ActionOp op;
+      uint8_t  pos = 0;
+      while (actionCodeNext(*menu.actions, menu.buttons[b].actions, pos, op)) {
+        bleKeyboardAction(op.action, op.value, op.text);
+      }
     }
   }
 }
 
 /**
- * @brief Load a configuration file with standardized error handling
+ * @brief Drop any held chord modifiers, used when leaving a page
+ */
+void releaseChord() {
+  if (chordHeldKeys != 0) {
+    chordHeldKeys = 0;
+    bleCombo.keyReleaseAll();
+  }
+}
+
+/**
+ * @brief Load a configuration file with standardized error handling. A file
+ *        that does not load is replaced by its previous version if there is
+ *        one.
  * @param configName Name of the configuration (without .json extension)
  * @return true if successful, false if failed
  */
 bool loadConfigWithErrorHandling(const char* configName) {
-  if (!loadConfig(configName)) {
+  unsigned long startMs = millis();
+  bool loaded = loadConfig(configName);
+  if (!loaded && strncmp(configName, "menu", 4) != 0) {
+    // Menus go back to their previous version in loadMenu()
+    char path[32];
+    snprintf(path, sizeof(path), "/config/%s.json", configName);
+    loaded = rollbackConfigFile(path) && loadConfig(configName);
+  }
+  Serial.printf("[INFO]: %s.json loaded in %lu ms\n", configName,
+                millis() - startMs);
+  if (!loaded) {
     Serial.printf("[WARNING]: %s.json seems to be corrupted!\n", configName);
     Serial.printf("[WARNING]: To reset to default type 'reset %s'.\n", configName);
     jsonfilefail = configName;
-    pageNum = 10;
+    pageNum = PAGE_JSON_ERROR;
     return false;
   }
   return true;
@@ -860,16 +1371,12 @@ void checkConfigFileExists(const char* filename) {
  * @return true if the command was handled, false otherwise
  */
 bool handleMenuSwitchCommand(const char* command) {
-  // Check each menu command (menu1 through menu5)
-  for (int menuNumber = 1; menuNumber <= 5; menuNumber++) {
-    char expectedCommand[10];
-    sprintf(expectedCommand, "menu%d", menuNumber);
-    if (strcmp(command, expectedCommand) == 0 && pageNum != menuNumber && pageNum != 7) {
-      pageNum = menuNumber;
-      drawKeypad();
-      Serial.printf("Auto Switched to Menu %d\n", menuNumber);
-      return true;
-    }
+  // Check for a menu command (menu1 up to the number of menus)
+  int menuNumber = deckMenuNumber(command, "");
+  if (isMenuPage(menuNumber) && pageNum != menuNumber && pageNum != PAGE_CONFIG_MODE) {
+    navigateToPage(menuNumber);
+    Serial.printf("Auto Switched to Menu %d\n", menuNumber);
+    return true;
   }
   return false;
 }
@@ -903,6 +1410,17 @@ uint8_t colArray[6] = {0, 1, 2, 0, 1, 2};
  * @param enableMouse Whether to enable mouse functionality
  */
 void navigateToPage(int newPageNum, bool enableMouse) {
+  releaseChord();
+
+  // Menus are loaded on demand, show the JSON error page if that fails
+  if (isMenuPage(newPageNum) && !openMenu(newPageNum - 1)) {
+    snprintf(menuFailName, sizeof(menuFailName), "menu%d", newPageNum);
+    jsonfilefail = menuFailName;
+    pageNum = PAGE_JSON_ERROR;
+    drawKeypad();
+    return;
+  }
+
   pageNum = newPageNum;
   if (enableMouse) {
     mouseEnabled = true;
@@ -911,17 +1429,27 @@ void navigateToPage(int newPageNum, bool enableMouse) {
 }
 
 /**
- * @brief Handle button press for home page (pageNum == 0)
+ * @brief Handle button press for home page (pageNum == PAGE_HOME)
  * @param buttonIndex The index of the pressed button (0-5)
+ *
+ * @note Keys 0-4 open menus 1-5, menus after that are opened with the
+ *       "Open menu" action.
  */
 void handleHomePageButton(int buttonIndex) {
+  if (buttonIndex == 5) {
+    navigateToPage(PAGE_SETTINGS);
+    return;
+  }
   int targetPage = buttonIndex + 1;
+  if (!isMenuPage(targetPage)) {
+    return;
+  }
   bool enableMouse = (targetPage == 4); // Only enable mouse for page 4
   navigateToPage(targetPage, enableMouse);
 }
 
 /**
- * @brief Handle button press for menu pages (pageNum 1-5)
+ * @brief Handle button press for menu pages (pageNum 1 - deck.menuCount)
  * @param buttonIndex The index of the pressed button (0-5)
  */
 void handleMenuPageButton(int buttonIndex) {
@@ -929,28 +1457,23 @@ void handleMenuPageButton(int buttonIndex) {
     if (pageNum == 4) {
       mouseEnabled = false;
     }
-    pageNum = 0;
+    releaseChord();
+    pageNum = PAGE_HOME;
     drawKeypad();
     return;
   }
   
-  if (buttonIndex >= 0 && buttonIndex <= 4) {
-    // Get the appropriate menu and button based on pageNum and button index
-    struct Button* button = nullptr;
-    int latchIndex = (pageNum - 1) * 5 + buttonIndex;
-    
-    if (pageNum >= 1 && pageNum <= 5) {
-      button = &menus[pageNum - 1].buttons[buttonIndex];
-    }
-    
-    if (button != nullptr) {
-      processButtonActions(button, latchIndex);
-    }
+  // Menus with fewer buttons leave the last keys blank
+  const MenuPage& page = menuPages[pageNum - 1];
+  Menu& menu = currentMenu();
+  if (buttonIndex >= 0 && buttonIndex < page.buttonCount && menu.actions) {
+    processButtonActions(*menu.actions, &menu.buttons[buttonIndex],
+                         page.firstButton + buttonIndex, buttonIndex);
   }
 }
 
 /**
- * @brief Handle button press for settings page (pageNum == 6)
+ * @brief Handle button press for settings page (pageNum == PAGE_SETTINGS)
  * @param buttonIndex The index of the pressed button (0-5)
  */
 void handleSettingsPageButton(int buttonIndex) {
@@ -965,19 +1488,15 @@ void handleSettingsPageButton(int buttonIndex) {
       bleKeyboardAction(11, 3, 0);
       break;
     case 3:
+      // Toggles sleep, the key shows generalconfig.sleepenable as its latch
       bleKeyboardAction(11, 4, 0);
-      if (islatched[28]) {
-        islatched[28] = 0;
-      } else {
-        islatched[28] = 1;
-      }
       break;
     case 4:
-      pageNum = 8;
+      pageNum = PAGE_INFO;
       drawKeypad();
       break;
     case 5:
-      pageNum = 0;
+      pageNum = PAGE_HOME;
       drawKeypad();
       break;
   }
@@ -988,15 +1507,166 @@ void handleSettingsPageButton(int buttonIndex) {
  * @param buttonIndex The index of the pressed button (0-5)
  */
 void handleButtonPress(int buttonIndex) {
-  if (pageNum == 0) {
+  latencyMark(inputLatency, LAT_BUTTON_HANDLER, micros());
+
+  if (pageNum == PAGE_HOME) {
     handleHomePageButton(buttonIndex);
-  } else if (pageNum >= 1 && pageNum <= 5) {
+  } else if (isMenuPage(pageNum)) {
     handleMenuPageButton(buttonIndex);
-  } else if (pageNum == 6) {
+  } else if (pageNum == PAGE_SETTINGS) {
     handleSettingsPageButton(buttonIndex);
   }
 }
 
+/**
+ * @brief Let go of a key: drop the modifiers it was holding for a chord
+ * @param buttonIndex The index of the released button (0-5)
+ */
+void handleButtonRelease(int buttonIndex) {
+  if (chordHeldKeys & (1 << buttonIndex)) {
+    chordHeldKeys &= ~(1 << buttonIndex);
+    releaseKeysKeepingChord();
+  }
+}
+
+/**
+ * @brief Run one control command through the same handlers as a touch
+ * @param command ControlCommand queued by the web server
+ */
+void runControlCommand(const ControlCommand& command) {
+  // Marks on the way belong to the request, not to the last touch
+  inputLatency.tracking = false;
+  latencyBegin(controlLatency, command.queuedUs);
+  latencyMark(controlLatency, LAT_BUTTON_HANDLER, micros());
+
+  if (command.page != CONTROL_PAGE_CURRENT && command.page != pageNum) {
+    // As with the keys, only menu 4 moves the mouse
+    mouseEnabled = false;
+    navigateToPage(command.page, command.page == 4);
+  }
+  if (command.op == CONTROL_PAGE) {
+    return;
+  }
+  // The page may have changed since the web server checked it
+  if (!isKeypadPage(pageNum)) {
+    return;
+  }
+
+  int page = pageNum;
+  if (command.op != CONTROL_RELEASE) {
+    handleButtonPress(command.button);
+  }
+  if (command.op != CONTROL_PRESS) {
+    handleButtonRelease(command.button);
+  }
+  latencyMark(controlLatency, LAT_HID_REPORT, micros());
+
+  // A latch may have flipped, a page switch draws all keys itself
+  if (pageNum == page) {
+    drawKeyUp(command.button);
+  }
+}
+
+/**
+ * @brief Run the control commands the web server has queued
+ *
+ * @note Commands are not run in configurator mode, the keypad is not shown
+ *       then. The web server does not queue them either.
+ */
+void runControlCommands() {
+  ControlCommand command;
+  while (pageNum != PAGE_CONFIG_MODE &&
+         xQueueReceive(controlQueue, &command, 0) == pdTRUE) {
+    runControlCommand(command);
+    previousMillis = millis(); // Same as a touch for the sleep timer
+  }
+}
+
+/**
+ * @brief Print the touch to HID report latency histograms to serial
+ */
+void printLatencyReport() {
+  Serial.println("[INFO]: Latency from touch (us): stage count min p50 p95 p99 max");
+  for (int i = LAT_JUST_PRESSED; i < LAT_STAGE_COUNT; i++) {
+    const LatencyHistogram& h = inputLatency.stages[i];
+    Serial.printf("[INFO]: %-12s %6u %8u %8u %8u %8u %8u\n", latencyStageName(i),
+                  h.count, h.count ? h.minUs : 0,
+                  latencyHistogramPercentile(h, 50),
+                  latencyHistogramPercentile(h, 95),
+                  latencyHistogramPercentile(h, 99), h.maxUs);
+  }
+  Serial.printf("[INFO]: Budgets: handler p95 < %lu us, report p95 < %lu us\n",
+                LATENCY_BUDGET_BUTTON_HANDLER_US, LATENCY_BUDGET_HID_REPORT_US);
+  for (int i = 0; i < LATENCY_LOAD_COUNT; i++) {
+    const LatencyHistogram& r = inputLatency.reports[i];
+    Serial.printf("[INFO]: %-12s %6u %8u %8u %8u %8u %8u\n", latencyLoadName(i),
+                  r.count, r.count ? r.minUs : 0,
+                  latencyHistogramPercentile(r, 50),
+                  latencyHistogramPercentile(r, 95),
+                  latencyHistogramPercentile(r, 99), r.maxUs);
+  }
+  const LatencyHistogram& c = controlLatency.stages[LAT_HID_REPORT];
+  Serial.printf("[INFO]: %-12s %6u %8u %8u %8u %8u %8u\n", "http", c.count,
+                c.count ? c.minUs : 0, latencyHistogramPercentile(c, 50),
+                latencyHistogramPercentile(c, 95),
+                latencyHistogramPercentile(c, 99), c.maxUs);
+  Serial.printf("[INFO]: Budget: http request to report p95 < %lu us\n",
+                LATENCY_BUDGET_CONTROL_US);
+}
+
+/**
+ * @brief Read everything /metrics reports
+ *
+ * @param snapshot MetricsSnapshot to fill
+ *
+ * @note Called from the web server task as well, it only reads.
+ */
+void takeMetricsSnapshot(MetricsSnapshot &snapshot) {
+  snapshot.uptimeMs = millis();
+  snapshot.heapFree = ESP.getFreeHeap();
+  snapshot.heapMinFree = ESP.getMinFreeHeap();
+  snapshot.heapLargestBlock = ESP.getMaxAllocHeap();
+  snapshot.psramSize = ESP.getPsramSize();
+  snapshot.psramFree = ESP.getFreePsram();
+  snapshot.fsUsed = FILESYSTEM.usedBytes();
+  snapshot.fsTotal = FILESYSTEM.totalBytes();
+  snapshot.bleConnected = bleCombo.isConnected() ? 1 : 0;
+  snapshot.deck = deckMetrics;
+}
+
+/**
+ * @brief Print what /metrics reports to serial, for when WiFi is off
+ */
+void printMetrics() {
+  MetricsSnapshot snapshot;
+  takeMetricsSnapshot(snapshot);
+  char entry[METRICS_ENTRY_SIZE];
+  for (uint8_t i = 0; metricsEntry(snapshot, i, entry, sizeof(entry)); i++) {
+    Serial.print(entry);
+  }
+}
+
+/**
+ * @brief Handle the serial "trace" command
+ * @param mode "record", "replay" or "stop"
+ */
+void handleTouchTraceCommand(const char* mode) {
+  // Ignore the line ending sent by the serial monitor
+  char value[16];
+  strlcpy(value, mode, sizeof(value));
+  value[strcspn(value, "\r\n")] = '\0';
+
+  if (strcmp(value, "record") == 0) {
+    startTouchTraceRecording();
+  } else if (strcmp(value, "replay") == 0) {
+    startTouchTraceReplay();
+  } else if (strcmp(value, "stop") == 0) {
+    stopTouchTrace();
+  } else {
+    Serial.println("[WARNING]: Unknown trace option. Choose: record, replay or stop");
+  }
+}
+
 /**
  * @brief Read a value from serial input with proper null termination
  * @param buffer Buffer to store the read value
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdint.h>
+
+#include "../src/JsonChunk.h"
+
+// Lists a directory of 1000 logos the way handleFileList() did, by growing
+// one String, and the way sendFileList() does, through a JsonChunker into the
+// buffers of a chunked response. Reports the time per listing and the heap
+// used while listing.
+
+// Heap accounting, every allocation made by this program goes through here.
+// Not inlined, so the compiler does not see through the size header.
+static size_t heapInUse = 0;
+static size_t heapPeak = 0;
+static size_t heapAllocations = 0;
+
+__attribute__((noinline)) void *operator new(size_t size) {
+    size_t *block = (size_t *)malloc(size + sizeof(size_t));
+    if (!block) throw std::bad_alloc();
+    *block = size;
+    heapInUse += size;
+    heapAllocations++;
+    if (heapInUse > heapPeak) heapPeak = heapInUse;
+    return block + 1;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+__attribute__((noinline)) void operator delete(void *ptr) noexcept {
+    if (!ptr) return;
+    size_t *block = (size_t *)ptr - 1;
+    heapInUse -= *block;
+    free(block);
+}
+
+void operator delete[](void *ptr) noexcept { operator delete(ptr); }
+
+// Grows like the Arduino String: every concat reallocates to the exact length
+struct ArduinoString {
+    char *buf;
+    size_t len;
+
+    ArduinoString() : buf(new char[1]), len(0) { buf[0] = '\0'; }
+    ~ArduinoString() { delete[] buf; }
+
+    void concat(const char *text, size_t n) {
+        char *grown = new char[len + n + 1];
+        memcpy(grown, buf, len);
+        memcpy(grown + len, text, n);
+        grown[len + n] = '\0';
+        delete[] buf;
+        buf = grown;
+        len += n;
+    }
+    void concat(const char *text) { concat(text, strlen(text)); }
+    bool operator!=(const char *text) const { return strcmp(buf, text) != 0; }
+};
+
+size_t listWithString(const std::vector<std::string> &names) {
+    ArduinoString output;
+    output.concat("[");
+    for (size_t i = 0; i < names.size(); i++) {
+        if (output != "[") {
+            output.concat(",");
+        }
+        char number[12];
+        snprintf(number, sizeof(number), "%u", (unsigned)i);
+        output.concat("{\"");
+        output.concat(number);
+        output.concat("\":\"");
+        // String(file.name()) is a temporary copy
+        ArduinoString name;
+        name.concat(names[i].c_str());
+        output.concat(name.buf, name.len);
+        output.concat("\"}");
+    }
+    output.concat("]");
+    return output.len;
+}
+
+struct NameWalk {
+    const std::vector<std::string> *names;
+    size_t next;
+};
+
+bool nextNameEntry(void *context, char *entry, size_t size) {
+    NameWalk *walk = (NameWalk *)context;
+    if (walk->next >= walk->names->size()) return false;
+    char number[12];
+    snprintf(number, sizeof(number), "%u", (unsigned)walk->next);
+    jsonChunkPair(entry, size, number, (*walk->names)[walk->next++].c_str());
+    return true;
+}
+
+size_t listWithChunker(const std::vector<std::string> &names, uint8_t *buf,
+                       size_t bufSize) {
+    NameWalk walk = {&names, 0};
+    JsonChunker *chunker = new JsonChunker;
+    jsonChunkBegin(*chunker, nextNameEntry, &walk);
+    size_t total = 0;
+    size_t n;
+    while ((n = jsonChunkFill(*chunker, buf, bufSize)) > 0) {
+        total += n;
+    }
+    delete chunker;
+    return total;
+}
+
+int main() {
+    const int files = 1000;
+    const int rounds = 200;
+    // What AsyncWebServer offers a chunked response on one TCP segment
+    const size_t segment = 1436;
+
+    std::vector<std::string> names;
+    for (int i = 0; i < files; i++) {
+        names.push_back("logo-" + std::to_string(i) + ".bmp");
+    }
+    uint8_t *buf = new uint8_t[segment];
+
+    std::cout << "File list benchmark, " << files << " files" << std::endl;
+
+    for (int way = 0; way < 2; way++) {
+        size_t bytes = 0;
+        size_t allocationsBefore = heapAllocations;
+        heapPeak = heapInUse;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            bytes = way == 0 ? listWithString(names)
+                             : listWithChunker(names, buf, segment);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        size_t allocations = (heapAllocations - allocationsBefore) / rounds;
+        size_t peak = heapPeak - heapInUse;
+
+        std::cout << (way == 0 ? "  String concat" : "  JsonChunker") << " ("
+                  << bytes << " bytes)" << std::endl;
+        std::cout << "    us per listing:  " << (double)elapsed / rounds / 1000
+                  << std::endl;
+        std::cout << "    heap peak:       " << peak << " bytes in "
+                  << allocations << " allocations" << std::endl;
+    }
+    std::cout << "  response buffer:   " << segment << " bytes, not counted"
+              << std::endl;
+
+    delete[] buf;
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdint.h>
+
+#include "../src/JsonStream.h"
+#include "../src/ActionCode.h"
+#include "../src/IconTable.h"
+
+// Parses the menu files in data/config the way loadMenuConfig() does, into
+// the same structs, and reports the parse time per file and the heap used
+// while parsing.
+
+// Heap accounting, every allocation made by this program goes through here
+static size_t heapInUse = 0;
+static size_t heapPeak = 0;
+static size_t heapAllocations = 0;
+
+void *operator new(size_t size) {
+    size_t *block = (size_t *)malloc(size + sizeof(size_t));
+    if (!block) throw std::bad_alloc();
+    *block = size;
+    heapInUse += size;
+    heapAllocations++;
+    if (heapInUse > heapPeak) heapPeak = heapInUse;
+    return block + 1;
+}
+
+void operator delete(void *ptr) noexcept {
+    if (!ptr) return;
+    size_t *block = (size_t *)ptr - 1;
+    heapInUse -= *block;
+    free(block);
+}
+
+// Same layout as the structs in main.cpp
+typedef char IconPath[ICON_PATH_SIZE];
+struct Button { ActionCode actions; bool latch; IconId latchLogo; };
+
+// Logos of the classic deck, as buildDeck() sizes the icon table
+static IconInfo iconInfos[64];
+static char iconPaths[64 * ICON_PATH_SIZE];
+IconTable iconTable;
+
+// The same pool as menuParsePool in main.cpp
+static ActionPool menuParsePool;
+
+// Same fields as MenuParseTarget in ConfigLoad.h
+struct MenuParseTarget {
+    IconId      *icons;
+    Button      *buttons;
+    uint8_t      buttonCount;
+    ActionPool  *pool;
+    ActionStage *stages;
+    bool         tooManyActions;
+    int          truncated;
+};
+
+struct MemorySource {
+    const std::string *text;
+    size_t pos;
+};
+
+size_t readMemorySource(void *context, uint8_t *buf, size_t len) {
+    MemorySource *src = (MemorySource *)context;
+    size_t n = src->text->size() - src->pos;
+    if (n > len) n = len;
+    memcpy(buf, src->text->data() + src->pos, n);
+    src->pos += n;
+    return n;
+}
+
+// Same as storeMenuField() in ConfigLoad.h, counting truncated values
+// instead of logging them
+void storeMenuField(void *context, const JsonStreamPath &path,
+                    JsonStreamType type, const char *value, bool truncated) {
+    MenuParseTarget *target = (MenuParseTarget *)context;
+    int button, slot;
+    MenuField field = menuFieldAt(path, button, slot);
+    if (field == MENU_FIELD_NONE || button >= target->buttonCount) return;
+
+    Button &b = target->buttons[button];
+    bool fits = !truncated;
+    switch (field) {
+    case MENU_FIELD_LOGO: {
+        IconPath logo;
+        fits &= jsonStreamCopy(logo, sizeof(logo), "/logos/", value);
+        target->icons[button] = iconTableIntern(iconTable, NULL, logo);
+        break;
+    }
+    case MENU_FIELD_LATCH:
+        b.latch = type == JSON_STREAM_BOOL && strcmp(value, "true") == 0;
+        break;
+    case MENU_FIELD_LATCHLOGO: {
+        IconPath logo;
+        fits &= jsonStreamCopy(logo, sizeof(logo), "/logos/", value);
+        b.latchLogo = value[0] ? iconTableIntern(iconTable, NULL, logo) : ICON_NONE;
+        break;
+    }
+    case MENU_FIELD_ACTION:
+        target->stages[button].action[slot] = atoi(value);
+        actionStageUse(target->stages[button], slot);
+        break;
+    case MENU_FIELD_VALUE: {
+        char text[ACTION_TEXT_SIZE];
+        fits &= jsonStreamCopy(text, sizeof(text), NULL, value);
+        target->stages[button].text[slot] = actionPoolIntern(*target->pool, text);
+        actionStageUse(target->stages[button], slot);
+        break;
+    }
+    case MENU_FIELD_TOO_MANY:
+        target->tooManyActions = true;
+        break;
+    default:
+        break;
+    }
+    if (!fits) target->truncated++;
+}
+
+// The body of loadMenuConfig() after the file is opened
+bool parseMenu(const std::string &text, IconId *icons, Button *buttons,
+               uint8_t buttonCount, int &truncated) {
+    IconId question = iconTableIntern(iconTable, "/logos/", "question.bmp");
+    for (int i = 0; i < buttonCount; i++) {
+        icons[i] = question;
+        buttons[i].latch = false;
+        buttons[i].latchLogo = question;
+    }
+    ActionStage stages[DECK_MAX_BUTTONS];
+    actionStageReset(stages, buttonCount);
+    actionPoolReset(menuParsePool);
+
+    MenuParseTarget target = {icons, buttons, buttonCount, &menuParsePool, stages,
+                              false, 0};
+    MemorySource src = {&text, 0};
+    JsonStream parser;
+    bool ok = jsonStreamParse(parser, readMemorySource, &src, storeMenuField, &target) &&
+              !target.tooManyActions;
+    truncated += target.truncated;
+
+    ActionCode codes[DECK_MAX_BUTTONS];
+    if (!ok || !actionCodeCompile(menuParsePool, stages, buttonCount, codes)) {
+        return false;
+    }
+    for (int i = 0; i < buttonCount; i++) {
+        buttons[i].actions = codes[i];
+    }
+    return true;
+}
+
+int main() {
+    const int rounds = 20000;
+
+    std::cout << "Menu parse benchmark" << std::endl;
+    std::cout << "  parser scratch:    " << sizeof(JsonStream) + sizeof(ActionStage) * DECK_MAX_BUTTONS
+              << " bytes" << std::endl;
+    std::cout << "  parse pool:        " << sizeof(ActionPool) << " bytes" << std::endl;
+    std::cout << "  target structs:    " << (sizeof(IconId) + sizeof(Button)) * DECK_MAX_BUTTONS
+              << " bytes" << std::endl;
+    iconTableBegin(iconTable, iconInfos, iconPaths, 64);
+
+    for (int m = 1; m <= 5; m++) {
+        std::string filename = "data/config/menu" + std::to_string(m) + ".json";
+        std::ifstream file(filename.c_str());
+        if (!file) {
+            std::cout << "  " << filename << ": not found" << std::endl;
+            continue;
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        std::string text = contents.str();
+
+        IconId icons[DECK_MAX_BUTTONS];
+        Button buttons[DECK_MAX_BUTTONS];
+        bool ok = true;
+        int truncated = 0;
+
+        size_t allocationsBefore = heapAllocations;
+        heapPeak = heapInUse;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            ok &= parseMenu(text, icons, buttons, DECK_MAX_BUTTONS, truncated);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        size_t allocations = heapAllocations - allocationsBefore;
+        size_t peak = heapPeak - heapInUse;
+
+        std::cout << "  " << filename << " (" << text.size() << " bytes)"
+                  << (ok ? "" : " PARSE ERROR") << std::endl;
+        std::cout << "    us per parse:    " << (double)elapsed / rounds / 1000 << std::endl;
+        std::cout << "    heap peak:       " << peak << " bytes in "
+                  << allocations << " allocations" << std::endl;
+        std::cout << "    actions:         " << actionPoolStoredSize(menuParsePool)
+                  << " bytes in use" << std::endl;
+        std::cout << "    truncated:       " << truncated / rounds << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+
+#include "../src/TouchTrace.h"
+
+// Replays a synthetic burst of touches and measures how long it takes to turn
+// each trace sample into a key decision.
+
+struct MemoryTrace {
+    std::vector<uint8_t> bytes;
+    size_t pos;
+};
+
+bool readMemoryTrace(void *context, TouchTraceSample &sample) {
+    MemoryTrace *trace = (MemoryTrace *)context;
+    if (trace->pos + TOUCH_TRACE_SAMPLE_SIZE > trace->bytes.size()) return false;
+    bool ok = touchTraceDecodeSample(&trace->bytes[trace->pos], sample);
+    trace->pos += TOUCH_TRACE_SAMPLE_SIZE;
+    return ok;
+}
+
+// Same geometry as the keys drawn on a 320x240 screen
+int keyAt(uint16_t x, uint16_t y) {
+    for (int b = 0; b < 6; b++) {
+        int col = b % 3, row = b / 3;
+        int x1 = 53 + col * 106 - 46, y1 = 60 + row * 106 - 45;
+        if (x >= x1 && x < x1 + 93 && y >= y1 && y < y1 + 91) return b;
+    }
+    return -1;
+}
+
+int main() {
+    const int bursts = 20000;
+    MemoryTrace trace = {std::vector<uint8_t>(TOUCH_TRACE_HEADER_SIZE), 0};
+    touchTraceEncodeHeader(&trace.bytes[0]);
+
+    // Bursts of fast taps and two finger chords with jitter while held
+    uint32_t t = 0;
+    uint32_t seed = 12345;
+    for (int i = 0; i < bursts; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint16_t x = 10 + (seed >> 8) % 300;
+        uint16_t y = 10 + (seed >> 16) % 220;
+        TouchTraceSample samples[4] = {
+            {t, 1, {x, 0}, {y, 0}},
+            {t + 3, 2, {x, (uint16_t)(320 - x)}, {y, (uint16_t)(240 - y)}},
+            {t + 9, 2, {(uint16_t)(x + 1), (uint16_t)(320 - x)}, {y, (uint16_t)(240 - y)}},
+            {t + 25, 0, {0, 0}, {0, 0}},
+        };
+        for (int s = 0; s < 4; s++) {
+            uint8_t buf[TOUCH_TRACE_SAMPLE_SIZE];
+            touchTraceEncodeSample(samples[s], buf);
+            trace.bytes.insert(trace.bytes.end(), buf, buf + sizeof(buf));
+        }
+        t += 30;
+    }
+    const int events = bursts * 4;
+
+    trace.pos = TOUCH_TRACE_HEADER_SIZE;
+    TouchTraceReplay replay;
+    touchTraceReplayBegin(replay, readMemoryTrace, &trace);
+
+    bool pressed[6] = {};
+    uint32_t justPressed = 0;
+    uint32_t polls = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t now = 0; ; now++) {
+        bool more = touchTraceReplayAdvance(replay, now, readMemoryTrace, &trace);
+        for (int b = 0; b < 6; b++) {
+            bool down = false;
+            for (int i = 0; i < replay.current.count; i++) {
+                if (keyAt(replay.current.x[i], replay.current.y[i]) == b) down = true;
+            }
+            if (down && !pressed[b]) justPressed++;
+            pressed[b] = down;
+        }
+        polls++;
+        if (!more) break;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Touch trace replay benchmark" << std::endl;
+    std::cout << "  events:            " << events << std::endl;
+    std::cout << "  polls (1 ms):      " << polls << std::endl;
+    std::cout << "  key presses:       " << justPressed << std::endl;
+    std::cout << "  ns per event:      " << (double)elapsed / events << std::endl;
+    std::cout << "  ns per poll:       " << (double)elapsed / polls << std::endl;
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include <iostream>
+#include <cassert>
+#include <cstring>
+#include <stdint.h>
+
+#include "../src/LatencyStats.h"
+#include "../src/ActionCode.h"
+#include "../src/Metrics.h"
+
+// Runs the real bleKeyboardAction() of src/Action.h on the host against a
+// stubbed BLE stack and a simulated clock, and checks the p95 of every stage
+// against the LATENCY_BUDGET_* constants.
+
+// Simulated clock, advanced by loop(), delay() and every HID report
+static uint32_t hostClockUs = 0;
+
+uint32_t micros() { return hostClockUs; }
+void delay(uint32_t ms) { hostClockUs += ms * 1000; }
+
+struct HostSerial {
+    void print(const char *) {}
+    void print(int) {}
+    void println(const char *) {}
+    void println(int) {}
+} Serial;
+
+// Key codes, only their values differ from the BLE library
+enum : uint8_t {
+    KEY_LEFT_CTRL = 0x80, KEY_LEFT_SHIFT, KEY_LEFT_ALT, KEY_LEFT_GUI,
+    KEY_RIGHT_CTRL, KEY_RIGHT_SHIFT, KEY_RIGHT_ALT, KEY_RIGHT_GUI,
+    KEY_UP_ARROW, KEY_DOWN_ARROW, KEY_LEFT_ARROW, KEY_RIGHT_ARROW,
+    KEY_BACKSPACE, KEY_TAB, KEY_RETURN, KEY_ESC, KEY_DELETE, KEY_PAGE_UP,
+    KEY_PAGE_DOWN, KEY_HOME, KEY_END, KEY_PRTSC,
+    KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9,
+    KEY_F10, KEY_F11, KEY_F12, KEY_F13, KEY_F14, KEY_F15, KEY_F16, KEY_F17,
+    KEY_F18, KEY_F19, KEY_F20, KEY_F21, KEY_F22, KEY_F23, KEY_F24,
+    KEY_NUM_0, KEY_NUM_1, KEY_NUM_2, KEY_NUM_3, KEY_NUM_4, KEY_NUM_5,
+    KEY_NUM_6, KEY_NUM_7, KEY_NUM_8, KEY_NUM_9, KEY_NUM_SLASH,
+    KEY_NUM_ASTERISK, KEY_NUM_MINUS, KEY_NUM_PLUS, KEY_NUM_ENTER,
+    KEY_NUM_PERIOD
+};
+enum : uint8_t { MOUSE_LEFT = 1, MOUSE_RIGHT = 2, MOUSE_MIDDLE = 4 };
+
+typedef uint8_t MediaKeyReport[2];
+const MediaKeyReport KEY_MEDIA_NEXT_TRACK = {1, 0};
+const MediaKeyReport KEY_MEDIA_PREVIOUS_TRACK = {2, 0};
+const MediaKeyReport KEY_MEDIA_STOP = {4, 0};
+const MediaKeyReport KEY_MEDIA_PLAY_PAUSE = {8, 0};
+const MediaKeyReport KEY_MEDIA_MUTE = {16, 0};
+const MediaKeyReport KEY_MEDIA_VOLUME_UP = {32, 0};
+const MediaKeyReport KEY_MEDIA_VOLUME_DOWN = {64, 0};
+
+// The BLE keyboard library waits 7 ms after every report it sends, a key
+// written or a character printed is a press and a release report
+#define HOST_BLE_REPORT_US 7000
+
+struct HostBleCombo {
+    uint32_t reports;
+
+    void send(uint32_t count) {
+        reports += count;
+        hostClockUs += count * HOST_BLE_REPORT_US;
+    }
+    bool isConnected() { return true; }
+    void write(uint8_t) { send(2); }
+    void write(const MediaKeyReport) { send(2); }
+    void print(const char *text) { send(2 * strlen(text)); }
+    void print(int value) {
+        char text[12];
+        snprintf(text, sizeof(text), "%d", value);
+        print(text);
+    }
+    void keyPress(uint8_t) { send(1); }
+    void keyReleaseAll() { send(1); }
+    void mouseClick(uint8_t) { send(2); }
+    void mouseMove(int, int, int = 0, int = 0) { send(1); }
+} bleCombo;
+
+// What Action.h reads from main.cpp
+struct HostConfig {
+    uint8_t  modifier1, modifier2, modifier3;
+    uint16_t helperdelay;
+    bool     sleepenable;
+    uint16_t sleeptimer;
+} generalconfig = {KEY_LEFT_CTRL, 0, 0, 0, false, 0};
+
+struct HostPreferences {
+    void putInt(const char *, int) {}
+} savedStates;
+
+LatencyTracker inputLatency;
+DeckMetrics    deckMetrics;
+int            ledBrightness = 255;
+unsigned long  Interval = 0;
+
+void ledcWrite(int, int) {}
+void configmode() {}
+void userAction1() {}
+void userAction2() {}
+void userAction3() {}
+void userAction4() {}
+void userAction5() {}
+void userAction6() {}
+void userAction7() {}
+bool isMenuPage(int page) { return page >= 1 && page <= DECK_MAX_MENUS; }
+void navigateToPage(int) {}
+
+#include "../src/Action.h"
+
+// One button of a menu, compiled the way loadMenuConfig() does
+struct HostButton {
+    ActionPool *pool;
+    ActionCode  code;
+};
+
+HostButton compileButton(const uint8_t *actions, const char *const *values,
+                         uint8_t count) {
+    static ActionPool pool;
+    actionPoolReset(pool);
+    ActionStage stage;
+    actionStageReset(&stage, 1);
+    for (uint8_t i = 0; i < count; i++) {
+        stage.action[i] = actions[i];
+        stage.text[i] = actionPoolIntern(pool, values[i]);
+        actionStageUse(stage, i);
+    }
+    HostButton button = {NULL, {0, 0, 0}};
+    assert(actionCodeCompile(pool, &stage, 1, &button.code));
+    button.pool = actionPoolClone(pool);
+    return button;
+}
+
+// A press as loop() handles it: the touch lands somewhere in a loop()
+// iteration, the key is drawn inverted, then processButtonActions() runs the
+// actions and releases all keys
+void pressButton(const HostButton &button, uint32_t loopUs) {
+    hostClockUs += 100000;
+    latencyBegin(inputLatency, hostClockUs);
+
+    hostClockUs += loopUs;
+    latencyMark(inputLatency, LAT_JUST_PRESSED, hostClockUs);
+    hostClockUs += 2000; // Drawing the inverted key
+    latencyMark(inputLatency, LAT_BUTTON_HANDLER, hostClockUs);
+
+    ActionOp op;
+    uint8_t  pos = 0;
+    while (actionCodeNext(*button.pool, button.code, pos, op)) {
+        bleKeyboardAction(op.action, op.value, op.text);
+    }
+    bleCombo.keyReleaseAll();
+    latencyMark(inputLatency, LAT_HID_REPORT, micros());
+}
+
+void test_shortcuts_within_budget() {
+    std::cout << "Testing latency budgets of shortcut keys..." << std::endl;
+
+    // CTRL + "c", a function key and a media key
+    const uint8_t copyActions[] = {5, 4};
+    const char *copyValues[] = {"1", "c"};
+    const uint8_t f5Actions[] = {6};
+    const char *f5Values[] = {"5"};
+    const uint8_t muteActions[] = {3};
+    const char *muteValues[] = {"1"};
+    HostButton buttons[] = {compileButton(copyActions, copyValues, 2),
+                            compileButton(f5Actions, f5Values, 1),
+                            compileButton(muteActions, muteValues, 1)};
+
+    latencyReset(inputLatency);
+    bleCombo.reports = 0;
+    for (int press = 0; press < 300; press++) {
+        pressButton(buttons[press % 3], 1000 + (press % 8) * 1000);
+    }
+
+    // CTRL + "c" is 4 reports with the release, F5 is held until the release
+    // and is 2, mute is 3
+    assert(bleCombo.reports == 100 * (4 + 2 + 3));
+    assert(inputLatency.stages[LAT_ACTION].count == 400);
+    assert(inputLatency.stages[LAT_HID_REPORT].count == 700);
+    assert(latencyHistogramPercentile(inputLatency.stages[LAT_BUTTON_HANDLER], 95) <
+           LATENCY_BUDGET_BUTTON_HANDLER_US);
+    assert(latencyHistogramPercentile(inputLatency.stages[LAT_HID_REPORT], 95) <
+           LATENCY_BUDGET_HID_REPORT_US);
+
+    for (HostButton &b : buttons) free(b.pool);
+    std::cout << "✓ Shortcut latency budget tests passed!" << std::endl;
+}
+
+void test_long_text_over_budget() {
+    std::cout << "Testing latency budget of a long text..." << std::endl;
+
+    // Every character is two reports, a sentence does not fit the budget
+    const uint8_t actions[] = {4};
+    const char *values[] = {"Kind regards, FreeTouchDeck"};
+    HostButton button = compileButton(actions, values, 1);
+
+    latencyReset(inputLatency);
+    for (int press = 0; press < 20; press++) {
+        pressButton(button, 1000);
+    }
+    assert(latencyHistogramPercentile(inputLatency.stages[LAT_BUTTON_HANDLER], 95) <
+           LATENCY_BUDGET_BUTTON_HANDLER_US);
+    assert(latencyHistogramPercentile(inputLatency.stages[LAT_HID_REPORT], 95) >=
+           LATENCY_BUDGET_HID_REPORT_US);
+
+    free(button.pool);
+    std::cout << "✓ Long text latency budget tests passed!" << std::endl;
+}
+
+int main() {
+    std::cout << "Running action latency tests..." << std::endl;
+    std::cout << "===============================" << std::endl;
+
+    test_shortcuts_within_budget();
+    test_long_text_over_budget();
+
+    std::cout << "===============================" << std::endl;
+    std::cout << "🎉 All action latency tests passed!" << std::endl;
+    return 0;
+}
@@ -5,184 +5,2162 @@
 
 // Include the pure function
 #include "../src/LatchImageHelper.h"
+#include "../src/LatencyStats.h"
+#include "../src/TouchTrace.h"
+#include "../src/TouchCalibration.h"
+#include "../src/TouchRegions.h"
+#include "../src/ConfigSnapshot.h"
+#include "../src/MenuCache.h"
+#include "../src/JsonStream.h"
+#include "../src/BootPlan.h"
+#include "../src/BootReport.h"
+#include "../src/DeckArena.h"
+#include "../src/ActionCode.h"
+#include "../src/IconTable.h"
+#include "../src/ConfigReload.h"
+#include "../src/ConfigStore.h"
+#include "../src/ConfigSchema.h"
+#include "../src/JsonChunk.h"
+#include "../src/AssetCache.h"
+#include "../src/UploadAdmit.h"
+#include "../src/RemoteControl.h"
+#include "../src/LiveState.h"
+#include "../src/ScreenMirror.h"
+#include "../src/Metrics.h"
+#include "../src/IconTranscode.h"
+#include <vector>
+#include <string>
+#include <map>
 
-// Mock function for getBMPColor
-uint16_t mockGetBMPColor(const char* filename) {
-    if (strcmp(filename, "/logos/custom1.bmp") == 0) return 0x1111;
-    if (strcmp(filename, "/logos/custom2.bmp") == 0) return 0x2222;
-    if (strcmp(filename, "/logos/screen_logo0.bmp") == 0) return 0x3333;
-    if (strcmp(filename, "/logos/screen_logo1.bmp") == 0) return 0x4444;
-    if (strcmp(filename, "/logos/screen_logo2.bmp") == 0) return 0x5555;
-    return 0x0000; // Default for unknown files
+void test_getLatchImageIcon() {
+    std::cout << "Testing getLatchImageIcon..." << std::endl;
+
+    // A latch logo is drawn on a latched key, its background fills the key
+    assert(getLatchImageIcon(3, 7) == 7);
+    assert(getLatchImageIcon(ICON_NONE, 7) == 7);
+
+    // Without one the key keeps the background of its logo
+    assert(getLatchImageIcon(3, ICON_NONE) == 3);
+    assert(getLatchImageIcon(ICON_NONE, ICON_NONE) == ICON_NONE);
+
+    std::cout << "✓ getLatchImageIcon tests passed!" << std::endl;
 }
 
-void test_getLatchLogoPath() {
-    std::cout << "Testing getLatchIconPath..." << std::endl;
-    
-    const char* menuButtons[5] = {
-        "/logos/custom1.bmp",
-        "/logos/",
-        "/logos/custom2.bmp",
-        "/logos/",
-        "/logos/custom1.bmp"
-    };
-    
-    // Test valid inputs
-    assert(strcmp(getLatchIconPath(menuButtons, 0), "/logos/custom1.bmp") == 0);
-    assert(strcmp(getLatchIconPath(menuButtons, 1), "/logos/") == 0);
-    assert(strcmp(getLatchIconPath(menuButtons, 2), "/logos/custom2.bmp") == 0);
-    
-    // Test invalid inputs
-    assert(getLatchIconPath(menuButtons, -1) == nullptr);
-    assert(getLatchIconPath(menuButtons, 5) == nullptr);
-    
-    std::cout << "✓ getLatchIconPath tests passed!" << std::endl;
+void test_latencyHistogram() {
+    std::cout << "Testing latency histogram..." << std::endl;
+
+    assert(latencyBucket(0) == 0);
+    assert(latencyBucket(1) == 0);
+    assert(latencyBucket(2) == 1);
+    assert(latencyBucket(3) == 1);
+    assert(latencyBucket(1024) == 10);
+    assert(latencyBucket(0xFFFFFFFF) == LATENCY_BUCKETS - 1);
+
+    LatencyHistogram h;
+    latencyHistogramReset(h);
+    assert(latencyHistogramPercentile(h, 50) == 0);
+
+    // 90 fast samples and 10 slow ones
+    for (int i = 0; i < 90; i++) latencyHistogramRecord(h, 1000);
+    for (int i = 0; i < 10; i++) latencyHistogramRecord(h, 40000);
+
+    assert(h.count == 100);
+    assert(h.minUs == 1000);
+    assert(h.maxUs == 40000);
+    assert(latencyHistogramPercentile(h, 50) == 1023);  // Bucket [512, 1024)
+    assert(latencyHistogramPercentile(h, 90) == 1023);
+    assert(latencyHistogramPercentile(h, 95) == 40000); // Clamped to max
+    assert(latencyHistogramPercentile(h, 100) == 40000);
+
+    std::cout << "✓ Latency histogram tests passed!" << std::endl;
 }
 
-void test_getLatchImageBGPure_custom_logos() {
-    std::cout << "Testing getLatchImageBGPure with custom logos..." << std::endl;
-    
-    const char* menuButtons[5] = {
-        "/logos/custom1.bmp",
-        "/logos/custom2.bmp",
-        "/logos/custom1.bmp",
-        "/logos/custom2.bmp",
-        "/logos/custom1.bmp"
-    };
-    
-    const char* screenLogos[5] = {
-        "/logos/screen_logo0.bmp",
-        "/logos/screen_logo1.bmp",
-        "/logos/screen_logo2.bmp",
-        "/logos/screen_logo1.bmp",
-        "/logos/screen_logo2.bmp"
-    };
-    
-    // Test custom logos
-    uint16_t result = getLatchImageBGPure(1, 0, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x1111); // custom1.bmp
-    
-    result = getLatchImageBGPure(1, 1, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x2222); // custom2.bmp
-    
-    std::cout << "✓ Custom logo tests passed!" << std::endl;
+void test_latencyTracker_ignores_untracked_marks() {
+    std::cout << "Testing latency tracker without a touch..." << std::endl;
+
+    LatencyTracker t;
+    latencyReset(t);
+
+    // Serial or settings actions are not preceded by a touch
+    latencyMark(t, LAT_ACTION, 1000);
+    assert(t.stages[LAT_ACTION].count == 0);
+
+    // A touch that is too old is dropped instead of skewing the histogram
+    latencyBegin(t, 0);
+    latencyMark(t, LAT_HID_REPORT, LATENCY_MAX_TRACK_US + 1);
+    assert(t.stages[LAT_HID_REPORT].count == 0);
+    assert(!t.tracking);
+
+    // micros() wrapping around is measured correctly
+    latencyBegin(t, 0xFFFFFF00);
+    latencyMark(t, LAT_JUST_PRESSED, 0x00000100);
+    assert(t.stages[LAT_JUST_PRESSED].maxUs == 0x200);
+
+    std::cout << "✓ Latency tracker tests passed!" << std::endl;
 }
 
-void test_getLatchImageBGPure_fallback_logos() {
-    std::cout << "Testing getLatchImageBGPure with fallback logos..." << std::endl;
-    
-    const char* menuButtons[5] = {
-        "/logos/",  // Should fall back to screen logo
-        "/logos/",  // Should fall back to screen logo
-        "/logos/custom2.bmp",
-        "/logos/",  // Should fall back to screen logo
-        "/logos/custom1.bmp"
-    };
-    
-    const char* screenLogos[5] = {
-        "/logos/screen_logo0.bmp",
-        "/logos/screen_logo1.bmp",
-        "/logos/screen_logo2.bmp",
-        "/logos/screen_logo1.bmp",
-        "/logos/screen_logo2.bmp"
-    };
-    
-    // Test fallback to screen logos
-    uint16_t result = getLatchImageBGPure(1, 0, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x3333); // screen_logo0.bmp
-    
-    result = getLatchImageBGPure(1, 1, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x4444); // screen_logo1.bmp
-    
-    result = getLatchImageBGPure(1, 3, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x4444); // screen_logo1.bmp
-    
-    std::cout << "✓ Fallback logo tests passed!" << std::endl;
+void test_latencyTracker_per_web_load() {
+    std::cout << "Testing latency per web server load..." << std::endl;
+
+    LatencyTracker t;
+    latencyReset(t);
+
+    // Touches without a load are counted as the web server being off
+    latencyBegin(t, 0);
+    latencyMark(t, LAT_HID_REPORT, 8000);
+    latencyBegin(t, 10000, LATENCY_WEB_IDLE);
+    latencyMark(t, LAT_ACTION, 15000);
+    latencyMark(t, LAT_HID_REPORT, 19000);
+    latencyBegin(t, 20000, LATENCY_WEB_BUSY);
+    latencyMark(t, LAT_HID_REPORT, 45000);
+    latencyMark(t, LAT_HID_REPORT, 46000);
+
+    assert(t.stages[LAT_HID_REPORT].count == 4);
+    assert(t.reports[LATENCY_WEB_OFF].count == 1 && t.reports[LATENCY_WEB_OFF].maxUs == 8000);
+    assert(t.reports[LATENCY_WEB_IDLE].count == 1 && t.reports[LATENCY_WEB_IDLE].maxUs == 9000);
+    assert(t.reports[LATENCY_WEB_BUSY].count == 2 && t.reports[LATENCY_WEB_BUSY].minUs == 25000);
+    // Only reports are split
+    assert(t.stages[LAT_ACTION].count == 1);
+
+    // An unknown load does not write past the histograms
+    latencyBegin(t, 50000, LATENCY_LOAD_COUNT);
+    assert(t.load == LATENCY_WEB_OFF);
+
+    latencyReset(t);
+    assert(t.reports[LATENCY_WEB_BUSY].count == 0);
+    assert(strcmp(latencyLoadName(LATENCY_WEB_BUSY), "web-busy") == 0);
+    assert(strcmp(latencyLoadName(LATENCY_LOAD_COUNT), "unknown") == 0);
+
+    std::cout << "✓ Latency per load tests passed!" << std::endl;
 }
 
-void test_getLatchImageBGPure_invalid_inputs() {
-    std::cout << "Testing getLatchImageBGPure with invalid inputs..." << std::endl;
-    
-    const char* menuButtons[5] = {
-        "/logos/custom1.bmp",
-        "/logos/",
-        "/logos/custom2.bmp",
-        "/logos/",
-        "/logos/custom1.bmp"
-    };
-    
-    const char* screenLogos[5] = {
-        "/logos/screen_logo0.bmp",
-        "/logos/screen_logo1.bmp",
-        "/logos/screen_logo2.bmp",
-        "/logos/screen_logo1.bmp",
-        "/logos/screen_logo2.bmp"
-    };
-    
-    // Test invalid page numbers
-    uint16_t result = getLatchImageBGPure(0, 0, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x0000);
-    
-    result = getLatchImageBGPure(6, 0, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x0000);
-    
-    result = getLatchImageBGPure(-1, 0, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x0000);
-    
-    // Test invalid button numbers
-    result = getLatchImageBGPure(1, -1, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x0000);
-    
-    result = getLatchImageBGPure(1, 5, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x0000);
-    
-    result = getLatchImageBGPure(1, 10, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result == 0x0000);
-    
-    std::cout << "✓ Invalid input tests passed!" << std::endl;
+void test_touchTrace_roundtrip() {
+    std::cout << "Testing touch trace encoding..." << std::endl;
+
+    uint8_t header[TOUCH_TRACE_HEADER_SIZE];
+    touchTraceEncodeHeader(header);
+    assert(touchTraceCheckHeader(header));
+    header[4] = TOUCH_TRACE_VERSION + 1;
+    assert(!touchTraceCheckHeader(header));
+
+    TouchTraceSample in = {0x01020304, 2, {319, 7}, {239, 65535}};
+    uint8_t buf[TOUCH_TRACE_SAMPLE_SIZE];
+    touchTraceEncodeSample(in, buf);
+    assert(buf[0] == 0x04 && buf[3] == 0x01); // Little-endian time
+
+    TouchTraceSample out;
+    assert(touchTraceDecodeSample(buf, out));
+    assert(out.timeMs == in.timeMs);
+    assert(touchTraceSameState(in, out));
+
+    buf[4] = 3; // More points than the FT6236 reports
+    assert(!touchTraceDecodeSample(buf, out));
+
+    // Only the used points are compared
+    TouchTraceSample a = {0, 1, {10, 1}, {20, 2}};
+    TouchTraceSample b = {5, 1, {10, 9}, {20, 9}};
+    assert(touchTraceSameState(a, b));
+    b.x[0] = 11;
+    assert(!touchTraceSameState(a, b));
+
+    std::cout << "✓ Touch trace encoding tests passed!" << std::endl;
 }
 
-void test_getLatchImageBGPure_boundary_values() {
-    std::cout << "Testing getLatchImageBGPure with boundary values..." << std::endl;
-    
-    const char* menuButtons[5] = {
-        "/logos/custom1.bmp",
-        "/logos/custom2.bmp",
-        "/logos/custom1.bmp",
-        "/logos/custom2.bmp",
-        "/logos/custom1.bmp"
-    };
-    
-    const char* screenLogos[5] = {
-        "/logos/screen_logo0.bmp",
-        "/logos/screen_logo1.bmp",
-        "/logos/screen_logo2.bmp",
-        "/logos/screen_logo1.bmp",
-        "/logos/screen_logo2.bmp"
+// Reads samples from an in-memory trace file
+struct MemoryTrace {
+    std::vector<uint8_t> bytes;
+    size_t pos;
+};
+
+bool readMemoryTrace(void *context, TouchTraceSample &sample) {
+    MemoryTrace *trace = (MemoryTrace *)context;
+    if (trace->pos + TOUCH_TRACE_SAMPLE_SIZE > trace->bytes.size()) return false;
+    bool ok = touchTraceDecodeSample(&trace->bytes[trace->pos], sample);
+    trace->pos += TOUCH_TRACE_SAMPLE_SIZE;
+    return ok;
+}
+
+void appendTraceSample(MemoryTrace &trace, uint32_t timeMs, uint8_t count,
+                       uint16_t x0, uint16_t y0) {
+    TouchTraceSample sample = {timeMs, count, {x0, 0}, {y0, 0}};
+    uint8_t buf[TOUCH_TRACE_SAMPLE_SIZE];
+    touchTraceEncodeSample(sample, buf);
+    trace.bytes.insert(trace.bytes.end(), buf, buf + sizeof(buf));
+}
+
+// The keypad of main.cpp on its 320x240 screen, built from the KEY_* defines
+// the way buildTouchLayout() does
+bool buildTestKeypad(TouchRegionLayout &layout, uint8_t deadZone) {
+    const int width = 320, height = 240;
+    const int spacingX = width / 24, spacingY = height / 16;
+    return touchRegionBuildKeypad(layout, width, height, width / 6, height / 4,
+                                  width / 3 - spacingX, width / 3 - spacingY,
+                                  spacingX, spacingY, deadZone, 0, nullptr);
+}
+
+// Host model of the pages: the home screen opens the menus of the deck, key 5
+// of a menu goes home and the other keys of a menu toggle their latch at
+// deckFirstButton() + key, as handleMenuPageButton() does. Touches go through
+// the touch tables and tracker of the firmware.
+struct DeckModel {
+    DeckManifest       manifest;
+    TouchRegionTracker tracker;
+    uint8_t            pressed; // Keys pressed after the last sample
+    int                pageNum;
+    bool               latched[DECK_MAX_MENUS * DECK_MAX_BUTTONS];
+    std::vector<int>   events; // page * 10 + key for every press
+};
+
+void deckPoll(DeckModel &deck, const TouchRegionLayout &layout,
+              const TouchTraceSample &touch, uint32_t nowMs) {
+    uint8_t pressed = touchRegionUpdate(deck.tracker, layout, touch.x, touch.y,
+                                        touch.count, nowMs);
+    uint8_t justPressed = pressed & ~deck.pressed;
+    deck.pressed = pressed;
+    for (int b = 0; b < 6; b++) {
+        if (!(justPressed & (1 << b))) continue;
+
+        deck.events.push_back(deck.pageNum * 10 + b);
+        if (deck.pageNum == 0) {
+            if (b < deck.manifest.menuCount) deck.pageNum = b + 1;
+        } else if (b == 5) {
+            deck.pageNum = 0;
+        } else if (b < deck.manifest.buttonCount[deck.pageNum - 1]) {
+            int idx = deckFirstButton(deck.manifest, deck.pageNum - 1) + b;
+            deck.latched[idx] = !deck.latched[idx];
+        }
+    }
+}
+
+DeckModel replayDeck(MemoryTrace trace, uint32_t pollMs, const DeckManifest &manifest) {
+    TouchRegionLayout layout;
+    assert(buildTestKeypad(layout, 4));
+
+    DeckModel deck = {};
+    deck.manifest = manifest;
+    touchRegionReset(deck.tracker);
+    TouchTraceReplay replay;
+    trace.pos = TOUCH_TRACE_HEADER_SIZE;
+    touchTraceReplayBegin(replay, readMemoryTrace, &trace);
+    for (uint32_t t = 0; ; t += pollMs) {
+        bool more = touchTraceReplayAdvance(replay, t, readMemoryTrace, &trace);
+        deckPoll(deck, layout, replay.current, t);
+        if (!more) break;
+    }
+    return deck;
+}
+
+void test_touchTrace_replay_navigation_and_latch() {
+    std::cout << "Testing touch trace replay of navigation and latch..." << std::endl;
+
+    // The keypad tables: key 0 starts at (7, 15), keys are 93x91 and 106
+    // apart, with a 4 pixel dead zone
+    TouchRegionLayout layout;
+    assert(buildTestKeypad(layout, 4));
+    assert(layout.keys == 6);
+    assert(touchRegionAt(layout, 53, 60) == 0);
+    assert(touchRegionAt(layout, 265, 166) == 5);
+    assert(touchRegionAt(layout, 98, 60) == TOUCH_REGION_NONE);  // Dead zone
+    assert(touchRegionAt(layout, 106, 60) == TOUCH_REGION_NONE); // Gap
+
+    // Two menus, the second with 3 buttons
+    DeckManifest manifest = {};
+    manifest.menuCount = 2;
+    manifest.buttonCount[0] = 5;
+    manifest.buttonCount[1] = 3;
+    assert(deckManifestValid(manifest));
+
+    MemoryTrace trace = {std::vector<uint8_t>(TOUCH_TRACE_HEADER_SIZE), 0};
+    touchTraceEncodeHeader(&trace.bytes[0]);
+
+    appendTraceSample(trace, 100, 1, 159, 60);   // Home: open menu 2
+    appendTraceSample(trace, 180, 0, 0, 0);
+    appendTraceSample(trace, 400, 1, 53, 60);    // Menu 2: latch key 0
+    appendTraceSample(trace, 460, 0, 0, 0);
+    appendTraceSample(trace, 700, 1, 53, 62);    // Latch key 0 again
+    appendTraceSample(trace, 705, 1, 54, 62);    // Jitter while held
+    appendTraceSample(trace, 760, 0, 0, 0);
+    appendTraceSample(trace, 910, 1, 265, 60);   // Latch key 2
+    appendTraceSample(trace, 950, 0, 0, 0);
+    appendTraceSample(trace, 1000, 1, 53, 166);  // Key 3, blank on menu 2
+    appendTraceSample(trace, 1050, 0, 0, 0);
+    appendTraceSample(trace, 1100, 1, 98, 60);   // Dead zone of key 0
+    appendTraceSample(trace, 1150, 0, 0, 0);
+    appendTraceSample(trace, 1200, 1, 159, 60);  // Latch key 1...
+    appendTraceSample(trace, 1205, 1, 265, 60);  // ...and slide onto key 2
+    appendTraceSample(trace, 1250, 0, 0, 0);
+    appendTraceSample(trace, 1300, 1, 265, 166); // Back home
+    appendTraceSample(trace, 1350, 0, 0, 0);
+    appendTraceSample(trace, 1400, 1, 265, 60);  // Home: there is no menu 3
+    appendTraceSample(trace, 1450, 0, 0, 0);
+
+    DeckModel first = replayDeck(trace, 5, manifest);
+    int expected[] = {1, 20, 20, 22, 23, 21, 25, 2};
+    assert(first.events.size() == 8);
+    for (int i = 0; i < 8; i++) assert(first.events[i] == expected[i]);
+    assert(first.pageNum == 0);
+    // Menu 2 starts after the 5 buttons of menu 1
+    for (int i = 0; i < DECK_MAX_MENUS * DECK_MAX_BUTTONS; i++) {
+        assert(first.latched[i] == (i == 6 || i == 7));
+    }
+
+    // Replaying the same trace gives the same result every time
+    DeckModel second = replayDeck(trace, 5, manifest);
+    assert(second.events == first.events);
+
+    // A touch shorter than a loop() iteration is missed, as on the device
+    DeckModel slow = replayDeck(trace, 100, manifest);
+    assert(slow.events.size() < first.events.size());
+
+    std::cout << "✓ Touch trace replay tests passed!" << std::endl;
+}
+
+// Simulated resistive panel: skewed and rotated raw axes, like a badly
+// mounted touch overlay on a 240x320 panel
+void simulateRawTouch(float nativeX, float nativeY, float noise,
+                      uint16_t &rawX, uint16_t &rawY) {
+    rawX = (uint16_t)(300 + 14.2f * nativeX + 0.9f * nativeY + noise);
+    rawY = (uint16_t)(3700 - 0.6f * nativeX - 10.8f * nativeY - noise);
+}
+
+void test_affineCalibration_fit() {
+    std::cout << "Testing affine touch calibration fit..." << std::endl;
+
+    // 5 points: four corners and the centre
+    int16_t nx5[] = {20, 219, 20, 219, 120};
+    int16_t ny5[] = {20, 20, 299, 299, 160};
+    float noise5[] = {3, -2, 1, -3, 2};
+    uint16_t rx5[5], ry5[5];
+    for (int i = 0; i < 5; i++) simulateRawTouch(nx5[i], ny5[i], noise5[i], rx5[i], ry5[i]);
+
+    AffineCalibration cal;
+    assert(solveAffineCalibration(rx5, ry5, nx5, ny5, 5, cal));
+    assert(affineCalibrationError(cal, rx5, ry5, nx5, ny5, 5) < 1.0f);
+
+    // Points that were not used for the fit land within a pixel too
+    float x, y;
+    uint16_t rx, ry;
+    simulateRawTouch(60, 250, 0, rx, ry);
+    applyAffineCalibration(cal, rx, ry, x, y);
+    assert(fabsf(x - 60) < 1.0f && fabsf(y - 250) < 1.0f);
+
+    // 9 points with more noise
+    int16_t nx9[9], ny9[9];
+    uint16_t rx9[9], ry9[9];
+    float noise9[] = {4, -5, 2, -1, 5, -4, 3, -2, 0};
+    for (int i = 0; i < 9; i++) {
+        nx9[i] = 20 + (i % 3) * 100;
+        ny9[i] = 20 + (i / 3) * 140;
+        simulateRawTouch(nx9[i], ny9[i], noise9[i], rx9[i], ry9[i]);
+    }
+    assert(solveAffineCalibration(rx9, ry9, nx9, ny9, 9, cal));
+    assert(affineCalibrationError(cal, rx9, ry9, nx9, ny9, 9) < 1.0f);
+
+    // Too few or collinear points can not be solved
+    assert(!solveAffineCalibration(rx5, ry5, nx5, ny5, 4, cal));
+    int16_t lineX[] = {0, 50, 100, 150, 200};
+    int16_t lineY[] = {0, 50, 100, 150, 200};
+    uint16_t lrx[5], lry[5];
+    for (int i = 0; i < 5; i++) {
+        lrx[i] = 500 + i * 100;
+        lry[i] = 500 + i * 100;
+    }
+    assert(!solveAffineCalibration(lrx, lry, lineX, lineY, 5, cal));
+
+    std::cout << "✓ Affine calibration fit tests passed!" << std::endl;
+}
+
+void test_affineCalibration_rotation() {
+    std::cout << "Testing touch rotation mapping..." << std::endl;
+
+    for (uint8_t rotation = 0; rotation < 4; rotation++) {
+        int32_t w = (rotation & 1) ? 320 : 240;
+        int32_t h = (rotation & 1) ? 240 : 320;
+        int32_t corners[4][2] = {{0, 0}, {w - 1, 0}, {0, h - 1}, {w - 1, h - 1}};
+        for (int i = 0; i < 4; i++) {
+            int32_t nx, ny, x, y;
+            rotatedToNative(corners[i][0], corners[i][1], rotation, 240, 320, nx, ny);
+            assert(nx >= 0 && nx < 240 && ny >= 0 && ny < 320);
+            nativeToRotated(nx, ny, rotation, 240, 320, x, y);
+            assert(x == corners[i][0] && y == corners[i][1]);
+        }
+    }
+
+    // Landscape (rotation 1): the native top left ends up bottom left
+    int32_t x, y;
+    nativeToRotated(0, 0, 1, 240, 320, x, y);
+    assert(x == 0 && y == 239);
+
+    std::cout << "✓ Touch rotation mapping tests passed!" << std::endl;
+}
+
+// Key grid of a 320x240 screen as drawn by drawKeypad()
+void buildDeckLayout(TouchRegionLayout &layout, uint8_t deadZone,
+                     uint8_t edgeZone, const uint8_t *minContactMs) {
+    bool ok = touchRegionBuild(layout, 320, 240, 7, 15, 93, 91, 106, 106, 3, 2,
+                               deadZone, edgeZone, minContactMs);
+    assert(ok);
+}
+
+uint8_t touchOne(TouchRegionTracker &tracker, const TouchRegionLayout &layout,
+                 uint16_t x, uint16_t y, uint32_t nowMs) {
+    return touchRegionUpdate(tracker, layout, &x, &y, 1, nowMs);
+}
+
+void test_touchRegions_dead_zones() {
+    std::cout << "Testing touch dead zones..." << std::endl;
+
+    TouchRegionLayout layout;
+    buildDeckLayout(layout, 0, 0, nullptr);
+    assert(touchRegionAt(layout, 53, 60) == 0);
+    assert(touchRegionAt(layout, 7, 15) == 0);
+    assert(touchRegionAt(layout, 99, 105) == 0);
+    assert(touchRegionAt(layout, 100, 60) == TOUCH_REGION_NONE); // Gap
+    assert(touchRegionAt(layout, 265, 166) == 5);
+    assert(touchRegionAt(layout, 319, 166) == TOUCH_REGION_NONE);
+    assert(touchRegionAt(layout, 400, 10) == TOUCH_REGION_NONE); // Off screen
+
+    // Same grid with a 4 pixel dead zone on every key and 14 along the edges
+    buildDeckLayout(layout, 4, 14, nullptr);
+    assert(touchRegionAt(layout, 53, 60) == 0);
+    assert(touchRegionAt(layout, 10, 60) == TOUCH_REGION_NONE);  // Key border
+    assert(touchRegionAt(layout, 13, 60) == TOUCH_REGION_NONE);  // Screen edge
+    assert(touchRegionAt(layout, 14, 60) == 0);
+    assert(touchRegionAt(layout, 97, 60) == TOUCH_REGION_NONE);
+    assert(touchRegionAt(layout, 159, 19) == 1);
+    assert(touchRegionAt(layout, 159, 18) == TOUCH_REGION_NONE);
+    assert(touchRegionAt(layout, 159, 229) == TOUCH_REGION_NONE);
+
+    // Grids that do not fit are refused
+    assert(!touchRegionBuild(layout, 800, 480, 0, 0, 10, 10, 10, 10, 3, 2, 0, 0,
+                             nullptr));
+    assert(!touchRegionBuild(layout, 320, 240, 0, 0, 10, 10, 10, 10, 3, 3, 0, 0,
+                             nullptr));
+
+    std::cout << "✓ Touch dead zone tests passed!" << std::endl;
+}
+
+void test_touchRegions_contact_and_rejection() {
+    std::cout << "Testing touch contact time and slide rejection..." << std::endl;
+
+    uint8_t minContact[6] = {0, 0, 0, 0, 0, 40};
+    TouchRegionLayout layout;
+    buildDeckLayout(layout, 2, 4, minContact);
+    TouchRegionTracker tracker;
+    touchRegionReset(tracker);
+
+    // Key 0 has no minimum contact time
+    assert(touchOne(tracker, layout, 53, 60, 0) == 0x01);
+    assert(touchRegionUpdate(tracker, layout, nullptr, nullptr, 0, 10) == 0);
+
+    // Key 5 needs 40 ms, a shorter brush is ignored
+    assert(touchOne(tracker, layout, 265, 166, 100) == 0);
+    assert(touchOne(tracker, layout, 266, 166, 120) == 0);
+    assert(touchRegionUpdate(tracker, layout, nullptr, nullptr, 0, 130) == 0);
+    assert(touchOne(tracker, layout, 265, 166, 200) == 0);
+    assert(touchOne(tracker, layout, 265, 166, 240) == 0x20);
+    assert(touchRegionUpdate(tracker, layout, nullptr, nullptr, 0, 250) == 0);
+
+    // Landing in a gap and sliding into a key does not press it
+    assert(touchOne(tracker, layout, 104, 60, 300) == 0);
+    assert(touchOne(tracker, layout, 120, 60, 310) == 0);
+    assert(touchOne(tracker, layout, 159, 60, 400) == 0);
+    assert(touchRegionUpdate(tracker, layout, nullptr, nullptr, 0, 410) == 0);
+
+    // Sliding from one key to another releases the first, ignores the second
+    assert(touchOne(tracker, layout, 53, 60, 500) == 0x01);
+    assert(touchOne(tracker, layout, 159, 60, 520) == 0);
+    assert(touchOne(tracker, layout, 53, 60, 540) == 0);
+    assert(touchRegionUpdate(tracker, layout, nullptr, nullptr, 0, 550) == 0);
+
+    // A second finger landing on another key is a chord, not a slide
+    uint16_t xs[2] = {53, 159};
+    uint16_t ys[2] = {60, 60};
+    assert(touchOne(tracker, layout, 53, 60, 600) == 0x01);
+    assert(touchRegionUpdate(tracker, layout, xs, ys, 2, 620) == 0x03);
+    assert(touchOne(tracker, layout, 159, 60, 640) == 0x02);
+
+    std::cout << "✓ Touch contact time and slide rejection tests passed!" << std::endl;
+}
+
+struct SnapshotConfig {
+    uint16_t colour;
+    bool     sleepenable;
+    uint8_t  minContact[6];
+};
+
+struct SnapshotMenu {
+    char logos[6][32];
+};
+
+void test_configSnapshot() {
+    std::cout << "Testing config snapshot..." << std::endl;
+
+    // Known CRC32 check value
+    assert(configSnapshotCrc32((const uint8_t *)"123456789", 9) == 0xCBF43926);
+
+    SnapshotConfig config = {0x1234, true, {0, 10, 0, 0, 0, 40}};
+    SnapshotMenu menus[3];
+    memset(menus, 0, sizeof(menus));
+    strcpy(menus[0].logos[0], "/logos/music.bmp");
+    strcpy(menus[2].logos[5], "/logos/home.bmp");
+
+    ConfigSnapshotSection sections[2] = {{&config, sizeof(config)},
+                                         {menus, sizeof(menus)}};
+    uint32_t size = configSnapshotSize(sections, 2);
+    assert(size == CONFIG_SNAPSHOT_HEADER_SIZE + sizeof(config) + sizeof(menus));
+    std::vector<uint8_t> image(size);
+    assert(configSnapshotEncode(sections, 2, &image[0]));
+
+    SnapshotConfig loadedConfig;
+    SnapshotMenu loadedMenus[3];
+    memset(&loadedConfig, 0, sizeof(loadedConfig));
+    memset(loadedMenus, 0, sizeof(loadedMenus));
+    ConfigSnapshotSection targets[2] = {{&loadedConfig, sizeof(loadedConfig)},
+                                        {loadedMenus, sizeof(loadedMenus)}};
+    assert(configSnapshotDecode(&image[0], size, targets, 2));
+    assert(memcmp(&loadedConfig, &config, sizeof(config)) == 0);
+    assert(strcmp(loadedMenus[2].logos[5], "/logos/home.bmp") == 0);
+
+    // A flipped payload byte fails the CRC and leaves the targets alone
+    memset(loadedMenus, 0, sizeof(loadedMenus));
+    std::vector<uint8_t> corrupt = image;
+    corrupt[size - 1] ^= 0x01;
+    assert(!configSnapshotDecode(&corrupt[0], size, targets, 2));
+    assert(loadedMenus[0].logos[0][0] == 0);
+
+    // Truncated file
+    assert(!configSnapshotDecode(&image[0], size - 1, targets, 2));
+    assert(!configSnapshotDecode(&image[0], 4, targets, 2));
+
+    // A firmware with a different struct layout sees a stale snapshot
+    SnapshotMenu fewerMenus[2];
+    ConfigSnapshotSection otherLayout[2] = {{&loadedConfig, sizeof(loadedConfig)},
+                                            {fewerMenus, sizeof(fewerMenus)}};
+    assert(!configSnapshotDecode(&image[0], size, otherLayout, 2));
+    assert(!configSnapshotDecode(&image[0], size, targets, 1));
+
+    // A single section can be checked on its own, as when opening a menu
+    uint32_t menuOffset = configSnapshotSectionOffset(sections, 1);
+    assert(menuOffset == CONFIG_SNAPSHOT_HEADER_SIZE + sizeof(config));
+    assert(configSnapshotCheckHeader(&image[0], targets, 2));
+    assert(configSnapshotStoredSize(&image[0], 1) == sizeof(menus));
+    assert(configSnapshotCheckSection(&image[0], 1, &image[menuOffset], sizeof(menus)));
+    assert(!configSnapshotCheckSection(&corrupt[0], 1, &corrupt[menuOffset], sizeof(menus)));
+    assert(configSnapshotCheckSection(&corrupt[0], 0, &corrupt[CONFIG_SNAPSHOT_HEADER_SIZE],
+                                      sizeof(config)));
+
+    // A different snapshot version is stale as well
+    std::vector<uint8_t> oldVersion = image;
+    oldVersion[4]++;
+    assert(!configSnapshotDecode(&oldVersion[0], size, targets, 2));
+
+    std::cout << "✓ Config snapshot tests passed!" << std::endl;
+}
+
+void test_menuCache_lru() {
+    std::cout << "Testing menu cache LRU..." << std::endl;
+
+    MenuCache cache;
+    menuCacheReset(cache);
+    assert(menuCacheFind(cache, 0) == MENU_CACHE_EMPTY);
+
+    // Empty slots are used first
+    int slot = menuCacheVictim(cache, MENU_CACHE_EMPTY);
+    menuCacheAssign(cache, slot, 0);
+    int other = menuCacheVictim(cache, MENU_CACHE_EMPTY);
+    assert(other != slot);
+    menuCacheAssign(cache, other, 1);
+    assert(menuCacheFind(cache, 0) == slot);
+    assert(menuCacheFind(cache, 1) == other);
+
+    // Menu 0 is used again, so menu 1 is the least recently used
+    menuCacheTouch(cache, menuCacheFind(cache, 0));
+    assert(menuCacheVictim(cache, MENU_CACHE_EMPTY) == other);
+
+    // The menu on screen is never evicted, even when it is the oldest
+    assert(menuCacheVictim(cache, 1) == slot);
+
+    menuCacheAssign(cache, other, 2);
+    assert(menuCacheFind(cache, 1) == MENU_CACHE_EMPTY);
+    assert(menuCacheFind(cache, 2) == other);
+
+    std::cout << "✓ Menu cache LRU tests passed!" << std::endl;
+}
+
+void test_menuCache_prefetch() {
+    std::cout << "Testing menu prefetch order..." << std::endl;
+
+    uint16_t visits[MENU_CACHE_MENUS] = {0, 0, 0, 0, 0};
+    int8_t order[MENU_CACHE_MENUS];
+    assert(menuCachePrefetchOrder(visits, order, MENU_CACHE_SLOTS) == 0);
+
+    menuCacheCountVisit(visits, 3);
+    menuCacheCountVisit(visits, 3);
+    menuCacheCountVisit(visits, 1);
+    menuCacheCountVisit(visits, 4);
+    assert(menuCachePrefetchOrder(visits, order, 2) == 2);
+    assert(order[0] == 3 && order[1] == 1); // Tie goes to the lower menu
+    assert(menuCachePrefetchOrder(visits, order, 5) == 3);
+    assert(order[2] == 4);
+
+    // Counts are halved instead of overflowing
+    visits[2] = UINT16_MAX;
+    menuCacheCountVisit(visits, 2);
+    assert(visits[2] == UINT16_MAX / 2 + 1);
+    assert(visits[3] == 1);
+    assert(visits[1] == 0);
+
+    std::cout << "✓ Menu prefetch order tests passed!" << std::endl;
+}
+
+// Feeds a string to the stream parser a few bytes at a time
+struct StringSource {
+    const char *text;
+    size_t pos;
+    size_t chunk;
+};
+
+size_t readStringSource(void *context, uint8_t *buf, size_t len) {
+    StringSource *src = (StringSource *)context;
+    size_t left = strlen(src->text) - src->pos;
+    size_t n = len < src->chunk ? len : src->chunk;
+    if (n > left) n = left;
+    memcpy(buf, src->text + src->pos, n);
+    src->pos += n;
+    return n;
+}
+
+// Records every value as "path=value" (with a '!' when truncated)
+void recordJsonValue(void *context, const JsonStreamPath &path,
+                     JsonStreamType type, const char *value, bool truncated) {
+    std::vector<std::string> *out = (std::vector<std::string> *)context;
+    std::string entry;
+    for (int i = 0; i < path.depth; i++) {
+        if (path.index[i] >= 0) entry += "[" + std::to_string(path.index[i]) + "]";
+        else entry += std::string(i ? "." : "") + path.key[i];
+    }
+    entry += (type == JSON_STREAM_STRING ? "=\"" : "=") + std::string(value);
+    if (truncated) entry += "!";
+    out->push_back(entry);
+}
+
+bool parseJsonString(const char *text, std::vector<std::string> &out,
+                     JsonStream &js, size_t chunk = 3) {
+    StringSource src = {text, 0, chunk};
+    return jsonStreamParse(js, readStringSource, &src, recordJsonValue, &out);
+}
+
+void test_jsonStream_tokens() {
+    std::cout << "Testing streaming JSON parser..." << std::endl;
+
+    JsonStream js;
+    std::vector<std::string> out;
+    assert(parseJsonString(" {\"a\": \"x\\ty\\\"\\u00e9\", \"b\" : [1, -2.5e3, true],"
+                           "\"c\": {\"d\": null, \"e\": []}, \"f\": false}\n", out, js));
+    assert(out.size() == 6);
+    assert(out[0] == "a=\"x\ty\"\xc3\xa9");
+    assert(out[1] == "b[0]=1");
+    assert(out[2] == "b[1]=-2.5e3");
+    assert(out[3] == "b[2]=true");
+    assert(out[4] == "c.d=null");
+    assert(out[5] == "f=false");
+
+    // Long values and keys are cut off and flagged, never overrun
+    std::string longValue(200, 'v');
+    std::string doc = "{\"averyveryverylongkey\": \"" + longValue + "\"}";
+    out.clear();
+    assert(parseJsonString(doc.c_str(), out, js, 64));
+    assert(out.size() == 1);
+    std::string expected = "averyveryverylo=\"" +
+                           std::string(JSON_STREAM_VALUE_SIZE - 1, 'v') + "!";
+    assert(out[0] == expected);
+
+    // Errors tell what and where
+    out.clear();
+    assert(!parseJsonString("{\"a\": 1,}", out, js));
+    assert(strcmp(js.error, "expected key") == 0 && js.offset == 8);
+    assert(!parseJsonString("{\"a\": \"open", out, js));
+    assert(strcmp(js.error, "unterminated string") == 0);
+    assert(!parseJsonString("[[[[[1]]]]]", out, js));
+    assert(strcmp(js.error, "nested too deep") == 0);
+    assert(!parseJsonString("{} x", out, js));
+    assert(!parseJsonString("{\"a\": tru}", out, js));
+    assert(!parseJsonString("", out, js));
+
+    char dest[8];
+    assert(jsonStreamCopy(dest, sizeof(dest), "/l/", "abcd"));
+    assert(strcmp(dest, "/l/abcd") == 0);
+    assert(!jsonStreamCopy(dest, sizeof(dest), "/l/", "abcde"));
+    assert(strcmp(dest, "/l/abcd") == 0);
+
+    std::cout << "✓ Streaming JSON parser tests passed!" << std::endl;
+}
+
+struct MenuFieldHit {
+    MenuField field;
+    int button;
+    int slot;
+};
+
+void recordMenuField(void *context, const JsonStreamPath &path,
+                     JsonStreamType type, const char *value, bool truncated) {
+    std::vector<MenuFieldHit> *out = (std::vector<MenuFieldHit> *)context;
+    MenuFieldHit hit;
+    hit.field = menuFieldAt(path, hit.button, hit.slot);
+    out->push_back(hit);
+}
+
+void test_jsonStream_menuFields() {
+    std::cout << "Testing menu field mapping..." << std::endl;
+
+    const char *menu =
+        "{\"logo0\": \"a.bmp\", \"logo7\": \"x\", \"logo12\": \"x\","
+        " \"button3\": {\"latch\": true, \"latchlogo\": \"b.bmp\","
+        " \"actionarray\": [\"4\", \"0\", \"0\", \"9\", \"0\", \"0\", \"0\", \"0\", \"5\"],"
+        " \"valuearray\": [\"hi\"],"
+        " \"extra\": 1}, \"button9\": {\"latch\": true}}";
+    std::vector<MenuFieldHit> hits;
+    StringSource src = {menu, 0, 16};
+    JsonStream js;
+    assert(jsonStreamParse(js, readStringSource, &src, recordMenuField, &hits));
+    assert(hits.size() == 17);
+    assert(hits[0].field == MENU_FIELD_LOGO && hits[0].button == 0);
+    assert(hits[1].field == MENU_FIELD_NONE); // logo7, only 5 logos
+    assert(hits[2].field == MENU_FIELD_NONE); // logo12
+    assert(hits[3].field == MENU_FIELD_LATCH && hits[3].button == 3);
+    assert(hits[4].field == MENU_FIELD_LATCHLOGO);
+    assert(hits[5].field == MENU_FIELD_ACTION && hits[5].slot == 0);
+    assert(hits[7].field == MENU_FIELD_ACTION && hits[7].slot == 2);
+    assert(hits[8].field == MENU_FIELD_ACTION && hits[8].slot == 3);
+    assert(hits[12].field == MENU_FIELD_ACTION && hits[12].slot == 7);
+    assert(hits[13].field == MENU_FIELD_TOO_MANY && hits[13].slot == 8); // Ninth action
+    assert(hits[14].field == MENU_FIELD_VALUE && hits[14].button == 3 &&
+           hits[14].slot == 0);
+    assert(hits[15].field == MENU_FIELD_NONE); // extra
+    assert(hits[16].field == MENU_FIELD_NONE); // button9
+
+    std::cout << "✓ Menu field mapping tests passed!" << std::endl;
+}
+
+void test_bootPlan() {
+    std::cout << "Testing boot plan..." << std::endl;
+
+    // Display core: a, c(after a, b). Other core: b(after a)
+    BootStage stages[3] = {
+        {"a", 1, 0, NULL},
+        {"b", 0, BOOT_AFTER(0), NULL},
+        {"c", 1, BOOT_AFTER(0) | BOOT_AFTER(1), NULL},
     };
-    
-    // Test boundary values for valid ranges
-    uint16_t result = getLatchImageBGPure(1, 0, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result != 0x0000); // Should be valid
-    
-    result = getLatchImageBGPure(1, 4, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result != 0x0000); // Should be valid
-    
-    result = getLatchImageBGPure(5, 0, menuButtons, screenLogos, mockGetBMPColor);
-    assert(result != 0x0000); // Should be valid
-    
-    std::cout << "✓ Boundary value tests passed!" << std::endl;
+    assert(bootPlanValid(stages, 3));
+
+    // A stage waiting for a later stage on the same core never runs
+    stages[0].after = BOOT_AFTER(2);
+    assert(!bootPlanValid(stages, 3));
+
+    // Stages on two cores waiting for each other
+    stages[0].after = BOOT_AFTER(1);
+    assert(!bootPlanValid(stages, 3));
+
+    // Unknown stage or core
+    stages[0].after = BOOT_AFTER(3);
+    assert(!bootPlanValid(stages, 3));
+    stages[0].after = 0;
+    stages[1].core = BOOT_CORES;
+    assert(!bootPlanValid(stages, 3));
+
+    char line[96];
+    stages[1].core = 0;
+    int len = bootTimelineLine(line, sizeof(line), stages[1], 2500, 5000,
+                               10000, 8);
+    assert(len == (int)strlen(line));
+    assert(strcmp(line, "b            c0     2.5 -     5.0 ms |  ##    |") == 0);
+
+    // A stage too short to show still gets a mark
+    bootTimelineLine(line, sizeof(line), stages[0], 0, 1, 10000, 8);
+    assert(strstr(line, "|#       |") != NULL);
+
+    // Never overruns a short buffer
+    char small[20];
+    bootTimelineLine(small, sizeof(small), stages[0], 0, 1, 10000, 8);
+    assert(strlen(small) < sizeof(small));
+
+    std::cout << "✓ Boot plan tests passed!" << std::endl;
+}
+
+void test_bootReport() {
+    std::cout << "Testing boot reports..." << std::endl;
+
+    BootStage stages[2] = {{"nvs", 1, 0, NULL}, {"hid", 0, 0, NULL}};
+    BootTimeline timeline = {};
+    timeline.startUs[0] = 0;
+    timeline.endUs[0] = 3400;
+    timeline.startUs[1] = 1000;
+    timeline.endUs[1] = 604000;
+
+    BootReportLog log;
+    bootReportLogReset(log);
+    assert(bootReportLogValid(log, sizeof(log)));
+    assert(!bootReportLogValid(log, sizeof(log) - 1));
+    assert(bootReportLatest(log, false) == NULL);
+
+    BootReport &first = bootReportLogAdd(log, timeline, 2, 0, 1234000, false);
+    assert(first.number == 0 && log.count == 1);
+    assert(first.keypadMs == 3 && first.readyMs == 1234);
+    assert(bootReportSlowestStage(first) == 1);
+
+    char line[64];
+    bootReportSummary(line, sizeof(line), first, stages, 2);
+    assert(strcmp(line, "#0 cold: keypad 3 ready 1234 ms, hid 603") == 0);
+
+    // Newest first, the oldest one is dropped when full
+    bootReportLogAdd(log, timeline, 2, 0, 500000, true);
+    for (int i = 0; i < BOOT_REPORT_COUNT; i++) {
+        bootReportLogAdd(log, timeline, 2, 0, 900000, false);
+    }
+    assert(log.count == BOOT_REPORT_COUNT);
+    assert(log.reports[0].number == BOOT_REPORT_COUNT + 1);
+    assert(log.reports[BOOT_REPORT_COUNT - 1].number == 2);
+    assert(bootReportLatest(log, true) == NULL);
+    assert(bootReportLatest(log, false) == &log.reports[0]);
+
+    // Long boots are capped instead of wrapping around
+    BootReport &slow = bootReportLogAdd(log, timeline, 2, 0, 70000000, true);
+    assert(slow.readyMs == UINT16_MAX);
+    assert(bootReportLatest(log, true) == &slow);
+
+    // Reports stored by another firmware are dropped
+    log.version = BOOT_REPORT_VERSION + 1;
+    assert(!bootReportLogValid(log, sizeof(log)));
+
+    std::cout << "✓ Boot report tests passed!" << std::endl;
+}
+
+bool parseDeck(const char *json, DeckManifest &deck) {
+    memset(&deck, 0, sizeof(deck));
+    DeckManifestParse parse = {&deck, true};
+    StringSource src = {json, 0, 7};
+    JsonStream js;
+    return jsonStreamParse(js, readStringSource, &src, deckManifestValue, &parse) &&
+           parse.valid && deckManifestValid(deck);
+}
+
+void test_deckArena() {
+    std::cout << "Testing deck manifest and arena..." << std::endl;
+
+    DeckManifest deck;
+    assert(parseDeck("{\"menus\": [5, 2, 5, 5, 5, 3, 1]}", deck));
+    assert(deck.menuCount == 7);
+    assert(deckButtonTotal(deck) == 26);
+    assert(deckFirstButton(deck, 0) == 0);
+    assert(deckFirstButton(deck, 2) == 7);
+    assert(deckFirstButton(deck, 6) == 25);
+    assert(deckMaxButtons(deck) == 5);
+
+    // Menus need 1 - 5 buttons, and there are at most 16 menus
+    assert(!parseDeck("{\"menus\": [5, 6]}", deck));
+    assert(!parseDeck("{\"menus\": [5, 0]}", deck));
+    assert(!parseDeck("{\"menus\": [5, \"5\"]}", deck));
+    assert(!parseDeck("{\"menus\": []}", deck));
+    // An object has no menu index, nothing may be written for it
+    assert(!parseDeck("{\"menus\": {\"a\": 3}}", deck));
+    assert(deck.menuCount == 0);
+    assert(!parseDeck("{\"menus\": [1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1]}", deck));
+    assert(parseDeck("{\"menus\": [1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1]}", deck));
+    assert(deck.menuCount == DECK_MAX_MENUS);
+
+    deckManifestDefault(deck);
+    assert(deckManifestValid(deck));
+    assert(deck.menuCount == 5 && deckButtonTotal(deck) == 25);
+
+    assert(deckMenuNumber("menu1", "") == 1);
+    assert(deckMenuNumber("menu16.json", ".json") == 16);
+    assert(deckMenuNumber("menu17", "") == 0);
+    assert(deckMenuNumber("menu0", "") == 0);
+    assert(deckMenuNumber("menu01", "") == 0);
+    assert(deckMenuNumber("menu", "") == 0);
+    assert(deckMenuNumber("menu3.json", "") == 0);
+    assert(deckMenuNumber("homescreen", "") == 0);
+
+    // Measuring and filling take the same blocks
+    DeckArena arena;
+    deckArenaBegin(arena, NULL, 0);
+    assert(deckArenaAlloc(arena, 3, 1) == NULL);
+    assert(deckArenaAlloc(arena, 8, 8) == NULL);
+    size_t size = arena.used;
+    assert(size == 16);
+
+    std::vector<uint8_t> buf(size + 8, 0xAA);
+    uint8_t *base = buf.data() + (8 - ((uintptr_t)buf.data() & 7)) % 8;
+    deckArenaBegin(arena, base, size);
+    uint8_t *a = (uint8_t *)deckArenaAlloc(arena, 3, 1);
+    uint8_t *b = (uint8_t *)deckArenaAlloc(arena, 8, 8);
+    assert(a == base && b == base + 8);
+    assert(a[0] == 0 && b[7] == 0);
+    assert(deckArenaFits(arena));
+
+    // An arena that is too small hands out nothing more
+    assert(deckArenaAlloc(arena, 1, 1) == NULL);
+    assert(!deckArenaFits(arena));
+
+    std::cout << "✓ Deck manifest and arena tests passed!" << std::endl;
+}
+
+void test_actionCode() {
+    std::cout << "Testing action bytecode..." << std::endl;
+
+    static ActionPool pool;
+    actionPoolReset(pool);
+    ActionStage stages[DECK_MAX_BUTTONS];
+    actionStageReset(stages, 3);
+
+    // Button 0: type "hello", press CTRL (5, 1), no action, type "hello"
+    const char *values0[] = {"hello", "1", "0", "hello"};
+    uint8_t actions0[] = {4, 5, 0, 4};
+    for (int i = 0; i < 4; i++) {
+        stages[0].action[i] = actions0[i];
+        stages[0].text[i] = actionPoolIntern(pool, values0[i]);
+        actionStageUse(stages[0], i);
+    }
+    // Texts are kept once
+    assert(stages[0].text[0] == stages[0].text[3]);
+
+    // Button 1: modifiers only, the second one has no value
+    stages[1].action[0] = 5;
+    stages[1].text[0] = actionPoolIntern(pool, "2");
+    stages[1].action[1] = 9;
+    actionStageUse(stages[1], 1);
+
+    // Button 2: a delay and "bye", the value came before the action
+    stages[2].text[1] = actionPoolIntern(pool, "bye");
+    stages[2].action[0] = 1;
+    stages[2].text[0] = actionPoolIntern(pool, "200");
+    stages[2].action[1] = 8;
+    actionStageUse(stages[2], 1);
+
+    ActionCode codes[DECK_MAX_BUTTONS];
+    assert(actionCodeCompile(pool, stages, 3, codes));
+
+    // Only the texts of actions 4 and 8 are left: "hello" and "bye"
+    assert(pool.texts == 10);
+    assert(codes[0].count == 3 && codes[0].length == 10);
+    assert(codes[1].count == 2 && codes[1].length == 4);
+    assert(codes[2].count == 2 && codes[2].length == 6);
+    assert(pool.used == pool.texts + 20);
+
+    ActionOp op;
+    uint8_t pos = 0;
+    assert(actionCodeNext(pool, codes[0], pos, op));
+    assert(op.action == 4 && strcmp(op.text, "hello") == 0);
+    assert(actionCodeNext(pool, codes[0], pos, op));
+    assert(op.action == 5 && op.value == 1 && op.text == NULL);
+    assert(actionCodeNext(pool, codes[0], pos, op));
+    assert(op.action == 4 && strcmp(op.text, "hello") == 0);
+    assert(!actionCodeNext(pool, codes[0], pos, op));
+
+    pos = 0;
+    assert(actionCodeNext(pool, codes[2], pos, op));
+    assert(op.action == 1 && op.value == 200);
+    assert(actionCodeNext(pool, codes[2], pos, op));
+    assert(op.action == 8 && strcmp(op.text, "bye") == 0);
+
+    assert(!actionCodeModifiersOnly(pool, codes[0]));
+    assert(actionCodeModifiersOnly(pool, codes[1]));
+    ActionCode none = {0, 0, 0};
+    assert(!actionCodeModifiersOnly(pool, none));
+
+    // A copy holds just the bytes in use
+    ActionPool *clone = actionPoolClone(pool);
+    assert(clone != NULL && clone->used == pool.used);
+    assert(memcmp(clone, &pool, actionPoolStoredSize(pool)) == 0);
+    pos = 0;
+    assert(actionCodeNext(*clone, codes[2], pos, op));
+    assert(actionCodeNext(*clone, codes[2], pos, op));
+    assert(strcmp(op.text, "bye") == 0);
+    free(clone);
+
+    // The most a menu file can hold fits: every button with every action,
+    // each with a text of its own of the longest length
+    actionPoolReset(pool);
+    actionStageReset(stages, DECK_MAX_BUTTONS);
+    char text[ACTION_TEXT_SIZE];
+    for (int b = 0; b < DECK_MAX_BUTTONS; b++) {
+        for (int i = 0; i < ACTION_CODE_MAX_OPS; i++) {
+            snprintf(text, sizeof(text), "%02d%061d", b * ACTION_CODE_MAX_OPS + i, 0);
+            stages[b].action[i] = 4;
+            stages[b].text[i] = actionPoolIntern(pool, text);
+            actionStageUse(stages[b], i);
+        }
+    }
+    assert(!pool.overflow);
+    assert(actionCodeCompile(pool, stages, DECK_MAX_BUTTONS, codes));
+    assert(pool.used == ACTION_POOL_SIZE && !pool.overflow);
+    pos = 0;
+    for (int i = 0; i < ACTION_CODE_MAX_OPS; i++) {
+        assert(actionCodeNext(pool, codes[DECK_MAX_BUTTONS - 1], pos, op));
+    }
+    assert(strcmp(op.text, text) == 0);
+    assert(actionPoolStoredSize(pool) == sizeof(ActionPool));
+
+    // Staged values that did not fit leave the menu without actions
+    actionPoolReset(pool);
+    actionStageReset(stages, 1);
+    for (int i = 0; i <= ACTION_POOL_SIZE / ACTION_TEXT_SIZE; i++) {
+        snprintf(text, sizeof(text), "%02d%061d", i, 0);
+        stages[0].text[0] = actionPoolIntern(pool, text);
+    }
+    stages[0].action[0] = 4;
+    actionStageUse(stages[0], 0);
+    assert(pool.overflow);
+    assert(!actionCodeCompile(pool, stages, 1, codes));
+    assert(codes[0].count == 0 && pool.used == 0);
+    assert(actionPoolStoredSize(pool) == offsetof(ActionPool, bytes));
+
+    std::cout << "✓ Action bytecode tests passed!" << std::endl;
+}
+
+void test_iconTable() {
+    std::cout << "Testing icon table..." << std::endl;
+
+    // Sized for the classic deck of 25 buttons
+    const uint8_t logos = iconTableLogos(25);
+    assert(logos == 64);
+    assert(iconTableLogos(16 * 5) == 2 * 16 * 5 + ICON_TABLE_FIXED);
+    assert(iconTableLogos(200) == ICON_NONE);
+    static IconInfo icons[64];
+    static char paths[64 * ICON_PATH_SIZE];
+    IconTable table;
+    iconTableBegin(table, icons, paths, logos);
+
+    IconId question = iconTableIntern(table, "/logos/", "question.bmp");
+    IconId home = iconTableIntern(table, "/sys/ico/", "home.bmp");
+    assert(question == 0 && home == 1);
+    // The same path is interned once, with or without the prefix
+    assert(iconTableIntern(table, NULL, "/logos/question.bmp") == question);
+    assert(table.count == 2);
+    assert(strcmp(iconTablePath(table, home), "/sys/ico/home.bmp") == 0);
+    assert(strcmp(iconTablePath(table, ICON_NONE), "") == 0);
+    assert(strcmp(iconTablePath(table, 2), "") == 0);
+
+    // Invalidating forgets the headers but keeps the ids
+    table.icons[question].flags = ICON_INFO_READ;
+    table.icons[question].background = 0x1234;
+    iconTableInvalidate(table);
+    assert(table.icons[question].flags == 0);
+    assert(iconTableIntern(table, "/logos/", "question.bmp") == question);
+
+    // A single logo can be invalidated, the others stay read
+    table.icons[question].flags = ICON_INFO_READ;
+    table.icons[home].flags = ICON_INFO_READ;
+    assert(iconTableFind(table, "/sys/ico/home.bmp") == home);
+    assert(iconTableFind(table, "/logos/home.bmp") == ICON_NONE);
+    iconTableInvalidateIcon(table, iconTableFind(table, "/logos/question.bmp"));
+    iconTableInvalidateIcon(table, ICON_NONE);
+    assert(iconTableStale(table, question));
+    assert(!iconTableStale(table, home));
+    assert(!iconTableStale(table, ICON_NONE));
+
+    // A full table hands out ICON_NONE
+    char name[16];
+    for (int i = table.count; i < logos; i++) {
+        snprintf(name, sizeof(name), "%d.bmp", i);
+        assert(iconTableIntern(table, "/logos/", name) == i);
+    }
+    assert(iconTableIntern(table, "/logos/", "new.bmp") == ICON_NONE);
+    assert(iconTableIntern(table, "/logos/", "7.bmp") == 7);
+
+    // Ids nothing keeps are freed and handed out again, kept ones stay
+    uint8_t keep[ICON_NONE] = {};
+    iconTableKeep(table, keep, question);
+    iconTableKeep(table, keep, home);
+    iconTableKeep(table, keep, 7);
+    iconTableKeep(table, keep, ICON_NONE);
+    table.icons[7].flags = ICON_INFO_READ;
+    assert(iconTableSweep(table, keep) == logos - 3);
+    assert(table.count == 8);
+    assert(iconTableFind(table, "/logos/8.bmp") == ICON_NONE);
+    assert(strcmp(iconTablePath(table, 7), "/logos/7.bmp") == 0);
+    assert(!iconTableStale(table, 7));
+    IconId reused = iconTableIntern(table, "/logos/", "new.bmp");
+    assert(reused == 2 && table.icons[reused].flags == 0);
+    assert(strcmp(iconTablePath(table, reused), "/logos/new.bmp") == 0);
+    assert(iconTableIntern(table, "/logos/", "7.bmp") == 7);
+    memset(keep, 0, sizeof(keep));
+    assert(iconTableSweep(table, keep) == 4 && table.count == 0);
+
+    // So does a table without storage
+    IconTable empty;
+    iconTableBegin(empty, NULL, NULL, 0);
+    assert(iconTableIntern(empty, "/logos/", "question.bmp") == ICON_NONE);
+    assert(strcmp(iconTablePath(empty, 0), "") == 0);
+
+    // Header of a 75x75 24 bpp bitmap
+    uint8_t header[54] = {'B', 'M'};
+    header[0x0A] = 54;
+    header[0x12] = 75;
+    header[0x16] = 75;
+    header[0x1C] = 24;
+    IconInfo info = {};
+    uint32_t dataOffset = 0;
+    assert(iconInfoFromBmpHeader(header, sizeof(header), info, dataOffset));
+    assert(info.width == 75 && info.height == 75 && info.bpp == 24);
+    assert(dataOffset == 54);
+    assert(!iconInfoFromBmpHeader(header, 20, info, dataOffset));
+    header[0] = 'P';
+    assert(!iconInfoFromBmpHeader(header, sizeof(header), info, dataOffset));
+
+    std::cout << "✓ Icon table tests passed!" << std::endl;
+}
+
+void test_configReload() {
+    std::cout << "Testing config reload..." << std::endl;
+
+    assert(configChangedByFile("/config/general.json") == CONFIG_CHANGED_GENERAL);
+    assert(configChangedByFile("homescreen.json") == CONFIG_CHANGED_HOME);
+    assert(configChangedByFile("/config/deck.json") == CONFIG_CHANGED_DECK);
+    assert(configChangedByFile("/config/menu1.json") == CONFIG_CHANGED_MENU(0));
+    assert(configChangedByFile("/config/menu16.json") == CONFIG_CHANGED_MENU(15));
+    assert(CONFIG_CHANGED_MENU(15) == 0x80000000);
+    assert((CONFIG_CHANGED_MENU(3) & CONFIG_CHANGED_MENUS) == CONFIG_CHANGED_MENU(3));
+    // Files that are not part of the running config
+    assert(configChangedByFile("/config/wificonfig.json") == 0);
+    assert(configChangedByFile("/config/default.json") == 0);
+    assert(configChangedByFile("/config/menu17.json") == 0);
+    assert(configChangedByFile("/config/menu1.json.bak") == 0);
+
+    uint8_t before[6] = {0, 1, 2, 3, 4, 5};
+    uint8_t after[6] = {0, 9, 2, 3, 4, 7};
+    assert(configKeysChanged(before, after, 1, 6) == ((1 << 1) | (1 << 5)));
+    // Only the keys of the page are compared
+    assert(configKeysChanged(before, after, 1, 5) == (1 << 1));
+    assert(configKeysChanged(before, before, 1, 6) == 0);
+
+    struct Record { uint16_t a; uint8_t b; uint8_t c; };
+    Record r1[3] = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+    Record r2[3] = {{1, 2, 3}, {4, 5, 6}, {7, 8, 0}};
+    assert(configKeysChanged(r1, r2, sizeof(Record), 3) == (1 << 2));
+
+    std::cout << "✓ Config reload tests passed!" << std::endl;
+}
+
+// In-memory filesystem for the config store. Every write, remove or rename
+// is a step; a crash stops everything from a step on (power lost), a failure
+// makes only that step fail.
+struct MemFs {
+    std::map<std::string, std::string> files;
+    int  steps;
+    int  crashAt; // -1 for never
+    int  failAt;  // -1 for never
+    bool corrupt; // Writes flip a byte
+    bool off;     // Set by the crash
+};
+
+bool memFsDead(MemFs &fs) { return fs.off; }
+
+bool memFsStep(MemFs &fs) {
+    if (fs.off) {
+        return false;
+    }
+    if (fs.steps == fs.crashAt) {
+        fs.off = true;
+        return false;
+    }
+    return fs.steps++ != fs.failAt;
+}
+
+bool memFsExists(void *context, const char *path) {
+    MemFs &fs = *(MemFs *)context;
+    return !memFsDead(fs) && fs.files.count(path) > 0;
+}
+
+bool memFsRemove(void *context, const char *path) {
+    MemFs &fs = *(MemFs *)context;
+    if (!memFsStep(fs) || fs.files.count(path) == 0) {
+        return false;
+    }
+    fs.files.erase(path);
+    return true;
+}
+
+bool memFsRename(void *context, const char *from, const char *to) {
+    MemFs &fs = *(MemFs *)context;
+    // Like SPIFFS, no rename onto an existing file
+    if (!memFsStep(fs) || fs.files.count(from) == 0 || fs.files.count(to) > 0) {
+        return false;
+    }
+    fs.files[to] = fs.files[from];
+    fs.files.erase(from);
+    return true;
+}
+
+bool memFsWrite(void *context, const char *path, const uint8_t *data, size_t len) {
+    MemFs &fs = *(MemFs *)context;
+    bool wasOff = fs.off;
+    bool ok = memFsStep(fs);
+    if (wasOff) {
+        return false;
+    }
+    // A write that is cut short leaves half of the data
+    std::string content((const char *)data, ok ? len : len / 2);
+    if (fs.corrupt && !content.empty()) {
+        content[0] ^= 0x20;
+    }
+    fs.files[path] = content;
+    return ok;
+}
+
+bool memFsCheck(void *context, const char *path, ConfigStoreSum &sum) {
+    MemFs &fs = *(MemFs *)context;
+    if (memFsDead(fs) || fs.files.count(path) == 0) {
+        return false;
+    }
+    const std::string &content = fs.files[path];
+    configStoreSumAdd(sum, (const uint8_t *)content.data(), content.size());
+    return true;
+}
+
+bool memFsSave(MemFs &fs, const char *path, const std::string &content) {
+    ConfigStoreFs store = {&fs, memFsExists, memFsRemove, memFsRename, memFsWrite,
+                           memFsCheck};
+    return configStoreSave(store, path, (const uint8_t *)content.data(),
+                           content.size());
+}
+
+ConfigStoreRecovery memFsReboot(MemFs &fs, const char *path) {
+    fs.crashAt = -1;
+    fs.failAt = -1;
+    fs.off = false;
+    ConfigStoreFs store = {&fs, memFsExists, memFsRemove, memFsRename, memFsWrite,
+                           memFsCheck};
+    return configStoreRecover(store, path);
+}
+
+void test_configStore() {
+    std::cout << "Testing journaled config writes..." << std::endl;
+
+    const char *path = "/config/general.json";
+    const std::string older = "{\"v\": 0}";
+    const std::string old = "{\"v\": 1}";
+    const std::string next = "{\"v\": 2, \"longer\": true}";
+
+    // CRC32 can be summed in parts
+    const uint8_t check[] = "123456789";
+    assert(configSnapshotCrc32(check, 9) == 0xCBF43926);
+    ConfigStoreSum sum = {0, 0};
+    configStoreSumAdd(sum, check, 4);
+    configStoreSumAdd(sum, check + 4, 5);
+    assert(sum.crc == 0xCBF43926 && sum.len == 9);
+
+    // A save keeps the previous generation and leaves nothing else
+    MemFs fs = {{{path, old}, {"/config/general.json.bak", older}}, 0, -1, -1, false,
+                false};
+    assert(memFsSave(fs, path, next));
+    assert(fs.files[path] == next);
+    assert(fs.files["/config/general.json.bak"] == old);
+    assert(fs.files.size() == 2);
+    int saveSteps = fs.steps;
+    assert(memFsReboot(fs, path) == CONFIG_STORE_CLEAN);
+
+    // The first save of a file
+    MemFs first = {{}, 0, -1, -1, false, false};
+    assert(memFsSave(first, path, next));
+    assert(first.files[path] == next && first.files.size() == 1);
+
+    // Power lost at every step: after the reboot the file is old or new,
+    // never missing or cut short
+    for (int step = 0; step <= saveSteps; step++) {
+        MemFs crash = {{{path, old}, {"/config/general.json.bak", older}}, 0, step, -1,
+                       false, false};
+        bool saved = memFsSave(crash, path, next);
+        assert(saved == (step == saveSteps));
+        memFsReboot(crash, path);
+        assert(crash.files.count(path) == 1);
+        assert(crash.files[path] == old || crash.files[path] == next);
+        assert(crash.files.count("/config/general.json.tmp") == 0);
+        assert(crash.files.count("/config/general.json.new") == 0);
+        // Once the new version was checked it is the one that is used
+        if (step >= 2) {
+            assert(crash.files[path] == next);
+        }
+    }
+
+    // A step that fails without a power loss
+    for (int step = 0; step < saveSteps; step++) {
+        MemFs fail = {{{path, old}, {"/config/general.json.bak", older}}, 0, -1, step,
+                      false, false};
+        assert(!memFsSave(fail, path, next));
+        memFsReboot(fail, path);
+        assert(fail.files.count(path) == 1);
+        assert(fail.files[path] == old || fail.files[path] == next);
+    }
+
+    // A write that does not read back is never swapped in
+    MemFs corrupt = {{{path, old}}, 0, -1, -1, true, false};
+    assert(!memFsSave(corrupt, path, next));
+    assert(corrupt.files[path] == old && corrupt.files.size() == 1);
+
+    // Going back to the previous generation
+    ConfigStoreFs store = {&fs, memFsExists, memFsRemove, memFsRename, memFsWrite,
+                           memFsCheck};
+    assert(configStoreRollback(store, path));
+    assert(fs.files[path] == old && fs.files.count("/config/general.json.bak") == 0);
+    assert(!configStoreRollback(store, path));
+
+    // Only the previous generation is left
+    fs.files.erase(path);
+    fs.files["/config/general.json.bak"] = older;
+    assert(memFsReboot(fs, path) == CONFIG_STORE_ROLLED_BACK);
+    assert(fs.files[path] == older);
+
+    std::cout << "✓ Journaled config write tests passed!" << std::endl;
+}
+
+bool checkConfig(ConfigSchemaFile file, const char *text, ConfigSchemaCheck &check) {
+    StringSource src = {text, 0, 5};
+    return configSchemaValidate(check, file, readStringSource, &src);
+}
+
+void test_configSchema() {
+    std::cout << "Testing config field table..." << std::endl;
+
+    // Names the configurator saves under
+    char path[CONFIG_STORE_PATH_SIZE];
+    assert(configSchemaFile("general", path, sizeof(path)) == CONFIG_SCHEMA_GENERAL);
+    assert(strcmp(path, "/config/general.json") == 0);
+    assert(configSchemaFile("wifi", path, sizeof(path)) == CONFIG_SCHEMA_WIFI);
+    assert(strcmp(path, "/config/wificonfig.json") == 0);
+    assert(configSchemaFile("homescreen", path, sizeof(path)) == CONFIG_SCHEMA_HOME);
+    assert(configSchemaFile("menu12", path, sizeof(path)) == CONFIG_SCHEMA_MENU);
+    assert(strcmp(path, "/config/menu12.json") == 0);
+    assert(configSchemaFile("menu0", path, sizeof(path)) == CONFIG_SCHEMA_NONE);
+    assert(configSchemaFile("deck", path, sizeof(path)) == CONFIG_SCHEMA_DECK);
+    assert(strcmp(path, "/config/deck.json") == 0);
+    assert(configSchemaFile("../general", path, sizeof(path)) == CONFIG_SCHEMA_NONE);
+
+    // What the configurator posts
+    ConfigSchemaCheck check;
+    assert(checkConfig(CONFIG_SCHEMA_GENERAL,
+                       "{\"menubuttoncolor\":\"#510101\",\"functionbuttoncolor\":\"#3c0548\","
+                       "\"latchcolor\":\"#f9b31a\",\"background\":\"#000000\","
+                       "\"sleepenable\":true,\"beep\":false,\"sleeptimer\":20,"
+                       "\"modifier1\":128,\"modifier2\":0,\"modifier3\":0,\"helperdelay\":0,"
+                       "\"touchdeadzone\":2,\"touchedgezone\":4,"
+                       "\"touchmincontact\":[0,0,0,0,0,30],\"prefetchmenus\":true}",
+                       check));
+    assert(checkConfig(CONFIG_SCHEMA_WIFI,
+                       "{\"ssid\":\"net\",\"password\":\"---\",\"wifimode\":\"WIFI_STA\","
+                       "\"wifihostname\":\"freetouchdeck\",\"attempts\":20,"
+                       "\"attemptdelay\":1000}",
+                       check));
+    assert(checkConfig(CONFIG_SCHEMA_HOME,
+                       "{\"logo0\":\"a.bmp\",\"logo5\":\"sys/ico/settings.bmp\"}", check));
+    const char *menu =
+        "{\"logo0\":\"question.bmp\",\"logo4\":\"b.bmp\","
+        "\"button0\":{\"latch\":true,\"latchlogo\":\"\","
+        "\"actionarray\":[\"4\",\"1\",0],\"valuearray\":[\"Hello, world\",\"1000\",0]},"
+        "\"button4\":{\"latch\":false,\"latchlogo\":\"c.bmp\","
+        "\"actionarray\":[\"0\",\"0\",\"0\"],\"valuearray\":[\"0\",\"0\",\"0\"]}}";
+    assert(checkConfig(CONFIG_SCHEMA_MENU, menu, check));
+    assert(check.error == NULL);
+    assert(checkConfig(CONFIG_SCHEMA_DECK, "{\"menus\":[5,5,5,5,5,3]}", check));
+
+    // A deck the arena cannot hold
+    assert(!checkConfig(CONFIG_SCHEMA_DECK, "{\"menus\":[5,6]}", check));
+    assert(strcmp(check.error, "out of range") == 0 && strcmp(check.where, "menus[1]") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_DECK,
+                        "{\"menus\":[1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1]}", check));
+    assert(strcmp(check.where, "menus[16]") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_DECK, "{\"menus\":[]}", check));
+    assert(strcmp(check.error, "missing field") == 0);
+
+    // Fields that are not in the table
+    assert(!checkConfig(CONFIG_SCHEMA_MENU, "{\"logo0\":\"a.bmp\",\"logo5\":\"b.bmp\"}", check));
+    assert(strcmp(check.error, "unknown field") == 0 && strcmp(check.where, "logo5") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_MENU, "{\"logo0\":\"a.bmp\",\"button5\":{\"latch\":true}}",
+                        check));
+    assert(strcmp(check.where, "button5.latch") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_MENU,
+                        "{\"logo0\":\"a.bmp\",\"button0\":{\"actionarray\":[1,2,3,4,5,6,7,8,9]}}",
+                        check));
+    assert(strcmp(check.error, "unknown field") == 0 &&
+           strcmp(check.where, "button0.actionarray[8]") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_MENU,
+                        "{\"logo0\":\"a.bmp\",\"button0\":{\"latch\":{\"on\":true}}}", check));
+    assert(!checkConfig(CONFIG_SCHEMA_GENERAL, "{\"sleeptimerx\":1}", check));
+    assert(strcmp(check.where, "sleeptimerx") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_HOME, "\"logo0\"", check));
+
+    // Values the loader would misread or truncate
+    assert(!checkConfig(CONFIG_SCHEMA_WIFI,
+                        "{\"ssid\":\"a\",\"password\":\"b\",\"wifimode\":\"WIFI_STA\","
+                        "\"attempts\":\"20\"}",
+                        check));
+    assert(strcmp(check.error, "wrong type") == 0 && strcmp(check.where, "attempts") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_WIFI,
+                        "{\"ssid\":\"a\",\"password\":\"b\",\"wifimode\":\"WIFI_STA\","
+                        "\"attempts\":256}",
+                        check));
+    assert(strcmp(check.error, "out of range") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_WIFI,
+                        "{\"ssid\":\"a\",\"password\":\"b\",\"wifimode\":\"WIFI_STA\","
+                        "\"attemptdelay\":-5}",
+                        check));
+    assert(strcmp(check.error, "not a whole number") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_WIFI,
+                        "{\"ssid\":\"a\",\"password\":\"b\",\"wifimode\":\"WIFI_STA\","
+                        "\"attemptdelay\":1.5}",
+                        check));
+    assert(!checkConfig(CONFIG_SCHEMA_WIFI,
+                        "{\"ssid\":\"a\",\"password\":\"b\",\"wifimode\":\"WIFI_STAAP\"}",
+                        check));
+    assert(strcmp(check.error, "too long") == 0 && strcmp(check.where, "wifimode") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_HOME,
+                        "{\"logo0\":\"a_logo_name_that_is_too_long.bmp\"}", check));
+    assert(strcmp(check.error, "too long") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_GENERAL,
+                        "{\"menubuttoncolor\":\"#510101\",\"sleepenable\":null}", check));
+    assert(strcmp(check.error, "wrong type") == 0);
+
+    // Required fields and broken JSON
+    assert(!checkConfig(CONFIG_SCHEMA_WIFI, "{\"ssid\":\"a\",\"password\":\"b\"}", check));
+    assert(strcmp(check.error, "missing field") == 0 && strcmp(check.where, "wifimode") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_MENU, "{}", check));
+    assert(strcmp(check.where, "logo#") == 0);
+    assert(!checkConfig(CONFIG_SCHEMA_MENU, "{\"logo0\":\"a.bmp\"", check));
+    assert(check.error != NULL);
+    assert(!checkConfig(CONFIG_SCHEMA_NONE, "{}", check));
+
+    std::cout << "✓ Config field table tests passed!" << std::endl;
+}
+
+// Hands out the names of a vector, an empty name is left out
+struct NameWalk {
+    const std::vector<std::string> *names;
+    size_t next;
+};
+
+bool nextNameEntry(void *context, char *entry, size_t size) {
+    NameWalk *walk = (NameWalk *)context;
+    if (walk->next >= walk->names->size()) return false;
+    size_t n = walk->next++;
+    if ((*walk->names)[n].empty()) return true;
+    jsonChunkPair(entry, size, std::to_string(n).c_str(), (*walk->names)[n].c_str());
+    return true;
+}
+
+std::string chunkNames(const std::vector<std::string> &names, size_t bufSize) {
+    NameWalk walk = {&names, 0};
+    JsonChunker chunker;
+    jsonChunkBegin(chunker, nextNameEntry, &walk);
+    std::string out;
+    uint8_t buf[256];
+    size_t n;
+    while ((n = jsonChunkFill(chunker, buf, bufSize)) > 0) {
+        assert(n <= bufSize);
+        out.append((const char *)buf, n);
+    }
+    assert(jsonChunkFill(chunker, buf, bufSize) == 0);
+    return out;
+}
+
+void test_jsonChunk() {
+    std::cout << "Testing chunked JSON replies..." << std::endl;
+
+    std::vector<std::string> none;
+    assert(chunkNames(none, 1) == "[]");
+
+    // The same reply whatever the size of the buffers
+    std::vector<std::string> names = {"a.bmp", "say \"hi\".bmp", "", "tab\there.bmp"};
+    const std::string expected =
+        "[{\"0\":\"a.bmp\"},{\"1\":\"say \\\"hi\\\".bmp\"},{\"3\":\"tab\\u0009here.bmp\"}]";
+    for (size_t size = 1; size <= 256; size++) {
+        assert(chunkNames(names, size) == expected);
+    }
+
+    // Every piece parses back
+    JsonStream js;
+    std::vector<std::string> values;
+    assert(parseJsonString(expected.c_str(), values, js));
+    assert(values.size() == 3 && values[1] == "[1].1=\"say \"hi\".bmp");
+
+    // A value that does not fit is cut without breaking an escape sequence
+    char entry[20];
+    assert(jsonChunkPair(entry, sizeof(entry), "7", "abc"));
+    assert(strcmp(entry, "{\"7\":\"abc\"}") == 0);
+    assert(!jsonChunkPair(entry, sizeof(entry), "7", "abcdefghij\"klmnop"));
+    assert(strcmp(entry, "{\"7\":\"abcdefghij\"}") == 0);
+    assert(!jsonChunkPair(entry, 8, "long key", "x"));
+    assert(entry[0] == '\0');
+
+    std::cout << "✓ Chunked JSON reply tests passed!" << std::endl;
+}
+
+void test_assetCache() {
+    std::cout << "Testing configurator asset cache..." << std::endl;
+
+    AssetCache cache;
+    assetCacheReset(cache);
+    const Asset *index = assetCacheAdd(cache, configuratorAssets[0], 0x0badf00d, 11895, true);
+    assert(index && strcmp(index->etag, "\"0badf00d-2e77\"") == 0 && index->gzipped);
+    // Read from the filesystem unless a flash build points it at its data
+    assert(index->data == NULL);
+    assert(assetCacheAdd(cache, configuratorAssets[1], 0xffffffff, 24600, true));
+
+    // "/" is the configurator itself
+    assert(assetCacheFind(cache, "/") == index);
+    assert(assetCacheFind(cache, "/index.htm") == index);
+    assert(assetCacheFind(cache, "/jquery-3.5.1.slim.min.js") == &cache.assets[1]);
+    assert(assetCacheFind(cache, "/favicon.ico") == NULL);
+
+    AssetSpec longName = {"/a-name-that-is-far-too-long-for-spiffs.htm", 0};
+    assert(assetCacheAdd(cache, longName, 0, 0, false) == NULL);
+    while (cache.count < ASSET_CACHE_SIZE) {
+        assert(assetCacheAdd(cache, configuratorAssets[2], 1, 1, false));
+    }
+    assert(assetCacheAdd(cache, configuratorAssets[2], 1, 1, false) == NULL);
+
+    // If-None-Match
+    const char *etag = "\"0badf00d-2e77\"";
+    assert(assetEtagMatches("\"0badf00d-2e77\"", etag));
+    assert(assetEtagMatches("W/\"0badf00d-2e77\"", etag));
+    assert(assetEtagMatches("\"1\", \"0badf00d-2e77\"", etag));
+    assert(assetEtagMatches("*", etag));
+    assert(!assetEtagMatches("\"0badf00d-2e78\"", etag));
+    assert(!assetEtagMatches("\"0badf00d-2e77", etag));
+    assert(!assetEtagMatches("0badf00d-2e77", etag));
+    assert(!assetEtagMatches("", etag));
+
+    // Cache-Control and Content-Type
+    char control[40];
+    assetCacheControl(*index, control, sizeof(control));
+    assert(strcmp(control, "no-cache") == 0);
+    assetCacheControl(cache.assets[1], control, sizeof(control));
+    assert(strcmp(control, "public, max-age=31536000") == 0);
+    assert(strcmp(assetContentType("/index.htm"), "text/html") == 0);
+    assert(strcmp(assetContentType("/jquery-3.5.1.slim.min.js"), "application/javascript") == 0);
+    assert(strcmp(assetContentType("/favicon.ico"), "image/x-icon") == 0);
+    assert(strcmp(assetContentType("/README"), "application/octet-stream") == 0);
+
+    std::cout << "✓ Asset cache tests passed!" << std::endl;
+}
+
+void test_uploadAdmit() {
+    std::cout << "Testing upload admission..." << std::endl;
+
+    UploadBudget budget;
+    // 20 logos of 17 kB in one request, 1 MB free
+    assert(uploadAdmit(budget, 20 * 17000, 1000000, UPLOAD_REQUEST_QUOTA) == UPLOAD_OVER_QUOTA);
+    assert(uploadVerdictStatus(budget.verdict) == 413);
+
+    // 10 of them fit the quota, and the space above the reserve
+    assert(uploadAdmit(budget, 10 * 17000, 1000000, UPLOAD_REQUEST_QUOTA) == UPLOAD_ADMITTED);
+    assert(budget.cost == uploadFlashCost(170000) && budget.cost > 170000);
+    assert(budget.available == 1000000 - UPLOAD_FREE_RESERVE);
+    assert(uploadVerdictStatus(budget.verdict) == 200);
+
+    // The reserve is not given away
+    assert(uploadAdmit(budget, 17000, UPLOAD_FREE_RESERVE + 17000, UPLOAD_REQUEST_QUOTA) == UPLOAD_NO_SPACE);
+    assert(uploadAdmit(budget, 17000, UPLOAD_FREE_RESERVE + uploadFlashCost(17000), UPLOAD_REQUEST_QUOTA) == UPLOAD_ADMITTED);
+    assert(uploadAdmit(budget, 17000, 50000, UPLOAD_REQUEST_QUOTA) == UPLOAD_NO_SPACE);
+    assert(budget.available == 0 && uploadVerdictStatus(budget.verdict) == 507);
+    assert(strcmp(uploadVerdictCode(budget.verdict), "103") == 0);
+
+    // Without a Content-Length nothing is written
+    assert(uploadAdmit(budget, 0, 1000000, UPLOAD_REQUEST_QUOTA) == UPLOAD_NO_LENGTH);
+    assert(uploadVerdictStatus(budget.verdict) == 411);
+
+    // The error text carries the sizes
+    char text[UPLOAD_TEXT_SIZE];
+    uploadAdmit(budget, 200000, 150000, UPLOAD_REQUEST_QUOTA);
+    uploadVerdictText(budget, text, sizeof(text));
+    assert(strstr(text, "need 207 kB and 48 kB is left") != NULL);
+    uploadAdmit(budget, 300000, 1000000, UPLOAD_REQUEST_QUOTA);
+    uploadVerdictText(budget, text, sizeof(text));
+    assert(strstr(text, "292 kB, at most 256 kB") != NULL);
+
+    // A request that got no memory is an error, not an upload of nothing
+    budget.verdict = UPLOAD_NO_MEMORY;
+    assert(uploadVerdictStatus(budget.verdict) == 500);
+    assert(strcmp(uploadVerdictCode(budget.verdict), "109") == 0);
+    uploadVerdictText(budget, text, sizeof(text));
+    assert(strstr(text, "nothing was stored") != NULL);
+
+    std::cout << "✓ Upload admission tests passed!" << std::endl;
+}
+
+void test_remoteControl() {
+    std::cout << "Testing remote control requests..." << std::endl;
+
+    uint8_t op = 99;
+    assert(controlParseOp("", op) && op == CONTROL_TAP);
+    assert(controlParseOp("press", op) && op == CONTROL_PRESS);
+    assert(controlParseOp("release", op) && op == CONTROL_RELEASE);
+    assert(!controlParseOp("hold", op));
+
+    uint8_t button = 99;
+    assert(controlParseButton("0", button) && button == 0);
+    assert(controlParseButton("5", button) && button == 5);
+    assert(!controlParseButton("6", button));
+    assert(!controlParseButton("12", button));
+    assert(!controlParseButton("", button));
+
+    // A deck of 10 menus, settings is page 100
+    int16_t page = -1;
+    assert(controlParsePage("home", 10, 100, page) && page == 0);
+    assert(controlParsePage("settings", 10, 100, page) && page == 100);
+    assert(controlParsePage("menu10", 10, 100, page) && page == 10);
+    assert(controlParsePage("3", 10, 100, page) && page == 3);
+    assert(!controlParsePage("menu11", 10, 100, page));
+    assert(!controlParsePage("menu0", 10, 100, page));
+    assert(!controlParsePage("menu", 10, 100, page));
+    assert(!controlParsePage("2a", 10, 100, page));
+    assert(!controlParsePage("1000", 10, 100, page));
+    assert(page == 3);
+
+    char name[12];
+    controlPageName(name, sizeof(name), 0, 10, 100);
+    assert(strcmp(name, "home") == 0);
+    controlPageName(name, sizeof(name), 7, 10, 100);
+    assert(strcmp(name, "menu7") == 0);
+    controlPageName(name, sizeof(name), 101, 10, 100);
+    assert(strcmp(name, "other") == 0);
+
+    char reply[CONTROL_STATE_SIZE];
+    bool keys[6] = {false, true, false, false, true, false};
+    assert(controlStateJson(reply, sizeof(reply), "menu7", keys, 6) > 0);
+    assert(strcmp(reply, "{\"page\":\"menu7\",\"latched\":[0,1,0,0,1,0]}") == 0);
+    controlStateJson(reply, sizeof(reply), "home", keys, 0);
+    assert(strcmp(reply, "{\"page\":\"home\",\"latched\":[]}") == 0);
+    // Too small, nothing half written is sent
+    assert(controlStateJson(reply, 20, "menu7", keys, 6) == 0);
+
+    std::cout << "✓ Remote control tests passed!" << std::endl;
+}
+
+void test_liveState() {
+    std::cout << "Testing live state frames..." << std::endl;
+
+    LiveState sent = {3, 0x05, 200, LIVE_LINK_BLE | LIVE_LINK_WIFI};
+    uint8_t frame[LIVE_FRAME_SIZE];
+
+    // A snapshot holds every field
+    size_t len = liveEncode(frame, sizeof(frame), 0x1234, NULL, sent);
+    const uint8_t snapshot[] = {LIVE_SNAPSHOT, 0x34, 0x12, LIVE_PAGE, 3, 0,
+                                LIVE_LATCHES, 0x05, LIVE_BRIGHTNESS, 200,
+                                LIVE_LINK, 0x03};
+    assert(len == sizeof(snapshot) && memcmp(frame, snapshot, len) == 0);
+
+    // A delta only what changed, nothing when nothing did
+    assert(liveEncode(frame, sizeof(frame), 1, &sent, sent) == 0);
+    LiveState state = sent;
+    state.latches = 0x07;
+    state.page = 100;
+    len = liveEncode(frame, sizeof(frame), 2, &sent, state);
+    const uint8_t delta[] = {LIVE_DELTA, 2, 0, LIVE_PAGE, 100, 0, LIVE_LATCHES, 0x07};
+    assert(len == sizeof(delta) && memcmp(frame, delta, len) == 0);
+    state.page = -1;
+    len = liveEncode(frame, sizeof(frame), 3, &sent, state);
+    assert(frame[4] == 0xFF && frame[5] == 0xFF);
+    assert(liveEncode(frame, 8, 3, NULL, state) == 0);
+
+    assert(liveEncodeError(frame, 409) == 3);
+    assert(frame[0] == LIVE_ERROR && frame[1] == (409 & 0xFF) && frame[2] == 409 >> 8);
+
+    // Commands, a deck of 10 menus with settings on page 100
+    ControlCommand command;
+    bool snap;
+    const uint8_t tap[] = {LIVE_CMD_BUTTON, 2, CONTROL_TAP, 0xFF, 0xFF};
+    assert(liveParseCommand(tap, sizeof(tap), 10, 100, command, snap) && !snap);
+    assert(command.op == CONTROL_TAP && command.button == 2 && command.page == CONTROL_PAGE_CURRENT);
+    const uint8_t press[] = {LIVE_CMD_BUTTON, 5, CONTROL_PRESS, 10, 0};
+    assert(liveParseCommand(press, sizeof(press), 10, 100, command, snap));
+    assert(command.op == CONTROL_PRESS && command.page == 10);
+    const uint8_t settings[] = {LIVE_CMD_PAGE, 100, 0};
+    assert(liveParseCommand(settings, sizeof(settings), 10, 100, command, snap));
+    assert(command.op == CONTROL_PAGE && command.page == 100);
+    const uint8_t again[] = {LIVE_CMD_SNAPSHOT};
+    assert(liveParseCommand(again, sizeof(again), 10, 100, command, snap) && snap);
+
+    const uint8_t noMenu[] = {LIVE_CMD_PAGE, 11, 0};
+    const uint8_t noCurrent[] = {LIVE_CMD_PAGE, 0xFF, 0xFF};
+    const uint8_t badKey[] = {LIVE_CMD_BUTTON, 6, CONTROL_TAP, 0, 0};
+    const uint8_t badOp[] = {LIVE_CMD_BUTTON, 1, CONTROL_PAGE, 0, 0};
+    const uint8_t shortFrame[] = {LIVE_CMD_BUTTON, 1, CONTROL_TAP};
+    const uint8_t unknown[] = {0x7F};
+    assert(!liveParseCommand(noMenu, sizeof(noMenu), 10, 100, command, snap));
+    assert(!liveParseCommand(noCurrent, sizeof(noCurrent), 10, 100, command, snap));
+    assert(!liveParseCommand(badKey, sizeof(badKey), 10, 100, command, snap));
+    assert(!liveParseCommand(badOp, sizeof(badOp), 10, 100, command, snap));
+    assert(!liveParseCommand(shortFrame, sizeof(shortFrame), 10, 100, command, snap));
+    assert(!liveParseCommand(unknown, sizeof(unknown), 10, 100, command, snap));
+    assert(!liveParseCommand(unknown, 0, 10, 100, command, snap) && !snap);
+
+    std::cout << "✓ Live state tests passed!" << std::endl;
+}
+
+// Decodes the rows of a region as a stream client would
+static size_t unRle(const uint8_t *data, size_t len, uint16_t *pixels, size_t count) {
+    size_t pos = 0, n = 0;
+    while (pos < len && n < count) {
+        uint8_t op = data[pos++];
+        if (op & 0x80) {
+            uint16_t pixel = data[pos] | (data[pos + 1] << 8);
+            pos += 2;
+            for (int i = 0; i <= (op & 0x7F); i++) {
+                pixels[n++] = pixel;
+            }
+        } else {
+            for (int i = 0; i <= op; i++, pos += 2) {
+                pixels[n++] = data[pos] | (data[pos + 1] << 8);
+            }
+        }
+    }
+    assert(pos == len);
+    return n;
+}
+
+void test_screenMirror() {
+    std::cout << "Testing screen mirror..." << std::endl;
+
+    // The 320x240 keypad of main.cpp
+    MirrorLayout layout;
+    mirrorLayoutInit(layout, 320, 240, 320 / 6, 240 / 4, (320 / 3) - 320 / 24,
+                     (320 / 3) - 240 / 16, 320 / 24, 240 / 16, 2);
+    assert(layout.left == 7 && layout.top == 15 && layout.keyW == 93 && layout.keyH == 91);
+    assert(layout.stepX == 106 && layout.stepY == 106);
+    assert(layout.logoX == 10 && layout.logoY == 9 && layout.dotX == 7 && layout.dotY == 6);
+    assert(mirrorKeyLeft(layout, 5) == 219 && mirrorKeyTop(layout, 5) == 121);
+    assert(mirrorKeyRow(layout, 14) == -1 && mirrorKeyRow(layout, 15) == 0);
+    assert(mirrorKeyRow(layout, 106) == -1 && mirrorKeyRow(layout, 211) == 1);
+    assert(mirrorKeyRow(layout, 212) == -1);
+
+    MirrorScreen screen;
+    memset(&screen, 0, sizeof(screen));
+    screen.background = 0x1111;
+    screen.latchColour = 0x2222;
+    for (int b = 0; b < MIRROR_KEYS; b++) {
+        screen.keys[b].fill = 0x3333;
+        screen.keys[b].icon = ICON_NONE;
+        screen.keys[b].flags = MIRROR_KEY_DRAWN;
+    }
+    uint16_t row[320];
+
+    // Between the keys only the background, a key has a white outline
+    mirrorRenderRow(screen, layout, 0, NULL, row);
+    for (int x = 0; x < 320; x++) assert(row[x] == 0x1111);
+    mirrorRenderRow(screen, layout, 60, NULL, row);
+    assert(row[6] == 0x1111 && row[7] == MIRROR_OUTLINE && row[8] == 0x3333);
+    assert(row[99] == MIRROR_OUTLINE && row[100] == 0x1111 && row[113] == MIRROR_OUTLINE);
+    // Rounded corners
+    mirrorRenderRow(screen, layout, 15, NULL, row);
+    assert(row[7] == 0x1111 && row[29] == MIRROR_OUTLINE && row[50] == MIRROR_OUTLINE);
+    mirrorRenderRow(screen, layout, 16, NULL, row);
+    assert(row[8] == 0x1111 && row[50] == 0x3333);
+
+    // Black logo pixels are left out of a transparent key
+    const uint16_t logoPixels[] = {0x0000, 0x4444, 0x0000};
+    MirrorLogoRow logos[MIRROR_KEYS] = {};
+    logos[0].pixels = logoPixels;
+    logos[0].width = 3;
+    logos[1] = logos[0];
+    screen.keys[0].flags |= MIRROR_KEY_TRANSPARENT;
+    mirrorRenderRow(screen, layout, 60, logos, row);
+    assert(row[17] == 0x3333 && row[18] == 0x4444 && row[19] == 0x3333);
+    assert(row[123] == 0x0000 && row[124] == 0x4444 && row[125] == 0x0000);
+
+    // A pressed key is white without its logo, a key not drawn is background
+    screen.keys[1].flags |= MIRROR_KEY_PRESSED;
+    screen.keys[2].flags = 0;
+    mirrorRenderRow(screen, layout, 60, logos, row);
+    assert(row[124] == MIRROR_OUTLINE && row[150] == MIRROR_OUTLINE);
+    assert(row[250] == 0x1111);
+
+    // The latch dot goes over the logo
+    screen.keys[0].flags |= MIRROR_KEY_LATCH_DOT;
+    mirrorRenderRow(screen, layout, 30, logos, row);
+    assert(row[13] == 0x3333 && row[14] == 0x2222 && row[18] == 0x2222 && row[31] == 0x2222);
+    assert(row[32] == 0x3333);
+
+    // Damage
+    MirrorScreen now = screen;
+    assert(mirrorDamage(NULL, now) == MIRROR_DAMAGE_SCREEN);
+    assert(mirrorDamage(&screen, now) == 0);
+    now.keys[1].generation++;
+    now.keys[4].generation++;
+    assert(mirrorDamage(&screen, now) == ((1 << 1) | (1 << 4)));
+    assert(mirrorRegionCount(mirrorDamage(&screen, now)) == 2);
+    now.background = 0;
+    assert(mirrorDamage(&screen, now) == MIRROR_DAMAGE_SCREEN);
+    assert(mirrorRegionCount(MIRROR_DAMAGE_SCREEN | 0x3F) == 1);
+
+    // BMP rows as drawBmpInternal() reads them
+    const uint8_t rgb[] = {0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF};
+    assert(mirrorBmpPixel(rgb, 24, 0, NULL) == 0x001F && mirrorBmpPixel(rgb, 24, 1, NULL) == 0xF800);
+    const uint8_t rgb565[] = {0x34, 0x12};
+    assert(mirrorBmpPixel(rgb565, 16, 0, NULL) == 0x1234);
+    const uint16_t palette[16] = {0xAAAA, 0xBBBB, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 0xFFFF};
+    const uint8_t nibbles[] = {0x1F};
+    assert(mirrorBmpPixel(nibbles, 4, 0, palette) == 0xBBBB && mirrorBmpPixel(nibbles, 4, 1, palette) == 0xFFFF);
+    const uint8_t bits[] = {0x80};
+    assert(mirrorBmpPixel(bits, 1, 0, palette) == 0xBBBB && mirrorBmpPixel(bits, 1, 1, palette) == 0xAAAA);
+    assert(mirrorBmpStride(75, 24) == 228 && mirrorBmpStride(75, 4) == 40 && mirrorBmpStride(75, 1) == 12);
+
+    // The /screen image, top row first
+    uint8_t header[MIRROR_BMP_HEADER_SIZE];
+    assert(mirrorBmpHeader(header, 320, 240) == MIRROR_BMP_HEADER_SIZE);
+    assert(mirrorBmpSize(320, 240) == 66 + 640 * 240);
+    assert(header[0] == 'B' && header[1] == 'M' && header[10] == 66 && header[28] == 16);
+    assert(header[2] == (mirrorBmpSize(320, 240) & 0xFF) && header[30] == 3);
+    assert(header[22] == 0x10 && header[23] == 0xFF && header[25] == 0xFF);
+    assert(header[54] == 0x00 && header[55] == 0xF8 && header[58] == 0xE0 && header[59] == 0x07);
+
+    // Stream headers
+    uint8_t frame[MIRROR_REGION_HEADER_SIZE];
+    assert(mirrorFrameHeader(frame, 0x0102, 3) == 4);
+    assert(frame[0] == 'S' && frame[1] == 0x02 && frame[2] == 0x01 && frame[3] == 3);
+    assert(mirrorRegionHeader(frame, layout, 4) == 9);
+    const uint8_t region[] = {4, 113, 0, 121, 0, 93, 0, 91, 0};
+    assert(memcmp(frame, region, sizeof(region)) == 0);
+    mirrorRegionHeader(frame, layout, MIRROR_REGION_SCREEN);
+    assert(frame[0] == 0xFF && frame[1] == 0 && frame[5] == 64 && frame[6] == 1 && frame[7] == 240);
+
+    // RLE: runs and literals
+    const uint16_t simple[] = {0xAAAA, 0xAAAA, 0xAAAA, 0x1234, 0x5678};
+    uint8_t rle[MIRROR_RLE_SIZE(320)];
+    const uint8_t simpleRle[] = {0x82, 0xAA, 0xAA, 0x01, 0x34, 0x12, 0x78, 0x56};
+    assert(mirrorRleRow(simple, 5, rle) == sizeof(simpleRle));
+    assert(memcmp(rle, simpleRle, sizeof(simpleRle)) == 0);
+
+    // A rendered row of keys takes a few bytes
+    mirrorRenderRow(screen, layout, 60, NULL, row);
+    size_t len = mirrorRleRow(row, 320, rle);
+    assert(len < 40);
+    uint16_t back[320];
+    assert(unRle(rle, len, back, 320) == 320 && memcmp(back, row, sizeof(row)) == 0);
+
+    // Runs longer than 128, and noise, stay in MIRROR_RLE_SIZE
+    uint32_t seed = 1;
+    for (int pattern = 0; pattern < 4; pattern++) {
+        for (int x = 0; x < 320; x++) {
+            seed = seed * 1103515245 + 12345;
+            row[x] = pattern == 0 ? 0x7777
+                   : pattern == 1 ? (uint16_t)x
+                   : pattern == 2 ? (uint16_t)((seed >> 16) & 3)
+                   : (uint16_t)(x % 3 == 2 ? x : 9);
+        }
+        len = mirrorRleRow(row, 320, rle);
+        assert(len <= MIRROR_RLE_SIZE(320));
+        assert(unRle(rle, len, back, 320) == 320 && memcmp(back, row, sizeof(row)) == 0);
+    }
+    assert(mirrorRleRow(row, 0, rle) == 0);
+
+    std::cout << "✓ Screen mirror tests passed!" << std::endl;
+}
+
+void test_metrics() {
+    std::cout << "Testing metrics..." << std::endl;
+
+    DeckMetrics deck;
+    metricsReset(deck);
+    // The first start only sets the time, the next ones are iterations
+    metricsLoopStart(deck, 1000);
+    assert(deck.loopUs.count == 0);
+    metricsLoopStart(deck, 1500);
+    metricsLoopStart(deck, 2500);
+    assert(deck.loopUs.count == 2 && deck.loopUs.sumUs == 1500);
+    deck.touches = 3;
+    deck.hidReports = 5;
+
+    char buf[METRICS_ENTRY_SIZE];
+    size_t len = metricsValue(buf, sizeof(buf), "touches_total", "counter",
+                              "Touches.", 3);
+    assert(len == strlen(buf));
+    assert(strcmp(buf, "# HELP freetouchdeck_touches_total Touches.\n"
+                       "# TYPE freetouchdeck_touches_total counter\n"
+                       "freetouchdeck_touches_total 3\n") == 0);
+    // Too small a buffer writes nothing usable
+    assert(metricsValue(buf, 20, "touches_total", "counter", "Touches.", 3) == 0);
+
+    len = metricsSummary(buf, sizeof(buf), "loop_seconds", "Loop.", deck.loopUs);
+    assert(len > 0);
+    assert(strstr(buf, "# TYPE freetouchdeck_loop_seconds summary\n"));
+    assert(strstr(buf, "freetouchdeck_loop_seconds{quantile=\"0.5\"} "));
+    assert(strstr(buf, "freetouchdeck_loop_seconds{quantile=\"0.99\"} "));
+    assert(strstr(buf, "freetouchdeck_loop_seconds_sum 0.001500\n"));
+    assert(strstr(buf, "freetouchdeck_loop_seconds_count 2\n"));
+    assert(metricsSummary(buf, 80, "loop_seconds", "Loop.", deck.loopUs) == 0);
+
+    MetricsSnapshot s;
+    memset(&s, 0, sizeof(s));
+    s.uptimeMs = 61500;
+    s.heapFree = 120000;
+    s.psramSize = 4000;
+    s.psramFree = 1000;
+    s.bleConnected = 1;
+    s.deck = deck;
+
+    // Every metric fits an entry and the walk ends
+    std::string all;
+    uint8_t count = 0;
+    while ((len = metricsEntry(s, count, buf, sizeof(buf))) > 0) {
+        all.append(buf, len);
+        count++;
+    }
+    assert(count == 17);
+    assert(all.find("freetouchdeck_uptime_seconds 61\n") != std::string::npos);
+    assert(all.find("freetouchdeck_heap_free_bytes 120000\n") != std::string::npos);
+    assert(all.find("freetouchdeck_psram_used_bytes 3000\n") != std::string::npos);
+    assert(all.find("freetouchdeck_ble_connected 1\n") != std::string::npos);
+    assert(all.find("freetouchdeck_hid_reports_total 5\n") != std::string::npos);
+
+    // Small response buffers give the same text as the entries
+    size_t sizes[] = {1, 7, 64, 1436};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        MetricsWalk walk;
+        walk.snapshot = s;
+        metricsBegin(walk);
+        std::string out;
+        uint8_t chunk[1436];
+        size_t n;
+        while ((n = metricsFill(walk, chunk, sizes[i])) > 0) {
+            assert(n <= sizes[i]);
+            out.append((const char *)chunk, n);
+        }
+        assert(out == all);
+        assert(metricsFill(walk, chunk, sizes[i]) == 0);
+    }
+
+    std::cout << "✓ Metrics tests passed!" << std::endl;
+}
+
+// A BMP with a 40 or 108 byte info header, pixel(x, y) gives the colour of
+// row y from the top as BGR888, or the palette index
+static std::vector<uint8_t> makeBmp(int w, int h, int bpp, uint32_t compression,
+                                    uint32_t infoSize, bool topDown,
+                                    const std::vector<uint32_t> &extra,
+                                    uint32_t (*pixel)(int x, int y)) {
+    uint32_t stride = ((uint32_t)w * bpp + 31) / 32 * 4;
+    uint32_t offset = 14 + infoSize + extra.size() * 4;
+    std::vector<uint8_t> bmp(offset + stride * h, 0);
+    bmp[0] = 'B';
+    bmp[1] = 'M';
+    iconPut32(&bmp[2], bmp.size());
+    iconPut32(&bmp[10], offset);
+    iconPut32(&bmp[14], infoSize);
+    iconPut32(&bmp[18], w);
+    iconPut32(&bmp[22], topDown ? (uint32_t)-h : (uint32_t)h);
+    iconPut16(&bmp[26], 1);
+    iconPut16(&bmp[28], bpp);
+    iconPut32(&bmp[30], compression);
+    // Masks or palette entries after the info header
+    for (size_t i = 0; i < extra.size(); i++) {
+        iconPut32(&bmp[14 + infoSize + i * 4], extra[i]);
+    }
+    for (int y = 0; y < h; y++) {
+        uint8_t *row = &bmp[offset + stride * (topDown ? y : h - 1 - y)];
+        for (int x = 0; x < w; x++) {
+            uint32_t v = pixel(x, y);
+            if (bpp == 1) {
+                row[x / 8] |= v << (7 - x % 8);
+            } else if (bpp == 8) {
+                row[x] = v;
+            } else {
+                for (int k = 0; k < bpp / 8; k++) {
+                    row[x * bpp / 8 + k] = (v >> (8 * k)) & 0xFF;
+                }
+            }
+        }
+    }
+    return bmp;
+}
+
+static uint16_t bgrTo565(uint32_t v) {
+    return ((v >> 16 & 0xF8) << 8) | ((v >> 8 & 0xFC) << 3) | ((v & 0xFF) >> 3);
+}
+
+static uint16_t nativePixel(const IconTranscode &t, int x, int y) {
+    return iconGet16(t.pixels + y * ICON_NATIVE_STRIDE(t.width) + 2 * x);
+}
+
+static IconTranscodeState feedBmp(IconTranscode &t, const std::vector<uint8_t> &bmp,
+                                  size_t chunk) {
+    iconTranscodeBegin(t);
+    IconTranscodeState state = ICON_TRANSCODE_HEADER;
+    for (size_t pos = 0; pos < bmp.size(); pos += chunk) {
+        state = iconTranscodeFeed(t, &bmp[pos], std::min(chunk, bmp.size() - pos));
+    }
+    return state;
+}
+
+// A black frame around a gradient, no two pixels alike in RGB565
+static uint32_t framedPixel(int x, int y) {
+    if (x == 0 || x == 4 || y == 0) {
+        return 0;
+    }
+    return (uint32_t)(x * 40) << 16 | (uint32_t)(y * 60) << 8 | 0x18;
+}
+
+// Each source pixel has its own RGB565, x and y can be read back
+static uint32_t positionPixel(int x, int y) {
+    return (uint32_t)((x & 31) << 3) << 16 | (uint32_t)((y & 63) << 2) << 8 |
+           ((x >> 5) << 3);
+}
+
+static uint32_t stripePixel(int x, int y) { return x >= 3 && x < 7 && y == 1; }
+static uint32_t rgb555Pixel(int x, int y) { return (31 << 10) | (x << 5) | y; }
+static uint32_t rgb565Pixel(int x, int y) { return (x << 11) | (y << 5) | 7; }
+
+void test_iconTranscode() {
+    std::cout << "Testing icon transcoding..." << std::endl;
+
+    assert(iconTranscodeWanted("logo.bmp") && iconTranscodeWanted("LOGO.BMP"));
+    assert(!iconTranscodeWanted("logo.png") && !iconTranscodeWanted("bmp"));
+
+    // Sources up to ICON_NATIVE_SIZE keep their size, larger ones their shape
+    uint16_t w, h;
+    iconTranscodeSize(75, 75, w, h);
+    assert(w == 75 && h == 75);
+    iconTranscodeSize(150, 100, w, h);
+    assert(w == 75 && h == 50);
+    iconTranscodeSize(2000, 10, w, h);
+    assert(w == 75 && h == 1);
+
+    IconTranscode *t = new IconTranscode();
+
+    // 24 bpp bottom up with a V4 header, as the logos in data/, in any chunks
+    std::vector<uint8_t> bmp = makeBmp(5, 3, 24, 0, 108, false, {}, framedPixel);
+    size_t chunks[] = {1, 3, 7, 64, 100000};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        assert(feedBmp(*t, bmp, chunks[i]) == ICON_TRANSCODE_DONE);
+        assert(t->width == 5 && t->height == 3);
+        for (int y = 0; y < 3; y++) {
+            for (int x = 0; x < 5; x++) {
+                assert(nativePixel(*t, x, y) == bgrTo565(framedPixel(x, y)));
+            }
+        }
+        // The bottom left pixel, the first a bottom-up BMP stores
+        assert(t->background == 0);
+        assert(t->spans[0][0] == 0 && t->spans[0][1] == 0);
+        assert(t->spans[1][0] == 1 && t->spans[1][1] == 4);
+    }
+
+    // The native logo is a top down RGB565 BMP the icon table can read
+    uint8_t header[ICON_NATIVE_HEADER_MAX];
+    size_t headerLen = iconNativeHeader(*t, header);
+    assert(headerLen == ICON_NATIVE_HEADER_SIZE(3) && headerLen % 4 == 0);
+    assert(iconNativeFileSize(*t) == headerLen + 12 * 3);
+    assert(iconGet32(header + 10) == headerLen && iconGet32(header + 2) == iconNativeFileSize(*t));
+    assert(iconNativeCheck(header, headerLen));
+    IconInfo info = {};
+    uint32_t dataOffset = 0;
+    assert(iconInfoFromBmpHeader(header, headerLen, info, dataOffset));
+    assert(info.width == 5 && info.height == 3 && info.bpp == 16);
+    assert((info.flags & ICON_INFO_NATIVE) && dataOffset == headerLen);
+    assert(header[ICON_NATIVE_BLOCK + 4] == 1 && header[ICON_NATIVE_BLOCK + 5] == 4);
+    assert(!iconNativeCheck(&bmp[0], bmp.size()));
+
+    // Feeding a native logo again gives the same pixels
+    std::vector<uint8_t> native(header, header + headerLen);
+    native.insert(native.end(), t->pixels, t->pixels + 12 * 3);
+    std::vector<uint8_t> pixels(t->pixels, t->pixels + 12 * 3);
+    assert(feedBmp(*t, native, 5) == ICON_TRANSCODE_DONE);
+    assert(t->width == 5 && t->height == 3 && t->format == ICON_SOURCE_RGB565);
+    assert(memcmp(t->pixels, pixels.data(), pixels.size()) == 0);
+
+    // Larger sources are sampled at the centre of each pixel of the logo
+    bmp = makeBmp(150, 100, 24, 0, 40, false, {}, positionPixel);
+    assert(feedBmp(*t, bmp, 512) == ICON_TRANSCODE_DONE);
+    assert(t->width == 75 && t->height == 50);
+    for (int y = 0; y < 50; y++) {
+        for (int x = 0; x < 75; x++) {
+            assert(nativePixel(*t, x, y) == bgrTo565(positionPixel(2 * x + 1, 2 * y + 1)));
+        }
+    }
+    bmp = makeBmp(100, 300, 32, 0, 40, true, {}, positionPixel);
+    assert(feedBmp(*t, bmp, 1000) == ICON_TRANSCODE_DONE);
+    assert(t->width == 25 && t->height == 75);
+    assert(nativePixel(*t, 0, 0) == bgrTo565(positionPixel(2, 2)));
+    assert(nativePixel(*t, 24, 74) == bgrTo565(positionPixel(98, 298)));
+
+    // 1 bpp with its palette, and an 8 bpp one using 2 colours
+    std::vector<uint32_t> palette = {0x000000, 0xFFFFFF};
+    bmp = makeBmp(10, 2, 1, 0, 40, false, palette, stripePixel);
+    assert(feedBmp(*t, bmp, 1) == ICON_TRANSCODE_DONE);
+    assert(nativePixel(*t, 2, 1) == 0 && nativePixel(*t, 3, 1) == 0xFFFF);
+    assert(t->spans[1][0] == 3 && t->spans[1][1] == 7);
+    bmp = makeBmp(10, 2, 8, 0, 40, false, palette, stripePixel);
+    iconPut32(&bmp[46], 2);
+    assert(feedBmp(*t, bmp, 9) == ICON_TRANSCODE_DONE);
+    assert(nativePixel(*t, 6, 1) == 0xFFFF && nativePixel(*t, 7, 1) == 0);
+
+    // 16 bpp: BI_RGB is 555, BI_BITFIELDS says which
+    bmp = makeBmp(4, 3, 16, 0, 40, false, {}, rgb555Pixel);
+    assert(feedBmp(*t, bmp, 2) == ICON_TRANSCODE_DONE);
+    assert(nativePixel(*t, 3, 2) == ((31 << 11) | (3 << 6) | 2));
+    bmp = makeBmp(3, 2, 16, 3, 40, true, {0xF800, 0x07E0, 0x001F}, rgb565Pixel);
+    assert(feedBmp(*t, bmp, 4) == ICON_TRANSCODE_DONE);
+    assert(nativePixel(*t, 2, 1) == rgb565Pixel(2, 1));
+
+    // What cannot be converted
+    bmp = makeBmp(3, 2, 16, 3, 40, false, {0x0F00, 0x00F0, 0x000F}, rgb565Pixel);
+    assert(feedBmp(*t, bmp, 7) == ICON_TRANSCODE_FAILED);
+    bmp = makeBmp(4, 4, 8, 1, 40, false, palette, stripePixel); // RLE8
+    assert(feedBmp(*t, bmp, 7) == ICON_TRANSCODE_FAILED);
+    bmp = makeBmp(5, 3, 24, 0, 40, false, {}, framedPixel);
+    bmp[0] = 'P';
+    assert(feedBmp(*t, bmp, 7) == ICON_TRANSCODE_FAILED);
+    bmp[0] = 'B';
+    bmp.resize(bmp.size() - 1);
+    assert(feedBmp(*t, bmp, 7) == ICON_TRANSCODE_PIXELS);
+    bmp.resize(40);
+    assert(feedBmp(*t, bmp, 7) == ICON_TRANSCODE_HEADER);
+
+    UploadBudget budget = {};
+    budget.verdict = UPLOAD_BAD_IMAGE;
+    assert(uploadVerdictStatus(budget.verdict) == 415);
+    char text[UPLOAD_TEXT_SIZE];
+    uploadVerdictText(budget, text, sizeof(text));
+    assert(strstr(text, "BMP"));
+
+    delete t;
+    std::cout << "✓ Icon transcoding tests passed!" << std::endl;
 }
 
 int main() {
     std::cout << "Running pure function tests..." << std::endl;
     std::cout << "===============================" << std::endl;
     
-    test_getLatchLogoPath();
-    test_getLatchImageBGPure_custom_logos();
-    test_getLatchImageBGPure_fallback_logos();
-    test_getLatchImageBGPure_invalid_inputs();
-    test_getLatchImageBGPure_boundary_values();
+    test_getLatchImageIcon();
+    test_latencyHistogram();
+    test_latencyTracker_ignores_untracked_marks();
+    test_latencyTracker_per_web_load();
+    test_touchTrace_roundtrip();
+    test_touchTrace_replay_navigation_and_latch();
+    test_affineCalibration_fit();
+    test_affineCalibration_rotation();
+    test_touchRegions_dead_zones();
+    test_touchRegions_contact_and_rejection();
+    test_configSnapshot();
+    test_menuCache_lru();
+    test_menuCache_prefetch();
+    test_jsonStream_tokens();
+    test_jsonStream_menuFields();
+    test_bootPlan();
+    test_bootReport();
+    test_deckArena();
+    test_actionCode();
+    test_iconTable();
+    test_configReload();
+    test_configStore();
+    test_configSchema();
+    test_jsonChunk();
+    test_assetCache();
+    test_uploadAdmit();
+    test_remoteControl();
+    test_liveState();
+    test_screenMirror();
+    test_metrics();
+    test_iconTranscode();
     
     std::cout << "===============================" << std::endl;
     std::cout << "🎉 All tests passed!" << std::endl;